@@ -0,0 +1,405 @@
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// An Aho-Corasick automaton finds every occurrence of any word of a trie in a
+// text in a single pass. Its states are the prefixes of the words, each byte
+// of a compressed edge of the trie getting a state of its own, with
+// transitions labelled with single bytes as in a DAWG.
+//
+// The failure link of a state leads to the state of its longest proper suffix
+// which is also a prefix of a word. When a byte of the text has no transition
+// from the current state, failure links are followed until one has, so the
+// state reached is always the longest suffix of the text read so far which is
+// a prefix of a word. Since each byte read deepens the state by at most one
+// and each failure link followed makes it shallower, scanning takes time
+// linear in the length of the text plus the number of matches. The root
+// holds a transition for every byte, most of them back to itself, so that
+// following failure links always ends there.
+//
+// The output link of a state leads to the terminal state of the longest word
+// which is a proper suffix of it, if any, so the words ending at each byte of
+// the text are reported without following the failure links of states which
+// end none.
+
+// Marks the absence of a state
+#define _TRIE_AUTOMATON_NO_STATE UINT32_MAX
+
+// A state of an automaton. Its transitions are the transition_count entries
+// from first_transition in the keys and targets of the automaton, in key
+// order. depth is the length of the prefix the state stands for, and value
+// the value of that prefix if it is a word
+typedef struct {
+    uint32_t first_transition;
+    uint32_t depth;
+    uint32_t fail;
+    uint32_t output;
+    void* value;
+    uint16_t transition_count;
+    bool terminal;
+} _trie_automaton_state_t;
+
+struct trie_automaton_t {
+    size_t size;
+    _trie_automaton_state_t* states;
+    uint32_t* targets;
+    unsigned char* keys;
+    uint32_t root_targets[256];
+};
+
+// An automaton being built
+typedef struct {
+    _trie_automaton_state_t* states;
+    size_t state_count;
+    size_t state_capacity;
+    uint32_t* targets;
+    size_t targets_capacity;
+    unsigned char* keys;
+    size_t keys_capacity;
+    size_t transition_count;
+} _trie_automaton_builder_t;
+
+// Adds a state of the given depth, as yet without transitions, setting state
+// to its index. Returns false if memory allocation fails or the automaton
+// would have too many states
+bool _add_automaton_state(_trie_automaton_builder_t* builder, uint32_t depth,
+    uint32_t* state) {
+
+    if (builder->state_count == _TRIE_AUTOMATON_NO_STATE ||
+        !_reserve((void**) &(builder->states), &(builder->state_capacity),
+            builder->state_count+1, sizeof(_trie_automaton_state_t))) {
+        return false;
+    }
+
+    _trie_automaton_state_t* added = &(builder->states[builder->state_count]);
+    added->first_transition = 0U;
+    added->depth = depth;
+    added->fail = 0U;
+    added->output = _TRIE_AUTOMATON_NO_STATE;
+    added->value = NULL;
+    added->transition_count = 0U;
+    added->terminal = false;
+
+    *state = (uint32_t) builder->state_count;
+    builder->state_count++;
+
+    return true;
+}
+
+// Makes room for count transitions from state, which must have none yet.
+// Returns false if memory allocation fails or the automaton would have too
+// many transitions
+bool _add_automaton_transitions(_trie_automaton_builder_t* builder,
+    uint32_t state, uint16_t count) {
+
+    size_t needed = builder->transition_count + count;
+    if (needed >= _TRIE_AUTOMATON_NO_STATE ||
+        !_reserve((void**) &(builder->targets),
+            &(builder->targets_capacity), needed, sizeof(uint32_t)) ||
+        !_reserve((void**) &(builder->keys), &(builder->keys_capacity),
+            needed, 1U)) {
+        return false;
+    }
+
+    builder->states[state].first_transition =
+        (uint32_t) builder->transition_count;
+    builder->states[state].transition_count = count;
+    builder->transition_count = needed;
+
+    return true;
+}
+
+// Sets the key and target of the transition at index i from state
+void _set_automaton_transition(_trie_automaton_builder_t* builder,
+    uint32_t state, uint16_t i, unsigned char key, uint32_t target) {
+
+    uint32_t transition = builder->states[state].first_transition + i;
+    builder->keys[transition] = key;
+    builder->targets[transition] = target;
+}
+
+// Adds the transitions of state, which stands for node, and the states below
+// it, each byte of the label of a child leading to a state of its own.
+// Returns false if memory allocation fails or the automaton would be too
+// large
+bool _add_automaton_node_states(_trie_automaton_builder_t* builder,
+    const _trie_node_t* node, uint32_t state) {
+
+    uint32_t label_lengths[256];
+    _trie_node_t* children[256];
+    uint16_t child_count = 0U;
+
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        label_lengths[child_count] = label_length;
+        children[child_count] = child;
+        child_count++;
+    }
+
+    if (!_add_automaton_transitions(builder, state, child_count)) {
+        return false;
+    }
+
+    uint32_t depth = builder->states[state].depth;
+    for (uint16_t i = 0U; i < child_count; i++) {
+        const char* label = _get_edge_label(children[i], label_lengths[i]);
+        uint32_t from = state;
+        uint16_t from_index = i;
+        uint32_t target = state;
+        for (uint32_t j = 0U; j < label_lengths[i]; j++) {
+            if (!_add_automaton_state(builder, depth+j+1, &target)) {
+                return false;
+            }
+            _set_automaton_transition(builder, from, from_index,
+                (unsigned char) label[j], target);
+
+            // Each byte of the label but the last leads on to the next
+            if (j+1 < label_lengths[i] &&
+                !_add_automaton_transitions(builder, target, 1U)) {
+                return false;
+            }
+            from = target;
+            from_index = 0U;
+        }
+
+        _trie_automaton_state_t* child_state = &(builder->states[target]);
+        child_state->terminal = _is_terminal_node(children[i]);
+        child_state->value = child_state->terminal ?
+            __atomic_load_n(&(children[i]->value), __ATOMIC_ACQUIRE) : NULL;
+        if (!_add_automaton_node_states(builder, children[i], target)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns the state reached from state through the transition with the given
+// key, or _TRIE_AUTOMATON_NO_STATE if there is no such transition
+uint32_t _get_automaton_transition(const trie_automaton_t* automaton,
+    uint32_t state, unsigned char key) {
+
+    const _trie_automaton_state_t* from = &(automaton->states[state]);
+    const unsigned char* keys = automaton->keys + from->first_transition;
+    const unsigned char* found = memchr(keys, key, from->transition_count);
+    if (found == NULL) {
+        return _TRIE_AUTOMATON_NO_STATE;
+    }
+
+    return automaton->targets[from->first_transition + (found-keys)];
+}
+
+// Returns the state reached from state on reading key, following failure
+// links until a state with a transition for key is found
+uint32_t _next_automaton_state(const trie_automaton_t* automaton,
+    uint32_t state, unsigned char key) {
+
+    while (state != 0U) {
+        uint32_t target = _get_automaton_transition(automaton, state, key);
+        if (target != _TRIE_AUTOMATON_NO_STATE) {
+            return target;
+        }
+        state = automaton->states[state].fail;
+    }
+
+    return automaton->root_targets[key];
+}
+
+// Sets the failure and output links of every state, visiting states in
+// order of depth so that the links of shallower states are always set first.
+// Returns false if memory allocation fails
+bool _link_automaton_states(trie_automaton_t* automaton, size_t state_count) {
+    uint32_t* queue =
+        _allocate_memory(state_count * sizeof(uint32_t), TRIE_MEMORY_OTHER);
+    if (queue == NULL) {
+        return false;
+    }
+
+    const _trie_automaton_state_t* root = &(automaton->states[0]);
+    for (uint16_t key = 0U; key < 256U; key++) {
+        automaton->root_targets[key] = 0U;
+    }
+    size_t queue_count = 0U;
+    for (uint16_t i = 0U; i < root->transition_count; i++) {
+        uint32_t transition = root->first_transition + i;
+        automaton->root_targets[automaton->keys[transition]] =
+            automaton->targets[transition];
+        queue[queue_count] = automaton->targets[transition];
+        queue_count++;
+    }
+
+    for (size_t next = 0U; next < queue_count; next++) {
+        const _trie_automaton_state_t* from =
+            &(automaton->states[queue[next]]);
+        for (uint16_t i = 0U; i < from->transition_count; i++) {
+            uint32_t transition = from->first_transition + i;
+            _trie_automaton_state_t* target =
+                &(automaton->states[automaton->targets[transition]]);
+            target->fail = _next_automaton_state(
+                automaton, from->fail, automaton->keys[transition]);
+
+            const _trie_automaton_state_t* fail =
+                &(automaton->states[target->fail]);
+            target->output = fail->terminal ? target->fail : fail->output;
+
+            queue[queue_count] = automaton->targets[transition];
+            queue_count++;
+        }
+    }
+
+    _deallocate_memory(queue, state_count * sizeof(uint32_t),
+        TRIE_MEMORY_OTHER);
+
+    return true;
+}
+
+// Creates an automaton from the states built in a single block of memory,
+// and links its states. Returns NULL if memory allocation fails
+trie_automaton_t* _create_automaton(const _trie_automaton_builder_t* builder) {
+    size_t states_size =
+        builder->state_count * sizeof(_trie_automaton_state_t);
+    size_t targets_size = builder->transition_count * sizeof(uint32_t);
+    size_t size = sizeof(trie_automaton_t) + states_size + targets_size +
+        builder->transition_count;
+    char* memory = _allocate_memory(size, TRIE_MEMORY_READ_ONLY);
+    if (memory == NULL) {
+        return NULL;
+    }
+
+    trie_automaton_t* automaton = (trie_automaton_t*) memory;
+    automaton->size = size;
+    automaton->states =
+        (_trie_automaton_state_t*) (memory + sizeof(trie_automaton_t));
+    automaton->targets =
+        (uint32_t*) ((char*) automaton->states + states_size);
+    automaton->keys = (unsigned char*) automaton->targets + targets_size;
+
+    memcpy(automaton->states, builder->states, states_size);
+    if (builder->transition_count > 0U) {
+        memcpy(automaton->targets, builder->targets, targets_size);
+        memcpy(automaton->keys, builder->keys, builder->transition_count);
+    }
+
+    if (!_link_automaton_states(automaton, builder->state_count)) {
+        _deallocate_memory(memory, size, TRIE_MEMORY_READ_ONLY);
+        return NULL;
+    }
+
+    return automaton;
+}
+
+// Deallocates the memory held by builder
+void _destroy_automaton_builder(_trie_automaton_builder_t* builder) {
+    _release(builder->states, builder->state_capacity,
+        sizeof(_trie_automaton_state_t));
+    _release(builder->targets, builder->targets_capacity, sizeof(uint32_t));
+    _release(builder->keys, builder->keys_capacity, 1U);
+}
+
+trie_result_t trie_automaton_create(trie_t* trie,
+    trie_automaton_t** automaton) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    _trie_automaton_builder_t builder;
+    memset(&builder, 0, sizeof(builder));
+
+    uint32_t root;
+    trie_automaton_t* created = NULL;
+    uint64_t* active = _begin_read(trie);
+    if (_add_automaton_state(&builder, 0U, &root) &&
+        _add_automaton_node_states(&builder, trie->root, root)) {
+        created = _create_automaton(&builder);
+    }
+    _end_read(active);
+    _destroy_automaton_builder(&builder);
+    if (created == NULL) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    *automaton = created;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_scan_begin(trie_scan_t* scan) {
+    if (scan == NULL) {
+        return TRIE_NULL;
+    }
+
+    scan->state = 0U;
+    scan->offset = 0U;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_scan_chunk(const trie_automaton_t* automaton,
+    trie_scan_t* scan, const char* chunk, size_t length,
+    void (*callback)(uint64_t offset, size_t length, void* value,
+        void* context),
+    void* context) {
+
+    if (automaton == NULL || scan == NULL || callback == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (chunk == NULL && length > 0U) {
+        return TRIE_WORD_NULL;
+    }
+
+    uint32_t state = scan->state;
+    for (size_t i = 0U; i < length; i++) {
+        state = _next_automaton_state(
+            automaton, state, (unsigned char) chunk[i]);
+
+        const _trie_automaton_state_t* reached = &(automaton->states[state]);
+        uint32_t match = reached->terminal ? state : reached->output;
+        while (match != _TRIE_AUTOMATON_NO_STATE) {
+            const _trie_automaton_state_t* matched =
+                &(automaton->states[match]);
+            callback(scan->offset + i+1 - matched->depth, matched->depth,
+                matched->value, context);
+            match = matched->output;
+        }
+    }
+
+    scan->state = state;
+    scan->offset += length;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_scan(const trie_automaton_t* automaton, const char* text,
+    size_t length,
+    void (*callback)(uint64_t offset, size_t length, void* value,
+        void* context),
+    void* context) {
+
+    trie_scan_t scan;
+    trie_scan_begin(&scan);
+
+    return trie_scan_chunk(
+        automaton, &scan, text, length, callback, context);
+}
+
+trie_result_t trie_automaton_destroy(trie_automaton_t* automaton) {
+    if (automaton == NULL) {
+        return TRIE_NULL;
+    }
+
+    _deallocate_memory(automaton, automaton->size, TRIE_MEMORY_READ_ONLY);
+
+    return TRIE_SUCCESS;
+}
@@ -0,0 +1,322 @@
+
+
+/* This is auto-generated code. Edit at your own peril. */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cutest/CuTest.h"
+
+extern void test_add_null_trie_fails(CuTest*);
+extern void test_add_null_word_fails(CuTest*);
+extern void test_add_empty_string_fails(CuTest*);
+extern void test_contains_null_trie_fails(CuTest*);
+extern void test_contains_null_word_fails(CuTest*);
+extern void test_contains_with_no_words(CuTest*);
+extern void test_contains_empty_string_is_false(CuTest*);
+extern void test_contains_with_single_char_word(CuTest*);
+extern void test_contains_with_two_chars_word(CuTest*);
+extern void test_contains_with_two_overlapping_words(CuTest*);
+extern void test_contains_matches_full_word(CuTest*);
+extern void test_contains_does_not_match_prefixes(CuTest*);
+extern void test_contains_matches_prefix_words(CuTest*);
+extern void test_prefix_matches_null_trie_fails(CuTest*);
+extern void test_prefix_matches_null_prefix_fails(CuTest*);
+extern void test_prefix_matches_empty_prefix_fails(CuTest*);
+extern void test_prefix_matches_zero_words_length_fails(CuTest*);
+extern void test_get_no_prefix_matches(CuTest*);
+extern void test_get_prefix_matches(CuTest*);
+extern void test_destroy_empty_does_not_leak_memory(CuTest*);
+extern void test_destroy_single_word_trie_does_not_leak_memory(CuTest*);
+extern void test_destroy_multi_word_trie_does_not_leak_memory(CuTest*);
+extern void test_create_with_zero_sized_arena_fails(CuTest*);
+extern void test_arena_contains_words(CuTest*);
+extern void test_arena_get_prefix_matches(CuTest*);
+extern void test_arena_allocates_per_chunk(CuTest*);
+extern void test_destroy_arena_trie_does_not_leak_memory(CuTest*);
+extern void test_contains_with_every_fan_out(CuTest*);
+extern void test_get_prefix_matches_with_large_fan_out(CuTest*);
+extern void test_contains_after_splitting_edges(CuTest*);
+extern void test_get_prefix_matches_ending_within_edge(CuTest*);
+extern void test_add_word_compresses_single_child_chains(CuTest*);
+extern void test_contains_many_random_words(CuTest*);
+extern void test_prefix_matches_without_stored_words_fails(CuTest*);
+extern void test_contains_without_stored_words(CuTest*);
+extern void test_copy_prefix_matches_zero_buffer_length_fails(CuTest*);
+extern void test_copy_prefix_matches(CuTest*);
+extern void test_copy_prefix_matches_without_stored_words(CuTest*);
+extern void test_copy_prefix_matches_bounded_by_buffer(CuTest*);
+extern void test_stored_words_are_not_allocated_individually(CuTest*);
+extern void test_save_null_path_fails(CuTest*);
+extern void test_open_missing_file_fails(CuTest*);
+extern void test_open_invalid_file_fails(CuTest*);
+extern void test_open_corrupted_file_fails(CuTest*);
+extern void test_mapped_contains_words(CuTest*);
+extern void test_mapped_get_prefix_matches(CuTest*);
+extern void test_mapped_copy_prefix_matches_without_stored_words(CuTest*);
+extern void test_add_to_mapped_fails(CuTest*);
+extern void test_mapped_contains_many_random_words(CuTest*);
+extern void test_build_from_unsorted_words_fails(CuTest*);
+extern void test_build_with_prefix_after_word_fails(CuTest*);
+extern void test_build_from_sorted_contains_words(CuTest*);
+extern void test_build_from_many_sorted_random_words(CuTest*);
+extern void test_build_to_file_contains_words(CuTest*);
+extern void test_destroy_builder_does_not_leak_memory(CuTest*);
+extern void test_destroy_built_trie_does_not_leak_memory(CuTest*);
+extern void test_count_prefix(CuTest*);
+extern void test_count_prefix_empty_prefix_fails(CuTest*);
+extern void test_dawg_contains_words(CuTest*);
+extern void test_dawg_first_state_leaf(CuTest*);
+extern void test_dawg_copy_prefix_matches(CuTest*);
+extern void test_dawg_is_read_only(CuTest*);
+extern void test_dawg_contains_many_random_words(CuTest*);
+extern void test_destroy_dawg_does_not_leak_memory(CuTest*);
+extern void test_double_array_contains_words(CuTest*);
+extern void test_double_array_contains_with_every_fan_out(CuTest*);
+extern void test_double_array_copy_prefix_matches(CuTest*);
+extern void test_double_array_is_read_only(CuTest*);
+extern void test_double_array_contains_many_random_words(CuTest*);
+extern void test_destroy_double_array_does_not_leak_memory(CuTest*);
+extern void test_louds_contains_words(CuTest*);
+extern void test_louds_copy_prefix_matches(CuTest*);
+extern void test_louds_is_read_only(CuTest*);
+extern void test_louds_contains_many_random_words(CuTest*);
+extern void test_save_and_open_mapped_louds(CuTest*);
+extern void test_open_corrupted_louds_file_fails(CuTest*);
+extern void test_destroy_louds_does_not_leak_memory(CuTest*);
+extern void test_top_k_prefix_matches(CuTest*);
+extern void test_top_k_prefix_matches_ending_within_edge(CuTest*);
+extern void test_top_k_after_lowering_weight(CuTest*);
+extern void test_top_k_keeps_weights_when_splitting_edges(CuTest*);
+extern void test_top_k_on_read_only_trie_fails(CuTest*);
+extern void test_cursor_visits_words_in_order(CuTest*);
+extern void test_cursor_with_prefix_ending_within_edge(CuTest*);
+extern void test_cursor_seek(CuTest*);
+extern void test_cursor_seek_outside_prefix(CuTest*);
+extern void test_cursor_memory_too_small_fails(CuTest*);
+extern void test_cursor_word_too_long_fails(CuTest*);
+extern void test_cursor_does_not_allocate_memory(CuTest*);
+extern void test_cursor_visits_many_random_words_in_order(CuTest*);
+extern void test_concurrent_trie_contains_many_random_words(CuTest*);
+extern void test_destroy_concurrent_trie_does_not_leak_memory(CuTest*);
+extern void test_concurrent_readers_while_adding_words(CuTest*);
+extern void test_concurrent_writers_add_every_word(CuTest*);
+extern void test_contains_words_batch(CuTest*);
+extern void test_contains_words_batch_with_null_word_fails(CuTest*);
+extern void test_remove_word(CuTest*);
+extern void test_remove_word_with_every_fan_out(CuTest*);
+extern void test_remove_many_random_words(CuTest*);
+extern void test_remove_weighted_word(CuTest*);
+extern void test_remove_word_from_concurrent_trie(CuTest*);
+extern void test_remove_word_from_read_only_trie_fails(CuTest*);
+extern void test_remove_all_words_and_compact_frees_memory(CuTest*);
+extern void test_compact_keeps_words(CuTest*);
+extern void test_keys_with_nul_bytes(CuTest*);
+extern void test_remove_and_compact_keys_with_nul_bytes(CuTest*);
+extern void test_read_only_tries_with_keys_with_nul_bytes(CuTest*);
+extern void test_contains_keys_batch(CuTest*);
+extern void test_cursor_visits_keys_with_nul_bytes(CuTest*);
+extern void test_add_empty_key_fails(CuTest*);
+extern void test_put_and_get_values(CuTest*);
+extern void test_copy_entries_matching_prefix(CuTest*);
+extern void test_values_on_read_only_trie_fail(CuTest*);
+extern void test_prefix_matches(CuTest*);
+extern void test_prefix_matches_with_invalid_arguments_fail(CuTest*);
+extern void test_scan_finds_overlapping_words(CuTest*);
+extern void test_scan_chunks(CuTest*);
+extern void test_scan_many_random_words(CuTest*);
+extern void test_automaton_create_on_read_only_trie_fails(CuTest*);
+extern void test_destroy_automaton_does_not_leak_memory(CuTest*);
+extern void test_fuzzy_search_orders_by_distance(CuTest*);
+extern void test_fuzzy_search_any_distance(CuTest*);
+extern void test_fuzzy_prefix_search(CuTest*);
+extern void test_fuzzy_search_many_random_words(CuTest*);
+extern void test_fuzzy_search_binary_keys(CuTest*);
+extern void test_fuzzy_search_on_read_only_trie_fails(CuTest*);
+extern void test_fuzzy_search_with_invalid_arguments_fails(CuTest*);
+extern void test_fuzzy_search_does_not_leak_memory(CuTest*);
+extern void test_match_pattern(CuTest*);
+extern void test_match_pattern_many_random_words(CuTest*);
+extern void test_match_pattern_binary_keys(CuTest*);
+extern void test_match_pattern_with_invalid_arguments_fails(CuTest*);
+extern void test_match_pattern_does_not_leak_memory(CuTest*);
+extern void test_range(CuTest*);
+extern void test_successor_and_predecessor(CuTest*);
+extern void test_successor_and_predecessor_after_concurrent_removal(CuTest*);
+extern void test_range_and_neighbours_of_many_random_words(CuTest*);
+extern void test_range_and_neighbours_of_binary_keys(CuTest*);
+extern void test_range_with_invalid_arguments_fails(CuTest*);
+extern void test_rank_and_select(CuTest*);
+extern void test_counts_of_many_random_words(CuTest*);
+extern void test_rank_and_select_with_invalid_arguments_fails(CuTest*);
+extern void test_get_stats(CuTest*);
+extern void test_get_stats_of_empty_and_deep_tries(CuTest*);
+extern void test_get_stats_bytes_match_sized_listeners(CuTest*);
+extern void test_sized_memory_listeners_balance(CuTest*);
+extern void test_get_stats_with_invalid_arguments_fails(CuTest*);
+extern void test_remove_word_keeps_edges_compressed(CuTest*);
+
+void RunAllTests(void) {
+    CuString *output = CuStringNew();
+    CuSuite* suite = CuSuiteNew();
+
+    SUITE_ADD_TEST(suite, test_add_null_trie_fails);
+    SUITE_ADD_TEST(suite, test_add_null_word_fails);
+    SUITE_ADD_TEST(suite, test_add_empty_string_fails);
+    SUITE_ADD_TEST(suite, test_contains_null_trie_fails);
+    SUITE_ADD_TEST(suite, test_contains_null_word_fails);
+    SUITE_ADD_TEST(suite, test_contains_with_no_words);
+    SUITE_ADD_TEST(suite, test_contains_empty_string_is_false);
+    SUITE_ADD_TEST(suite, test_contains_with_single_char_word);
+    SUITE_ADD_TEST(suite, test_contains_with_two_chars_word);
+    SUITE_ADD_TEST(suite, test_contains_with_two_overlapping_words);
+    SUITE_ADD_TEST(suite, test_contains_matches_full_word);
+    SUITE_ADD_TEST(suite, test_contains_does_not_match_prefixes);
+    SUITE_ADD_TEST(suite, test_contains_matches_prefix_words);
+    SUITE_ADD_TEST(suite, test_prefix_matches_null_trie_fails);
+    SUITE_ADD_TEST(suite, test_prefix_matches_null_prefix_fails);
+    SUITE_ADD_TEST(suite, test_prefix_matches_empty_prefix_fails);
+    SUITE_ADD_TEST(suite, test_prefix_matches_zero_words_length_fails);
+    SUITE_ADD_TEST(suite, test_get_no_prefix_matches);
+    SUITE_ADD_TEST(suite, test_get_prefix_matches);
+    SUITE_ADD_TEST(suite, test_destroy_empty_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_destroy_single_word_trie_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_destroy_multi_word_trie_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_create_with_zero_sized_arena_fails);
+    SUITE_ADD_TEST(suite, test_arena_contains_words);
+    SUITE_ADD_TEST(suite, test_arena_get_prefix_matches);
+    SUITE_ADD_TEST(suite, test_arena_allocates_per_chunk);
+    SUITE_ADD_TEST(suite, test_destroy_arena_trie_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_contains_with_every_fan_out);
+    SUITE_ADD_TEST(suite, test_get_prefix_matches_with_large_fan_out);
+    SUITE_ADD_TEST(suite, test_contains_after_splitting_edges);
+    SUITE_ADD_TEST(suite, test_get_prefix_matches_ending_within_edge);
+    SUITE_ADD_TEST(suite, test_add_word_compresses_single_child_chains);
+    SUITE_ADD_TEST(suite, test_contains_many_random_words);
+    SUITE_ADD_TEST(suite, test_prefix_matches_without_stored_words_fails);
+    SUITE_ADD_TEST(suite, test_contains_without_stored_words);
+    SUITE_ADD_TEST(suite, test_copy_prefix_matches_zero_buffer_length_fails);
+    SUITE_ADD_TEST(suite, test_copy_prefix_matches);
+    SUITE_ADD_TEST(suite, test_copy_prefix_matches_without_stored_words);
+    SUITE_ADD_TEST(suite, test_copy_prefix_matches_bounded_by_buffer);
+    SUITE_ADD_TEST(suite, test_stored_words_are_not_allocated_individually);
+    SUITE_ADD_TEST(suite, test_save_null_path_fails);
+    SUITE_ADD_TEST(suite, test_open_missing_file_fails);
+    SUITE_ADD_TEST(suite, test_open_invalid_file_fails);
+    SUITE_ADD_TEST(suite, test_open_corrupted_file_fails);
+    SUITE_ADD_TEST(suite, test_mapped_contains_words);
+    SUITE_ADD_TEST(suite, test_mapped_get_prefix_matches);
+    SUITE_ADD_TEST(suite, test_mapped_copy_prefix_matches_without_stored_words);
+    SUITE_ADD_TEST(suite, test_add_to_mapped_fails);
+    SUITE_ADD_TEST(suite, test_mapped_contains_many_random_words);
+    SUITE_ADD_TEST(suite, test_build_from_unsorted_words_fails);
+    SUITE_ADD_TEST(suite, test_build_with_prefix_after_word_fails);
+    SUITE_ADD_TEST(suite, test_build_from_sorted_contains_words);
+    SUITE_ADD_TEST(suite, test_build_from_many_sorted_random_words);
+    SUITE_ADD_TEST(suite, test_build_to_file_contains_words);
+    SUITE_ADD_TEST(suite, test_destroy_builder_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_destroy_built_trie_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_count_prefix);
+    SUITE_ADD_TEST(suite, test_count_prefix_empty_prefix_fails);
+    SUITE_ADD_TEST(suite, test_dawg_contains_words);
+    SUITE_ADD_TEST(suite, test_dawg_first_state_leaf);
+    SUITE_ADD_TEST(suite, test_dawg_copy_prefix_matches);
+    SUITE_ADD_TEST(suite, test_dawg_is_read_only);
+    SUITE_ADD_TEST(suite, test_dawg_contains_many_random_words);
+    SUITE_ADD_TEST(suite, test_destroy_dawg_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_double_array_contains_words);
+    SUITE_ADD_TEST(suite, test_double_array_contains_with_every_fan_out);
+    SUITE_ADD_TEST(suite, test_double_array_copy_prefix_matches);
+    SUITE_ADD_TEST(suite, test_double_array_is_read_only);
+    SUITE_ADD_TEST(suite, test_double_array_contains_many_random_words);
+    SUITE_ADD_TEST(suite, test_destroy_double_array_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_louds_contains_words);
+    SUITE_ADD_TEST(suite, test_louds_copy_prefix_matches);
+    SUITE_ADD_TEST(suite, test_louds_is_read_only);
+    SUITE_ADD_TEST(suite, test_louds_contains_many_random_words);
+    SUITE_ADD_TEST(suite, test_save_and_open_mapped_louds);
+    SUITE_ADD_TEST(suite, test_open_corrupted_louds_file_fails);
+    SUITE_ADD_TEST(suite, test_destroy_louds_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_top_k_prefix_matches);
+    SUITE_ADD_TEST(suite, test_top_k_prefix_matches_ending_within_edge);
+    SUITE_ADD_TEST(suite, test_top_k_after_lowering_weight);
+    SUITE_ADD_TEST(suite, test_top_k_keeps_weights_when_splitting_edges);
+    SUITE_ADD_TEST(suite, test_top_k_on_read_only_trie_fails);
+    SUITE_ADD_TEST(suite, test_cursor_visits_words_in_order);
+    SUITE_ADD_TEST(suite, test_cursor_with_prefix_ending_within_edge);
+    SUITE_ADD_TEST(suite, test_cursor_seek);
+    SUITE_ADD_TEST(suite, test_cursor_seek_outside_prefix);
+    SUITE_ADD_TEST(suite, test_cursor_memory_too_small_fails);
+    SUITE_ADD_TEST(suite, test_cursor_word_too_long_fails);
+    SUITE_ADD_TEST(suite, test_cursor_does_not_allocate_memory);
+    SUITE_ADD_TEST(suite, test_cursor_visits_many_random_words_in_order);
+    SUITE_ADD_TEST(suite, test_concurrent_trie_contains_many_random_words);
+    SUITE_ADD_TEST(suite, test_destroy_concurrent_trie_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_concurrent_readers_while_adding_words);
+    SUITE_ADD_TEST(suite, test_concurrent_writers_add_every_word);
+    SUITE_ADD_TEST(suite, test_contains_words_batch);
+    SUITE_ADD_TEST(suite, test_contains_words_batch_with_null_word_fails);
+    SUITE_ADD_TEST(suite, test_remove_word);
+    SUITE_ADD_TEST(suite, test_remove_word_with_every_fan_out);
+    SUITE_ADD_TEST(suite, test_remove_many_random_words);
+    SUITE_ADD_TEST(suite, test_remove_weighted_word);
+    SUITE_ADD_TEST(suite, test_remove_word_from_concurrent_trie);
+    SUITE_ADD_TEST(suite, test_remove_word_from_read_only_trie_fails);
+    SUITE_ADD_TEST(suite, test_remove_all_words_and_compact_frees_memory);
+    SUITE_ADD_TEST(suite, test_compact_keeps_words);
+    SUITE_ADD_TEST(suite, test_keys_with_nul_bytes);
+    SUITE_ADD_TEST(suite, test_remove_and_compact_keys_with_nul_bytes);
+    SUITE_ADD_TEST(suite, test_read_only_tries_with_keys_with_nul_bytes);
+    SUITE_ADD_TEST(suite, test_contains_keys_batch);
+    SUITE_ADD_TEST(suite, test_cursor_visits_keys_with_nul_bytes);
+    SUITE_ADD_TEST(suite, test_add_empty_key_fails);
+    SUITE_ADD_TEST(suite, test_put_and_get_values);
+    SUITE_ADD_TEST(suite, test_copy_entries_matching_prefix);
+    SUITE_ADD_TEST(suite, test_values_on_read_only_trie_fail);
+    SUITE_ADD_TEST(suite, test_prefix_matches);
+    SUITE_ADD_TEST(suite, test_prefix_matches_with_invalid_arguments_fail);
+    SUITE_ADD_TEST(suite, test_scan_finds_overlapping_words);
+    SUITE_ADD_TEST(suite, test_scan_chunks);
+    SUITE_ADD_TEST(suite, test_scan_many_random_words);
+    SUITE_ADD_TEST(suite, test_automaton_create_on_read_only_trie_fails);
+    SUITE_ADD_TEST(suite, test_destroy_automaton_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_fuzzy_search_orders_by_distance);
+    SUITE_ADD_TEST(suite, test_fuzzy_search_any_distance);
+    SUITE_ADD_TEST(suite, test_fuzzy_prefix_search);
+    SUITE_ADD_TEST(suite, test_fuzzy_search_many_random_words);
+    SUITE_ADD_TEST(suite, test_fuzzy_search_binary_keys);
+    SUITE_ADD_TEST(suite, test_fuzzy_search_on_read_only_trie_fails);
+    SUITE_ADD_TEST(suite, test_fuzzy_search_with_invalid_arguments_fails);
+    SUITE_ADD_TEST(suite, test_fuzzy_search_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_match_pattern);
+    SUITE_ADD_TEST(suite, test_match_pattern_many_random_words);
+    SUITE_ADD_TEST(suite, test_match_pattern_binary_keys);
+    SUITE_ADD_TEST(suite, test_match_pattern_with_invalid_arguments_fails);
+    SUITE_ADD_TEST(suite, test_match_pattern_does_not_leak_memory);
+    SUITE_ADD_TEST(suite, test_range);
+    SUITE_ADD_TEST(suite, test_successor_and_predecessor);
+    SUITE_ADD_TEST(suite, test_successor_and_predecessor_after_concurrent_removal);
+    SUITE_ADD_TEST(suite, test_range_and_neighbours_of_many_random_words);
+    SUITE_ADD_TEST(suite, test_range_and_neighbours_of_binary_keys);
+    SUITE_ADD_TEST(suite, test_range_with_invalid_arguments_fails);
+    SUITE_ADD_TEST(suite, test_rank_and_select);
+    SUITE_ADD_TEST(suite, test_counts_of_many_random_words);
+    SUITE_ADD_TEST(suite, test_rank_and_select_with_invalid_arguments_fails);
+    SUITE_ADD_TEST(suite, test_get_stats);
+    SUITE_ADD_TEST(suite, test_get_stats_of_empty_and_deep_tries);
+    SUITE_ADD_TEST(suite, test_get_stats_bytes_match_sized_listeners);
+    SUITE_ADD_TEST(suite, test_sized_memory_listeners_balance);
+    SUITE_ADD_TEST(suite, test_get_stats_with_invalid_arguments_fails);
+    SUITE_ADD_TEST(suite, test_remove_word_keeps_edges_compressed);
+
+    CuSuiteRun(suite);
+    CuSuiteSummary(suite, output);
+    CuSuiteDetails(suite, output);
+    printf("%s\n", output->buffer);
+    CuStringDelete(output);
+    CuSuiteDelete(suite);
+}
+
+int main(void) {
+    RunAllTests();
+}
+
@@ -0,0 +1,193 @@
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// A single lookup follows a chain of dependent reads, each likely to miss the
+// cache: a children block, then the child found in it, then its children
+// block and so on. A batch keeps a group of lookups in flight instead, in the
+// style of asynchronous memory access chaining. Each step of a lookup
+// prefetches the memory its next step will read, then moves on to the other
+// lookups in the group, so by the time it comes round again that memory has
+// usually arrived. Whenever a lookup finishes, the next word of the batch
+// takes its place in the group. Double arrays are looked up in batches the
+// same way, in trie-double-array.c.
+
+// A lookup in flight. At each step it either finds the child through which
+// the word continues within children, or checks the label of the edge into
+// node
+typedef struct {
+    size_t index;
+    const char* word;
+    size_t length;
+    size_t i;
+    const _trie_node_t* node;
+    uint32_t label_length;
+    const _trie_children_t* children;
+    bool at_children;
+} _trie_node_lookup_t;
+
+// Moves lookup on from node, all of whose label has been matched, either
+// finishing it or prefetching the children of node. Returns false if the
+// lookup is finished
+bool _leave_node(_trie_node_lookup_t* lookup, bool* contains) {
+    if (lookup->i == lookup->length) {
+        contains[lookup->index] = _is_terminal_node(lookup->node);
+        return false;
+    }
+
+    lookup->children =
+        __atomic_load_n(&(lookup->node->children), __ATOMIC_ACQUIRE);
+    if (lookup->children == NULL) {
+        contains[lookup->index] = false;
+        return false;
+    }
+
+    _TRIE_PREFETCH(lookup->children);
+    lookup->at_children = true;
+
+    return true;
+}
+
+// Starts a lookup of the word at index within words at the root of trie.
+// The length of the word is taken from lengths, or from its terminating NUL if
+// lengths is NULL. Returns false if the lookup is already finished
+bool _start_node_lookup(_trie_node_lookup_t* lookup, const trie_t* trie,
+    const char** words, const size_t* lengths, size_t index, bool* contains) {
+
+    lookup->index = index;
+    lookup->word = words[index];
+    lookup->length =
+        lengths == NULL ? strlen(lookup->word) : lengths[index];
+    lookup->i = 0U;
+    lookup->node = trie->root;
+    if (lookup->length == 0U) {
+        contains[index] = false;
+        return false;
+    }
+
+    return _leave_node(lookup, contains);
+}
+
+// Takes one step of lookup. Returns false if the lookup is finished
+bool _step_node_lookup(_trie_node_lookup_t* lookup, bool* contains) {
+    if (lookup->at_children) {
+        uint32_t label_length;
+        const _trie_node_t* child = _get_child_from(lookup->children,
+            (unsigned char) lookup->word[lookup->i], &label_length);
+        if (child == NULL || label_length > lookup->length - lookup->i) {
+            contains[lookup->index] = false;
+            return false;
+        }
+
+        _TRIE_PREFETCH(child);
+        lookup->node = child;
+        lookup->label_length = label_length;
+        lookup->at_children = false;
+
+        return true;
+    }
+
+    if (memcmp(_get_edge_label(lookup->node, lookup->label_length),
+        lookup->word + lookup->i, lookup->label_length) != 0) {
+        contains[lookup->index] = false;
+        return false;
+    }
+    lookup->i += lookup->label_length;
+
+    return _leave_node(lookup, contains);
+}
+
+// Looks up every word in a trie made up of nodes, a group at a time
+void _contains_words(const trie_t* trie, const char** words,
+    const size_t* lengths, size_t n, bool* contains) {
+
+    _trie_node_lookup_t lookups[_TRIE_BATCH_GROUP_SIZE];
+    bool in_flight[_TRIE_BATCH_GROUP_SIZE];
+    size_t in_flight_count = 0U;
+    size_t next = 0U;
+
+    for (size_t slot = 0U; slot < _TRIE_BATCH_GROUP_SIZE; slot++) {
+        in_flight[slot] = false;
+        while (!in_flight[slot] && next < n) {
+            in_flight[slot] = _start_node_lookup(
+                &lookups[slot], trie, words, lengths, next, contains);
+            next++;
+        }
+        in_flight_count += in_flight[slot] ? 1U : 0U;
+    }
+
+    while (in_flight_count > 0U) {
+        for (size_t slot = 0U; slot < _TRIE_BATCH_GROUP_SIZE; slot++) {
+            if (!in_flight[slot] ||
+                _step_node_lookup(&lookups[slot], contains)) {
+                continue;
+            }
+
+            in_flight[slot] = false;
+            while (!in_flight[slot] && next < n) {
+                in_flight[slot] = _start_node_lookup(
+                    &lookups[slot], trie, words, lengths, next, contains);
+                next++;
+            }
+            in_flight_count -= in_flight[slot] ? 0U : 1U;
+        }
+    }
+}
+
+// Looks up a batch of words, whose lengths are taken from lengths, or from
+// their terminating NULs if lengths is NULL
+trie_result_t _contains_batch(trie_t* trie, const char** words,
+    const size_t* lengths, size_t n, bool* contains) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (n > 0U && words == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    for (size_t i = 0U; i < n; i++) {
+        if (words[i] == NULL) {
+            return TRIE_WORD_NULL;
+        }
+    }
+
+    if (trie->kind == _TRIE_NODES) {
+        uint64_t* active = _begin_read(trie);
+        _contains_words(trie, words, lengths, n, contains);
+        _end_read(active);
+        return TRIE_SUCCESS;
+    }
+
+    if (trie->kind == _TRIE_DOUBLE_ARRAY) {
+        _double_array_contains_words(
+            trie->double_array, words, lengths, n, contains);
+        return TRIE_SUCCESS;
+    }
+
+    for (size_t i = 0U; i < n; i++) {
+        trie_contains_key(trie, words[i],
+            lengths == NULL ? strlen(words[i]) : lengths[i], &contains[i]);
+    }
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_contains_words_batch(trie_t* trie, const char** words,
+    size_t n, bool* contains) {
+
+    return _contains_batch(trie, words, NULL, n, contains);
+}
+
+trie_result_t trie_contains_keys_batch(trie_t* trie, const char** keys,
+    const size_t* lengths, size_t n, bool* contains) {
+
+    if (n > 0U && lengths == NULL) {
+        return trie == NULL ? TRIE_NULL : TRIE_WORD_NULL;
+    }
+
+    return _contains_batch(trie, keys, lengths, n, contains);
+}
@@ -0,0 +1,1007 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trie.h"
+
+// Runs every benchmark over each dataset in turn: synthetic English-like
+// words, URLs and random binary keys, and a wordlist read from a file. Each
+// result is written to standard output as a single line of JSON, so results
+// from different commits can be compared with ordinary tools, and a readable
+// copy is written to standard error.
+//
+// Usage: trie-benchmark [-n key_count] [-w wordlist] [-l label]
+
+#define DEFAULT_KEY_COUNT 200000U
+#define DEFAULT_WORDLIST_PATH "trie-benchmark-words.txt"
+#define SAVED_TRIE_PATH "trie-benchmark.trie"
+#define MAX_KEY_LENGTH 256U
+#define QUERY_COUNT 200000U
+#define LOOKUP_ROUNDS 5U
+#define BATCH_SIZE 4096U
+#define PREFIX_QUERY_COUNT 2000U
+#define PREFIX_SPANS_LENGTH 1024U
+#define PREFIX_BUFFER_LENGTH (PREFIX_SPANS_LENGTH * MAX_KEY_LENGTH)
+#define MAX_WRITER_THREADS 8U
+
+// Exponent of the Zipfian distributions, about that of word frequencies in
+// natural language
+#define ZIPF_EXPONENT 1.0
+
+#define SYLLABLE_LENGTH 8U
+#define HOST_COUNT 5000U
+#define SEGMENT_COUNT 20000U
+
+typedef struct {
+    char* bytes;
+    size_t length;
+} key_entry_t;
+
+// A set of distinct keys, sorted in byte order once generated
+typedef struct {
+    const char* name;
+    key_entry_t* keys;
+    size_t count;
+    size_t capacity;
+} dataset_t;
+
+// Cumulative probabilities of the ranks of a Zipfian distribution
+typedef struct {
+    double* cdf;
+    size_t n;
+} zipf_t;
+
+// Tables from which synthetic keys are generated
+typedef struct {
+    char (*syllables)[SYLLABLE_LENGTH];
+    zipf_t syllable_ranks;
+    char (*hosts)[MAX_KEY_LENGTH];
+    zipf_t host_ranks;
+    char (*segments)[MAX_KEY_LENGTH];
+    zipf_t segment_ranks;
+} generator_t;
+
+// Where and how results are reported
+typedef struct {
+    const char* label;
+    const char* dataset;
+    size_t key_count;
+} reporter_t;
+
+const char* onsets[] = {
+    "", "b", "c", "d", "f", "g", "h", "j", "k", "l", "m", "n", "p", "r", "s",
+    "t", "v", "w", "y", "z", "bl", "br", "ch", "cl", "cr", "dr", "fl", "fr",
+    "gr", "pl", "pr", "sh", "sl", "sp", "st", "str", "th", "tr", "wh"
+};
+const char* nuclei[] = {
+    "a", "e", "i", "o", "u", "ai", "ea", "ee", "ie", "oa", "oo", "ou", "y"
+};
+const char* codas[] = {
+    "", "", "b", "ck", "d", "ft", "g", "l", "ll", "m", "n", "nd", "ng", "nt",
+    "p", "r", "rd", "rn", "s", "ss", "st", "t", "th", "x"
+};
+const char* suffixes[] = { "s", "ed", "ing", "er", "ly", "tion" };
+const char* top_level_domains[] = { ".com", ".org", ".net", ".io" };
+
+#define COUNT_OF(array) (sizeof(array) / sizeof((array)[0]))
+
+// Returns the next number of a xorshift64* pseudo-random generator
+uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 2685821657736338717ULL;
+}
+
+// Returns a pseudo-random number in [0, 1)
+double next_uniform(uint64_t* state) {
+    return (double) (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Returns a pseudo-random number in [0, n)
+size_t next_below(uint64_t* state, size_t n) {
+    return (size_t) (next_random(state) % n);
+}
+
+bool zipf_create(zipf_t* zipf, size_t n) {
+    zipf->cdf = malloc(n * sizeof(double));
+    zipf->n = n;
+    if (zipf->cdf == NULL) {
+        return false;
+    }
+
+    double total = 0.0;
+    for (size_t i = 0U; i < n; i++) {
+        total += 1.0 / pow((double) (i+1), ZIPF_EXPONENT);
+        zipf->cdf[i] = total;
+    }
+    for (size_t i = 0U; i < n; i++) {
+        zipf->cdf[i] /= total;
+    }
+
+    return true;
+}
+
+// Returns a rank in [0, n), rank 0 being the most likely
+size_t zipf_sample(const zipf_t* zipf, uint64_t* state) {
+    double u = next_uniform(state);
+    size_t low = 0U;
+    size_t high = zipf->n - 1U;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2U;
+        if (zipf->cdf[middle] < u) {
+            low = middle + 1U;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+void zipf_destroy(zipf_t* zipf) {
+    free(zipf->cdf);
+}
+
+// Returns the elapsed wall clock time in seconds since some fixed point
+double now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}
+
+void report(const reporter_t* reporter, const char* representation,
+    const char* metric, double value) {
+
+    printf("{\"label\": \"%s\", \"dataset\": \"%s\", \"keys\": %zu, "
+        "\"representation\": \"%s\", \"metric\": \"%s\", \"value\": %.3f}\n",
+        reporter->label, reporter->dataset, reporter->key_count,
+        representation, metric, value);
+    fprintf(stderr, "%-10s %-14s %-32s %14.3f\n", reporter->dataset,
+        representation, metric, value);
+}
+
+bool dataset_add(dataset_t* dataset, const char* key, size_t length) {
+    if (dataset->count == dataset->capacity) {
+        size_t capacity = dataset->capacity == 0U ? 1024U :
+            2U * dataset->capacity;
+        key_entry_t* keys = realloc(dataset->keys,
+            capacity * sizeof(key_entry_t));
+        if (keys == NULL) {
+            return false;
+        }
+        dataset->keys = keys;
+        dataset->capacity = capacity;
+    }
+
+    char* bytes = malloc(length == 0U ? 1U : length);
+    if (bytes == NULL) {
+        return false;
+    }
+    memcpy(bytes, key, length);
+    key_entry_t entry = { bytes, length };
+    dataset->keys[dataset->count++] = entry;
+
+    return true;
+}
+
+int compare_keys(const void* a, const void* b) {
+    const key_entry_t* first = a;
+    const key_entry_t* second = b;
+    size_t length = first->length < second->length ? first->length :
+        second->length;
+    int order = memcmp(first->bytes, second->bytes, length);
+    if (order != 0) {
+        return order;
+    }
+
+    return first->length < second->length ? -1 :
+        first->length > second->length ? 1 : 0;
+}
+
+// Sorts the keys of dataset in byte order, dropping duplicates and empty keys
+void dataset_sort_unique(dataset_t* dataset) {
+    qsort(dataset->keys, dataset->count, sizeof(key_entry_t), compare_keys);
+
+    size_t count = 0U;
+    for (size_t i = 0U; i < dataset->count; i++) {
+        key_entry_t* key = &dataset->keys[i];
+        if (key->length == 0U ||
+            (count > 0U && compare_keys(&dataset->keys[count-1], key) == 0)) {
+            free(key->bytes);
+            continue;
+        }
+        dataset->keys[count++] = *key;
+    }
+    dataset->count = count;
+}
+
+void dataset_destroy(dataset_t* dataset) {
+    for (size_t i = 0U; i < dataset->count; i++) {
+        free(dataset->keys[i].bytes);
+    }
+    free(dataset->keys);
+}
+
+// Appends text to the key of length bytes, if it fits
+void append(char* key, size_t* length, const char* text) {
+    size_t text_length = strlen(text);
+    if (*length + text_length < MAX_KEY_LENGTH) {
+        memcpy(key + *length, text, text_length);
+        *length += text_length;
+    }
+}
+
+// Generates an English-like word from syllables of Zipfian frequency, with an
+// occasional suffix, returning its length
+size_t make_english_word(const generator_t* generator, uint64_t* state,
+    char* word) {
+
+    double u = next_uniform(state);
+    size_t syllable_count = u < 0.25 ? 1U : u < 0.65 ? 2U : u < 0.9 ? 3U : 4U;
+    size_t length = 0U;
+    for (size_t i = 0U; i < syllable_count; i++) {
+        append(word, &length, generator->syllables[
+            zipf_sample(&generator->syllable_ranks, state)]);
+    }
+    if (next_uniform(state) < 0.2) {
+        append(word, &length,
+            suffixes[next_below(state, COUNT_OF(suffixes))]);
+    }
+
+    return length;
+}
+
+// Generates a URL on a host of Zipfian popularity with a path of Zipfian
+// segments and an occasional query string, returning its length
+size_t make_url(const generator_t* generator, uint64_t* state, char* url) {
+    size_t length = 0U;
+    append(url, &length, "https://");
+    size_t host = zipf_sample(&generator->host_ranks, state);
+    if (host % 2U == 0U) {
+        append(url, &length, "www.");
+    }
+    append(url, &length, generator->hosts[host]);
+
+    size_t segment_count = 1U + next_below(state, 4U);
+    for (size_t i = 0U; i < segment_count; i++) {
+        append(url, &length, "/");
+        append(url, &length, generator->segments[
+            zipf_sample(&generator->segment_ranks, state)]);
+    }
+    if (next_uniform(state) < 0.3) {
+        char query[32];
+        sprintf(query, "?id=%zu", next_below(state, 1000000U));
+        append(url, &length, query);
+    }
+
+    return length;
+}
+
+// Generates a key of 8 to 32 uniformly random bytes, returning its length
+size_t make_binary_key(const generator_t* generator, uint64_t* state,
+    char* key) {
+
+    (void) generator;
+    size_t length = 8U + next_below(state, 25U);
+    for (size_t i = 0U; i < length; i++) {
+        key[i] = (char) (next_random(state) & 0xFFU);
+    }
+
+    return length;
+}
+
+typedef size_t (*make_key_t)(const generator_t*, uint64_t*, char*);
+
+// Generates the syllables, hosts and path segments of synthetic keys
+bool generator_create(generator_t* generator) {
+    size_t syllable_count =
+        COUNT_OF(onsets) * COUNT_OF(nuclei) * COUNT_OF(codas);
+    generator->syllables = malloc(syllable_count * SYLLABLE_LENGTH);
+    generator->hosts = malloc(HOST_COUNT * MAX_KEY_LENGTH);
+    generator->segments = malloc(SEGMENT_COUNT * MAX_KEY_LENGTH);
+    if (generator->syllables == NULL || generator->hosts == NULL ||
+        generator->segments == NULL ||
+        !zipf_create(&generator->syllable_ranks, syllable_count) ||
+        !zipf_create(&generator->host_ranks, HOST_COUNT) ||
+        !zipf_create(&generator->segment_ranks, SEGMENT_COUNT)) {
+        return false;
+    }
+
+    // Syllables are ranked in a shuffled order, so the most frequent are not
+    // all those starting with the first onset
+    size_t i = 0U;
+    for (size_t o = 0U; o < COUNT_OF(onsets); o++) {
+        for (size_t n = 0U; n < COUNT_OF(nuclei); n++) {
+            for (size_t c = 0U; c < COUNT_OF(codas); c++) {
+                sprintf(generator->syllables[i++], "%s%s%s", onsets[o],
+                    nuclei[n], codas[c]);
+            }
+        }
+    }
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (i = syllable_count - 1U; i > 0U; i--) {
+        size_t j = next_below(&state, i+1);
+        char syllable[SYLLABLE_LENGTH];
+        memcpy(syllable, generator->syllables[i], SYLLABLE_LENGTH);
+        memcpy(generator->syllables[i], generator->syllables[j],
+            SYLLABLE_LENGTH);
+        memcpy(generator->syllables[j], syllable, SYLLABLE_LENGTH);
+    }
+
+    for (i = 0U; i < HOST_COUNT; i++) {
+        size_t length = make_english_word(generator, &state,
+            generator->hosts[i]);
+        append(generator->hosts[i], &length, top_level_domains[
+            next_below(&state, COUNT_OF(top_level_domains))]);
+        generator->hosts[i][length] = '\0';
+    }
+    for (i = 0U; i < SEGMENT_COUNT; i++) {
+        size_t length = make_english_word(generator, &state,
+            generator->segments[i]);
+        generator->segments[i][length] = '\0';
+    }
+
+    return true;
+}
+
+void generator_destroy(generator_t* generator) {
+    free(generator->syllables);
+    free(generator->hosts);
+    free(generator->segments);
+    zipf_destroy(&generator->syllable_ranks);
+    zipf_destroy(&generator->host_ranks);
+    zipf_destroy(&generator->segment_ranks);
+}
+
+// Fills dataset with key_count distinct keys made by make_key, or as many as
+// can be made in a few rounds
+bool generate_dataset(dataset_t* dataset, const generator_t* generator,
+    make_key_t make_key, uint64_t seed, size_t key_count) {
+
+    char key[MAX_KEY_LENGTH];
+    for (size_t round = 0U; round < 8U && dataset->count < key_count;
+        round++) {
+        size_t missing = key_count - dataset->count;
+        for (size_t i = 0U; i < missing; i++) {
+            size_t length = make_key(generator, &seed, key);
+            if (!dataset_add(dataset, key, length)) {
+                return false;
+            }
+        }
+        dataset_sort_unique(dataset);
+    }
+
+    return true;
+}
+
+// Fills dataset with the lines of the file at path, returning false if it
+// cannot be read
+bool read_dataset(dataset_t* dataset, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+
+    char line[MAX_KEY_LENGTH];
+    bool added = true;
+    while (added && fgets(line, sizeof(line), file) != NULL) {
+        size_t length = strcspn(line, "\r\n");
+        added = dataset_add(dataset, line, length);
+    }
+    fclose(file);
+    dataset_sort_unique(dataset);
+
+    return added;
+}
+
+// Sets queries to QUERY_COUNT keys of dataset drawn with Zipfian popularity,
+// the most popular keys being spread across the dataset
+bool make_hit_queries(const dataset_t* dataset, uint64_t seed,
+    const key_entry_t** queries) {
+
+    zipf_t ranks;
+    size_t* order = malloc(dataset->count * sizeof(size_t));
+    if (order == NULL || !zipf_create(&ranks, dataset->count)) {
+        free(order);
+        return false;
+    }
+
+    for (size_t i = 0U; i < dataset->count; i++) {
+        order[i] = i;
+    }
+    for (size_t i = dataset->count - 1U; i > 0U; i--) {
+        size_t j = next_below(&seed, i+1);
+        size_t swapped = order[i];
+        order[i] = order[j];
+        order[j] = swapped;
+    }
+    for (size_t i = 0U; i < QUERY_COUNT; i++) {
+        queries[i] = &dataset->keys[order[zipf_sample(&ranks, &seed)]];
+    }
+
+    zipf_destroy(&ranks);
+    free(order);
+
+    return true;
+}
+
+// Fills misses with up to QUERY_COUNT keys not in trie, each a hit query
+// with one byte appended or changed
+bool make_miss_queries(trie_t* trie, const key_entry_t** hits, uint64_t seed,
+    dataset_t* misses) {
+
+    char key[MAX_KEY_LENGTH];
+    for (size_t i = 0U; i < 4U * QUERY_COUNT && misses->count < QUERY_COUNT;
+        i++) {
+        const key_entry_t* hit = hits[i % QUERY_COUNT];
+        size_t length = hit->length;
+        memcpy(key, hit->bytes, length);
+        char byte = (char) ('a' + next_below(&seed, 26U));
+        if (length + 1U < MAX_KEY_LENGTH && next_uniform(&seed) < 0.5) {
+            key[length++] = byte;
+        }
+        else {
+            key[next_below(&seed, length)] = byte;
+        }
+
+        bool contains;
+        trie_contains_key(trie, key, length, &contains);
+        if (!contains && !dataset_add(misses, key, length)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Looks up every query LOOKUP_ROUNDS times, returning the mean time in
+// nanoseconds taken per lookup, and sets found to the number found
+double time_contains(trie_t* trie, const key_entry_t** queries,
+    size_t query_count, size_t* found) {
+
+    *found = 0U;
+    double start = now();
+    for (size_t round = 0U; round < LOOKUP_ROUNDS; round++) {
+        for (size_t i = 0U; i < query_count; i++) {
+            bool contains;
+            trie_contains_key(trie, queries[i]->bytes, queries[i]->length,
+                &contains);
+            *found += contains ? 1U : 0U;
+        }
+    }
+
+    return (now() - start) * 1e9 / (double) (LOOKUP_ROUNDS * query_count);
+}
+
+int compare_doubles(const void* a, const void* b) {
+    double first = *(const double*) a;
+    double second = *(const double*) b;
+
+    return first < second ? -1 : first > second ? 1 : 0;
+}
+
+// Returns the median time in nanoseconds taken to read the clock twice, which
+// is subtracted from the time of each lookup timed on its own
+double measure_timer_overhead(double* samples) {
+    for (size_t i = 0U; i < QUERY_COUNT; i++) {
+        double start = now();
+        samples[i] = (now() - start) * 1e9;
+    }
+    qsort(samples, QUERY_COUNT, sizeof(double), compare_doubles);
+
+    return samples[QUERY_COUNT / 2U];
+}
+
+// Times each query on its own, reporting the median and 99th percentile
+// latencies under the names of metric followed by _p50_ns and _p99_ns
+void report_latencies(const reporter_t* reporter, const char* representation,
+    const char* metric, trie_t* trie, const key_entry_t** queries,
+    size_t query_count, double* samples, double overhead) {
+
+    for (size_t i = 0U; i < query_count; i++) {
+        bool contains;
+        double start = now();
+        trie_contains_key(trie, queries[i]->bytes, queries[i]->length,
+            &contains);
+        double latency = (now() - start) * 1e9 - overhead;
+        samples[i] = latency < 0.0 ? 0.0 : latency;
+    }
+    qsort(samples, query_count, sizeof(double), compare_doubles);
+
+    char name[64];
+    sprintf(name, "%s_p50_ns", metric);
+    report(reporter, representation, name, samples[query_count / 2U]);
+    sprintf(name, "%s_p99_ns", metric);
+    report(reporter, representation, name,
+        samples[query_count * 99U / 100U]);
+}
+
+// Looks up every query LOOKUP_ROUNDS times in batches, returning the mean time
+// in nanoseconds taken per key
+double time_contains_batch(trie_t* trie, const key_entry_t** queries,
+    const char** keys, size_t* lengths, bool* contains, size_t query_count) {
+
+    for (size_t i = 0U; i < query_count; i++) {
+        keys[i] = queries[i]->bytes;
+        lengths[i] = queries[i]->length;
+    }
+
+    double start = now();
+    for (size_t round = 0U; round < LOOKUP_ROUNDS; round++) {
+        for (size_t i = 0U; i < query_count; i += BATCH_SIZE) {
+            size_t n = query_count - i < BATCH_SIZE ? query_count - i :
+                BATCH_SIZE;
+            trie_contains_keys_batch(trie, keys+i, lengths+i, n, contains+i);
+        }
+    }
+
+    return (now() - start) * 1e9 / (double) (LOOKUP_ROUNDS * query_count);
+}
+
+// Copies the keys matching PREFIX_QUERY_COUNT prefixes of hit queries, up to
+// PREFIX_SPANS_LENGTH keys each, reporting the keys copied per second
+void report_prefix_throughput(const reporter_t* reporter,
+    const char* representation, trie_t* trie, const key_entry_t** queries,
+    char* buffer, trie_word_span_t* spans) {
+
+    uint64_t seed = 5U;
+    size_t copied = 0U;
+    double start = now();
+    for (size_t i = 0U; i < PREFIX_QUERY_COUNT; i++) {
+        const key_entry_t* query = queries[i];
+        size_t prefix_length = 1U + next_below(&seed,
+            query->length < 6U ? query->length : query->length / 2U);
+        size_t key_count;
+        if (trie_copy_keys_matching_prefix(trie, query->bytes, prefix_length,
+            buffer, PREFIX_BUFFER_LENGTH, spans, PREFIX_SPANS_LENGTH,
+            &key_count) == TRIE_SUCCESS) {
+            copied += key_count;
+        }
+    }
+    double seconds = now() - start;
+
+    report(reporter, representation, "prefix_keys_per_second",
+        (double) copied / seconds);
+    report(reporter, representation, "prefix_query_ns",
+        seconds * 1e9 / (double) PREFIX_QUERY_COUNT);
+}
+
+// Buffers shared by the lookup benchmarks of every representation
+typedef struct {
+    const key_entry_t** hits;
+    const key_entry_t** misses;
+    size_t miss_count;
+    double* samples;
+    double timer_overhead;
+    const char** keys;
+    size_t* lengths;
+    bool* contains;
+    char* prefix_buffer;
+    trie_word_span_t* prefix_spans;
+} workload_t;
+
+// Runs the lookup and prefix benchmarks against trie, returning false if a
+// lookup gave a wrong answer
+bool benchmark_queries(const reporter_t* reporter, const char* representation,
+    trie_t* trie, const workload_t* workload) {
+
+    size_t hits_found;
+    size_t misses_found = 0U;
+    report(reporter, representation, "contains_hit_mean_ns",
+        time_contains(trie, workload->hits, QUERY_COUNT, &hits_found));
+    if (workload->miss_count > 0U) {
+        report(reporter, representation, "contains_miss_mean_ns",
+            time_contains(trie, workload->misses, workload->miss_count,
+            &misses_found));
+    }
+    if (hits_found != LOOKUP_ROUNDS * QUERY_COUNT || misses_found != 0U) {
+        fprintf(stderr, "%s lookups failed\n", representation);
+        return false;
+    }
+
+    report_latencies(reporter, representation, "contains_hit", trie,
+        workload->hits, QUERY_COUNT, workload->samples,
+        workload->timer_overhead);
+    if (workload->miss_count > 0U) {
+        report_latencies(reporter, representation, "contains_miss", trie,
+            workload->misses, workload->miss_count, workload->samples,
+            workload->timer_overhead);
+    }
+
+    report(reporter, representation, "contains_batch_hit_mean_ns",
+        time_contains_batch(trie, workload->hits, workload->keys,
+        workload->lengths, workload->contains, QUERY_COUNT));
+
+    report_prefix_throughput(reporter, representation, trie, workload->hits,
+        workload->prefix_buffer, workload->prefix_spans);
+
+    return true;
+}
+
+// Saves trie and reports the size of its file per key, if it can be saved
+bool report_file_size(const reporter_t* reporter, const char* representation,
+    trie_t* trie) {
+
+    trie_result_t result = trie_save(trie, SAVED_TRIE_PATH);
+    if (result == TRIE_UNSUPPORTED) {
+        return true;
+    }
+    if (result != TRIE_SUCCESS) {
+        fprintf(stderr, "trie_save failed\n");
+        return false;
+    }
+
+    FILE* file = fopen(SAVED_TRIE_PATH, "rb");
+    if (file == NULL || fseek(file, 0L, SEEK_END) != 0) {
+        fprintf(stderr, "reading %s failed\n", SAVED_TRIE_PATH);
+        return false;
+    }
+    long size = ftell(file);
+    fclose(file);
+
+    report(reporter, representation, "file_bytes_per_key",
+        (double) size / (double) reporter->key_count);
+
+    return true;
+}
+
+// Reports the heap bytes per key of a trie made up of nodes, and the mean
+// number of edges followed to look up a key
+bool report_node_stats(const reporter_t* reporter, trie_t* trie) {
+    trie_stats_t stats;
+    if (trie_get_stats(trie, &stats) != TRIE_SUCCESS) {
+        fprintf(stderr, "trie_get_stats failed\n");
+        return false;
+    }
+
+    report(reporter, "nodes", "heap_bytes_per_key",
+        (double) stats.allocated_bytes / (double) reporter->key_count);
+    report(reporter, "nodes", "lookup_path_length",
+        stats.average_lookup_path_length);
+
+    return true;
+}
+
+// Bytes allocated less bytes deallocated while the sized memory listeners
+// below are set
+int64_t heap_bytes = 0;
+
+void heap_allocated(size_t size, trie_memory_category_t category) {
+    (void) category;
+    heap_bytes += (int64_t) size;
+}
+
+void heap_deallocated(size_t size, trie_memory_category_t category) {
+    (void) category;
+    heap_bytes -= (int64_t) size;
+}
+
+typedef struct {
+    trie_t* trie;
+    const dataset_t* dataset;
+    unsigned thread;
+    unsigned thread_count;
+    size_t failures;
+} writer_t;
+
+// Adds the keys whose first byte is assigned to the writer, so writers add
+// under disjoint prefixes
+void* add_keys(void* argument) {
+    writer_t* writer = argument;
+    for (size_t i = 0U; i < writer->dataset->count; i++) {
+        const key_entry_t* key = &writer->dataset->keys[i];
+        if ((unsigned char) key->bytes[0] % writer->thread_count ==
+            writer->thread && trie_add_key(writer->trie, key->bytes,
+            key->length) != TRIE_SUCCESS) {
+            writer->failures++;
+        }
+    }
+
+    return NULL;
+}
+
+// Adds every key to a concurrent trie using thread_count threads, returning
+// the time taken in seconds or a negative time if adding failed
+double benchmark_concurrent_add(unsigned thread_count,
+    const dataset_t* dataset) {
+
+    trie_t* trie;
+    trie_options_t options = { 0U, false, true };
+    if (trie_create_with_options(&trie, &options) != TRIE_SUCCESS) {
+        return -1.0;
+    }
+
+    writer_t writers[MAX_WRITER_THREADS];
+    pthread_t threads[MAX_WRITER_THREADS];
+    double start = now();
+    for (unsigned i = 0U; i < thread_count; i++) {
+        writer_t writer = { trie, dataset, i, thread_count, 0U };
+        writers[i] = writer;
+        pthread_create(&threads[i], NULL, add_keys, &writers[i]);
+    }
+    size_t failures = 0U;
+    for (unsigned i = 0U; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+        failures += writers[i].failures;
+    }
+    double seconds = now() - start;
+
+    const key_entry_t* last = &dataset->keys[dataset->count-1];
+    bool contains;
+    trie_contains_key(trie, last->bytes, last->length, &contains);
+    trie_destroy(trie);
+    if (failures > 0U || !contains) {
+        return -1.0;
+    }
+
+    return seconds;
+}
+
+// Adds the keys of dataset in a shuffled order, reporting keys added per
+// second, and sets trie to the trie built
+bool benchmark_add(const reporter_t* reporter, const dataset_t* dataset,
+    trie_t** trie) {
+
+    const key_entry_t** order = malloc(dataset->count * sizeof(key_entry_t*));
+    trie_options_t options = { 0U, false, false };
+    if (order == NULL ||
+        trie_create_with_options(trie, &options) != TRIE_SUCCESS) {
+        free(order);
+        fprintf(stderr, "trie_create_with_options failed\n");
+        return false;
+    }
+
+    uint64_t seed = 3U;
+    for (size_t i = 0U; i < dataset->count; i++) {
+        size_t j = next_below(&seed, i+1);
+        order[i] = order[j];
+        order[j] = &dataset->keys[i];
+    }
+
+    bool added = true;
+    double start = now();
+    for (size_t i = 0U; i < dataset->count && added; i++) {
+        added = trie_add_key(*trie, order[i]->bytes, order[i]->length) ==
+            TRIE_SUCCESS;
+    }
+    double seconds = now() - start;
+    free(order);
+    if (!added) {
+        fprintf(stderr, "trie_add_key failed\n");
+        return false;
+    }
+
+    report(reporter, "nodes", "build_keys_per_second",
+        (double) dataset->count / seconds);
+
+    return true;
+}
+
+// Builds a trie from the sorted keys of dataset with a builder, reporting
+// keys added per second
+bool benchmark_builder(const reporter_t* reporter, const dataset_t* dataset) {
+    trie_builder_t* builder;
+    trie_options_t options = { 0U, false, false };
+    if (trie_builder_create(&builder, &options) != TRIE_SUCCESS) {
+        fprintf(stderr, "trie_builder_create failed\n");
+        return false;
+    }
+
+    bool added = true;
+    double start = now();
+    for (size_t i = 0U; i < dataset->count && added; i++) {
+        added = trie_builder_add_key(builder, dataset->keys[i].bytes,
+            dataset->keys[i].length) == TRIE_SUCCESS;
+    }
+    trie_t* trie;
+    if (!added || trie_builder_finish(builder, &trie) != TRIE_SUCCESS) {
+        trie_builder_destroy(builder);
+        fprintf(stderr, "building from sorted keys failed\n");
+        return false;
+    }
+    double seconds = now() - start;
+    trie_destroy(trie);
+
+    report(reporter, "builder", "build_keys_per_second",
+        (double) dataset->count / seconds);
+
+    return true;
+}
+
+typedef trie_result_t (*freeze_t)(trie_t*, trie_t**);
+
+// Benchmarks a read-only copy of trie made by freeze, reporting the keys
+// copied per second and the heap bytes per key the copy holds on to
+bool benchmark_frozen(const reporter_t* reporter, const char* representation,
+    freeze_t freeze, trie_t* trie, const workload_t* workload) {
+
+    trie_t* frozen;
+    heap_bytes = 0;
+    trie_set_sized_memory_allocation_listener(heap_allocated);
+    trie_set_sized_memory_deallocation_listener(heap_deallocated);
+    double start = now();
+    trie_result_t result = freeze(trie, &frozen);
+    double seconds = now() - start;
+    trie_set_sized_memory_allocation_listener(NULL);
+    trie_set_sized_memory_deallocation_listener(NULL);
+    if (result != TRIE_SUCCESS) {
+        fprintf(stderr, "freezing to %s failed\n", representation);
+        return false;
+    }
+
+    report(reporter, representation, "build_keys_per_second",
+        (double) reporter->key_count / seconds);
+    report(reporter, representation, "heap_bytes_per_key",
+        (double) heap_bytes / (double) reporter->key_count);
+    bool succeeded =
+        benchmark_queries(reporter, representation, frozen, workload) &&
+        report_file_size(reporter, representation, frozen);
+    trie_destroy(frozen);
+
+    return succeeded;
+}
+
+bool workload_create(workload_t* workload, const dataset_t* dataset,
+    trie_t* trie, dataset_t* misses) {
+
+    memset(workload, 0, sizeof(workload_t));
+    workload->hits = malloc(QUERY_COUNT * sizeof(key_entry_t*));
+    workload->misses = malloc(QUERY_COUNT * sizeof(key_entry_t*));
+    workload->samples = malloc(QUERY_COUNT * sizeof(double));
+    workload->keys = malloc(QUERY_COUNT * sizeof(char*));
+    workload->lengths = malloc(QUERY_COUNT * sizeof(size_t));
+    workload->contains = malloc(QUERY_COUNT * sizeof(bool));
+    workload->prefix_buffer = malloc(PREFIX_BUFFER_LENGTH);
+    workload->prefix_spans =
+        malloc(PREFIX_SPANS_LENGTH * sizeof(trie_word_span_t));
+    if (workload->hits == NULL || workload->misses == NULL ||
+        workload->samples == NULL || workload->keys == NULL ||
+        workload->lengths == NULL || workload->contains == NULL ||
+        workload->prefix_buffer == NULL || workload->prefix_spans == NULL ||
+        !make_hit_queries(dataset, 1U, workload->hits) ||
+        !make_miss_queries(trie, workload->hits, 2U, misses)) {
+        return false;
+    }
+
+    workload->miss_count = misses->count;
+    for (size_t i = 0U; i < misses->count; i++) {
+        workload->misses[i] = &misses->keys[i];
+    }
+    workload->timer_overhead = measure_timer_overhead(workload->samples);
+
+    return true;
+}
+
+void workload_destroy(workload_t* workload) {
+    free(workload->hits);
+    free(workload->misses);
+    free(workload->samples);
+    free(workload->keys);
+    free(workload->lengths);
+    free(workload->contains);
+    free(workload->prefix_buffer);
+    free(workload->prefix_spans);
+}
+
+// Runs every benchmark over dataset, returning false if any failed
+bool benchmark_dataset(const char* label, const dataset_t* dataset) {
+    reporter_t reporter = { label, dataset->name, dataset->count };
+    trie_t* trie;
+    if (!benchmark_add(&reporter, dataset, &trie)) {
+        return false;
+    }
+
+    dataset_t misses = { "misses", NULL, 0U, 0U };
+    workload_t workload;
+    bool succeeded = workload_create(&workload, dataset, trie, &misses);
+    if (!succeeded) {
+        fprintf(stderr, "malloc failed\n");
+    }
+
+    succeeded = succeeded && benchmark_builder(&reporter, dataset) &&
+        benchmark_queries(&reporter, "nodes", trie, &workload) &&
+        report_file_size(&reporter, "nodes", trie) &&
+        report_node_stats(&reporter, trie) &&
+        benchmark_frozen(&reporter, "dawg", trie_freeze_to_dawg, trie,
+            &workload) &&
+        benchmark_frozen(&reporter, "double_array",
+            trie_freeze_to_double_array, trie, &workload) &&
+        benchmark_frozen(&reporter, "louds", trie_freeze_to_louds, trie,
+            &workload);
+
+    // The nodes trie is saved again and queried in place
+    trie_t* mapped = NULL;
+    if (succeeded) {
+        succeeded = report_file_size(&reporter, "mapped", trie) &&
+            trie_open_mapped(SAVED_TRIE_PATH, &mapped) == TRIE_SUCCESS &&
+            benchmark_queries(&reporter, "mapped", mapped, &workload);
+    }
+    if (mapped != NULL) {
+        trie_destroy(mapped);
+    }
+    remove(SAVED_TRIE_PATH);
+    trie_destroy(trie);
+
+    for (unsigned thread_count = 1U; succeeded &&
+        thread_count <= MAX_WRITER_THREADS; thread_count *= 2U) {
+        double seconds = benchmark_concurrent_add(thread_count, dataset);
+        if (seconds < 0.0) {
+            fprintf(stderr, "concurrent trie_add_key failed\n");
+            succeeded = false;
+            break;
+        }
+        char representation[32];
+        sprintf(representation, "concurrent_%u", thread_count);
+        report(&reporter, representation, "build_keys_per_second",
+            (double) dataset->count / seconds);
+    }
+
+    workload_destroy(&workload);
+    dataset_destroy(&misses);
+
+    return succeeded;
+}
+
+int main(int argc, char** argv) {
+    size_t key_count = DEFAULT_KEY_COUNT;
+    const char* wordlist_path = DEFAULT_WORDLIST_PATH;
+    const char* label = "";
+    for (int i = 1; i+1 < argc; i += 2) {
+        if (strcmp(argv[i], "-n") == 0) {
+            key_count = (size_t) strtoul(argv[i+1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-w") == 0) {
+            wordlist_path = argv[i+1];
+        }
+        else if (strcmp(argv[i], "-l") == 0) {
+            label = argv[i+1];
+        }
+    }
+    if (argc % 2 == 0 || key_count == 0U) {
+        fprintf(stderr, "usage: %s [-n key_count] [-w wordlist] [-l label]\n",
+            argv[0]);
+        return 1;
+    }
+
+    generator_t generator;
+    if (!generator_create(&generator)) {
+        fprintf(stderr, "malloc failed\n");
+        return 1;
+    }
+
+    const char* names[] = { "words", "urls", "binary" };
+    make_key_t makers[] = { make_english_word, make_url, make_binary_key };
+    bool succeeded = true;
+    for (size_t i = 0U; i < COUNT_OF(names) && succeeded; i++) {
+        dataset_t dataset = { names[i], NULL, 0U, 0U };
+        succeeded = generate_dataset(&dataset, &generator, makers[i],
+            (uint64_t) (i+1), key_count);
+        if (!succeeded) {
+            fprintf(stderr, "malloc failed\n");
+        }
+        succeeded = succeeded && benchmark_dataset(label, &dataset);
+        dataset_destroy(&dataset);
+    }
+    generator_destroy(&generator);
+
+    dataset_t wordlist = { "wordlist", NULL, 0U, 0U };
+    if (succeeded && read_dataset(&wordlist, wordlist_path) &&
+        wordlist.count > 0U) {
+        succeeded = benchmark_dataset(label, &wordlist);
+    }
+    else if (succeeded) {
+        fprintf(stderr, "skipping unreadable wordlist %s\n", wordlist_path);
+    }
+    dataset_destroy(&wordlist);
+
+    return succeeded ? 0 : 1;
+}
@@ -0,0 +1,438 @@
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// A builder relies on words arriving in sorted order. Only the nodes on the
+// path of the most recently added word can still gain children, so those are
+// kept pending on a stack. Each new word shares some prefix with the previous
+// one: pending nodes below that prefix are complete and are emitted, either
+// as nodes of a trie or as records of a trie file, and the new word's suffix
+// becomes a single pending node. Every node is emitted once, with all of its
+// children known, so construction takes time linear in the total length of
+// the words.
+
+// A node on the path of the most recently added word. The label of the edge
+// leading to it is the part of that word between the depth of its parent and
+// its own depth. Its emitted children start at children_start
+typedef struct {
+    size_t depth;
+    bool terminal;
+    size_t children_start;
+} _trie_pending_node_t;
+
+// An emitted node waiting to be attached to its parent. node is set when
+// building a trie, offset when building a trie file
+typedef struct {
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* node;
+    uint32_t offset;
+} _trie_emitted_node_t;
+
+struct trie_builder_t {
+    trie_t* trie;
+    _trie_file_writer_t writer;
+    char* path;
+    char* previous_word;
+    size_t previous_word_length;
+    size_t previous_word_capacity;
+    _trie_pending_node_t* pending;
+    size_t pending_count;
+    size_t pending_capacity;
+    _trie_emitted_node_t* emitted;
+    size_t emitted_count;
+    size_t emitted_capacity;
+};
+
+// Creates a builder with the root as its only pending node
+trie_result_t _create_builder(trie_builder_t** builder) {
+    trie_builder_t* created =
+        _allocate_memory(sizeof(trie_builder_t), TRIE_MEMORY_OTHER);
+    if (created == NULL) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    memset(created, 0, sizeof(trie_builder_t));
+    if (!_reserve((void**) &(created->pending), &(created->pending_capacity),
+        1U, sizeof(_trie_pending_node_t))) {
+        _deallocate_memory(created, sizeof(trie_builder_t),
+            TRIE_MEMORY_OTHER);
+        return TRIE_MALLOC_FAIL;
+    }
+    created->pending[0].depth = 0U;
+    created->pending[0].terminal = false;
+    created->pending[0].children_start = 0U;
+    created->pending_count = 1U;
+
+    *builder = created;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_builder_create(trie_builder_t** builder,
+    const trie_options_t* options) {
+
+    trie_builder_t* created;
+    trie_result_t create_result = _create_builder(&created);
+    if (create_result != TRIE_SUCCESS) {
+        return create_result;
+    }
+
+    create_result = trie_create_with_options(&(created->trie), options);
+    if (create_result != TRIE_SUCCESS) {
+        trie_builder_destroy(created);
+        return create_result;
+    }
+
+    *builder = created;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_builder_create_for_file(trie_builder_t** builder,
+    const char* path, bool store_words) {
+
+    if (path == NULL) {
+        return TRIE_PATH_NULL;
+    }
+
+    trie_builder_t* created;
+    trie_result_t create_result = _create_builder(&created);
+    if (create_result != TRIE_SUCCESS) {
+        return create_result;
+    }
+
+    created->path = _allocate_memory(strlen(path)+1, TRIE_MEMORY_OTHER);
+    if (created->path == NULL) {
+        trie_builder_destroy(created);
+        return TRIE_MALLOC_FAIL;
+    }
+    strcpy(created->path, path);
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        trie_builder_destroy(created);
+        return TRIE_FILE_ERROR;
+    }
+
+    if (!_begin_file(&(created->writer), file, store_words)) {
+        trie_builder_destroy(created);
+        return TRIE_FILE_ERROR;
+    }
+
+    *builder = created;
+
+    return TRIE_SUCCESS;
+}
+
+// Creates a node of the trie being built, with the given label and emitted
+// children. Returns NULL if memory allocation fails
+_trie_node_t* _build_node(trie_builder_t* builder, const char* label,
+    uint32_t label_length, bool terminal, size_t depth,
+    const _trie_emitted_node_t* children, size_t child_count) {
+
+    trie_t* trie = builder->trie;
+    _trie_node_t* node = _create_node(trie, label, label_length);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    if (terminal &&
+        !_set_terminal(trie, node, builder->previous_word, depth)) {
+        _destroy_node(trie, node);
+        return NULL;
+    }
+    node->word_count = terminal ? 1U : 0U;
+
+    if (child_count > 0U) {
+        _trie_children_kind_t kind = child_count <= 4U ? _TRIE_CHILDREN_4 :
+            child_count <= 16U ? _TRIE_CHILDREN_16 :
+            child_count <= 48U ? _TRIE_CHILDREN_48 : _TRIE_CHILDREN_256;
+        node->children = _create_children(trie, kind);
+        if (node->children == NULL) {
+            _destroy_node(trie, node);
+            return NULL;
+        }
+
+        for (size_t i = 0U; i < child_count; i++) {
+            _insert_child(node->children, children[i].key,
+                children[i].label_length, children[i].node);
+            node->word_count += children[i].node->word_count;
+        }
+    }
+
+    return node;
+}
+
+// Writes the record of a node of the trie file being built, with the given
+// label and emitted children. Returns false if writing fails
+bool _build_record(trie_builder_t* builder, const char* label,
+    uint32_t label_length, bool terminal, size_t depth,
+    const _trie_emitted_node_t* children, size_t child_count,
+    uint32_t* offset) {
+
+    unsigned char keys[256];
+    uint32_t offsets[256];
+    for (size_t i = 0U; i < child_count; i++) {
+        keys[i] = children[i].key;
+        offsets[i] = children[i].offset;
+    }
+
+    return _write_record(&(builder->writer), label, label_length, terminal,
+        builder->previous_word, depth, keys, offsets, (uint16_t) child_count,
+        offset);
+}
+
+// Emits the most recently pending node, which becomes a child awaiting its
+// parent. Returns false if memory allocation or writing fails
+bool _emit_pending_node(trie_builder_t* builder) {
+    const _trie_pending_node_t* node =
+        &(builder->pending[builder->pending_count-1]);
+    const _trie_pending_node_t* parent =
+        &(builder->pending[builder->pending_count-2]);
+
+    _trie_emitted_node_t emitted;
+    const char* label = builder->previous_word + parent->depth;
+    emitted.key = (unsigned char) label[0];
+    emitted.label_length = (uint32_t) (node->depth - parent->depth);
+    emitted.node = NULL;
+    emitted.offset = 0U;
+
+    const _trie_emitted_node_t* children =
+        builder->emitted + node->children_start;
+    size_t child_count = builder->emitted_count - node->children_start;
+    if (builder->trie != NULL) {
+        emitted.node = _build_node(builder, label, emitted.label_length,
+            node->terminal, node->depth, children, child_count);
+        if (emitted.node == NULL) {
+            return false;
+        }
+    }
+    else if (!_build_record(builder, label, emitted.label_length,
+        node->terminal, node->depth, children, child_count,
+        &(emitted.offset))) {
+        return false;
+    }
+
+    builder->emitted_count = node->children_start;
+    builder->emitted[builder->emitted_count] = emitted;
+    builder->emitted_count++;
+    builder->pending_count--;
+
+    return true;
+}
+
+// Emits every pending node deeper than depth. If the edge leading to the
+// shallowest of those starts above depth, it is split by a new pending node
+// at depth. Returns false if memory allocation or writing fails
+bool _emit_pending_nodes_below(trie_builder_t* builder, size_t depth) {
+    while (builder->pending[builder->pending_count-1].depth > depth) {
+        _trie_pending_node_t* parent =
+            &(builder->pending[builder->pending_count-2]);
+        if (parent->depth < depth) {
+            if (!_reserve((void**) &(builder->pending),
+                &(builder->pending_capacity), builder->pending_count+1,
+                sizeof(_trie_pending_node_t))) {
+                return false;
+            }
+
+            _trie_pending_node_t* node =
+                &(builder->pending[builder->pending_count-1]);
+            node[1] = node[0];
+            node[0].depth = depth;
+            node[0].terminal = false;
+            builder->pending_count++;
+        }
+
+        if (!_reserve((void**) &(builder->emitted),
+            &(builder->emitted_capacity), builder->emitted_count+1,
+            sizeof(_trie_emitted_node_t)) ||
+            !_emit_pending_node(builder)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+trie_result_t trie_builder_add_key(trie_builder_t* builder,
+    const char* word, size_t word_length) {
+
+    if (builder == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (word == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    if (word_length == 0U) {
+        return TRIE_WORD_EMPTY;
+    }
+
+    const char* previous_word = builder->previous_word;
+    size_t previous_word_length = builder->previous_word_length;
+    size_t common_length = 0U;
+    while (common_length < word_length &&
+        common_length < previous_word_length &&
+        word[common_length] == previous_word[common_length]) {
+        common_length++;
+    }
+
+    if (common_length == word_length) {
+        return word_length == previous_word_length ?
+            TRIE_SUCCESS : TRIE_WORDS_NOT_SORTED;
+    }
+
+    if (common_length < previous_word_length &&
+        (unsigned char) word[common_length] <
+            (unsigned char) previous_word[common_length]) {
+        return TRIE_WORDS_NOT_SORTED;
+    }
+
+    if (!_emit_pending_nodes_below(builder, common_length) ||
+        !_reserve((void**) &(builder->pending), &(builder->pending_capacity),
+            builder->pending_count+1, sizeof(_trie_pending_node_t)) ||
+        !_reserve((void**) &(builder->previous_word),
+            &(builder->previous_word_capacity), word_length, 1U)) {
+        return builder->trie != NULL ? TRIE_MALLOC_FAIL : TRIE_FILE_ERROR;
+    }
+
+    _trie_pending_node_t* node = &(builder->pending[builder->pending_count]);
+    node->depth = word_length;
+    node->terminal = true;
+    node->children_start = builder->emitted_count;
+    builder->pending_count++;
+
+    memcpy(builder->previous_word, word, word_length);
+    builder->previous_word_length = word_length;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_builder_add_word(trie_builder_t* builder,
+    const char* word) {
+
+    return trie_builder_add_key(
+        builder, word, word == NULL ? 0U : strlen(word));
+}
+
+// Emits all pending nodes, attaching the children of the root to the trie
+// being built or writing the record of the root to the trie file being
+// built. Returns false if memory allocation or writing fails
+bool _finish_building(trie_builder_t* builder) {
+    if (!_emit_pending_nodes_below(builder, 0U)) {
+        return false;
+    }
+
+    if (builder->trie != NULL) {
+        _trie_node_t* root = _build_node(builder, "", 0U, false, 0U,
+            builder->emitted, builder->emitted_count);
+        if (root == NULL) {
+            return false;
+        }
+        builder->emitted_count = 0U;
+
+        _destroy_node(builder->trie, builder->trie->root);
+        builder->trie->root = root;
+
+        return true;
+    }
+
+    uint32_t root;
+    bool written = _build_record(builder, "", 0U, false, 0U,
+        builder->emitted, builder->emitted_count, &root) &&
+        _finish_file(&(builder->writer), root);
+    builder->emitted_count = 0U;
+
+    bool closed = fclose(builder->writer.file) == 0;
+    builder->writer.file = NULL;
+
+    return written && closed;
+}
+
+trie_result_t trie_builder_finish(trie_builder_t* builder, trie_t** trie) {
+    if (builder == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (!_finish_building(builder)) {
+        trie_result_t result =
+            builder->trie != NULL ? TRIE_MALLOC_FAIL : TRIE_FILE_ERROR;
+        trie_builder_destroy(builder);
+        return result;
+    }
+
+    trie_result_t result = TRIE_SUCCESS;
+    if (builder->trie != NULL) {
+        *trie = builder->trie;
+        builder->trie = NULL;
+    }
+    else {
+        if (trie != NULL) {
+            result = trie_open_mapped(builder->path, trie);
+        }
+        _deallocate_memory(builder->path, strlen(builder->path)+1,
+            TRIE_MEMORY_OTHER);
+        builder->path = NULL;
+    }
+
+    trie_builder_destroy(builder);
+
+    return result;
+}
+
+trie_result_t trie_builder_destroy(trie_builder_t* builder) {
+    if (builder->trie != NULL) {
+        for (size_t i = 0U; i < builder->emitted_count; i++) {
+            _destroy_node(builder->trie, builder->emitted[i].node);
+        }
+        trie_destroy(builder->trie);
+    }
+
+    if (builder->writer.file != NULL) {
+        fclose(builder->writer.file);
+    }
+    if (builder->path != NULL) {
+        remove(builder->path);
+        _deallocate_memory(builder->path, strlen(builder->path)+1,
+            TRIE_MEMORY_OTHER);
+    }
+
+    _release(builder->previous_word, builder->previous_word_capacity, 1U);
+    _release(builder->emitted, builder->emitted_capacity,
+        sizeof(_trie_emitted_node_t));
+    _release(builder->pending, builder->pending_capacity,
+        sizeof(_trie_pending_node_t));
+    _deallocate_memory(builder, sizeof(trie_builder_t), TRIE_MEMORY_OTHER);
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_build_from_sorted(const char** words, size_t n,
+    trie_t** trie) {
+
+    if (words == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    trie_builder_t* builder;
+    trie_options_t options = { 0U, true, false };
+    trie_result_t result = trie_builder_create(&builder, &options);
+    if (result != TRIE_SUCCESS) {
+        return result;
+    }
+
+    for (size_t i = 0U; i < n; i++) {
+        result = trie_builder_add_word(builder, words[i]);
+        if (result != TRIE_SUCCESS) {
+            trie_builder_destroy(builder);
+            return result;
+        }
+    }
+
+    return trie_builder_finish(builder, trie);
+}
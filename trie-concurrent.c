@@ -0,0 +1,222 @@
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// A concurrent trie is read and written without locks. A writer never
+// changes a children block which others may be using: it builds a changed
+// copy and publishes it with a single compare-and-swap, so a reader sees
+// either the old block or the new one, each of them complete. If another
+// writer published a block for the same node first, the swap fails and the
+// writer retries its change against that block instead. Writers adding words
+// under different nodes never touch the same memory.
+//
+// A block which has been replaced is retired rather than deallocated, since
+// readers which loaded it before the replacement may still be using it.
+// Retired blocks are reclaimed using epochs. Each reader counts itself in
+// against the parity of the current epoch for the duration of a query. To
+// reclaim, a writer advances the epoch, moving the blocks retired so far to
+// a waiting list, and deallocates that list once no readers remain counted
+// against the previous parity, since any reader still able to reach those
+// blocks started before the epoch advanced. Writers count themselves in as
+// readers while looking through the trie. Only one writer reclaims at a time,
+// and the others skip reclaiming rather than wait for it.
+//
+// Readers only ever write to their own counters, which are spread across
+// separate cache lines by thread, so they never wait for each other or for
+// writers.
+
+// Number of separate sets of reader counters. Threads beyond this many share
+// counters, which is correct but may cause contention
+#define _TRIE_READER_SLOTS 64U
+
+// Assumed size of a cache line, used to keep reader counters apart
+#define _TRIE_CACHE_LINE_SIZE 64U
+
+// The number of readers counted against each epoch parity by the threads
+// sharing a slot
+typedef struct {
+    uint64_t active[2];
+    char padding[_TRIE_CACHE_LINE_SIZE - 2U*sizeof(uint64_t)];
+} _trie_reader_slot_t;
+
+typedef struct _trie_retired_t _trie_retired_t;
+
+// Children blocks retired by a writer, in a list
+struct _trie_retired_t {
+    _trie_retired_t* next;
+    _trie_children_t* children;
+};
+
+// retired is pushed onto by every writer, whereas waiting belongs to the
+// writer which has set reclaiming
+struct _trie_epochs_t {
+    uint64_t epoch;
+    _trie_reader_slot_t slots[_TRIE_READER_SLOTS];
+    _trie_retired_t* retired;
+    _trie_retired_t* waiting;
+    bool reclaiming;
+};
+
+// The slot used by the calling thread, or zero if it has not been assigned
+// one yet. Slots are otherwise numbered from one
+static __thread unsigned _trie_reader_slot = 0U;
+
+// The number of reader slots assigned so far, across all threads
+static unsigned _trie_reader_slots_assigned = 0U;
+
+_trie_epochs_t* _create_epochs() {
+    _trie_epochs_t* epochs =
+        _allocate_memory(sizeof(_trie_epochs_t), TRIE_MEMORY_OTHER);
+    if (epochs == NULL) {
+        return NULL;
+    }
+
+    memset(epochs, 0, sizeof(_trie_epochs_t));
+
+    return epochs;
+}
+
+// Returns the reader counters of the calling thread
+_trie_reader_slot_t* _get_reader_slot(_trie_epochs_t* epochs) {
+    if (_trie_reader_slot == 0U) {
+        unsigned assigned = __atomic_fetch_add(
+            &_trie_reader_slots_assigned, 1U, __ATOMIC_RELAXED);
+        _trie_reader_slot = assigned % _TRIE_READER_SLOTS + 1U;
+    }
+
+    return &(epochs->slots[_trie_reader_slot-1]);
+}
+
+uint64_t* _begin_read(const trie_t* trie) {
+    _trie_epochs_t* epochs = trie->epochs;
+    if (epochs == NULL) {
+        return NULL;
+    }
+
+    _trie_reader_slot_t* slot = _get_reader_slot(epochs);
+    while (true) {
+        uint64_t epoch = __atomic_load_n(&(epochs->epoch), __ATOMIC_SEQ_CST);
+        uint64_t* active = &(slot->active[epoch & 1U]);
+        __atomic_fetch_add(active, 1U, __ATOMIC_SEQ_CST);
+
+        // If the epoch advanced before this reader was counted, the writer
+        // may not have seen it, so it is counted against the new epoch instead
+        if (__atomic_load_n(&(epochs->epoch), __ATOMIC_SEQ_CST) == epoch) {
+            return active;
+        }
+        __atomic_fetch_sub(active, 1U, __ATOMIC_RELEASE);
+    }
+}
+
+void _end_read(uint64_t* active) {
+    if (active != NULL) {
+        __atomic_fetch_sub(active, 1U, __ATOMIC_RELEASE);
+    }
+}
+
+bool _publish_children(trie_t* trie, _trie_node_t* node,
+    const _trie_children_t* expected, _trie_children_t* children) {
+
+    if (trie->epochs == NULL) {
+        node->children = children;
+    }
+    else if (!__atomic_compare_exchange_n(&(node->children),
+        (_trie_children_t**) &expected, children, false, __ATOMIC_ACQ_REL,
+        __ATOMIC_RELAXED)) {
+        return false;
+    }
+
+    if (expected != NULL) {
+        _retire_children(trie, (_trie_children_t*) expected);
+    }
+
+    return true;
+}
+
+void _retire_children(trie_t* trie, _trie_children_t* children) {
+    _trie_epochs_t* epochs = trie->epochs;
+    if (epochs == NULL) {
+        _deallocate_children(trie, children);
+        return;
+    }
+
+    // Arena memory lives until the trie is destroyed anyway
+    if (trie->arena != NULL) {
+        return;
+    }
+
+    // Memory which cannot be recorded as retired is leaked rather than risk
+    // freeing it while it is in use
+    _trie_retired_t* retired =
+        _allocate_memory(sizeof(_trie_retired_t), TRIE_MEMORY_OTHER);
+    if (retired == NULL) {
+        return;
+    }
+
+    retired->children = children;
+    retired->next = __atomic_load_n(&(epochs->retired), __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&(epochs->retired), &(retired->next),
+        retired, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Deallocates the retired children blocks in list, and the list itself
+void _deallocate_retired(trie_t* trie, _trie_retired_t* list) {
+    while (list != NULL) {
+        _trie_retired_t* next = list->next;
+        _deallocate_children(trie, list->children);
+        _deallocate_memory(list, sizeof(_trie_retired_t), TRIE_MEMORY_OTHER);
+        list = next;
+    }
+}
+
+// Returns whether or not any reader is counted against the given parity
+bool _has_readers(_trie_epochs_t* epochs, unsigned parity) {
+    for (unsigned i = 0U; i < _TRIE_READER_SLOTS; i++) {
+        if (__atomic_load_n(&(epochs->slots[i].active[parity]),
+            __ATOMIC_SEQ_CST) != 0U) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void _reclaim_retired(trie_t* trie) {
+    _trie_epochs_t* epochs = trie->epochs;
+    if (epochs == NULL ||
+        __atomic_exchange_n(&(epochs->reclaiming), true, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    uint64_t epoch = __atomic_load_n(&(epochs->epoch), __ATOMIC_SEQ_CST);
+    if (epochs->waiting != NULL &&
+        !_has_readers(epochs, (unsigned) ((epoch+1U) & 1U))) {
+        _deallocate_retired(trie, epochs->waiting);
+        epochs->waiting = NULL;
+    }
+
+    if (epochs->waiting == NULL) {
+        epochs->waiting =
+            __atomic_exchange_n(&(epochs->retired), NULL, __ATOMIC_ACQUIRE);
+        if (epochs->waiting != NULL) {
+            __atomic_store_n(&(epochs->epoch), epoch+1U, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    __atomic_store_n(&(epochs->reclaiming), false, __ATOMIC_RELEASE);
+}
+
+void _destroy_epochs(trie_t* trie) {
+    _trie_epochs_t* epochs = trie->epochs;
+
+    _deallocate_retired(trie, epochs->waiting);
+    _deallocate_retired(trie, epochs->retired);
+    _deallocate_memory(epochs, sizeof(_trie_epochs_t), TRIE_MEMORY_OTHER);
+}
+
+size_t _get_epochs_size() {
+    return sizeof(_trie_epochs_t);
+}
@@ -0,0 +1,258 @@
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// A cursor walks the words matching a prefix depth first, in byte order,
+// with an explicit stack of frames rather than recursion. Each frame holds a
+// node on the current path and how far through its children the walk has
+// got, and the bytes of the current path are kept alongside. Every edge is at
+// least one byte long, so a cursor for words of up to max_word_length bytes
+// needs no more than max_word_length+1 frames, and all of its memory can be
+// supplied by the caller up front.
+
+// A node on the path of a cursor, reached through an edge of label_length
+// bytes. visited is set once the word ending at the node, if any, has been
+// returned or skipped
+typedef struct {
+    const _trie_node_t* node;
+    _trie_children_iterator_t iterator;
+    uint32_t label_length;
+    bool visited;
+} _trie_cursor_frame_t;
+
+// The first frame is for the node at the end of the prefix, and the first
+// prefix_path_length bytes of path spell out the edges to that node. A cursor
+// over a concurrent trie counts as a reader through active until it is closed
+struct trie_cursor_t {
+    uint64_t* active;
+    _trie_node_t* prefix_node;
+    size_t prefix_path_length;
+    size_t max_word_length;
+    size_t depth;
+    size_t path_length;
+    char* path;
+    _trie_cursor_frame_t frames[];
+};
+
+size_t trie_cursor_size(size_t max_word_length) {
+    return sizeof(trie_cursor_t) +
+        (max_word_length+1) * sizeof(_trie_cursor_frame_t) +
+        max_word_length+1;
+}
+
+// Pushes a frame for node, reached through an edge with the given label
+void _push_frame(trie_cursor_t* cursor, const _trie_node_t* node,
+    const char* label, uint32_t label_length) {
+
+    _trie_cursor_frame_t* frame = &(cursor->frames[cursor->depth]);
+    frame->node = node;
+    _begin_children(node, &(frame->iterator));
+    frame->label_length = label_length;
+    frame->visited = false;
+    cursor->depth++;
+
+    memcpy(cursor->path + cursor->path_length, label, label_length);
+    cursor->path_length += label_length;
+}
+
+// Moves the cursor back to the first word matching its prefix
+void _rewind_cursor(trie_cursor_t* cursor) {
+    cursor->depth = 0U;
+    cursor->path_length = cursor->prefix_path_length;
+    if (cursor->prefix_node != NULL) {
+        _push_frame(cursor, cursor->prefix_node, "", 0U);
+    }
+}
+
+trie_result_t trie_cursor_open_key(trie_t* trie, const char* prefix,
+    size_t prefix_length, size_t max_word_length, void* memory,
+    size_t memory_length, trie_cursor_t** cursor) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (prefix == NULL) {
+        return TRIE_PREFIX_NULL;
+    }
+
+    if (memory == NULL || memory_length < trie_cursor_size(max_word_length)) {
+        return TRIE_CURSOR_MEMORY_TOO_SMALL;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    if (prefix_length > max_word_length) {
+        return TRIE_WORD_TOO_LONG;
+    }
+
+    trie_cursor_t* opened = memory;
+    opened->max_word_length = max_word_length;
+    opened->path =
+        (char*) (opened->frames + (max_word_length+1));
+
+    opened->active = _begin_read(trie);
+    uint32_t remaining_length;
+    opened->prefix_node = _find_prefix_node(
+        trie->root, prefix, prefix_length, &remaining_length);
+    opened->prefix_path_length = prefix_length;
+    if (opened->prefix_node != NULL) {
+        if (remaining_length > max_word_length - prefix_length) {
+            _end_read(opened->active);
+            return TRIE_WORD_TOO_LONG;
+        }
+
+        memcpy(opened->path, prefix, prefix_length);
+        memcpy(opened->path + prefix_length, opened->prefix_node->label +
+            opened->prefix_node->label_length - remaining_length,
+            remaining_length);
+        opened->prefix_path_length += remaining_length;
+    }
+    _rewind_cursor(opened);
+
+    *cursor = opened;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_cursor_open(trie_t* trie, const char* prefix,
+    size_t max_word_length, void* memory, size_t memory_length,
+    trie_cursor_t** cursor) {
+
+    return trie_cursor_open_key(trie, prefix,
+        prefix == NULL ? 0U : strlen(prefix), max_word_length, memory,
+        memory_length, cursor);
+}
+
+trie_result_t trie_cursor_next_key(trie_cursor_t* cursor, const char** word,
+    size_t* word_length) {
+
+    if (cursor == NULL) {
+        return TRIE_NULL;
+    }
+
+    while (cursor->depth > 0U) {
+        _trie_cursor_frame_t* frame = &(cursor->frames[cursor->depth-1]);
+        if (!frame->visited) {
+            frame->visited = true;
+            if (_is_terminal_node(frame->node)) {
+                cursor->path[cursor->path_length] = '\0';
+                *word = cursor->path;
+                *word_length = cursor->path_length;
+                return TRIE_SUCCESS;
+            }
+        }
+
+        unsigned char key;
+        uint32_t label_length;
+        _trie_node_t* child;
+        if (_next_child(&(frame->iterator), &key, &label_length, &child)) {
+            if (label_length > cursor->max_word_length - cursor->path_length) {
+                return TRIE_WORD_TOO_LONG;
+            }
+            _push_frame(cursor, child, _get_edge_label(child, label_length),
+                label_length);
+        }
+        else {
+            cursor->path_length -= frame->label_length;
+            cursor->depth--;
+        }
+    }
+
+    *word = NULL;
+    *word_length = 0U;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_cursor_next(trie_cursor_t* cursor, const char** word) {
+    size_t word_length;
+
+    return trie_cursor_next_key(cursor, word, &word_length);
+}
+
+trie_result_t trie_cursor_seek_key(trie_cursor_t* cursor, const char* word,
+    size_t word_length) {
+
+    if (cursor == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (word == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    _rewind_cursor(cursor);
+    if (cursor->depth == 0U) {
+        return TRIE_SUCCESS;
+    }
+
+    // Words before the prefix leave the cursor at the start, and words after
+    // it leave the cursor at the end
+    size_t compared_length = word_length < cursor->prefix_path_length ?
+        word_length : cursor->prefix_path_length;
+    int comparison = memcmp(cursor->path, word, compared_length);
+    if (comparison < 0) {
+        cursor->depth = 0U;
+    }
+    if (comparison != 0 || word_length <= cursor->prefix_path_length) {
+        return TRIE_SUCCESS;
+    }
+
+    // Follows word down the trie for as long as it matches, positioning each
+    // frame on the way at the first child which may hold a word after it
+    while (true) {
+        _trie_cursor_frame_t* frame = &(cursor->frames[cursor->depth-1]);
+        frame->visited = true;
+
+        unsigned char key = (unsigned char) word[cursor->path_length];
+        uint32_t label_length;
+        _trie_node_t* child = _get_child(frame->node, key, &label_length);
+        if (child == NULL) {
+            _seek_children(&(frame->iterator), key);
+            return TRIE_SUCCESS;
+        }
+
+        const char* label = _get_edge_label(child, label_length);
+        size_t remaining_length = word_length - cursor->path_length;
+        comparison = memcmp(label, word + cursor->path_length,
+            remaining_length < label_length ? remaining_length : label_length);
+        if (comparison > 0 ||
+            (comparison == 0 && remaining_length <= label_length)) {
+            _seek_children(&(frame->iterator), key);
+            return TRIE_SUCCESS;
+        }
+
+        _seek_children(&(frame->iterator), (uint16_t) (key+1U));
+        if (comparison < 0) {
+            return TRIE_SUCCESS;
+        }
+
+        if (label_length > cursor->max_word_length - cursor->path_length) {
+            return TRIE_WORD_TOO_LONG;
+        }
+        _push_frame(cursor, child, label, label_length);
+    }
+}
+
+trie_result_t trie_cursor_seek(trie_cursor_t* cursor, const char* word) {
+    return trie_cursor_seek_key(
+        cursor, word, word == NULL ? 0U : strlen(word));
+}
+
+trie_result_t trie_cursor_close(trie_cursor_t* cursor) {
+    if (cursor == NULL) {
+        return TRIE_NULL;
+    }
+
+    cursor->depth = 0U;
+    cursor->prefix_node = NULL;
+    _end_read(cursor->active);
+    cursor->active = NULL;
+
+    return TRIE_SUCCESS;
+}
@@ -0,0 +1,483 @@
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// A DAWG (directed acyclic word graph) is the minimal deterministic automaton
+// accepting the words of a trie. Nodes of the trie which accept the same set
+// of suffixes are merged into a single state, so common suffixes are stored
+// once, just as common prefixes are in the trie. Transitions are labelled
+// with single bytes, since merging states with differently compressed edges
+// would hide suffixes which could otherwise be shared.
+//
+// A state no longer corresponds to a single word, so words are not stored:
+// they are reconstructed from the path taken through the DAWG. Each state
+// records how many words are accepted from it, so words matching a prefix can
+// be counted without visiting them.
+//
+// The DAWG is built bottom-up from the nodes of a trie. Each state is looked
+// up in a hash table of the states built so far, keyed on whether it is
+// terminal and on its transitions, and is only added if no equivalent state
+// exists. Since the targets of transitions are themselves unique, two states
+// are equivalent exactly when those keys are equal.
+
+// Marks the absence of a state
+#define _TRIE_DAWG_NO_STATE UINT32_MAX
+
+// Number of slots in the hash table of states when building starts, which
+// must be a power of two. The table is doubled whenever it is half full
+#define _TRIE_DAWG_TABLE_INITIAL_CAPACITY 1024U
+
+// A state of a DAWG. Its transitions are the transition_count entries from
+// first_transition in the keys and targets of the DAWG, in key order
+typedef struct {
+    uint32_t first_transition;
+    uint32_t word_count;
+    uint16_t transition_count;
+    bool terminal;
+} _trie_dawg_state_t;
+
+struct _trie_dawg_t {
+    size_t size;
+    const _trie_dawg_state_t* states;
+    const uint32_t* targets;
+    const unsigned char* keys;
+    uint32_t root;
+};
+
+// A DAWG being built. Each occupied slot of the hash table holds one more
+// than the index of a state
+typedef struct {
+    _trie_dawg_state_t* states;
+    size_t state_count;
+    size_t state_capacity;
+    uint32_t* targets;
+    size_t targets_capacity;
+    unsigned char* keys;
+    size_t keys_capacity;
+    size_t transition_count;
+    uint32_t* table;
+    size_t table_capacity;
+} _trie_dawg_builder_t;
+
+// Returns the hash of a state with the given transitions
+uint32_t _hash_state(bool terminal, const unsigned char* keys,
+    const uint32_t* targets, uint16_t transition_count) {
+
+    // FNV-1a
+    uint32_t hash = 2166136261U ^ (terminal ? 1U : 0U);
+    for (uint16_t i = 0U; i < transition_count; i++) {
+        hash = (hash ^ keys[i]) * 16777619U;
+        hash = (hash ^ targets[i]) * 16777619U;
+    }
+
+    return hash;
+}
+
+// Returns the slot of the hash table holding the state with the given
+// transitions, or the empty slot at which it belongs if there is no such
+// state
+size_t _find_state_slot(const _trie_dawg_builder_t* builder, bool terminal,
+    const unsigned char* keys, const uint32_t* targets,
+    uint16_t transition_count) {
+
+    size_t mask = builder->table_capacity-1;
+    size_t slot =
+        _hash_state(terminal, keys, targets, transition_count) & mask;
+    while (builder->table[slot] != 0U) {
+        const _trie_dawg_state_t* state =
+            &(builder->states[builder->table[slot]-1]);
+        // The keys and targets are not allocated until a state with
+        // transitions is added, so states without any are not compared
+        if (state->terminal == terminal &&
+            state->transition_count == transition_count &&
+            (transition_count == 0U ||
+            (memcmp(builder->keys + state->first_transition, keys,
+                transition_count) == 0 &&
+            memcmp(builder->targets + state->first_transition, targets,
+                transition_count * sizeof(uint32_t)) == 0))) {
+            break;
+        }
+        slot = (slot+1) & mask;
+    }
+
+    return slot;
+}
+
+// Doubles the capacity of the hash table, returning false if memory
+// allocation fails
+bool _grow_state_table(_trie_dawg_builder_t* builder) {
+    size_t capacity = builder->table_capacity * 2U;
+    uint32_t* table =
+        _allocate_memory(capacity * sizeof(uint32_t), TRIE_MEMORY_OTHER);
+    if (table == NULL) {
+        return false;
+    }
+    memset(table, 0, capacity * sizeof(uint32_t));
+
+    _release(builder->table, builder->table_capacity, sizeof(uint32_t));
+    builder->table = table;
+    builder->table_capacity = capacity;
+
+    for (size_t i = 0U; i < builder->state_count; i++) {
+        const _trie_dawg_state_t* state = &(builder->states[i]);
+        size_t slot = _find_state_slot(builder, state->terminal,
+            builder->keys + state->first_transition,
+            builder->targets + state->first_transition,
+            state->transition_count);
+        table[slot] = (uint32_t) (i+1);
+    }
+
+    return true;
+}
+
+// Sets state to the state with the given transitions, adding it if there is
+// no such state. Returns false if memory allocation fails or the DAWG would
+// have too many states
+bool _add_state(_trie_dawg_builder_t* builder, bool terminal,
+    const unsigned char* keys, const uint32_t* targets,
+    uint16_t transition_count, uint32_t* state) {
+
+    size_t slot =
+        _find_state_slot(builder, terminal, keys, targets, transition_count);
+    if (builder->table[slot] != 0U) {
+        *state = builder->table[slot]-1;
+        return true;
+    }
+
+    size_t transition_end = builder->transition_count + transition_count;
+    if (builder->state_count == _TRIE_DAWG_NO_STATE-1 ||
+        transition_end > UINT32_MAX ||
+        !_reserve((void**) &(builder->states), &(builder->state_capacity),
+            builder->state_count+1, sizeof(_trie_dawg_state_t)) ||
+        !_reserve((void**) &(builder->targets), &(builder->targets_capacity),
+            transition_end, sizeof(uint32_t)) ||
+        !_reserve((void**) &(builder->keys), &(builder->keys_capacity),
+            transition_end, 1U)) {
+        return false;
+    }
+
+    _trie_dawg_state_t* added = &(builder->states[builder->state_count]);
+    added->first_transition = (uint32_t) builder->transition_count;
+    added->word_count = terminal ? 1U : 0U;
+    added->transition_count = transition_count;
+    added->terminal = terminal;
+    for (uint16_t i = 0U; i < transition_count; i++) {
+        added->word_count += builder->states[targets[i]].word_count;
+    }
+
+    if (transition_count > 0U) {
+        memcpy(builder->keys + builder->transition_count, keys,
+            transition_count);
+        memcpy(builder->targets + builder->transition_count, targets,
+            transition_count * sizeof(uint32_t));
+    }
+    builder->transition_count = transition_end;
+
+    *state = (uint32_t) builder->state_count;
+    builder->table[slot] = (uint32_t) (builder->state_count+1);
+    builder->state_count++;
+
+    if (builder->state_count*2U > builder->table_capacity) {
+        return _grow_state_table(builder);
+    }
+
+    return true;
+}
+
+// Sets state to the state accepting the same suffixes as node, adding it and
+// the states reachable from it as needed. Returns false if memory allocation
+// fails or the DAWG would have too many states
+bool _add_node_states(_trie_dawg_builder_t* builder,
+    const _trie_node_t* node, uint32_t* state) {
+
+    unsigned char keys[256];
+    uint32_t targets[256];
+    uint16_t transition_count = 0U;
+
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        uint32_t target;
+        if (!_add_node_states(builder, child, &target)) {
+            return false;
+        }
+
+        // Each byte of the label after the first leads to a state of its own
+        const char* label = _get_edge_label(child, label_length);
+        for (uint32_t i = label_length-1; i > 0U; i--) {
+            unsigned char label_key = (unsigned char) label[i];
+            if (!_add_state(builder, false, &label_key, &target, 1U,
+                &target)) {
+                return false;
+            }
+        }
+
+        keys[transition_count] = key;
+        targets[transition_count] = target;
+        transition_count++;
+    }
+
+    return _add_state(builder, _is_terminal_node(node), keys, targets,
+        transition_count, state);
+}
+
+// Creates a DAWG from the states built, with the given root, in a single
+// block of memory. Returns NULL if memory allocation fails
+_trie_dawg_t* _create_dawg(const _trie_dawg_builder_t* builder,
+    uint32_t root) {
+
+    size_t states_size = builder->state_count * sizeof(_trie_dawg_state_t);
+    size_t targets_size = builder->transition_count * sizeof(uint32_t);
+    size_t size = sizeof(_trie_dawg_t) + states_size + targets_size +
+        builder->transition_count;
+    char* memory = _allocate_memory(size, TRIE_MEMORY_READ_ONLY);
+    if (memory == NULL) {
+        return NULL;
+    }
+
+    _trie_dawg_t* dawg = (_trie_dawg_t*) memory;
+    _trie_dawg_state_t* states =
+        (_trie_dawg_state_t*) (memory + sizeof(_trie_dawg_t));
+    uint32_t* targets = (uint32_t*) ((char*) states + states_size);
+    unsigned char* keys = (unsigned char*) targets + targets_size;
+
+    memcpy(states, builder->states, states_size);
+    if (builder->transition_count > 0U) {
+        memcpy(targets, builder->targets, targets_size);
+        memcpy(keys, builder->keys, builder->transition_count);
+    }
+
+    dawg->size = size;
+    dawg->states = states;
+    dawg->targets = targets;
+    dawg->keys = keys;
+    dawg->root = root;
+
+    return dawg;
+}
+
+// Deallocates the memory held by builder
+void _destroy_dawg_builder(_trie_dawg_builder_t* builder) {
+    _release(builder->states, builder->state_capacity,
+        sizeof(_trie_dawg_state_t));
+    _release(builder->targets, builder->targets_capacity, sizeof(uint32_t));
+    _release(builder->keys, builder->keys_capacity, 1U);
+    _release(builder->table, builder->table_capacity, sizeof(uint32_t));
+}
+
+trie_result_t trie_freeze_to_dawg(trie_t* trie, trie_t** dawg) {
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    _trie_dawg_builder_t builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.table_capacity = _TRIE_DAWG_TABLE_INITIAL_CAPACITY;
+    builder.table = _allocate_memory(
+        builder.table_capacity * sizeof(uint32_t), TRIE_MEMORY_OTHER);
+    if (builder.table == NULL) {
+        return TRIE_MALLOC_FAIL;
+    }
+    memset(builder.table, 0, builder.table_capacity * sizeof(uint32_t));
+
+    uint32_t root;
+    _trie_dawg_t* created_dawg = NULL;
+    uint64_t* active = _begin_read(trie);
+    if (_add_node_states(&builder, trie->root, &root)) {
+        created_dawg = _create_dawg(&builder, root);
+    }
+    _end_read(active);
+    _destroy_dawg_builder(&builder);
+    if (created_dawg == NULL) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    trie_t* created = _allocate_memory(sizeof(trie_t), TRIE_MEMORY_OTHER);
+    if (created == NULL) {
+        _destroy_dawg(created_dawg);
+        return TRIE_MALLOC_FAIL;
+    }
+
+    memset(created, 0, sizeof(trie_t));
+    created->kind = _TRIE_DAWG;
+    created->store_words = false;
+    created->dawg = created_dawg;
+
+    *dawg = created;
+
+    return TRIE_SUCCESS;
+}
+
+// Returns the state reached from state through the transition with the given
+// key, or _TRIE_DAWG_NO_STATE if there is no such transition
+uint32_t _get_transition(const _trie_dawg_t* dawg, uint32_t state,
+    unsigned char key) {
+
+    const _trie_dawg_state_t* from = &(dawg->states[state]);
+    const unsigned char* keys = dawg->keys + from->first_transition;
+    const unsigned char* found = memchr(keys, key, from->transition_count);
+    if (found == NULL) {
+        return _TRIE_DAWG_NO_STATE;
+    }
+
+    return dawg->targets[from->first_transition + (found-keys)];
+}
+
+// Returns the state reached from the root through the given bytes, or
+// _TRIE_DAWG_NO_STATE if there is no such state
+uint32_t _find_state(const _trie_dawg_t* dawg, const char* key,
+    size_t length) {
+
+    uint32_t state = dawg->root;
+    for (size_t i = 0U; i < length && state != _TRIE_DAWG_NO_STATE; i++) {
+        state = _get_transition(dawg, state, (unsigned char) key[i]);
+    }
+
+    return state;
+}
+
+bool _dawg_contains_word(const _trie_dawg_t* dawg, const char* word,
+    size_t word_length) {
+
+    uint32_t state = _find_state(dawg, word, word_length);
+
+    return state != _TRIE_DAWG_NO_STATE && dawg->states[state].terminal;
+}
+
+void _dawg_find_prefix_matches(const _trie_dawg_t* dawg, const char* input,
+    size_t length, _trie_prefix_matches_t* matches) {
+
+    uint32_t state = dawg->root;
+    for (size_t i = 0U; i < length && !matches->done; i++) {
+        state = _get_transition(dawg, state, (unsigned char) input[i]);
+        if (state == _TRIE_DAWG_NO_STATE) {
+            return;
+        }
+
+        if (dawg->states[state].terminal) {
+            _record_prefix_match(matches, i+1);
+        }
+    }
+}
+
+void _copy_state_words(const _trie_dawg_t* dawg, uint32_t state,
+    _trie_word_copy_t* copy) {
+
+    const _trie_dawg_state_t* from = &(dawg->states[state]);
+    if (from->terminal) {
+        _copy_path_word(copy);
+    }
+
+    for (uint16_t i = 0U; i < from->transition_count && !copy->done; i++) {
+        uint32_t transition = from->first_transition + i;
+        if (_push_path(copy, (const char*) dawg->keys + transition, 1U)) {
+            _copy_state_words(dawg, dawg->targets[transition], copy);
+            copy->path_length--;
+        }
+    }
+}
+
+void _dawg_copy_words_matching_prefix(const _trie_dawg_t* dawg,
+    const char* prefix, size_t prefix_length, _trie_word_copy_t* copy) {
+
+    uint32_t state = _find_state(dawg, prefix, prefix_length);
+    if (state != _TRIE_DAWG_NO_STATE &&
+        _push_path(copy, prefix, prefix_length)) {
+        _copy_state_words(dawg, state, copy);
+    }
+}
+
+size_t _dawg_count_words_matching_prefix(const _trie_dawg_t* dawg,
+    const char* prefix, size_t prefix_length) {
+
+    uint32_t state = _find_state(dawg, prefix, prefix_length);
+    if (state == _TRIE_DAWG_NO_STATE) {
+        return 0U;
+    }
+
+    return dawg->states[state].word_count;
+}
+
+size_t _dawg_rank_key(const _trie_dawg_t* dawg, const char* key,
+    size_t length) {
+
+    size_t rank = 0U;
+    uint32_t state = dawg->root;
+    for (size_t i = 0U; i < length; i++) {
+        const _trie_dawg_state_t* from = &(dawg->states[state]);
+        if (from->terminal) {
+            rank++;
+        }
+
+        // Every word through a transition on a lesser key comes before key
+        uint32_t next = _TRIE_DAWG_NO_STATE;
+        for (uint16_t j = 0U; j < from->transition_count; j++) {
+            uint32_t transition = from->first_transition + j;
+            unsigned char transition_key = dawg->keys[transition];
+            if (transition_key >= (unsigned char) key[i]) {
+                if (transition_key == (unsigned char) key[i]) {
+                    next = dawg->targets[transition];
+                }
+                break;
+            }
+            rank += dawg->states[dawg->targets[transition]].word_count;
+        }
+        if (next == _TRIE_DAWG_NO_STATE) {
+            return rank;
+        }
+        state = next;
+    }
+
+    return rank;
+}
+
+bool _dawg_select_key(const _trie_dawg_t* dawg, size_t index, char* buffer,
+    size_t buffer_length, size_t* key_length, bool* found) {
+
+    *found = false;
+    uint32_t state = dawg->root;
+    if (index >= dawg->states[state].word_count) {
+        return true;
+    }
+
+    // index stays less than the number of words at or below state, so a
+    // transition leading to the word is always found
+    size_t used = 0U;
+    while (!dawg->states[state].terminal || index > 0U) {
+        const _trie_dawg_state_t* from = &(dawg->states[state]);
+        if (from->terminal) {
+            index--;
+        }
+
+        uint32_t transition = from->first_transition;
+        while (index >= dawg->states[dawg->targets[transition]].word_count) {
+            index -= dawg->states[dawg->targets[transition]].word_count;
+            transition++;
+        }
+
+        if (buffer_length - used <= 1U) {
+            return false;
+        }
+        buffer[used++] = (char) dawg->keys[transition];
+        state = dawg->targets[transition];
+    }
+
+    buffer[used] = '\0';
+    *key_length = used;
+    *found = true;
+
+    return true;
+}
+
+void _destroy_dawg(_trie_dawg_t* dawg) {
+    _deallocate_memory(dawg, dawg->size, TRIE_MEMORY_READ_ONLY);
+}
@@ -0,0 +1,511 @@
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// A double array holds the states of a trie in an array of cells, one cell
+// per state, with transitions labelled with single bytes. The transition from
+// state s through byte c leads to state base(s) + c, which exists only if the
+// check of that cell is s + 1. Following a transition therefore takes two
+// array reads and no search, at the cost of the array having some unused
+// cells. Words are not stored: they are reconstructed from the path taken.
+//
+// The cells are filled from the nodes of a trie, depth first. The transitions
+// of each state are given the lowest base at which all of their cells are
+// free, with each byte of a compressed edge label becoming a state of its own.
+// The root is always in cell 0, and every other state has a base of at least
+// one, so no transition leads back to the root.
+
+// Set in the base of a cell when its state is terminal
+#define _TRIE_DOUBLE_ARRAY_TERMINAL 0x80000000U
+
+// The largest number of cells in a double array
+#define _TRIE_DOUBLE_ARRAY_MAX_CELLS _TRIE_DOUBLE_ARRAY_TERMINAL
+
+// Number of cells allocated when building starts
+#define _TRIE_DOUBLE_ARRAY_INITIAL_CELLS 1024U
+
+// A state of a double array. A check of zero marks an unused cell
+typedef struct {
+    uint32_t base;
+    uint32_t check;
+} _trie_double_array_cell_t;
+
+struct _trie_double_array_t {
+    size_t cell_count;
+    _trie_double_array_cell_t cells[];
+};
+
+// The free cells of a double array being built are kept in a doubly linked
+// list, in ascending order, so finding a base only visits free cells. Cells
+// beyond the capacity are all free, and are added to the list as it grows.
+// Cell 0, holding the root, is never free, so it marks the end of the list
+typedef struct {
+    uint32_t next;
+    uint32_t previous;
+} _trie_double_array_link_t;
+
+// A double array being built. No cell at or beyond cell_count is in use
+typedef struct {
+    _trie_double_array_cell_t* cells;
+    _trie_double_array_link_t* links;
+    size_t capacity;
+    size_t cell_count;
+} _trie_double_array_builder_t;
+
+// Ensures at least capacity cells are allocated, linking any new cells onto
+// the end of the free list. Returns false if memory allocation fails or the
+// double array would have too many cells
+bool _reserve_cells(_trie_double_array_builder_t* builder, size_t capacity) {
+    if (capacity <= builder->capacity) {
+        return true;
+    }
+
+    size_t grown_capacity = builder->capacity * 2U;
+    if (grown_capacity < capacity) {
+        grown_capacity = capacity;
+    }
+    if (grown_capacity > _TRIE_DOUBLE_ARRAY_MAX_CELLS) {
+        grown_capacity = _TRIE_DOUBLE_ARRAY_MAX_CELLS;
+        if (grown_capacity < capacity) {
+            return false;
+        }
+    }
+
+    _trie_double_array_cell_t* cells = _allocate_memory(
+        grown_capacity * sizeof(_trie_double_array_cell_t),
+        TRIE_MEMORY_OTHER);
+    _trie_double_array_link_t* links = _allocate_memory(
+        grown_capacity * sizeof(_trie_double_array_link_t),
+        TRIE_MEMORY_OTHER);
+    if (cells == NULL || links == NULL) {
+        _release(cells, grown_capacity, sizeof(_trie_double_array_cell_t));
+        _release(links, grown_capacity, sizeof(_trie_double_array_link_t));
+        return false;
+    }
+
+    size_t old_capacity = builder->capacity;
+    if (old_capacity > 0U) {
+        memcpy(cells, builder->cells,
+            old_capacity * sizeof(_trie_double_array_cell_t));
+        memcpy(links, builder->links,
+            old_capacity * sizeof(_trie_double_array_link_t));
+    }
+    memset(cells + old_capacity, 0,
+        (grown_capacity - old_capacity) * sizeof(_trie_double_array_cell_t));
+
+    uint32_t last = old_capacity == 0U ? 0U : links[0].previous;
+    for (size_t i = old_capacity == 0U ? 1U : old_capacity;
+        i < grown_capacity; i++) {
+        links[last].next = (uint32_t) i;
+        links[i].previous = last;
+        last = (uint32_t) i;
+    }
+    links[last].next = 0U;
+    links[0].previous = last;
+
+    _release(builder->cells, old_capacity,
+        sizeof(_trie_double_array_cell_t));
+    _release(builder->links, old_capacity,
+        sizeof(_trie_double_array_link_t));
+    builder->cells = cells;
+    builder->links = links;
+    builder->capacity = grown_capacity;
+
+    return true;
+}
+
+// Gives state transitions through each of the count keys, in ascending
+// order, at the lowest base for which all of their cells are free. Returns
+// false if memory allocation fails or the double array would have too many
+// cells
+bool _add_transitions(_trie_double_array_builder_t* builder, uint32_t state,
+    const unsigned char* keys, uint16_t count) {
+
+    size_t base = 0U;
+    uint32_t position = builder->links[0].next;
+    while (base == 0U) {
+        if (position == 0U) {
+            // Every allocated cell has been tried, so continue with new ones
+            uint32_t last = builder->links[0].previous;
+            if (!_reserve_cells(builder, builder->capacity+1)) {
+                return false;
+            }
+            position = builder->links[last].next;
+            continue;
+        }
+
+        if (position > keys[0]) {
+            base = position - keys[0];
+            if (!_reserve_cells(builder, base + keys[count-1] + 1U)) {
+                return false;
+            }
+            for (uint16_t i = 1U; i < count && base != 0U; i++) {
+                if (builder->cells[base + keys[i]].check != 0U) {
+                    base = 0U;
+                }
+            }
+        }
+        position = builder->links[position].next;
+    }
+
+    builder->cells[state].base |= (uint32_t) base;
+    for (uint16_t i = 0U; i < count; i++) {
+        size_t cell = base + keys[i];
+        builder->cells[cell].check = state+1;
+
+        _trie_double_array_link_t* link = &(builder->links[cell]);
+        builder->links[link->previous].next = link->next;
+        builder->links[link->next].previous = link->previous;
+    }
+
+    size_t end = base + keys[count-1] + 1U;
+    if (builder->cell_count < end) {
+        builder->cell_count = end;
+    }
+
+    return true;
+}
+
+// Adds the descendants of node, which is held in the given state. Returns
+// false if memory allocation fails or the double array would have too many
+// cells
+bool _add_node_cells(_trie_double_array_builder_t* builder,
+    const _trie_node_t* node, uint32_t state) {
+
+    unsigned char keys[256];
+    uint16_t count = 0U;
+
+    // Both passes visit the same children block, since in a concurrent trie
+    // a larger one may be published between them, holding keys for which no
+    // cells were reserved
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    _trie_children_iterator_t first_child = iterator;
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        keys[count] = key;
+        count++;
+    }
+
+    if (count == 0U || !_add_transitions(builder, state, keys, count)) {
+        return count == 0U;
+    }
+
+    uint32_t base = builder->cells[state].base & ~_TRIE_DOUBLE_ARRAY_TERMINAL;
+    iterator = first_child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        uint32_t child_state = base + key;
+
+        // Each byte of the label after the first leads to a state of its own
+        const char* label = _get_edge_label(child, label_length);
+        for (uint32_t i = 1U; i < label_length; i++) {
+            unsigned char label_key = (unsigned char) label[i];
+            if (!_add_transitions(builder, child_state, &label_key, 1U)) {
+                return false;
+            }
+            child_state = (builder->cells[child_state].base &
+                ~_TRIE_DOUBLE_ARRAY_TERMINAL) + label_key;
+        }
+
+        if (_is_terminal_node(child)) {
+            builder->cells[child_state].base |= _TRIE_DOUBLE_ARRAY_TERMINAL;
+        }
+
+        if (!_add_node_cells(builder, child, child_state)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+trie_result_t trie_freeze_to_double_array(trie_t* trie,
+    trie_t** double_array) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    _trie_double_array_builder_t builder = { NULL, NULL, 0U, 1U };
+    uint64_t* active = _begin_read(trie);
+    bool built = _reserve_cells(&builder, _TRIE_DOUBLE_ARRAY_INITIAL_CELLS) &&
+        _add_node_cells(&builder, trie->root, 0U);
+    _end_read(active);
+
+    _trie_double_array_t* created_array = NULL;
+    if (built) {
+        size_t cells_size =
+            builder.cell_count * sizeof(_trie_double_array_cell_t);
+        created_array = _allocate_memory(
+            sizeof(_trie_double_array_t) + cells_size, TRIE_MEMORY_READ_ONLY);
+        if (created_array != NULL) {
+            created_array->cell_count = builder.cell_count;
+            memcpy(created_array->cells, builder.cells, cells_size);
+        }
+    }
+    _release(builder.cells, builder.capacity,
+        sizeof(_trie_double_array_cell_t));
+    _release(builder.links, builder.capacity,
+        sizeof(_trie_double_array_link_t));
+    if (created_array == NULL) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    trie_t* created = _allocate_memory(sizeof(trie_t), TRIE_MEMORY_OTHER);
+    if (created == NULL) {
+        _destroy_double_array(created_array);
+        return TRIE_MALLOC_FAIL;
+    }
+
+    memset(created, 0, sizeof(trie_t));
+    created->kind = _TRIE_DOUBLE_ARRAY;
+    created->store_words = false;
+    created->double_array = created_array;
+
+    *double_array = created;
+
+    return TRIE_SUCCESS;
+}
+
+// Returns the base of state, without its terminal flag
+uint32_t _get_base(const _trie_double_array_t* double_array, uint32_t state) {
+    return double_array->cells[state].base & ~_TRIE_DOUBLE_ARRAY_TERMINAL;
+}
+
+// Returns whether or not state is terminal
+bool _is_terminal(const _trie_double_array_t* double_array, uint32_t state) {
+    return (double_array->cells[state].base &
+        _TRIE_DOUBLE_ARRAY_TERMINAL) != 0U;
+}
+
+// Sets state to the state reached from the root through the given bytes,
+// returning false if there is no such state
+bool _find_cell(const _trie_double_array_t* double_array, const char* key,
+    size_t length, uint32_t* state) {
+
+    uint32_t current = 0U;
+    for (size_t i = 0U; i < length; i++) {
+        size_t next = (size_t) _get_base(double_array, current) +
+            (unsigned char) key[i];
+        if (next >= double_array->cell_count ||
+            double_array->cells[next].check != current+1) {
+            return false;
+        }
+        current = (uint32_t) next;
+    }
+
+    *state = current;
+
+    return true;
+}
+
+bool _double_array_contains_word(const _trie_double_array_t* double_array,
+    const char* word, size_t word_length) {
+
+    uint32_t state;
+
+    return _find_cell(double_array, word, word_length, &state) &&
+        _is_terminal(double_array, state);
+}
+
+void _double_array_find_prefix_matches(
+    const _trie_double_array_t* double_array, const char* input,
+    size_t length, _trie_prefix_matches_t* matches) {
+
+    uint32_t state = 0U;
+    for (size_t i = 0U; i < length && !matches->done; i++) {
+        size_t next = (size_t) _get_base(double_array, state) +
+            (unsigned char) input[i];
+        if (next >= double_array->cell_count ||
+            double_array->cells[next].check != state+1) {
+            return;
+        }
+
+        state = (uint32_t) next;
+        if (_is_terminal(double_array, state)) {
+            _record_prefix_match(matches, i+1);
+        }
+    }
+}
+
+// A lookup in flight within a batch. cells[state] has been prefetched, and
+// state is only reached if its check is that given
+typedef struct {
+    size_t index;
+    const char* word;
+    size_t length;
+    size_t i;
+    uint32_t state;
+    uint32_t check;
+} _trie_double_array_lookup_t;
+
+// Starts a lookup of the word at index within words at the root. The length
+// of the word is taken from lengths, or from its terminating NUL if lengths is
+// NULL. Returns false if the lookup is already finished
+bool _start_cell_lookup(const _trie_double_array_t* double_array,
+    _trie_double_array_lookup_t* lookup, const char** words,
+    const size_t* lengths, size_t index, bool* contains) {
+
+    lookup->index = index;
+    lookup->word = words[index];
+    lookup->length =
+        lengths == NULL ? strlen(lookup->word) : lengths[index];
+    lookup->i = 0U;
+    lookup->state = 0U;
+    lookup->check = double_array->cells[0].check;
+    if (lookup->length == 0U) {
+        contains[index] = false;
+        return false;
+    }
+
+    return true;
+}
+
+// Takes one step of lookup, checking the state reached and prefetching the
+// next. Returns false if the lookup is finished
+bool _step_cell_lookup(const _trie_double_array_t* double_array,
+    _trie_double_array_lookup_t* lookup, bool* contains) {
+
+    uint32_t state = lookup->state;
+    if (double_array->cells[state].check != lookup->check) {
+        contains[lookup->index] = false;
+        return false;
+    }
+
+    if (lookup->i == lookup->length) {
+        contains[lookup->index] = _is_terminal(double_array, state);
+        return false;
+    }
+
+    size_t next = (size_t) _get_base(double_array, state) +
+        (unsigned char) lookup->word[lookup->i];
+    if (next >= double_array->cell_count) {
+        contains[lookup->index] = false;
+        return false;
+    }
+
+    _TRIE_PREFETCH(&(double_array->cells[next]));
+    lookup->i++;
+    lookup->state = (uint32_t) next;
+    lookup->check = state+1;
+
+    return true;
+}
+
+void _double_array_contains_words(const _trie_double_array_t* double_array,
+    const char** words, const size_t* lengths, size_t n, bool* contains) {
+
+    _trie_double_array_lookup_t lookups[_TRIE_BATCH_GROUP_SIZE];
+    bool in_flight[_TRIE_BATCH_GROUP_SIZE];
+    size_t in_flight_count = 0U;
+    size_t next = 0U;
+
+    for (size_t slot = 0U; slot < _TRIE_BATCH_GROUP_SIZE; slot++) {
+        in_flight[slot] = false;
+        while (!in_flight[slot] && next < n) {
+            in_flight[slot] = _start_cell_lookup(
+                double_array, &lookups[slot], words, lengths, next,
+                contains);
+            next++;
+        }
+        in_flight_count += in_flight[slot] ? 1U : 0U;
+    }
+
+    while (in_flight_count > 0U) {
+        for (size_t slot = 0U; slot < _TRIE_BATCH_GROUP_SIZE; slot++) {
+            if (!in_flight[slot] ||
+                _step_cell_lookup(double_array, &lookups[slot], contains)) {
+                continue;
+            }
+
+            in_flight[slot] = false;
+            while (!in_flight[slot] && next < n) {
+                in_flight[slot] = _start_cell_lookup(double_array,
+                    &lookups[slot], words, lengths, next, contains);
+                next++;
+            }
+            in_flight_count -= in_flight[slot] ? 0U : 1U;
+        }
+    }
+}
+
+void _copy_cell_words(const _trie_double_array_t* double_array,
+    uint32_t state, _trie_word_copy_t* copy) {
+
+    if (_is_terminal(double_array, state)) {
+        _copy_path_word(copy);
+    }
+
+    size_t base = _get_base(double_array, state);
+    for (size_t key = 0U; key < 256U && !copy->done; key++) {
+        size_t child = base + key;
+        if (child >= double_array->cell_count) {
+            break;
+        }
+
+        if (double_array->cells[child].check == state+1) {
+            char byte = (char) key;
+            if (_push_path(copy, &byte, 1U)) {
+                _copy_cell_words(double_array, (uint32_t) child, copy);
+                copy->path_length--;
+            }
+        }
+    }
+}
+
+void _double_array_copy_words_matching_prefix(
+    const _trie_double_array_t* double_array, const char* prefix,
+    size_t prefix_length, _trie_word_copy_t* copy) {
+
+    uint32_t state;
+    if (_find_cell(double_array, prefix, prefix_length, &state) &&
+        _push_path(copy, prefix, prefix_length)) {
+        _copy_cell_words(double_array, state, copy);
+    }
+}
+
+size_t _count_cell_words(const _trie_double_array_t* double_array,
+    uint32_t state) {
+
+    size_t word_count = _is_terminal(double_array, state) ? 1U : 0U;
+
+    size_t base = _get_base(double_array, state);
+    for (size_t key = 0U; key < 256U; key++) {
+        size_t child = base + key;
+        if (child >= double_array->cell_count) {
+            break;
+        }
+
+        if (double_array->cells[child].check == state+1) {
+            word_count += _count_cell_words(double_array, (uint32_t) child);
+        }
+    }
+
+    return word_count;
+}
+
+size_t _double_array_count_words_matching_prefix(
+    const _trie_double_array_t* double_array, const char* prefix,
+    size_t prefix_length) {
+
+    uint32_t state;
+    if (!_find_cell(double_array, prefix, prefix_length, &state)) {
+        return 0U;
+    }
+
+    return _count_cell_words(double_array, state);
+}
+
+void _destroy_double_array(_trie_double_array_t* double_array) {
+    _deallocate_memory(double_array, sizeof(_trie_double_array_t) +
+        double_array->cell_count * sizeof(_trie_double_array_cell_t),
+        TRIE_MEMORY_READ_ONLY);
+}
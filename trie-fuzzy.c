@@ -0,0 +1,343 @@
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// A fuzzy search walks the trie depth first, keeping one row of the
+// Levenshtein distance table per byte of the current path: entry j of the row
+// for a path is the edit distance between that path and the first j bytes of
+// the query. Each row follows from the row before and the next byte alone, so
+// the rows of a path are shared by every word below it, and the walk turns
+// back as soon as every entry of a row exceeds the distance sought, since no
+// longer path can then come closer.
+//
+// Words are found in passes of increasing distance, each pass finding exactly
+// the words at one distance, so results come out in distance order without
+// collecting and sorting every candidate. Each pass notes the least distance
+// at which it turned back, and the next pass searches for that distance, so
+// no pass is wasted on a distance at which nothing can be found. The rows
+// grow with the path as it deepens, so they never take more memory than the
+// longest path visited needs, however great the distance sought.
+//
+// A fuzzy prefix search finds the words with any prefix within the distance
+// of the query, the distance of a word being the least over its prefixes.
+// Once no longer path can come closer than the best prefix so far, the words
+// below are copied without computing any more rows.
+
+// What to do with the path just extended by one byte
+typedef enum {
+    _TRIE_FUZZY_PRUNE,
+    _TRIE_FUZZY_COPY_ALL,
+    _TRIE_FUZZY_DESCEND
+} _trie_fuzzy_step_t;
+
+// State of a pass of a fuzzy search for the words at distance. rows holds
+// query_length+1 entries for each byte of the current path, and
+// next_distance is the least distance greater than distance at which a word
+// may yet be found
+typedef struct {
+    const char* query;
+    size_t query_length;
+    uint32_t* rows;
+    size_t rows_capacity;
+    bool malloc_failed;
+    bool prefix;
+    uint32_t distance;
+    uint32_t next_distance;
+    uint32_t* distances;
+    _trie_word_copy_t* copy;
+} _trie_fuzzy_search_t;
+
+// Notes that a word may be found at a distance greater than that of the
+// current pass
+void _note_fuzzy_distance(_trie_fuzzy_search_t* search, uint32_t distance) {
+    if (distance < search->next_distance) {
+        search->next_distance = distance;
+    }
+}
+
+// Computes the row for the path of depth+1 bytes which ends in key from the
+// row for its first depth bytes, returning the least entry of the new row
+uint32_t _compute_fuzzy_row(const _trie_fuzzy_search_t* search, size_t depth,
+    unsigned char key) {
+
+    size_t width = search->query_length+1;
+    const uint32_t* previous = search->rows + depth*width;
+    uint32_t* row = search->rows + (depth+1)*width;
+
+    row[0] = previous[0]+1;
+    uint32_t least = row[0];
+    for (size_t j = 1U; j < width; j++) {
+        uint32_t substitution = previous[j-1] +
+            ((unsigned char) search->query[j-1] == key ? 0U : 1U);
+        uint32_t deletion = previous[j]+1;
+        uint32_t insertion = row[j-1]+1;
+        uint32_t entry = substitution < deletion ? substitution : deletion;
+        row[j] = entry < insertion ? entry : insertion;
+        if (row[j] < least) {
+            least = row[j];
+        }
+    }
+
+    return least;
+}
+
+// Decides what to do with the path whose row at depth has just been computed,
+// with least entry least. For a prefix search, best is the least distance of
+// any prefix of the path, and is updated to include the path itself
+_trie_fuzzy_step_t _check_fuzzy_row(_trie_fuzzy_search_t* search,
+    size_t depth, uint32_t least, uint32_t* best) {
+
+    if (search->prefix) {
+        uint32_t distance = search->rows[
+            depth*(search->query_length+1) + search->query_length];
+        if (distance < *best) {
+            *best = distance;
+        }
+
+        // Words below a prefix closer than the distance sought were found by
+        // an earlier pass, and no longer path can come closer than least
+        if (*best < search->distance) {
+            return _TRIE_FUZZY_PRUNE;
+        }
+        if (*best == search->distance && least >= *best) {
+            return _TRIE_FUZZY_COPY_ALL;
+        }
+    }
+
+    if (least > search->distance) {
+        _note_fuzzy_distance(search, search->prefix && *best < least ?
+            *best : least);
+        return _TRIE_FUZZY_PRUNE;
+    }
+
+    return _TRIE_FUZZY_DESCEND;
+}
+
+// Copies every word at or below node, all of which are at the distance of
+// the current pass
+void _copy_fuzzy_words(_trie_fuzzy_search_t* search,
+    const _trie_node_t* node) {
+
+    size_t first = search->copy->word_count;
+    _copy_descendant_words(node, search->copy);
+    if (search->distances != NULL) {
+        for (size_t i = first; i < search->copy->word_count; i++) {
+            search->distances[i] = search->distance;
+        }
+    }
+}
+
+// Searches the words at or below node, whose path of depth bytes is held in
+// the copy and whose rows have been computed. For a prefix search, best is
+// the least distance of any prefix of the path
+void _search_fuzzy_node(_trie_fuzzy_search_t* search,
+    const _trie_node_t* node, size_t depth, uint32_t best) {
+
+    _trie_word_copy_t* copy = search->copy;
+    if (_is_terminal_node(node)) {
+        uint32_t distance = search->prefix ? best : search->rows[
+            depth*(search->query_length+1) + search->query_length];
+        if (distance == search->distance) {
+            if (search->distances != NULL) {
+                search->distances[copy->word_count] = distance;
+            }
+            _copy_path_word(copy);
+        }
+        else if (distance > search->distance) {
+            _note_fuzzy_distance(search, distance);
+        }
+    }
+
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (!copy->done &&
+        _next_child(&iterator, &key, &label_length, &child)) {
+        size_t width = search->query_length+1;
+        if (!_reserve((void**) &(search->rows), &(search->rows_capacity),
+            (depth + label_length + 1U) * width, sizeof(uint32_t))) {
+            search->malloc_failed = true;
+            copy->done = true;
+            return;
+        }
+
+        const char* label = _get_edge_label(child, label_length);
+        if (!_push_path(copy, label, label_length)) {
+            return;
+        }
+
+        uint32_t child_best = best;
+        _trie_fuzzy_step_t step = _TRIE_FUZZY_DESCEND;
+        for (uint32_t i = 0U; i < label_length &&
+            step == _TRIE_FUZZY_DESCEND; i++) {
+            uint32_t least = _compute_fuzzy_row(
+                search, depth+i, (unsigned char) label[i]);
+            step = _check_fuzzy_row(search, depth+i+1, least, &child_best);
+        }
+
+        if (step == _TRIE_FUZZY_COPY_ALL) {
+            _copy_fuzzy_words(search, child);
+        }
+        else if (step == _TRIE_FUZZY_DESCEND) {
+            _search_fuzzy_node(search, child, depth+label_length, child_best);
+        }
+        copy->path_length -= label_length;
+    }
+}
+
+// Finds the words of trie within max_edits of the query of length bytes, or
+// with a prefix within max_edits if prefix is set, in order of distance.
+// Returns false if memory allocation fails
+bool _fuzzy_search(trie_t* trie, const char* query, size_t length,
+    uint32_t max_edits, bool prefix, uint32_t* distances,
+    _trie_word_copy_t* copy) {
+
+    _trie_fuzzy_search_t search = {
+        query, length, NULL, 0U, false, prefix, 0U, 0U, distances, copy
+    };
+
+    size_t width = length+1;
+    if (!_reserve((void**) &(search.rows), &(search.rows_capacity), width,
+        sizeof(uint32_t))) {
+        return false;
+    }
+    for (size_t j = 0U; j < width; j++) {
+        search.rows[j] = (uint32_t) j;
+    }
+
+    uint64_t* active = _begin_read(trie);
+    while (!copy->done) {
+        search.next_distance = UINT32_MAX;
+
+        uint32_t best = UINT32_MAX;
+        _trie_fuzzy_step_t step =
+            _check_fuzzy_row(&search, 0U, 0U, &best);
+        if (step == _TRIE_FUZZY_COPY_ALL) {
+            _copy_fuzzy_words(&search, trie->root);
+        }
+        else if (step == _TRIE_FUZZY_DESCEND) {
+            _search_fuzzy_node(&search, trie->root, 0U, best);
+        }
+
+        if (search.next_distance == UINT32_MAX ||
+            search.next_distance > max_edits) {
+            break;
+        }
+        search.distance = search.next_distance;
+    }
+    _end_read(active);
+
+    _release(search.rows, search.rows_capacity, sizeof(uint32_t));
+
+    return !search.malloc_failed;
+}
+
+trie_result_t trie_fuzzy_search_key(trie_t* trie, const char* query,
+    size_t length, uint32_t max_edits, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, uint32_t* distances, size_t n,
+    size_t* word_count) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (query == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    if (length == 0U) {
+        return TRIE_WORD_EMPTY;
+    }
+
+    if (n == 0U) {
+        return TRIE_WORDS_LENGTH_ZERO;
+    }
+
+    if (buffer_length == 0U) {
+        return TRIE_BUFFER_LENGTH_ZERO;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    _trie_word_copy_t copy = {
+        buffer, buffer_length, 0U, 0U, spans, NULL, n, 0U, false
+    };
+
+    if (!_fuzzy_search(trie, query, length, max_edits, false, distances,
+        &copy)) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    *word_count = copy.word_count;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_fuzzy_search(trie_t* trie, const char* query,
+    uint32_t max_edits, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, uint32_t* distances, size_t n,
+    size_t* word_count) {
+
+    return trie_fuzzy_search_key(trie, query,
+        query == NULL ? 0U : strlen(query), max_edits, buffer, buffer_length,
+        spans, distances, n, word_count);
+}
+
+trie_result_t trie_fuzzy_prefix_search_key(trie_t* trie, const char* prefix,
+    size_t prefix_length, uint32_t max_edits, char* buffer,
+    size_t buffer_length, trie_word_span_t* spans, uint32_t* distances,
+    size_t n, size_t* word_count) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (prefix == NULL) {
+        return TRIE_PREFIX_NULL;
+    }
+
+    if (prefix_length == 0U) {
+        return TRIE_PREFIX_EMPTY;
+    }
+
+    if (n == 0U) {
+        return TRIE_WORDS_LENGTH_ZERO;
+    }
+
+    if (buffer_length == 0U) {
+        return TRIE_BUFFER_LENGTH_ZERO;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    _trie_word_copy_t copy = {
+        buffer, buffer_length, 0U, 0U, spans, NULL, n, 0U, false
+    };
+
+    if (!_fuzzy_search(trie, prefix, prefix_length, max_edits, true,
+        distances, &copy)) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    *word_count = copy.word_count;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_fuzzy_prefix_search(trie_t* trie, const char* prefix,
+    uint32_t max_edits, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, uint32_t* distances, size_t n,
+    size_t* word_count) {
+
+    return trie_fuzzy_prefix_search_key(trie, prefix,
+        prefix == NULL ? 0U : strlen(prefix), max_edits, buffer,
+        buffer_length, spans, distances, n, word_count);
+}
@@ -0,0 +1,384 @@
+#ifndef TRIE_INTERNAL_H
+#define TRIE_INTERNAL_H
+
+// Definitions shared between the source files making up the trie
+// implementation. Not part of the public interface.
+
+#include "trie.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Hints that the memory at address will be read soon
+#if defined(__GNUC__)
+#define _TRIE_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define _TRIE_PREFETCH(address) ((void) (address))
+#endif
+
+// Number of lookups kept in flight at once by a batch lookup, enough to cover
+// the latency of a cache miss with the work of the other lookups
+#define _TRIE_BATCH_GROUP_SIZE 16U
+
+typedef struct _trie_node_t _trie_node_t;
+
+// The children of a node are held in one of four classes, in the style of an
+// adaptive radix tree. Each lookup step costs a bounded number of cache misses
+// whatever the fan-out, and a class is replaced by the next larger one when it
+// becomes full
+typedef enum {
+    _TRIE_CHILDREN_4,
+    _TRIE_CHILDREN_16,
+    _TRIE_CHILDREN_48,
+    _TRIE_CHILDREN_256
+} _trie_children_kind_t;
+
+// Header common to every children class
+typedef struct {
+    uint8_t kind;
+    uint16_t count;
+} _trie_children_t;
+
+// Each child is reached through an edge labelled with one or more bytes, the
+// first of which is the key of the edge. Chains of single children are
+// compressed into one edge, so there are far fewer nodes than bytes in the
+// words
+
+// Up to 4 children, with keys kept sorted
+typedef struct {
+    _trie_children_t header;
+    unsigned char keys[4];
+    uint32_t label_lengths[4];
+    _trie_node_t* nodes[4];
+} _trie_children4_t;
+
+// Up to 16 children, with keys kept sorted and matched using SIMD where
+// available
+typedef struct {
+    _trie_children_t header;
+    unsigned char keys[16];
+    uint32_t label_lengths[16];
+    _trie_node_t* nodes[16];
+} _trie_children16_t;
+
+// Up to 48 children, indexed by key. An index of zero means there is no child
+// for the key, otherwise the child is at nodes[index-1]
+typedef struct {
+    _trie_children_t header;
+    uint8_t indexes[256];
+    uint32_t label_lengths[48];
+    _trie_node_t* nodes[48];
+} _trie_children48_t;
+
+// Up to 256 children, directly indexed by key
+typedef struct {
+    _trie_children_t header;
+    uint32_t label_lengths[256];
+    _trie_node_t* nodes[256];
+} _trie_children256_t;
+
+// A node holds the label of the edge through which it was created. When that
+// edge is later split the node keeps its bytes and the shorter edge into it
+// uses the final bytes of label, so labels never move or change. A node is
+// terminal if a word ends at it. When the trie stores words, word points to
+// the copy of that word in the word pool (or arena). value is the value
+// associated with the word, if terminal, and is held here so that one lookup
+// finds both. weight is the weight of the word, if terminal, and max_weight
+// the greatest weight of any word at or below the node
+struct _trie_node_t {
+    char* word;
+    void* value;
+    _trie_children_t* children;
+    bool terminal;
+    uint32_t weight;
+    uint32_t max_weight;
+    uint32_t label_length;
+    size_t word_count;
+    char label[];
+};
+
+typedef struct _trie_arena_chunk_t _trie_arena_chunk_t;
+
+// A large block of memory out of which nodes and words are carved when a trie
+// is created in arena mode, or out of which words are carved for the word pool
+// of a trie. Chunks form a list, most recently allocated first
+struct _trie_arena_chunk_t {
+    _trie_arena_chunk_t* previous;
+    size_t capacity;
+    size_t used;
+    char memory[];
+};
+
+typedef struct {
+    _trie_arena_chunk_t* current_chunk;
+} _trie_arena_t;
+
+// The representation of a trie
+typedef enum {
+    // A mutable trie made up of nodes
+    _TRIE_NODES,
+    // A read-only trie queried directly within a file mapped into memory
+    _TRIE_MAPPED,
+    // A read-only minimal automaton sharing suffixes as well as prefixes
+    _TRIE_DAWG,
+    // A read-only trie held in a double array, for the fastest lookups
+    _TRIE_DOUBLE_ARRAY,
+    // A read-only trie held in succinct bit sequences, for the least memory
+    _TRIE_LOUDS
+} _trie_kind_t;
+
+typedef struct _trie_mapped_t _trie_mapped_t;
+
+typedef struct _trie_dawg_t _trie_dawg_t;
+
+typedef struct _trie_double_array_t _trie_double_array_t;
+
+typedef struct _trie_louds_t _trie_louds_t;
+
+typedef struct _trie_epochs_t _trie_epochs_t;
+
+// epochs is only set for a concurrent trie
+struct trie_t {
+    _trie_kind_t kind;
+    _trie_node_t* root;
+    _trie_arena_t* arena;
+    _trie_arena_t word_pool;
+    bool store_words;
+    _trie_mapped_t* mapped;
+    _trie_dawg_t* dawg;
+    _trie_double_array_t* double_array;
+    _trie_louds_t* louds;
+    _trie_epochs_t* epochs;
+};
+
+// Position within the children of a node, used to visit them in key order
+typedef struct {
+    const _trie_children_t* children;
+    uint16_t position;
+} _trie_children_iterator_t;
+
+// State of a copy of words into a caller supplied buffer. The path of the
+// node being visited is held in the buffer just beyond the words copied so
+// far, so words are reconstructed without any other memory. values, if not
+// NULL, receives the value of each word copied, alongside its span
+typedef struct {
+    char* buffer;
+    size_t buffer_length;
+    size_t used;
+    size_t path_length;
+    trie_word_span_t* spans;
+    void** values;
+    size_t spans_length;
+    size_t word_count;
+    bool done;
+} _trie_word_copy_t;
+
+// State of a search for the words which are prefixes of an input, shortest
+// first. lengths, if not NULL, receives the length of each word found until
+// it is full, and longest is the length of the longest word found so far
+typedef struct {
+    size_t* lengths;
+    size_t lengths_length;
+    size_t match_count;
+    size_t longest;
+    bool done;
+} _trie_prefix_matches_t;
+
+void* _allocate_memory(size_t size, trie_memory_category_t category);
+
+void _deallocate_memory(void* memory, size_t size,
+    trie_memory_category_t category);
+
+bool _reserve(void** array, size_t* capacity, size_t needed,
+    size_t element_size);
+
+void _release(void* array, size_t capacity, size_t element_size);
+
+extern const size_t _children_sizes[];
+
+_trie_node_t* _create_node(trie_t* trie, const char* label,
+    uint32_t label_length);
+
+size_t _get_node_size(const _trie_node_t* node);
+
+void _deallocate_node(trie_t* trie, _trie_node_t* node);
+
+void _deallocate_children(trie_t* trie, _trie_children_t* children);
+
+bool _set_terminal(trie_t* trie, _trie_node_t* node, const char* word,
+    size_t word_length);
+
+bool _is_terminal_node(const _trie_node_t* node);
+
+_trie_children_t* _create_children(trie_t* trie, _trie_children_kind_t kind);
+
+void _insert_child(_trie_children_t* children, unsigned char key,
+    uint32_t label_length, _trie_node_t* child);
+
+void _destroy_node(trie_t* trie, _trie_node_t* node);
+
+const char* _get_edge_label(const _trie_node_t* node, uint32_t label_length);
+
+void _begin_children(const _trie_node_t* node,
+    _trie_children_iterator_t* iterator);
+
+bool _next_child(_trie_children_iterator_t* iterator, unsigned char* key,
+    uint32_t* label_length, _trie_node_t** child);
+
+void _seek_children(_trie_children_iterator_t* iterator, uint16_t key);
+
+_trie_node_t* _get_child_from(const _trie_children_t* children,
+    unsigned char key, uint32_t* label_length);
+
+_trie_node_t* _get_child(const _trie_node_t* node, unsigned char key,
+    uint32_t* label_length);
+
+_trie_node_t* _find_prefix_node(_trie_node_t* node, const char* prefix,
+    size_t length, uint32_t* remaining_length);
+
+bool _push_path(_trie_word_copy_t* copy, const char* bytes, size_t length);
+
+void _copy_path_word(_trie_word_copy_t* copy);
+
+void _copy_descendant_words(const _trie_node_t* from_node,
+    _trie_word_copy_t* copy);
+
+void _record_prefix_match(_trie_prefix_matches_t* matches, size_t length);
+
+size_t _get_word_count(const trie_t* trie, const _trie_node_t* node);
+
+// Implemented in trie-mapped.c
+
+// Writes a trie file
+typedef struct {
+    FILE* file;
+    uint64_t offset;
+    bool store_words;
+} _trie_file_writer_t;
+
+bool _begin_file(_trie_file_writer_t* writer, FILE* file, bool store_words);
+
+bool _write_record(_trie_file_writer_t* writer, const char* label,
+    uint32_t label_length, bool terminal, const char* word,
+    size_t word_length, const unsigned char* keys, const uint32_t* children,
+    uint16_t child_count, uint32_t* offset);
+
+bool _finish_file(_trie_file_writer_t* writer, uint32_t root);
+
+bool _mapped_contains_word(const _trie_mapped_t* mapped, const char* word,
+    size_t word_length);
+
+void _mapped_find_prefix_matches(const _trie_mapped_t* mapped,
+    const char* input, size_t length, _trie_prefix_matches_t* matches);
+
+size_t _mapped_get_words_matching_prefix(const _trie_mapped_t* mapped,
+    const char* prefix, size_t prefix_length, const char** words,
+    size_t words_length);
+
+void _mapped_copy_words_matching_prefix(const _trie_mapped_t* mapped,
+    const char* prefix, size_t prefix_length, _trie_word_copy_t* copy);
+
+size_t _mapped_count_words_matching_prefix(const _trie_mapped_t* mapped,
+    const char* prefix, size_t prefix_length);
+
+void _destroy_mapped(_trie_mapped_t* mapped);
+
+// Implemented in trie-dawg.c
+
+bool _dawg_contains_word(const _trie_dawg_t* dawg, const char* word,
+    size_t word_length);
+
+void _dawg_find_prefix_matches(const _trie_dawg_t* dawg, const char* input,
+    size_t length, _trie_prefix_matches_t* matches);
+
+void _dawg_copy_words_matching_prefix(const _trie_dawg_t* dawg,
+    const char* prefix, size_t prefix_length, _trie_word_copy_t* copy);
+
+size_t _dawg_count_words_matching_prefix(const _trie_dawg_t* dawg,
+    const char* prefix, size_t prefix_length);
+
+// Returns the number of keys of dawg which come before key
+size_t _dawg_rank_key(const _trie_dawg_t* dawg, const char* key,
+    size_t length);
+
+// Writes the key of dawg at index in byte order into buffer, setting found if
+// there is one. Returns false if there is no room for it
+bool _dawg_select_key(const _trie_dawg_t* dawg, size_t index, char* buffer,
+    size_t buffer_length, size_t* key_length, bool* found);
+
+void _destroy_dawg(_trie_dawg_t* dawg);
+
+// Implemented in trie-double-array.c
+
+bool _double_array_contains_word(const _trie_double_array_t* double_array,
+    const char* word, size_t word_length);
+
+void _double_array_find_prefix_matches(
+    const _trie_double_array_t* double_array, const char* input,
+    size_t length, _trie_prefix_matches_t* matches);
+
+void _double_array_copy_words_matching_prefix(
+    const _trie_double_array_t* double_array, const char* prefix,
+    size_t prefix_length, _trie_word_copy_t* copy);
+
+void _double_array_contains_words(const _trie_double_array_t* double_array,
+    const char** words, const size_t* lengths, size_t n, bool* contains);
+
+size_t _double_array_count_words_matching_prefix(
+    const _trie_double_array_t* double_array, const char* prefix,
+    size_t prefix_length);
+
+void _destroy_double_array(_trie_double_array_t* double_array);
+
+// Implemented in trie-louds.c
+
+bool _louds_contains_word(const _trie_louds_t* louds, const char* word,
+    size_t word_length);
+
+void _louds_find_prefix_matches(const _trie_louds_t* louds,
+    const char* input, size_t length, _trie_prefix_matches_t* matches);
+
+void _louds_copy_words_matching_prefix(const _trie_louds_t* louds,
+    const char* prefix, size_t prefix_length, _trie_word_copy_t* copy);
+
+size_t _louds_count_words_matching_prefix(const _trie_louds_t* louds,
+    const char* prefix, size_t prefix_length);
+
+bool _write_louds(const _trie_louds_t* louds, FILE* file);
+
+bool _is_louds_file(const char* base, size_t size);
+
+trie_result_t _open_louds(const char* base, size_t size,
+    _trie_louds_t** louds);
+
+void _destroy_louds(_trie_louds_t* louds);
+
+// Implemented in trie-concurrent.c
+
+_trie_epochs_t* _create_epochs();
+
+// Counts the calling thread in as a reader of trie until _end_read is called
+// with the counter returned, so no memory it can reach is reclaimed. Returns
+// NULL for a trie which is not concurrent
+uint64_t* _begin_read(const trie_t* trie);
+
+void _end_read(uint64_t* active);
+
+// Replaces the children of node, provided they are still expected, retiring
+// the block replaced. Returns false if another writer replaced them first
+bool _publish_children(trie_t* trie, _trie_node_t* node,
+    const _trie_children_t* expected, _trie_children_t* children);
+
+// Deallocates a children block no longer reachable from the trie once no
+// reader can be using it
+void _retire_children(trie_t* trie, _trie_children_t* children);
+
+void _reclaim_retired(trie_t* trie);
+
+void _destroy_epochs(trie_t* trie);
+
+// Returns the size in bytes of the epochs of a concurrent trie, excluding the
+// blocks retired
+size_t _get_epochs_size();
+
+#endif /* TRIE_INTERNAL_H */
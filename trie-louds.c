@@ -0,0 +1,595 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// A LOUDS (level-order unary degree sequence) trie lists the states of a trie
+// breadth first, with transitions labelled with single bytes as in a double
+// array, each byte of a compressed edge label becoming a state of its own.
+// The shape of the trie is a sequence of bits holding, for each state in
+// turn, a 1 for each of its children followed by a 0. The children of each
+// state follow those of the state before, so the children of state v are
+// numbered from one more than the number of 1s before the 0 ending the
+// sequence of state v-1, and no pointers are needed. Alongside are the label
+// of the transition into each state but the root, and a bit for each state
+// set if it is terminal. With n states, that is 2n-1 bits of shape, n bits of
+// terminals and n-1 bytes of labels.
+//
+// Finding the children of a state needs the position of a given 0 (select)
+// and the number of 1s before a position (rank). Rank is answered from a
+// count of the 1s before each block of 512 bits, and select from the
+// position of every 512th 0, each followed by a short scan of 64 bit words,
+// at an overhead of under a fifth of a bit per bit of shape.
+//
+// Everything is held in a single block of memory laid out exactly as in a
+// file, so trie_save() writes the block out as it is, and trie_open_mapped()
+// queries the file in place. The arrays are 8 byte aligned within the block.
+
+// Identifies a LOUDS trie file
+#define _TRIE_LOUDS_MAGIC "LOUD"
+
+// Written in the native byte order, to detect a file saved on a machine with
+// a different byte order
+#define _TRIE_LOUDS_BYTE_ORDER 0x01020304U
+
+#define _TRIE_LOUDS_VERSION 1U
+
+// Bits per rank block, and 0s per select sample
+#define _TRIE_LOUDS_BLOCK_BITS 512U
+#define _TRIE_LOUDS_SELECT_ZEROS 512U
+
+typedef struct {
+    char magic[4];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t padding;
+    uint64_t size;
+    uint64_t state_count;
+} _trie_louds_header_t;
+
+// The arrays point into the block of size bytes at base, which was mapped
+// from a file if mapped is set
+struct _trie_louds_t {
+    const char* base;
+    size_t size;
+    bool mapped;
+    size_t state_count;
+    size_t bit_count;
+    const uint64_t* bits;
+    const uint64_t* ranks;
+    const uint64_t* selects;
+    const uint64_t* terminals;
+    const unsigned char* labels;
+};
+
+// Sizes in bytes of the arrays of a LOUDS trie
+typedef struct {
+    size_t bits;
+    size_t ranks;
+    size_t selects;
+    size_t terminals;
+    size_t labels;
+} _trie_louds_sizes_t;
+
+// Returns size rounded up to a multiple of 8
+size_t _align_to_word(size_t size) {
+    return (size + 7U) & ~(size_t) 7U;
+}
+
+// Returns the total size of a LOUDS trie of state_count states, setting
+// sizes to the sizes of its arrays
+size_t _get_louds_sizes(size_t state_count, _trie_louds_sizes_t* sizes) {
+    size_t bit_count = 2U*state_count - 1U;
+    sizes->bits = (bit_count+63U) / 64U * sizeof(uint64_t);
+    sizes->ranks = (bit_count / _TRIE_LOUDS_BLOCK_BITS + 1U) *
+        sizeof(uint64_t);
+    sizes->selects = ((state_count-1U) / _TRIE_LOUDS_SELECT_ZEROS + 1U) *
+        sizeof(uint64_t);
+    sizes->terminals = (state_count+63U) / 64U * sizeof(uint64_t);
+    sizes->labels = _align_to_word(state_count-1U);
+
+    return sizeof(_trie_louds_header_t) + sizes->bits + sizes->ranks +
+        sizes->selects + sizes->terminals + sizes->labels;
+}
+
+// Points the arrays of louds into its block, which holds state_count states
+void _locate_louds_arrays(_trie_louds_t* louds, size_t state_count) {
+    _trie_louds_sizes_t sizes;
+    _get_louds_sizes(state_count, &sizes);
+
+    const char* position = louds->base + sizeof(_trie_louds_header_t);
+    louds->state_count = state_count;
+    louds->bit_count = 2U*state_count - 1U;
+    louds->bits = (const uint64_t*) position;
+    position += sizes.bits;
+    louds->ranks = (const uint64_t*) position;
+    position += sizes.ranks;
+    louds->selects = (const uint64_t*) position;
+    position += sizes.selects;
+    louds->terminals = (const uint64_t*) position;
+    position += sizes.terminals;
+    louds->labels = (const unsigned char*) position;
+}
+
+// Sets bit i of bits
+void _set_louds_bit(uint64_t* bits, size_t i) {
+    bits[i / 64U] |= (uint64_t) 1U << (i % 64U);
+}
+
+// Returns bit i of bits
+bool _get_louds_bit(const uint64_t* bits, size_t i) {
+    return (bits[i / 64U] >> (i % 64U) & 1U) != 0U;
+}
+
+// A state of the trie being encoded: the state reached after the first
+// offset bytes of the label of the edge of label_length bytes to node, which
+// is node itself once offset reaches label_length. label is that of the
+// transition into the state, and child_count and terminal are filled in once
+// it is visited
+typedef struct {
+    const _trie_node_t* node;
+    uint32_t label_length;
+    uint32_t offset;
+    uint16_t child_count;
+    unsigned char label;
+    bool terminal;
+} _trie_louds_state_t;
+
+// Lists the states of trie breadth first into states, which has room for
+// capacity of them, setting state_count to their number. Each node is looked
+// at once, so the states are consistent even if words are being added to a
+// concurrent trie. Returns false if memory allocation fails
+bool _list_louds_states(const trie_t* trie, _trie_louds_state_t** states,
+    size_t* capacity, size_t* state_count) {
+
+    _trie_louds_state_t root = { trie->root, 0U, 0U, 0U, 0U, false };
+    (*states)[0] = root;
+    size_t count = 1U;
+    for (size_t v = 0U; v < count; v++) {
+        const _trie_node_t* node = (*states)[v].node;
+        uint32_t label_length = (*states)[v].label_length;
+        uint32_t offset = (*states)[v].offset;
+
+        // Within the label of an edge there is a single child, and no word
+        if (offset < label_length) {
+            if (!_reserve((void**) states, capacity, count+1,
+                sizeof(_trie_louds_state_t))) {
+                return false;
+            }
+            _trie_louds_state_t next = {
+                node, label_length, offset+1, 0U,
+                (unsigned char) _get_edge_label(node, label_length)[offset],
+                false
+            };
+            (*states)[count++] = next;
+            (*states)[v].child_count = 1U;
+            continue;
+        }
+
+        (*states)[v].terminal = _is_terminal_node(node);
+        _trie_children_iterator_t iterator;
+        _begin_children(node, &iterator);
+        unsigned char key;
+        uint32_t child_label_length;
+        _trie_node_t* child;
+        uint16_t child_count = 0U;
+        while (_next_child(&iterator, &key, &child_label_length, &child)) {
+            if (!_reserve((void**) states, capacity, count+1,
+                sizeof(_trie_louds_state_t))) {
+                return false;
+            }
+            _trie_louds_state_t next = {
+                child, child_label_length, 1U, 0U, key, false
+            };
+            (*states)[count++] = next;
+            child_count++;
+        }
+        (*states)[v].child_count = child_count;
+    }
+
+    *state_count = count;
+
+    return true;
+}
+
+// Fills in the shape, terminals and labels of the LOUDS trie being encoded
+// from its listed states
+void _encode_louds_states(_trie_louds_t* louds,
+    const _trie_louds_state_t* states) {
+
+    uint64_t* bits = (uint64_t*) louds->bits;
+    uint64_t* terminals = (uint64_t*) louds->terminals;
+    unsigned char* labels = (unsigned char*) louds->labels;
+
+    size_t bit = 0U;
+    for (size_t v = 0U; v < louds->state_count; v++) {
+        for (uint16_t i = 0U; i < states[v].child_count; i++) {
+            _set_louds_bit(bits, bit++);
+        }
+        bit++;
+
+        if (states[v].terminal) {
+            _set_louds_bit(terminals, v);
+        }
+        if (v > 0U) {
+            labels[v-1] = states[v].label;
+        }
+    }
+}
+
+// Fills in the rank and select directories of the LOUDS trie being encoded
+void _index_louds_bits(_trie_louds_t* louds) {
+    uint64_t* ranks = (uint64_t*) louds->ranks;
+    uint64_t* selects = (uint64_t*) louds->selects;
+
+    uint64_t ones = 0U;
+    uint64_t zeros = 0U;
+    for (size_t i = 0U; i < louds->bit_count; i++) {
+        if (i % _TRIE_LOUDS_BLOCK_BITS == 0U) {
+            ranks[i / _TRIE_LOUDS_BLOCK_BITS] = ones;
+        }
+        if (_get_louds_bit(louds->bits, i)) {
+            ones++;
+        }
+        else {
+            if (zeros % _TRIE_LOUDS_SELECT_ZEROS == 0U) {
+                selects[zeros / _TRIE_LOUDS_SELECT_ZEROS] = i;
+            }
+            zeros++;
+        }
+    }
+    if (louds->bit_count % _TRIE_LOUDS_BLOCK_BITS == 0U) {
+        ranks[louds->bit_count / _TRIE_LOUDS_BLOCK_BITS] = ones;
+    }
+}
+
+trie_result_t trie_freeze_to_louds(trie_t* trie, trie_t** louds) {
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    _trie_louds_state_t* states = NULL;
+    size_t capacity = 0U;
+    size_t state_count = 0U;
+    uint64_t* active = _begin_read(trie);
+    bool listed = _reserve((void**) &states, &capacity, 1U,
+        sizeof(_trie_louds_state_t)) &&
+        _list_louds_states(trie, &states, &capacity, &state_count);
+    _end_read(active);
+
+    _trie_louds_sizes_t sizes;
+    size_t size = listed ? _get_louds_sizes(state_count, &sizes) : 0U;
+    char* block = listed ? _allocate_memory(size, TRIE_MEMORY_READ_ONLY) : NULL;
+    _trie_louds_t* created_louds =
+        _allocate_memory(sizeof(_trie_louds_t), TRIE_MEMORY_OTHER);
+    trie_t* created = _allocate_memory(sizeof(trie_t), TRIE_MEMORY_OTHER);
+    if (block == NULL || created_louds == NULL || created == NULL) {
+        _release(states, capacity, sizeof(_trie_louds_state_t));
+        if (block != NULL) {
+            _deallocate_memory(block, size, TRIE_MEMORY_READ_ONLY);
+        }
+        if (created_louds != NULL) {
+            _deallocate_memory(created_louds, sizeof(_trie_louds_t),
+                TRIE_MEMORY_OTHER);
+        }
+        if (created != NULL) {
+            _deallocate_memory(created, sizeof(trie_t), TRIE_MEMORY_OTHER);
+        }
+        return TRIE_MALLOC_FAIL;
+    }
+
+    memset(block, 0, size);
+    _trie_louds_header_t* header = (_trie_louds_header_t*) block;
+    memcpy(header->magic, _TRIE_LOUDS_MAGIC, sizeof(header->magic));
+    header->byte_order = _TRIE_LOUDS_BYTE_ORDER;
+    header->version = _TRIE_LOUDS_VERSION;
+    header->size = size;
+    header->state_count = state_count;
+
+    created_louds->base = block;
+    created_louds->size = size;
+    created_louds->mapped = false;
+    _locate_louds_arrays(created_louds, state_count);
+    _encode_louds_states(created_louds, states);
+    _index_louds_bits(created_louds);
+    _release(states, capacity, sizeof(_trie_louds_state_t));
+
+    memset(created, 0, sizeof(trie_t));
+    created->kind = _TRIE_LOUDS;
+    created->store_words = false;
+    created->louds = created_louds;
+
+    *louds = created;
+
+    return TRIE_SUCCESS;
+}
+
+// Returns the number of 1s before bit i
+size_t _rank_louds_ones(const _trie_louds_t* louds, size_t i) {
+    size_t block = i / _TRIE_LOUDS_BLOCK_BITS;
+    size_t rank = (size_t) louds->ranks[block];
+    for (size_t word = block * (_TRIE_LOUDS_BLOCK_BITS/64U); word < i / 64U;
+        word++) {
+        rank += (size_t) __builtin_popcountll(louds->bits[word]);
+    }
+    if (i % 64U != 0U) {
+        uint64_t mask = ((uint64_t) 1U << (i % 64U)) - 1U;
+        rank += (size_t) __builtin_popcountll(louds->bits[i / 64U] & mask);
+    }
+
+    return rank;
+}
+
+// Returns the position of 0 number k, counting from zero
+size_t _select_louds_zero(const _trie_louds_t* louds, size_t k) {
+    size_t sample = (size_t) louds->selects[k / _TRIE_LOUDS_SELECT_ZEROS];
+    size_t remaining = k % _TRIE_LOUDS_SELECT_ZEROS;
+
+    // Count from the start of the word holding the sampled 0
+    size_t word = sample / 64U;
+    uint64_t before = ((uint64_t) 1U << (sample % 64U)) - 1U;
+    remaining += (size_t) __builtin_popcountll(~louds->bits[word] & before);
+    while (true) {
+        uint64_t zeros = ~louds->bits[word];
+        size_t count = (size_t) __builtin_popcountll(zeros);
+        if (remaining < count) {
+            for (size_t i = 0U; i < remaining; i++) {
+                zeros &= zeros-1U;
+            }
+            return word*64U + (size_t) __builtin_ctzll(zeros);
+        }
+        remaining -= count;
+        word++;
+    }
+}
+
+// The children of a state: count states numbered from first, whose labels
+// start at labels[first-1]
+typedef struct {
+    size_t first;
+    size_t count;
+} _trie_louds_children_t;
+
+// Finds the children of state
+void _get_louds_children(const _trie_louds_t* louds, size_t state,
+    _trie_louds_children_t* children) {
+
+    size_t start = state == 0U ? 0U : _select_louds_zero(louds, state-1U)+1U;
+    size_t end = start;
+    while (_get_louds_bit(louds->bits, end)) {
+        end++;
+    }
+
+    children->first = _rank_louds_ones(louds, start) + 1U;
+    children->count = end - start;
+}
+
+// Returns whether or not state is terminal
+bool _is_louds_terminal(const _trie_louds_t* louds, size_t state) {
+    return _get_louds_bit(louds->terminals, state);
+}
+
+// Sets child to the child of state through key, returning false if there is
+// none
+bool _get_louds_child(const _trie_louds_t* louds, size_t state,
+    unsigned char key, size_t* child) {
+
+    _trie_louds_children_t children;
+    _get_louds_children(louds, state, &children);
+
+    // Labels of siblings are in increasing order
+    size_t low = children.first;
+    size_t high = children.first + children.count;
+    while (low < high) {
+        size_t middle = low + (high-low) / 2U;
+        unsigned char label = louds->labels[middle-1U];
+        if (label == key) {
+            *child = middle;
+            return true;
+        }
+        if (label < key) {
+            low = middle+1U;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    return false;
+}
+
+// Sets state to the state reached from the root through the given bytes,
+// returning false if there is no such state
+bool _find_louds_state(const _trie_louds_t* louds, const char* key,
+    size_t length, size_t* state) {
+
+    size_t current = 0U;
+    for (size_t i = 0U; i < length; i++) {
+        if (!_get_louds_child(louds, current, (unsigned char) key[i],
+            &current)) {
+            return false;
+        }
+    }
+
+    *state = current;
+
+    return true;
+}
+
+bool _louds_contains_word(const _trie_louds_t* louds, const char* word,
+    size_t word_length) {
+
+    size_t state;
+
+    return _find_louds_state(louds, word, word_length, &state) &&
+        _is_louds_terminal(louds, state);
+}
+
+void _louds_find_prefix_matches(const _trie_louds_t* louds,
+    const char* input, size_t length, _trie_prefix_matches_t* matches) {
+
+    size_t state = 0U;
+    for (size_t i = 0U; i < length && !matches->done; i++) {
+        if (!_get_louds_child(louds, state, (unsigned char) input[i],
+            &state)) {
+            return;
+        }
+
+        if (_is_louds_terminal(louds, state)) {
+            _record_prefix_match(matches, i+1);
+        }
+    }
+}
+
+void _copy_louds_words(const _trie_louds_t* louds, size_t state,
+    _trie_word_copy_t* copy) {
+
+    if (_is_louds_terminal(louds, state)) {
+        _copy_path_word(copy);
+    }
+
+    _trie_louds_children_t children;
+    _get_louds_children(louds, state, &children);
+    for (size_t i = 0U; i < children.count && !copy->done; i++) {
+        size_t child = children.first + i;
+        if (_push_path(copy, (const char*) &(louds->labels[child-1U]), 1U)) {
+            _copy_louds_words(louds, child, copy);
+            copy->path_length--;
+        }
+    }
+}
+
+void _louds_copy_words_matching_prefix(const _trie_louds_t* louds,
+    const char* prefix, size_t prefix_length, _trie_word_copy_t* copy) {
+
+    size_t state;
+    if (_find_louds_state(louds, prefix, prefix_length, &state) &&
+        _push_path(copy, prefix, prefix_length)) {
+        _copy_louds_words(louds, state, copy);
+    }
+}
+
+// Returns the number of terminal states at or below state
+size_t _count_louds_words(const _trie_louds_t* louds, size_t state) {
+    size_t word_count = _is_louds_terminal(louds, state) ? 1U : 0U;
+
+    _trie_louds_children_t children;
+    _get_louds_children(louds, state, &children);
+    for (size_t i = 0U; i < children.count; i++) {
+        word_count += _count_louds_words(louds, children.first + i);
+    }
+
+    return word_count;
+}
+
+size_t _louds_count_words_matching_prefix(const _trie_louds_t* louds,
+    const char* prefix, size_t prefix_length) {
+
+    size_t state;
+    if (!_find_louds_state(louds, prefix, prefix_length, &state)) {
+        return 0U;
+    }
+
+    return _count_louds_words(louds, state);
+}
+
+bool _write_louds(const _trie_louds_t* louds, FILE* file) {
+    return fwrite(louds->base, 1U, louds->size, file) == louds->size;
+}
+
+bool _is_louds_file(const char* base, size_t size) {
+    return size >= sizeof(_trie_louds_header_t) &&
+        memcmp(base, _TRIE_LOUDS_MAGIC, 4U) == 0;
+}
+
+// Returns whether or not the bits of louds, read from a file, describe a
+// trie and are indexed as _index_louds_bits() would index them, so that no
+// query reads beyond its arrays or follows a state back to itself. Each
+// state must have a greater number than its parent, as it does when the
+// states are listed breadth first
+bool _is_valid_louds(const _trie_louds_t* louds) {
+    size_t ones = 0U;
+    size_t zeros = 0U;
+    bool run_started = false;
+    for (size_t i = 0U; i < louds->bit_count; i++) {
+        if (i % _TRIE_LOUDS_BLOCK_BITS == 0U &&
+            louds->ranks[i / _TRIE_LOUDS_BLOCK_BITS] != ones) {
+            return false;
+        }
+        if (_get_louds_bit(louds->bits, i)) {
+            // The children of state zeros are numbered from ones+1
+            if (!run_started && ones < zeros) {
+                return false;
+            }
+            run_started = true;
+            ones++;
+        }
+        else {
+            if (zeros % _TRIE_LOUDS_SELECT_ZEROS == 0U &&
+                louds->selects[zeros / _TRIE_LOUDS_SELECT_ZEROS] != i) {
+                return false;
+            }
+            run_started = false;
+            zeros++;
+        }
+    }
+    if (louds->bit_count % _TRIE_LOUDS_BLOCK_BITS == 0U &&
+        louds->ranks[louds->bit_count / _TRIE_LOUDS_BLOCK_BITS] != ones) {
+        return false;
+    }
+
+    return zeros == louds->state_count && ones == louds->state_count-1U &&
+        !_get_louds_bit(louds->bits, louds->bit_count-1U);
+}
+
+trie_result_t _open_louds(const char* base, size_t size,
+    _trie_louds_t** louds) {
+
+    const _trie_louds_header_t* header = (const _trie_louds_header_t*) base;
+    _trie_louds_sizes_t sizes;
+    if (header->byte_order != _TRIE_LOUDS_BYTE_ORDER ||
+        header->version != _TRIE_LOUDS_VERSION || header->size != size ||
+        header->state_count == 0U || header->state_count > size ||
+        _get_louds_sizes((size_t) header->state_count, &sizes) != size) {
+        return TRIE_FILE_INVALID;
+    }
+
+    _trie_louds_t* opened =
+        _allocate_memory(sizeof(_trie_louds_t), TRIE_MEMORY_OTHER);
+    if (opened == NULL) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    opened->base = base;
+    opened->size = size;
+    opened->mapped = true;
+    _locate_louds_arrays(opened, (size_t) header->state_count);
+    if (!_is_valid_louds(opened)) {
+        _deallocate_memory(opened, sizeof(_trie_louds_t), TRIE_MEMORY_OTHER);
+        return TRIE_FILE_INVALID;
+    }
+
+    *louds = opened;
+
+    return TRIE_SUCCESS;
+}
+
+void _destroy_louds(_trie_louds_t* louds) {
+    if (louds->mapped) {
+        munmap((void*) louds->base, louds->size);
+    }
+    else {
+        _deallocate_memory((void*) louds->base, louds->size,
+            TRIE_MEMORY_READ_ONLY);
+    }
+    _deallocate_memory(louds, sizeof(_trie_louds_t), TRIE_MEMORY_OTHER);
+}
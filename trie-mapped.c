@@ -0,0 +1,636 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A trie file starts with a header, followed by a record for each node. The
+// records of the children of a node precede its own record, so a file can be
+// written in a single pass. If the trie stores words, the word of each
+// terminal node, followed by a NUL, immediately precedes its record. All
+// positions within the file are offsets from its start, so it can be mapped
+// at any address and queried in place. Offsets are 32 bits, which limits a
+// file to 4 GiB.
+
+// Identifies a trie file
+#define _TRIE_FILE_MAGIC "TRIE"
+
+// Written in the native byte order, to detect a file saved on a machine with
+// a different byte order
+#define _TRIE_FILE_BYTE_ORDER 0x01020304U
+
+#define _TRIE_FILE_VERSION 1U
+
+// Set in the header flags when the file holds a copy of each word
+#define _TRIE_FILE_WORDS_STORED 1U
+
+typedef struct {
+    char magic[4];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t flags;
+    uint64_t size;
+    uint32_t root;
+    uint32_t padding;
+} _trie_file_header_t;
+
+// A node record is followed by the offsets of the records of its children,
+// then their keys (in increasing order), then the label of the edge leading
+// to the node, padded to a multiple of 4 bytes. word is the offset of the
+// word of a terminal node, if words are stored
+typedef struct {
+    uint32_t word;
+    uint32_t label_length;
+    uint16_t child_count;
+    uint8_t terminal;
+    uint8_t padding;
+} _trie_file_node_t;
+
+struct _trie_mapped_t {
+    const char* base;
+    size_t size;
+};
+
+// Returns size rounded up to a multiple of 4
+size_t _align_to_record(size_t size) {
+    return (size + 3U) & ~(size_t) 3U;
+}
+
+// Writes length bytes to the file, returning false if writing fails
+bool _write_bytes(_trie_file_writer_t* writer, const void* bytes,
+    size_t length) {
+
+    if (fwrite(bytes, 1U, length, writer->file) != length) {
+        return false;
+    }
+    writer->offset += length;
+
+    return true;
+}
+
+// Writes zero bytes up to the next multiple of 4, returning false if writing
+// fails
+bool _write_padding(_trie_file_writer_t* writer) {
+    const char padding[4] = { 0 };
+
+    return _write_bytes(writer, padding,
+        _align_to_record(writer->offset) - writer->offset);
+}
+
+// Starts writing a trie file by leaving room for its header. Returns false if
+// writing fails
+bool _begin_file(_trie_file_writer_t* writer, FILE* file, bool store_words) {
+    writer->file = file;
+    writer->offset = 0U;
+    writer->store_words = store_words;
+
+    _trie_file_header_t header;
+    memset(&header, 0, sizeof(header));
+
+    return _write_bytes(writer, &header, sizeof(header));
+}
+
+// Writes the record of a node reached through an edge with the given label,
+// preceded by its word if it is terminal and words are stored. The node has
+// child_count children, with the given keys and record offsets. Sets offset
+// to that of the record. Returns false if writing fails or the file would be
+// too large
+bool _write_record(_trie_file_writer_t* writer, const char* label,
+    uint32_t label_length, bool terminal, const char* word,
+    size_t word_length, const unsigned char* keys, const uint32_t* children,
+    uint16_t child_count, uint32_t* offset) {
+
+    _trie_file_node_t record = { 0U, label_length, child_count, terminal, 0U };
+    if (terminal && writer->store_words) {
+        record.word = (uint32_t) writer->offset;
+        if (!_write_bytes(writer, word, word_length) ||
+            !_write_bytes(writer, "", 1U) || !_write_padding(writer)) {
+            return false;
+        }
+    }
+
+    size_t record_length = sizeof(record) +
+        child_count*(sizeof(uint32_t)+1U) + label_length;
+    if (_align_to_record(writer->offset + record_length) > UINT32_MAX) {
+        return false;
+    }
+    *offset = (uint32_t) writer->offset;
+
+    return _write_bytes(writer, &record, sizeof(record)) &&
+        _write_bytes(writer, children, child_count*sizeof(uint32_t)) &&
+        _write_bytes(writer, keys, child_count) &&
+        _write_bytes(writer, label, label_length) &&
+        _write_padding(writer);
+}
+
+// Finishes writing a trie file by writing its header, given the offset of the
+// record of the root node. Returns false if writing fails
+bool _finish_file(_trie_file_writer_t* writer, uint32_t root) {
+    _trie_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, _TRIE_FILE_MAGIC, sizeof(header.magic));
+    header.byte_order = _TRIE_FILE_BYTE_ORDER;
+    header.version = _TRIE_FILE_VERSION;
+    header.flags = writer->store_words ? _TRIE_FILE_WORDS_STORED : 0U;
+    header.size = writer->offset;
+    header.root = root;
+
+    return fseek(writer->file, 0L, SEEK_SET) == 0 &&
+        fwrite(&header, sizeof(header), 1U, writer->file) == 1U;
+}
+
+// Writes the records of the descendants of node, followed by the record of
+// node itself, which is reached through an edge with the given label and
+// whose path is length bytes long. Sets offset to that of the record of node.
+// Returns false if writing fails or the file would be too large
+bool _write_node_records(_trie_file_writer_t* writer,
+    const _trie_node_t* node, const char* label, uint32_t label_length,
+    size_t length, uint32_t* offset) {
+
+    // The children are counted and visited in the same block, since in a
+    // concurrent trie a larger one may be published meanwhile
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    uint16_t child_count =
+        iterator.children == NULL ? 0U : iterator.children->count;
+    uint32_t children[child_count+1];
+    unsigned char keys[child_count+1];
+
+    uint16_t i = 0U;
+    uint32_t child_label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &keys[i], &child_label_length, &child)) {
+        if (!_write_node_records(writer, child,
+            _get_edge_label(child, child_label_length), child_label_length,
+            length+child_label_length, &children[i])) {
+            return false;
+        }
+        i++;
+    }
+
+    return _write_record(writer, label, label_length,
+        _is_terminal_node(node),
+        node->word, node->word == NULL ? 0U : length, keys,
+        children, child_count, offset);
+}
+
+trie_result_t trie_save(trie_t* trie, const char* path) {
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (path == NULL) {
+        return TRIE_PATH_NULL;
+    }
+
+    if (trie->kind == _TRIE_DAWG || trie->kind == _TRIE_DOUBLE_ARRAY) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        return TRIE_FILE_ERROR;
+    }
+
+    bool written;
+    if (trie->kind == _TRIE_LOUDS) {
+        written = _write_louds(trie->louds, file);
+    }
+    else if (trie->kind == _TRIE_MAPPED) {
+        written = fwrite(trie->mapped->base, 1U, trie->mapped->size, file) ==
+            trie->mapped->size;
+    }
+    else {
+        _trie_file_writer_t writer;
+        uint32_t root;
+        uint64_t* active = _begin_read(trie);
+        written = _begin_file(&writer, file, trie->store_words) &&
+            _write_node_records(&writer, trie->root, "", 0U, 0U, &root) &&
+            _finish_file(&writer, root);
+        _end_read(active);
+    }
+
+    if (fclose(file) != 0 || !written) {
+        remove(path);
+        return TRIE_FILE_ERROR;
+    }
+
+    return TRIE_SUCCESS;
+}
+
+// Returns the record at the given offset within the mapped file
+const _trie_file_node_t* _get_record(const _trie_mapped_t* mapped,
+    uint32_t offset) {
+
+    return (const _trie_file_node_t*) (mapped->base + offset);
+}
+
+// Returns the offsets of the records of the children of record
+const uint32_t* _get_record_children(const _trie_file_node_t* record) {
+    return (const uint32_t*) (record+1);
+}
+
+// Returns the keys of the children of record
+const unsigned char* _get_record_keys(const _trie_file_node_t* record) {
+    return (const unsigned char*) (_get_record_children(record) +
+        record->child_count);
+}
+
+// Returns the label of the edge leading to record
+const char* _get_record_label(const _trie_file_node_t* record) {
+    return (const char*) (_get_record_keys(record) + record->child_count);
+}
+
+// Returns whether or not the size bytes at base start with a valid header
+bool _is_valid_file(const char* base, size_t size) {
+    if (size < sizeof(_trie_file_header_t)) {
+        return false;
+    }
+
+    const _trie_file_header_t* header = (const _trie_file_header_t*) base;
+
+    return memcmp(header->magic, _TRIE_FILE_MAGIC, sizeof(header->magic)) == 0
+        && header->byte_order == _TRIE_FILE_BYTE_ORDER
+        && header->version == _TRIE_FILE_VERSION
+        && header->size == size
+        && header->root < size;
+}
+
+// Returns whether or not the record at offset lies within the size bytes at
+// base, with the records of its children before it, and if words are stored
+// and it is terminal, its word before it too
+bool _is_valid_record(const char* base, size_t size, uint32_t offset,
+    bool store_words) {
+
+    if (offset < sizeof(_trie_file_header_t) || offset % 4U != 0U ||
+        size - offset < sizeof(_trie_file_node_t)) {
+        return false;
+    }
+
+    const _trie_file_node_t* record =
+        (const _trie_file_node_t*) (base + offset);
+    size_t available = size - offset - sizeof(_trie_file_node_t);
+    size_t children_length = record->child_count*(sizeof(uint32_t)+1U);
+    if (available < children_length ||
+        available - children_length < record->label_length) {
+        return false;
+    }
+
+    const uint32_t* children = _get_record_children(record);
+    for (uint16_t i = 0U; i < record->child_count; i++) {
+        if (children[i] >= offset) {
+            return false;
+        }
+    }
+
+    return !record->terminal || !store_words ||
+        (record->word >= sizeof(_trie_file_header_t) &&
+        record->word < offset &&
+        memchr(base + record->word, '\0', offset - record->word) != NULL);
+}
+
+// Checks every record reachable from the root of the trie file of size bytes
+// at base, whose header is valid, so that queries never read beyond the end
+// of the file. Each record may be reached only once, as the records form a
+// tree. Returns TRIE_FILE_INVALID if a record is not valid, or
+// TRIE_MALLOC_FAIL if memory allocation fails
+trie_result_t _check_records(const char* base, size_t size) {
+    const _trie_file_header_t* header = (const _trie_file_header_t*) base;
+    bool store_words = (header->flags & _TRIE_FILE_WORDS_STORED) != 0U;
+
+    // A bit for each offset at which a record may start
+    size_t visited_size = (size/4U + 7U) / 8U;
+    unsigned char* visited =
+        _allocate_memory(visited_size, TRIE_MEMORY_OTHER);
+    uint32_t* pending = NULL;
+    size_t pending_capacity = 0U;
+    size_t pending_count = 0U;
+    if (visited == NULL || !_reserve((void**) &pending, &pending_capacity,
+        1U, sizeof(uint32_t))) {
+        if (visited != NULL) {
+            _deallocate_memory(visited, visited_size, TRIE_MEMORY_OTHER);
+        }
+        return TRIE_MALLOC_FAIL;
+    }
+    memset(visited, 0, visited_size);
+    pending[pending_count++] = header->root;
+
+    trie_result_t result = TRIE_SUCCESS;
+    while (result == TRIE_SUCCESS && pending_count > 0U) {
+        uint32_t offset = pending[--pending_count];
+        size_t slot = offset / 4U;
+        if (!_is_valid_record(base, size, offset, store_words) ||
+            (visited[slot / 8U] >> (slot % 8U) & 1U) != 0U) {
+            result = TRIE_FILE_INVALID;
+            break;
+        }
+        visited[slot / 8U] |= (unsigned char) (1U << (slot % 8U));
+
+        const _trie_file_node_t* record =
+            (const _trie_file_node_t*) (base + offset);
+        if (!_reserve((void**) &pending, &pending_capacity,
+            pending_count + record->child_count, sizeof(uint32_t))) {
+            result = TRIE_MALLOC_FAIL;
+            break;
+        }
+        memcpy(pending + pending_count, _get_record_children(record),
+            record->child_count * sizeof(uint32_t));
+        pending_count += record->child_count;
+    }
+
+    _deallocate_memory(visited, visited_size, TRIE_MEMORY_OTHER);
+    _release(pending, pending_capacity, sizeof(uint32_t));
+
+    return result;
+}
+
+// Opens the LOUDS trie file of size bytes mapped at base, unmapping it if it
+// cannot be opened
+trie_result_t _open_mapped_louds(void* base, size_t size, trie_t** trie) {
+    _trie_louds_t* louds = NULL;
+    trie_result_t result = _open_louds(base, size, &louds);
+    trie_t* opened = result == TRIE_SUCCESS ?
+        _allocate_memory(sizeof(trie_t), TRIE_MEMORY_OTHER) : NULL;
+    if (opened == NULL) {
+        if (louds != NULL) {
+            _destroy_louds(louds);
+        }
+        else {
+            munmap(base, size);
+        }
+        return result == TRIE_SUCCESS ? TRIE_MALLOC_FAIL : result;
+    }
+
+    memset(opened, 0, sizeof(trie_t));
+    opened->kind = _TRIE_LOUDS;
+    opened->store_words = false;
+    opened->louds = louds;
+
+    *trie = opened;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_open_mapped(const char* path, trie_t** trie) {
+    if (path == NULL) {
+        return TRIE_PATH_NULL;
+    }
+
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor == -1) {
+        return TRIE_FILE_ERROR;
+    }
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0) {
+        close(descriptor);
+        return TRIE_FILE_ERROR;
+    }
+
+    size_t size = (size_t) status.st_size;
+    if (size < sizeof(_trie_file_header_t)) {
+        close(descriptor);
+        return TRIE_FILE_INVALID;
+    }
+
+    void* base = mmap(NULL, size, PROT_READ, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (base == MAP_FAILED) {
+        return TRIE_FILE_ERROR;
+    }
+
+    if (_is_louds_file(base, size)) {
+        return _open_mapped_louds(base, size, trie);
+    }
+
+    if (!_is_valid_file(base, size)) {
+        munmap(base, size);
+        return TRIE_FILE_INVALID;
+    }
+
+    trie_result_t checked = _check_records(base, size);
+    if (checked != TRIE_SUCCESS) {
+        munmap(base, size);
+        return checked;
+    }
+
+    _trie_mapped_t* mapped =
+        _allocate_memory(sizeof(_trie_mapped_t), TRIE_MEMORY_OTHER);
+    trie_t* opened = _allocate_memory(sizeof(trie_t), TRIE_MEMORY_OTHER);
+    if (mapped == NULL || opened == NULL) {
+        if (mapped != NULL) {
+            _deallocate_memory(mapped, sizeof(_trie_mapped_t),
+                TRIE_MEMORY_OTHER);
+        }
+        if (opened != NULL) {
+            _deallocate_memory(opened, sizeof(trie_t), TRIE_MEMORY_OTHER);
+        }
+        munmap(base, size);
+        return TRIE_MALLOC_FAIL;
+    }
+
+    const _trie_file_header_t* header = base;
+    mapped->base = base;
+    mapped->size = size;
+
+    memset(opened, 0, sizeof(trie_t));
+    opened->kind = _TRIE_MAPPED;
+    opened->store_words = (header->flags & _TRIE_FILE_WORDS_STORED) != 0U;
+    opened->mapped = mapped;
+
+    *trie = opened;
+
+    return TRIE_SUCCESS;
+}
+
+// Returns the record of the child of record reached through the edge with
+// the given key, or NULL if there is no such child
+const _trie_file_node_t* _get_record_child(const _trie_mapped_t* mapped,
+    const _trie_file_node_t* record, unsigned char key) {
+
+    const unsigned char* keys = _get_record_keys(record);
+    const unsigned char* found = memchr(keys, key, record->child_count);
+    if (found == NULL) {
+        return NULL;
+    }
+
+    return _get_record(mapped, _get_record_children(record)[found-keys]);
+}
+
+// The mapped file equivalent of _find_prefix_node()
+const _trie_file_node_t* _find_prefix_record(const _trie_mapped_t* mapped,
+    const char* prefix, size_t length, uint32_t* remaining_length) {
+
+    const _trie_file_header_t* header =
+        (const _trie_file_header_t*) mapped->base;
+    const _trie_file_node_t* record = _get_record(mapped, header->root);
+    *remaining_length = 0U;
+
+    size_t i = 0U;
+    while (i < length) {
+        record = _get_record_child(mapped, record, (unsigned char) prefix[i]);
+        if (record == NULL) {
+            return NULL;
+        }
+
+        const char* label = _get_record_label(record);
+        size_t remaining = length-i;
+        if (remaining < record->label_length) {
+            if (memcmp(label, prefix+i, remaining) != 0) {
+                return NULL;
+            }
+            *remaining_length = record->label_length - (uint32_t) remaining;
+            return record;
+        }
+
+        if (memcmp(label, prefix+i, record->label_length) != 0) {
+            return NULL;
+        }
+
+        i += record->label_length;
+    }
+
+    return record;
+}
+
+bool _mapped_contains_word(const _trie_mapped_t* mapped, const char* word,
+    size_t word_length) {
+
+    uint32_t remaining_length;
+    const _trie_file_node_t* record =
+        _find_prefix_record(mapped, word, word_length, &remaining_length);
+
+    return record != NULL && remaining_length == 0U && record->terminal;
+}
+
+void _mapped_find_prefix_matches(const _trie_mapped_t* mapped,
+    const char* input, size_t length, _trie_prefix_matches_t* matches) {
+
+    const _trie_file_header_t* header =
+        (const _trie_file_header_t*) mapped->base;
+    const _trie_file_node_t* record = _get_record(mapped, header->root);
+
+    size_t i = 0U;
+    while (i < length && !matches->done) {
+        record = _get_record_child(mapped, record, (unsigned char) input[i]);
+        if (record == NULL || record->label_length > length-i ||
+            memcmp(_get_record_label(record), input+i,
+                record->label_length) != 0) {
+            return;
+        }
+
+        i += record->label_length;
+        if (record->terminal) {
+            _record_prefix_match(matches, i);
+        }
+    }
+}
+
+size_t _get_descendant_record_words(const _trie_mapped_t* mapped,
+    const _trie_file_node_t* from_record, const char** words,
+    size_t words_length) {
+
+    size_t word_count = 0U;
+
+    if (from_record->terminal) {
+        words[word_count] = mapped->base + from_record->word;
+        word_count++;
+    }
+
+    const uint32_t* children = _get_record_children(from_record);
+    for (uint16_t i = 0U;
+        i < from_record->child_count && word_count < words_length; i++) {
+        word_count += _get_descendant_record_words(mapped,
+            _get_record(mapped, children[i]), words+word_count,
+            words_length-word_count);
+    }
+
+    return word_count;
+}
+
+size_t _mapped_get_words_matching_prefix(const _trie_mapped_t* mapped,
+    const char* prefix, size_t prefix_length, const char** words,
+    size_t words_length) {
+
+    uint32_t remaining_length;
+    const _trie_file_node_t* record =
+        _find_prefix_record(mapped, prefix, prefix_length, &remaining_length);
+    if (record == NULL) {
+        return 0U;
+    }
+
+    return _get_descendant_record_words(mapped, record, words, words_length);
+}
+
+void _copy_descendant_record_words(const _trie_mapped_t* mapped,
+    const _trie_file_node_t* from_record, _trie_word_copy_t* copy) {
+
+    if (from_record->terminal) {
+        _copy_path_word(copy);
+    }
+
+    const uint32_t* children = _get_record_children(from_record);
+    for (uint16_t i = 0U; i < from_record->child_count && !copy->done; i++) {
+        const _trie_file_node_t* child = _get_record(mapped, children[i]);
+        if (_push_path(copy, _get_record_label(child), child->label_length)) {
+            _copy_descendant_record_words(mapped, child, copy);
+            copy->path_length -= child->label_length;
+        }
+    }
+}
+
+void _mapped_copy_words_matching_prefix(const _trie_mapped_t* mapped,
+    const char* prefix, size_t prefix_length, _trie_word_copy_t* copy) {
+
+    uint32_t remaining_length;
+    const _trie_file_node_t* record =
+        _find_prefix_record(mapped, prefix, prefix_length, &remaining_length);
+    if (record == NULL) {
+        return;
+    }
+
+    if (_push_path(copy, prefix, prefix_length) &&
+        _push_path(copy, _get_record_label(record) + record->label_length -
+            remaining_length, remaining_length)) {
+        _copy_descendant_record_words(mapped, record, copy);
+    }
+}
+
+size_t _count_descendant_records(const _trie_mapped_t* mapped,
+    const _trie_file_node_t* from_record) {
+
+    size_t word_count = from_record->terminal ? 1U : 0U;
+
+    const uint32_t* children = _get_record_children(from_record);
+    for (uint16_t i = 0U; i < from_record->child_count; i++) {
+        word_count += _count_descendant_records(mapped,
+            _get_record(mapped, children[i]));
+    }
+
+    return word_count;
+}
+
+size_t _mapped_count_words_matching_prefix(const _trie_mapped_t* mapped,
+    const char* prefix, size_t prefix_length) {
+
+    uint32_t remaining_length;
+    const _trie_file_node_t* record =
+        _find_prefix_record(mapped, prefix, prefix_length, &remaining_length);
+    if (record == NULL) {
+        return 0U;
+    }
+
+    return _count_descendant_records(mapped, record);
+}
+
+void _destroy_mapped(_trie_mapped_t* mapped) {
+    munmap((void*) mapped->base, mapped->size);
+    _deallocate_memory(mapped, sizeof(_trie_mapped_t), TRIE_MEMORY_OTHER);
+}
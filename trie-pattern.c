@@ -0,0 +1,403 @@
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// A pattern is compiled to a sequence of elements, each matching one byte
+// from a set of bytes, or for '*' any number of bytes. Matching walks the
+// trie depth first, keeping for each byte of the current path the set of
+// elements the path may have matched up to, as in a simulation of the
+// nondeterministic automaton of the pattern. Every way of matching '*' is
+// tried at once rather than by backtracking over each in turn, so each word
+// is found exactly once, in byte order, and the walk turns back as soon as
+// the set becomes empty.
+//
+// Once the path has matched up to the trailing run of '*' of the pattern,
+// every word below matches, and they are copied without tracking any more
+// sets. Where the path can only go on with a single byte, the child for that
+// byte is looked up directly instead of trying each child in turn.
+
+// An element of a pattern, matching a single byte of bytes, or if repeat is
+// set, any number of them
+typedef struct {
+    uint32_t bytes[8];
+    bool repeat;
+} _trie_pattern_element_t;
+
+// State of a search for the words matching a pattern of element_count
+// elements. states holds element_count+1 flags for each byte of the current
+// path, flag i being set if the path may have matched the first i elements.
+// Every element from tail_start on is a '*'
+typedef struct {
+    _trie_pattern_element_t* elements;
+    size_t element_count;
+    size_t tail_start;
+    unsigned char* states;
+    size_t states_capacity;
+    bool malloc_failed;
+    _trie_word_copy_t* copy;
+} _trie_pattern_search_t;
+
+// Returns true if element matches byte
+bool _pattern_element_matches(const _trie_pattern_element_t* element,
+    unsigned char byte) {
+
+    return (element->bytes[byte / 32U] >> (byte % 32U) & 1U) != 0U;
+}
+
+// Adds the bytes from first to last inclusive to element
+void _add_pattern_bytes(_trie_pattern_element_t* element, unsigned char first,
+    unsigned char last) {
+
+    for (unsigned int byte = first; byte <= last; byte++) {
+        element->bytes[byte / 32U] |= 1U << (byte % 32U);
+    }
+}
+
+// Compiles the character class of pattern starting just after its '[' at
+// offset, setting offset to just after its ']'. Returns false if the class is
+// not terminated
+bool _compile_pattern_class(const char* pattern, size_t length,
+    size_t* offset, _trie_pattern_element_t* element) {
+
+    size_t i = *offset;
+    bool negated = i < length && pattern[i] == '^';
+    if (negated) {
+        i++;
+    }
+
+    // A ']' straight after the '[' or '[^' is taken literally
+    bool first = true;
+    while (i < length && (first || pattern[i] != ']')) {
+        first = false;
+        if (pattern[i] == '\\') {
+            i++;
+            if (i == length) {
+                return false;
+            }
+        }
+        unsigned char low = (unsigned char) pattern[i++];
+        unsigned char high = low;
+        if (i+1 < length && pattern[i] == '-' && pattern[i+1] != ']') {
+            i++;
+            if (pattern[i] == '\\') {
+                i++;
+                if (i == length) {
+                    return false;
+                }
+            }
+            high = (unsigned char) pattern[i++];
+        }
+        if (low <= high) {
+            _add_pattern_bytes(element, low, high);
+        }
+    }
+    if (i == length) {
+        return false;
+    }
+
+    if (negated) {
+        for (size_t j = 0U; j < 8U; j++) {
+            element->bytes[j] = ~element->bytes[j];
+        }
+    }
+    *offset = i+1;
+
+    return true;
+}
+
+// Compiles a pattern of length bytes into elements, which has room for at
+// least length elements, collapsing runs of '*'. Returns false if the
+// pattern is invalid
+bool _compile_pattern(const char* pattern, size_t length,
+    _trie_pattern_element_t* elements, size_t* element_count) {
+
+    size_t count = 0U;
+    size_t i = 0U;
+    while (i < length) {
+        _trie_pattern_element_t* element = &elements[count];
+        memset(element, 0, sizeof(*element));
+        char byte = pattern[i++];
+        if (byte == '*') {
+            if (count > 0U && elements[count-1].repeat) {
+                continue;
+            }
+            _add_pattern_bytes(element, 0U, UINT8_MAX);
+            element->repeat = true;
+        }
+        else if (byte == '?') {
+            _add_pattern_bytes(element, 0U, UINT8_MAX);
+        }
+        else if (byte == '[') {
+            if (!_compile_pattern_class(pattern, length, &i, element)) {
+                return false;
+            }
+        }
+        else {
+            if (byte == '\\') {
+                if (i == length) {
+                    return false;
+                }
+                byte = pattern[i++];
+            }
+            _add_pattern_bytes(element, (unsigned char) byte,
+                (unsigned char) byte);
+        }
+        count++;
+    }
+    *element_count = count;
+
+    return true;
+}
+
+// Sets the flag of each element which may be matched without consuming a
+// byte, following the set flag of a '*' before it
+void _close_pattern_states(const _trie_pattern_search_t* search,
+    unsigned char* states) {
+
+    for (size_t i = 0U; i < search->element_count; i++) {
+        if (states[i] && search->elements[i].repeat) {
+            states[i+1] = 1U;
+        }
+    }
+}
+
+// Computes the states for the path of depth+1 bytes which ends in byte from
+// those of its first depth bytes, which have been reserved. Returns false if
+// no element is matched by the longer path
+bool _compute_pattern_states(_trie_pattern_search_t* search, size_t depth,
+    unsigned char byte) {
+
+    size_t width = search->element_count+1;
+    const unsigned char* previous = search->states + depth*width;
+    unsigned char* states = search->states + (depth+1)*width;
+
+    memset(states, 0, width);
+    bool matched = false;
+    for (size_t i = 0U; i < search->element_count; i++) {
+        const _trie_pattern_element_t* element = &search->elements[i];
+        if (previous[i] && _pattern_element_matches(element, byte)) {
+            states[element->repeat ? i : i+1] = 1U;
+            matched = true;
+        }
+    }
+    _close_pattern_states(search, states);
+
+    return matched;
+}
+
+// Returns true if every word below the path whose states are at depth matches
+bool _matches_any_suffix(const _trie_pattern_search_t* search, size_t depth) {
+    if (search->tail_start == search->element_count) {
+        return false;
+    }
+
+    const unsigned char* states =
+        search->states + depth*(search->element_count+1);
+    for (size_t i = search->tail_start; i <= search->element_count; i++) {
+        if (states[i]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Returns true if the path whose states are at depth can only go on with a
+// single byte, setting byte to it
+bool _get_single_pattern_byte(const _trie_pattern_search_t* search,
+    size_t depth, unsigned char* byte) {
+
+    const unsigned char* states =
+        search->states + depth*(search->element_count+1);
+    bool found = false;
+    for (size_t i = 0U; i < search->element_count; i++) {
+        if (!states[i]) {
+            continue;
+        }
+
+        const _trie_pattern_element_t* element = &search->elements[i];
+        if (element->repeat) {
+            return false;
+        }
+        for (size_t j = 0U; j < 8U; j++) {
+            uint32_t bits = element->bytes[j];
+            if (bits == 0U) {
+                continue;
+            }
+            if ((bits & (bits-1U)) != 0U) {
+                return false;
+            }
+            unsigned char only = (unsigned char) (j*32U);
+            while ((bits & 1U) == 0U) {
+                bits >>= 1;
+                only++;
+            }
+            if (found && only != *byte) {
+                return false;
+            }
+            *byte = only;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+void _match_pattern_node(_trie_pattern_search_t* search,
+    const _trie_node_t* node, size_t depth);
+
+// Matches the words at or below child, whose edge label of label_length
+// bytes leads on from the path of depth bytes
+void _match_pattern_child(_trie_pattern_search_t* search,
+    const _trie_node_t* child, uint32_t label_length, size_t depth) {
+
+    size_t width = search->element_count+1;
+    if (!_reserve((void**) &(search->states), &(search->states_capacity),
+        (depth + label_length + 1U) * width, sizeof(unsigned char))) {
+        search->malloc_failed = true;
+        search->copy->done = true;
+        return;
+    }
+
+    const char* label = _get_edge_label(child, label_length);
+    for (uint32_t i = 0U; i < label_length; i++) {
+        if (!_compute_pattern_states(search, depth+i,
+            (unsigned char) label[i])) {
+            return;
+        }
+    }
+
+    _trie_word_copy_t* copy = search->copy;
+    if (!_push_path(copy, label, label_length)) {
+        return;
+    }
+    if (_matches_any_suffix(search, depth+label_length)) {
+        _copy_descendant_words(child, copy);
+    }
+    else {
+        _match_pattern_node(search, child, depth+label_length);
+    }
+    copy->path_length -= label_length;
+}
+
+// Matches the words at or below node, whose path of depth bytes is held in
+// the copy and whose states have been computed
+void _match_pattern_node(_trie_pattern_search_t* search,
+    const _trie_node_t* node, size_t depth) {
+
+    size_t width = search->element_count+1;
+    if (_is_terminal_node(node) &&
+        search->states[depth*width + search->element_count]) {
+        _copy_path_word(search->copy);
+    }
+
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    if (_get_single_pattern_byte(search, depth, &key)) {
+        child = _get_child(node, key, &label_length);
+        if (child != NULL && !search->copy->done) {
+            _match_pattern_child(search, child, label_length, depth);
+        }
+        return;
+    }
+
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    while (!search->copy->done &&
+        _next_child(&iterator, &key, &label_length, &child)) {
+        _match_pattern_child(search, child, label_length, depth);
+    }
+}
+
+trie_result_t trie_match_pattern_key(trie_t* trie, const char* pattern,
+    size_t pattern_length, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, size_t n, size_t* key_count) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (pattern == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    if (pattern_length == 0U) {
+        return TRIE_WORD_EMPTY;
+    }
+
+    if (n == 0U) {
+        return TRIE_WORDS_LENGTH_ZERO;
+    }
+
+    if (buffer_length == 0U) {
+        return TRIE_BUFFER_LENGTH_ZERO;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    size_t elements_size = pattern_length * sizeof(_trie_pattern_element_t);
+    _trie_pattern_element_t* elements =
+        _allocate_memory(elements_size, TRIE_MEMORY_OTHER);
+    if (elements == NULL) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    size_t element_count;
+    if (!_compile_pattern(pattern, pattern_length, elements, &element_count)) {
+        _deallocate_memory(elements, elements_size, TRIE_MEMORY_OTHER);
+        return TRIE_PATTERN_INVALID;
+    }
+
+    _trie_word_copy_t copy = {
+        buffer, buffer_length, 0U, 0U, spans, NULL, n, 0U, false
+    };
+    _trie_pattern_search_t search = {
+        elements, element_count, element_count, NULL, 0U, false, &copy
+    };
+    while (search.tail_start > 0U && elements[search.tail_start-1].repeat) {
+        search.tail_start--;
+    }
+
+    if (!_reserve((void**) &(search.states), &(search.states_capacity),
+        element_count+1, sizeof(unsigned char))) {
+        _deallocate_memory(elements, elements_size, TRIE_MEMORY_OTHER);
+        return TRIE_MALLOC_FAIL;
+    }
+    memset(search.states, 0, element_count+1);
+    search.states[0] = 1U;
+    _close_pattern_states(&search, search.states);
+
+    uint64_t* active = _begin_read(trie);
+    if (_matches_any_suffix(&search, 0U)) {
+        _copy_descendant_words(trie->root, &copy);
+    }
+    else {
+        _match_pattern_node(&search, trie->root, 0U);
+    }
+    _end_read(active);
+
+    _release(search.states, search.states_capacity, sizeof(unsigned char));
+    _deallocate_memory(elements, elements_size, TRIE_MEMORY_OTHER);
+
+    if (search.malloc_failed) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    *key_count = copy.word_count;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_match_pattern(trie_t* trie, const char* pattern,
+    char* buffer, size_t buffer_length, trie_word_span_t* spans, size_t n,
+    size_t* word_count) {
+
+    return trie_match_pattern_key(trie, pattern,
+        pattern == NULL ? 0U : strlen(pattern), buffer, buffer_length, spans,
+        n, word_count);
+}
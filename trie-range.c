@@ -0,0 +1,643 @@
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// The children of every node are kept in byte order, so a depth first walk
+// visits words in byte order, and ordered queries need only follow the path
+// of their bounds. A range walk skips the children before the lower bound
+// with a seek, copies every word below children strictly between the bounds
+// without comparing them again, and stops at the first path reaching the
+// upper bound.
+//
+// The successor of a key lies below the last place on its path where a
+// greater branch leaves it: the smallest word there is the first terminal
+// node down the first children. The predecessor, likewise, lies below the
+// last place where a smaller branch leaves it, as the last word down the last
+// children, or is the last word which is a proper prefix of the key, which
+// comes before every longer word sharing that prefix. Removing a word from a
+// concurrent trie does not prune its nodes, so there a subtree may hold no
+// word at all, and is passed over for the next one which does.
+//
+// Each node counts the words at or below it, so the rank of a key adds up the
+// counts of the children branching off before its path, and the word at an
+// index is found by skipping whole children until the index falls within
+// one, both in time proportional to the length of the key times the fanout.
+
+// State of a copy of the words from low, inclusive, up to high, exclusive.
+// Either bound may be NULL, leaving the range unbounded on that side
+typedef struct {
+    const char* low;
+    size_t low_length;
+    const char* high;
+    size_t high_length;
+    _trie_word_copy_t* copy;
+} _trie_range_t;
+
+// Copies the words at or below node within a range, whose path of depth
+// bytes is held in the copy. low_bounded is set if the path is a prefix of
+// the lower bound, and high_bounded if it is a prefix of the upper bound
+void _copy_range_words(_trie_range_t* range, const _trie_node_t* node,
+    size_t depth, bool low_bounded, bool high_bounded) {
+
+    _trie_word_copy_t* copy = range->copy;
+    if (!low_bounded && !high_bounded) {
+        _copy_descendant_words(node, copy);
+        return;
+    }
+
+    // The path is the upper bound, so neither it nor any word below is in
+    // range, and nor is any word after
+    if (high_bounded && depth == range->high_length) {
+        copy->done = true;
+        return;
+    }
+
+    if (_is_terminal_node(node) &&
+        (!low_bounded || depth == range->low_length)) {
+        _copy_path_word(copy);
+    }
+
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    if (low_bounded && depth < range->low_length) {
+        _seek_children(&iterator, (unsigned char) range->low[depth]);
+    }
+
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (!copy->done &&
+        _next_child(&iterator, &key, &label_length, &child)) {
+        const char* label = _get_edge_label(child, label_length);
+
+        bool child_low_bounded = low_bounded;
+        bool below_range = false;
+        for (uint32_t i = 0U; child_low_bounded && i < label_length; i++) {
+            if (depth+i == range->low_length ||
+                label[i] != range->low[depth+i]) {
+                child_low_bounded = false;
+                below_range = depth+i < range->low_length &&
+                    (unsigned char) label[i] <
+                    (unsigned char) range->low[depth+i];
+            }
+        }
+        if (below_range) {
+            continue;
+        }
+
+        bool child_high_bounded = high_bounded;
+        for (uint32_t i = 0U; child_high_bounded && i < label_length; i++) {
+            if (depth+i == range->high_length ||
+                label[i] != range->high[depth+i]) {
+                if (depth+i == range->high_length ||
+                    (unsigned char) label[i] >
+                    (unsigned char) range->high[depth+i]) {
+                    copy->done = true;
+                    return;
+                }
+                child_high_bounded = false;
+            }
+        }
+
+        if (_push_path(copy, label, label_length)) {
+            _copy_range_words(range, child, depth+label_length,
+                child_low_bounded, child_high_bounded);
+            copy->path_length -= label_length;
+        }
+    }
+}
+
+trie_result_t trie_range_key(trie_t* trie, const char* low, size_t low_length,
+    const char* high, size_t high_length, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, size_t n, size_t* key_count) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (n == 0U) {
+        return TRIE_WORDS_LENGTH_ZERO;
+    }
+
+    if (buffer_length == 0U) {
+        return TRIE_BUFFER_LENGTH_ZERO;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    _trie_word_copy_t copy = {
+        buffer, buffer_length, 0U, 0U, spans, NULL, n, 0U, false
+    };
+    _trie_range_t range = { low, low_length, high, high_length, &copy };
+
+    uint64_t* active = _begin_read(trie);
+    _copy_range_words(&range, trie->root, 0U, low != NULL, high != NULL);
+    _end_read(active);
+
+    *key_count = copy.word_count;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_range(trie_t* trie, const char* low, const char* high,
+    char* buffer, size_t buffer_length, trie_word_span_t* spans, size_t n,
+    size_t* word_count) {
+
+    return trie_range_key(trie, low, low == NULL ? 0U : strlen(low), high,
+        high == NULL ? 0U : strlen(high), buffer, buffer_length, spans, n,
+        word_count);
+}
+
+// The subtree holding the successor or predecessor of a key: the child
+// reached through label from the node of the first depth bytes of the key,
+// or if descend is not set, the word of that node itself
+typedef struct {
+    const _trie_node_t* node;
+    size_t depth;
+    const char* label;
+    uint32_t label_length;
+    bool descend;
+} _trie_neighbour_t;
+
+// Appends length bytes to the word of used bytes in buffer, leaving room for
+// its null terminator. Returns false if there is no room
+bool _append_neighbour_bytes(char* buffer, size_t buffer_length,
+    size_t* used, const char* bytes, size_t length) {
+
+    if (buffer_length - *used <= length) {
+        return false;
+    }
+
+    memcpy(buffer + *used, bytes, length);
+    *used += length;
+
+    return true;
+}
+
+// Sets found to the subtree of child, reached through an edge of label_length
+// bytes from the node of the first depth bytes of a key
+void _set_neighbour(_trie_neighbour_t* found, const _trie_node_t* child,
+    size_t depth, uint32_t label_length) {
+
+    found->node = child;
+    found->depth = depth;
+    found->label = _get_edge_label(child, label_length);
+    found->label_length = label_length;
+    found->descend = true;
+}
+
+// Returns true if a word ends at or below node. Only in a concurrent trie may
+// a subtree hold no word, as there removing a word leaves its nodes in place
+bool _holds_word(const _trie_node_t* node) {
+    if (_is_terminal_node(node)) {
+        return true;
+    }
+
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        if (_holds_word(child)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Sets found to the subtree of the first of child and the children after it
+// in iterator below which a word ends. Returns false, leaving found
+// unchanged, if there is none
+bool _set_first_neighbour(_trie_neighbour_t* found,
+    _trie_children_iterator_t* iterator, _trie_node_t* child, size_t depth,
+    uint32_t label_length) {
+
+    unsigned char key;
+    do {
+        if (_holds_word(child)) {
+            _set_neighbour(found, child, depth, label_length);
+            return true;
+        }
+    } while (_next_child(iterator, &key, &label_length, &child));
+
+    return false;
+}
+
+// Finds the subtree holding the smallest word greater than key. Returns false
+// if there is none
+bool _find_successor(const trie_t* trie, const char* key, size_t length,
+    _trie_neighbour_t* successor) {
+
+    bool found = false;
+    const _trie_node_t* node = trie->root;
+    size_t depth = 0U;
+    while (true) {
+        _trie_children_iterator_t iterator;
+        _begin_children(node, &iterator);
+        if (depth < length) {
+            _seek_children(&iterator, (unsigned char) key[depth]);
+        }
+
+        unsigned char child_key;
+        uint32_t label_length;
+        _trie_node_t* child;
+        if (!_next_child(&iterator, &child_key, &label_length, &child)) {
+            return found;
+        }
+
+        // Every child of the node of the whole key, and every child beyond
+        // the key, leads only to greater words
+        if (depth == length || child_key != (unsigned char) key[depth]) {
+            return _set_first_neighbour(successor, &iterator, child, depth,
+                label_length) || found;
+        }
+
+        unsigned char next_key;
+        uint32_t next_label_length;
+        _trie_node_t* next_child;
+        if (_next_child(&iterator, &next_key, &next_label_length,
+            &next_child) && _set_first_neighbour(successor, &iterator,
+            next_child, depth, next_label_length)) {
+            found = true;
+        }
+
+        const char* label = _get_edge_label(child, label_length);
+        for (uint32_t i = 0U; i < label_length; i++) {
+            if (depth+i == length || (unsigned char) label[i] >
+                (unsigned char) key[depth+i]) {
+                if (!_holds_word(child)) {
+                    return found;
+                }
+                _set_neighbour(successor, child, depth, label_length);
+                return true;
+            }
+            if (label[i] != key[depth+i]) {
+                return found;
+            }
+        }
+
+        node = child;
+        depth += label_length;
+    }
+}
+
+// Finds the subtree holding the greatest word less than key. Returns false
+// if there is none
+bool _find_predecessor(const trie_t* trie, const char* key, size_t length,
+    _trie_neighbour_t* predecessor) {
+
+    bool found = false;
+    const _trie_node_t* node = trie->root;
+    size_t depth = 0U;
+    while (depth < length) {
+        // The word of the node is a proper prefix of the key, but comes
+        // before the words of any child less than the key
+        if (_is_terminal_node(node)) {
+            _trie_neighbour_t prefix = { node, depth, "", 0U, false };
+            *predecessor = prefix;
+            found = true;
+        }
+
+        _trie_children_iterator_t iterator;
+        _begin_children(node, &iterator);
+        unsigned char child_key;
+        uint32_t label_length;
+        _trie_node_t* child;
+        _trie_node_t* match = NULL;
+        uint32_t match_label_length = 0U;
+        while (_next_child(&iterator, &child_key, &label_length, &child) &&
+            child_key <= (unsigned char) key[depth]) {
+            if (child_key == (unsigned char) key[depth]) {
+                match = child;
+                match_label_length = label_length;
+            }
+            else if (_holds_word(child)) {
+                _set_neighbour(predecessor, child, depth, label_length);
+                found = true;
+            }
+        }
+        if (match == NULL) {
+            return found;
+        }
+
+        const char* label = _get_edge_label(match, match_label_length);
+        for (uint32_t i = 0U; i < match_label_length; i++) {
+            if (depth+i == length) {
+                return found;
+            }
+            if (label[i] != key[depth+i]) {
+                if ((unsigned char) label[i] < (unsigned char) key[depth+i] &&
+                    _holds_word(match)) {
+                    _set_neighbour(predecessor, match, depth,
+                        match_label_length);
+                    found = true;
+                }
+                return found;
+            }
+        }
+
+        node = match;
+        depth += match_label_length;
+    }
+
+    return found;
+}
+
+// Writes the word at the first (or if last is set, the last) terminal node of
+// a subtree into buffer. Returns false if there is no room for it
+bool _write_neighbour(const _trie_neighbour_t* neighbour, const char* key,
+    bool last, char* buffer, size_t buffer_length, size_t* word_length) {
+
+    size_t used = 0U;
+    if (!_append_neighbour_bytes(buffer, buffer_length, &used, key,
+        neighbour->depth) || !_append_neighbour_bytes(buffer, buffer_length,
+        &used, neighbour->label, neighbour->label_length)) {
+        return false;
+    }
+
+    const _trie_node_t* node = neighbour->node;
+    while (neighbour->descend && !(_is_terminal_node(node) && !last)) {
+        _trie_children_iterator_t iterator;
+        _begin_children(node, &iterator);
+        unsigned char child_key;
+        uint32_t label_length;
+        _trie_node_t* child;
+        const _trie_node_t* next = NULL;
+        uint32_t next_label_length = 0U;
+        while (_next_child(&iterator, &child_key, &label_length, &child)) {
+            if (!_holds_word(child)) {
+                continue;
+            }
+            next = child;
+            next_label_length = label_length;
+            if (!last) {
+                break;
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+
+        if (!_append_neighbour_bytes(buffer, buffer_length, &used,
+            _get_edge_label(next, next_label_length), next_label_length)) {
+            return false;
+        }
+        node = next;
+    }
+
+    buffer[used] = '\0';
+    *word_length = used;
+
+    return true;
+}
+
+// Finds the word after (or if before is set, before) key, and writes it into
+// buffer
+trie_result_t _find_neighbour(trie_t* trie, const char* key, size_t length,
+    bool before, char* buffer, size_t buffer_length, size_t* word_length) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (key == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    if (buffer_length == 0U) {
+        return TRIE_BUFFER_LENGTH_ZERO;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    trie_result_t result = TRIE_NOT_FOUND;
+    _trie_neighbour_t neighbour;
+    uint64_t* active = _begin_read(trie);
+    if (before ? _find_predecessor(trie, key, length, &neighbour) :
+        _find_successor(trie, key, length, &neighbour)) {
+        result = _write_neighbour(&neighbour, key, before, buffer,
+            buffer_length, word_length) ? TRIE_SUCCESS : TRIE_WORD_TOO_LONG;
+    }
+    _end_read(active);
+
+    return result;
+}
+
+trie_result_t trie_successor_key(trie_t* trie, const char* key, size_t length,
+    char* buffer, size_t buffer_length, size_t* successor_length) {
+
+    return _find_neighbour(trie, key, length, false, buffer, buffer_length,
+        successor_length);
+}
+
+trie_result_t trie_successor(trie_t* trie, const char* word, char* buffer,
+    size_t buffer_length) {
+
+    size_t successor_length;
+
+    return trie_successor_key(trie, word, word == NULL ? 0U : strlen(word),
+        buffer, buffer_length, &successor_length);
+}
+
+trie_result_t trie_predecessor_key(trie_t* trie, const char* key,
+    size_t length, char* buffer, size_t buffer_length,
+    size_t* predecessor_length) {
+
+    return _find_neighbour(trie, key, length, true, buffer, buffer_length,
+        predecessor_length);
+}
+
+trie_result_t trie_predecessor(trie_t* trie, const char* word, char* buffer,
+    size_t buffer_length) {
+
+    size_t predecessor_length;
+
+    return trie_predecessor_key(trie, word, word == NULL ? 0U : strlen(word),
+        buffer, buffer_length, &predecessor_length);
+}
+
+// Returns the number of words of trie which come before key
+size_t _rank_key(const trie_t* trie, const char* key, size_t length) {
+    size_t rank = 0U;
+    const _trie_node_t* node = trie->root;
+    size_t depth = 0U;
+    while (depth < length) {
+        if (_is_terminal_node(node)) {
+            rank++;
+        }
+
+        _trie_children_iterator_t iterator;
+        _begin_children(node, &iterator);
+        unsigned char child_key;
+        uint32_t label_length;
+        _trie_node_t* child;
+        _trie_node_t* match = NULL;
+        uint32_t match_label_length = 0U;
+        while (_next_child(&iterator, &child_key, &label_length, &child) &&
+            child_key <= (unsigned char) key[depth]) {
+            if (child_key == (unsigned char) key[depth]) {
+                match = child;
+                match_label_length = label_length;
+            }
+            else {
+                rank += _get_word_count(trie, child);
+            }
+        }
+        if (match == NULL) {
+            return rank;
+        }
+
+        const char* label = _get_edge_label(match, match_label_length);
+        for (uint32_t i = 0U; i < match_label_length; i++) {
+            if (depth+i == length) {
+                return rank;
+            }
+            if (label[i] != key[depth+i]) {
+                if ((unsigned char) label[i] < (unsigned char) key[depth+i]) {
+                    rank += _get_word_count(trie, match);
+                }
+                return rank;
+            }
+        }
+
+        node = match;
+        depth += match_label_length;
+    }
+
+    return rank;
+}
+
+trie_result_t trie_rank_key(trie_t* trie, const char* key, size_t length,
+    size_t* rank) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (key == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    if (trie->kind == _TRIE_DAWG) {
+        *rank = _dawg_rank_key(trie->dawg, key, length);
+        return TRIE_SUCCESS;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    uint64_t* active = _begin_read(trie);
+    *rank = _rank_key(trie, key, length);
+    _end_read(active);
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_rank(trie_t* trie, const char* word, size_t* rank) {
+    return trie_rank_key(trie, word, word == NULL ? 0U : strlen(word), rank);
+}
+
+// Writes the word of trie at index in byte order into buffer, setting found
+// if there is one. Returns false if there is no room for it
+bool _select_key(const trie_t* trie, size_t index, char* buffer,
+    size_t buffer_length, size_t* key_length, bool* found) {
+
+    *found = false;
+    if (index >= _get_word_count(trie, trie->root)) {
+        return true;
+    }
+
+    size_t used = 0U;
+    const _trie_node_t* node = trie->root;
+    while (!_is_terminal_node(node) || index > 0U) {
+        if (_is_terminal_node(node)) {
+            index--;
+        }
+
+        _trie_children_iterator_t iterator;
+        _begin_children(node, &iterator);
+        unsigned char child_key;
+        uint32_t label_length;
+        _trie_node_t* child;
+        const _trie_node_t* next = NULL;
+        while (next == NULL &&
+            _next_child(&iterator, &child_key, &label_length, &child)) {
+            size_t child_word_count = _get_word_count(trie, child);
+            if (index < child_word_count) {
+                next = child;
+            }
+            else {
+                index -= child_word_count;
+            }
+        }
+
+        // Words of a concurrent trie may be removed while it is walked
+        if (next == NULL) {
+            return true;
+        }
+
+        if (!_append_neighbour_bytes(buffer, buffer_length, &used,
+            _get_edge_label(next, label_length), label_length)) {
+            return false;
+        }
+        node = next;
+    }
+
+    buffer[used] = '\0';
+    *key_length = used;
+    *found = true;
+
+    return true;
+}
+
+trie_result_t trie_select_key(trie_t* trie, size_t index, char* buffer,
+    size_t buffer_length, size_t* key_length) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (buffer_length == 0U) {
+        return TRIE_BUFFER_LENGTH_ZERO;
+    }
+
+    if (trie->kind != _TRIE_DAWG && trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    bool found;
+    bool written;
+    if (trie->kind == _TRIE_DAWG) {
+        written = _dawg_select_key(trie->dawg, index, buffer, buffer_length,
+            key_length, &found);
+    }
+    else {
+        uint64_t* active = _begin_read(trie);
+        written = _select_key(trie, index, buffer, buffer_length, key_length,
+            &found);
+        _end_read(active);
+    }
+
+    if (!written) {
+        return TRIE_WORD_TOO_LONG;
+    }
+
+    return found ? TRIE_SUCCESS : TRIE_NOT_FOUND;
+}
+
+trie_result_t trie_select(trie_t* trie, size_t index, char* buffer,
+    size_t buffer_length) {
+
+    size_t word_length;
+
+    return trie_select_key(trie, index, buffer, buffer_length, &word_length);
+}
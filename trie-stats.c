@@ -0,0 +1,106 @@
+#include "trie.h"
+#include "trie-internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Statistics are gathered by a single depth first walk of the nodes. Sizes
+// are those each node and children block was allocated with, so in a trie
+// without an arena node_bytes and children_bytes are exactly the bytes
+// reported to sized memory listeners for those categories. In an arena they
+// leave out the alignment padding and unused space of the chunks, which
+// allocated_bytes includes instead.
+
+// State of a walk gathering the statistics of a trie. edge_total is the sum
+// over the words of the number of edges followed to reach them
+typedef struct {
+    trie_stats_t* stats;
+    bool store_words;
+    size_t edge_total;
+} _trie_stats_walk_t;
+
+// Gathers the statistics of node and the nodes below it. node is reached by
+// following depth edges, which spell out length bytes
+void _gather_node_stats(_trie_stats_walk_t* walk, const _trie_node_t* node,
+    size_t depth, size_t length) {
+
+    trie_stats_t* stats = walk->stats;
+    stats->node_count++;
+    stats->node_bytes += _get_node_size(node);
+    stats->depth_histogram[depth < TRIE_STATS_MAX_DEPTH ?
+        depth : TRIE_STATS_MAX_DEPTH-1]++;
+
+    if (_is_terminal_node(node)) {
+        stats->word_count++;
+        walk->edge_total += depth;
+        if (walk->store_words) {
+            stats->string_bytes += length+1;
+        }
+    }
+
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    if (iterator.children == NULL) {
+        stats->fan_out_histogram[0]++;
+        return;
+    }
+    stats->children_bytes += _children_sizes[iterator.children->kind];
+    stats->fan_out_histogram[iterator.children->count]++;
+
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        _gather_node_stats(walk, child, depth+1, length+label_length);
+    }
+}
+
+// Returns the number of bytes allocated for the chunks of arena
+size_t _get_arena_chunks_size(const _trie_arena_t* arena) {
+    size_t size = 0U;
+    const _trie_arena_chunk_t* chunk =
+        __atomic_load_n(&(arena->current_chunk), __ATOMIC_ACQUIRE);
+    while (chunk != NULL) {
+        size += sizeof(_trie_arena_chunk_t) + chunk->capacity;
+        chunk = chunk->previous;
+    }
+
+    return size;
+}
+
+trie_result_t trie_get_stats(trie_t* trie, trie_stats_t* stats) {
+    if (trie == NULL || stats == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    memset(stats, 0, sizeof(trie_stats_t));
+    _trie_stats_walk_t walk = { stats, trie->store_words, 0U };
+
+    uint64_t* active = _begin_read(trie);
+    _gather_node_stats(&walk, trie->root, 0U, 0U);
+
+    stats->allocated_bytes = sizeof(trie_t) +
+        _get_arena_chunks_size(&(trie->word_pool));
+    if (trie->arena != NULL) {
+        stats->allocated_bytes += sizeof(_trie_arena_t) +
+            _get_arena_chunks_size(trie->arena);
+    }
+    else {
+        stats->allocated_bytes += stats->node_bytes + stats->children_bytes;
+    }
+    if (trie->epochs != NULL) {
+        stats->allocated_bytes += _get_epochs_size();
+    }
+    _end_read(active);
+
+    if (stats->word_count > 0U) {
+        stats->average_lookup_path_length =
+            (double) walk.edge_total / (double) stats->word_count;
+    }
+
+    return TRIE_SUCCESS;
+}
@@ -1,4 +1,7 @@
+#include <pthread.h>
+#include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include "cutest/CuTest.h"
 #include "trie.h"
@@ -260,22 +263,43 @@ void test_get_prefix_matches(CuTest* test) {
 }
 
 int64_t currently_allocated_memory;
+// The listeners may be called from several threads at once
 void memory_allocated() {
-    currently_allocated_memory++;
+    __atomic_fetch_add(&currently_allocated_memory, 1, __ATOMIC_RELAXED);
 }
 
 void memory_deallocated() {
-    currently_allocated_memory--;
+    __atomic_fetch_sub(&currently_allocated_memory, 1, __ATOMIC_RELAXED);
+}
+
+// Bytes currently allocated in each category, as reported to the sized
+// listeners
+int64_t currently_allocated_bytes[TRIE_MEMORY_OTHER+1];
+
+void memory_allocated_sized(size_t size, trie_memory_category_t category) {
+    __atomic_fetch_add(&currently_allocated_bytes[category], (int64_t) size,
+        __ATOMIC_RELAXED);
+}
+
+void memory_deallocated_sized(size_t size, trie_memory_category_t category) {
+    __atomic_fetch_sub(&currently_allocated_bytes[category], (int64_t) size,
+        __ATOMIC_RELAXED);
 }
 
 void set_up_memory_leak_detection() {
     currently_allocated_memory = 0;
+    memset(currently_allocated_bytes, 0, sizeof(currently_allocated_bytes));
     trie_set_memory_allocation_listener(memory_allocated);
     trie_set_memory_deallocation_listener(memory_deallocated);
+    trie_set_sized_memory_allocation_listener(memory_allocated_sized);
+    trie_set_sized_memory_deallocation_listener(memory_deallocated_sized);
 }
 
 void assert_no_memory_leaks(CuTest* test) {
     CuAssertIntEquals(test, 0, currently_allocated_memory);
+    for (size_t i = 0U; i <= TRIE_MEMORY_OTHER; i++) {
+        CuAssertIntEquals(test, 0, currently_allocated_bytes[i]);
+    }
 }
 
 void test_destroy_empty_does_not_leak_memory(CuTest* test) {
@@ -307,3 +331,3703 @@ void test_destroy_multi_word_trie_does_not_leak_memory(CuTest* test) {
 
     assert_no_memory_leaks(test);
 }
+
+trie_t* trie_create_with_arena_checked(CuTest* test, size_t initial_bytes) {
+    trie_t* trie;
+
+    if (trie_create_with_arena(&trie, initial_bytes) != TRIE_SUCCESS) {
+        CuFail(test, "trie_create_with_arena failed");
+    }
+
+    return trie;
+}
+
+void test_create_with_zero_sized_arena_fails(CuTest* test) {
+    trie_t* trie;
+    trie_result_t create_result = trie_create_with_arena(&trie, 0U);
+
+    CuAssertIntEquals(test, TRIE_ARENA_SIZE_ZERO, create_result);
+}
+
+void test_arena_contains_words(CuTest* test) {
+    trie_t* trie = trie_create_with_arena_checked(test, 64U);
+
+    trie_add_word_checked(test, trie, "bone");
+    trie_add_word_checked(test, trie, "body");
+    trie_add_word_checked(test, trie, "bo");
+
+    assert_trie_contains_word(test, trie, "bone");
+    assert_trie_contains_word(test, trie, "body");
+    assert_trie_contains_word(test, trie, "bo");
+    assert_trie_does_not_contain_word(test, trie, "b");
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_arena_get_prefix_matches(CuTest* test) {
+    trie_t* trie = trie_create_with_arena_checked(test, 64U);
+
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "wolf");
+    trie_add_word_checked(test, trie, "aardwolf");
+
+    size_t words_length = 2U;
+    const char* words[words_length];
+    size_t word_count;
+    if (trie_get_words_matching_prefix(
+        trie, "aard", words, words_length, &word_count) != TRIE_SUCCESS) {
+        CuFail(test, "trie_get_words_matching_prefix failed");
+    }
+
+    CuAssertIntEquals(test, 2U, word_count);
+    CuAssertStrEquals(test, "aardvark", words[0]);
+    CuAssertStrEquals(test, "aardwolf", words[1]);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_arena_allocates_per_chunk(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_with_arena_checked(test, 4096U);
+    int64_t allocated_after_create = currently_allocated_memory;
+
+    trie_add_word_checked(test, trie, "one");
+    trie_add_word_checked(test, trie, "two");
+    trie_add_word_checked(test, trie, "three");
+
+    CuAssertIntEquals(test, allocated_after_create, currently_allocated_memory);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_destroy_arena_trie_does_not_leak_memory(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_with_arena_checked(test, 16U);
+    trie_add_word_checked(test, trie, "one");
+    trie_add_word_checked(test, trie, "two");
+    trie_add_word_checked(test, trie, "three");
+
+    trie_destroy_checked(test, trie);
+
+    assert_no_memory_leaks(test);
+}
+
+void test_contains_with_every_fan_out(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+
+    char word[3] = { '\0', 'x', '\0' };
+    for (int ch = 255; ch > 0; ch--) {
+        word[0] = (char) ch;
+        trie_add_word_checked(test, trie, word);
+
+        for (int added = 255; added >= ch; added--) {
+            word[0] = (char) added;
+            assert_trie_contains_word(test, trie, word);
+        }
+    }
+
+    word[0] = 'a';
+    word[1] = 'y';
+    assert_trie_does_not_contain_word(test, trie, word);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_get_prefix_matches_with_large_fan_out(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+
+    char word[4] = { 'a', '\0', 'z', '\0' };
+    for (char ch = 'z'; ch >= 'A'; ch--) {
+        word[1] = ch;
+        trie_add_word_checked(test, trie, word);
+    }
+
+    size_t words_length = 100U;
+    const char* words[words_length];
+    size_t word_count;
+    if (trie_get_words_matching_prefix(
+        trie, "a", words, words_length, &word_count) != TRIE_SUCCESS) {
+        CuFail(test, "trie_get_words_matching_prefix failed");
+    }
+
+    CuAssertIntEquals(test, 'z'-'A'+1, word_count);
+    CuAssertStrEquals(test, "aAz", words[0]);
+    CuAssertStrEquals(test, "azz", words[word_count-1]);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_contains_after_splitting_edges(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+
+    trie_add_word_checked(test, trie, "organization");
+    trie_add_word_checked(test, trie, "organ");
+    trie_add_word_checked(test, trie, "organism");
+    trie_add_word_checked(test, trie, "orbit");
+
+    assert_trie_contains_word(test, trie, "organization");
+    assert_trie_contains_word(test, trie, "organ");
+    assert_trie_contains_word(test, trie, "organism");
+    assert_trie_contains_word(test, trie, "orbit");
+    assert_trie_does_not_contain_word(test, trie, "or");
+    assert_trie_does_not_contain_word(test, trie, "organi");
+    assert_trie_does_not_contain_word(test, trie, "organizations");
+    assert_trie_does_not_contain_word(test, trie, "orbits");
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_get_prefix_matches_ending_within_edge(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+
+    trie_add_word_checked(test, trie, "realization");
+    trie_add_word_checked(test, trie, "realizations");
+    trie_add_word_checked(test, trie, "reorganization");
+
+    size_t words_length = 3U;
+    const char* words[words_length];
+    size_t word_count;
+    if (trie_get_words_matching_prefix(
+        trie, "reali", words, words_length, &word_count) != TRIE_SUCCESS) {
+        CuFail(test, "trie_get_words_matching_prefix failed");
+    }
+
+    CuAssertIntEquals(test, 2U, word_count);
+    CuAssertStrEquals(test, "realization", words[0]);
+    CuAssertStrEquals(test, "realizations", words[1]);
+
+    if (trie_get_words_matching_prefix(
+        trie, "realz", words, words_length, &word_count) != TRIE_SUCCESS) {
+        CuFail(test, "trie_get_words_matching_prefix failed");
+    }
+
+    CuAssertIntEquals(test, 0U, word_count);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_add_word_compresses_single_child_chains(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_checked(test);
+    int64_t allocated_after_create = currently_allocated_memory;
+
+    trie_add_word_checked(test, trie, "internationalization");
+
+    // Children of the root, one node and the first chunk of the word pool
+    CuAssertIntEquals(test, allocated_after_create+3,
+        currently_allocated_memory);
+
+    trie_destroy_checked(test, trie);
+    assert_no_memory_leaks(test);
+}
+
+// Fills word with a pseudo-random lower case word of 1 to 12 letters, drawn
+// from a small alphabet so that words share many prefixes
+void make_random_word(uint32_t* seed, char* word) {
+    *seed = *seed * 1103515245U + 12345U;
+    size_t length = 1U + (*seed >> 16) % 12U;
+    for (size_t i = 0U; i < length; i++) {
+        *seed = *seed * 1103515245U + 12345U;
+        word[i] = (char) ('a' + (*seed >> 16) % 4U);
+    }
+    word[length] = '\0';
+}
+
+void test_contains_many_random_words(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+
+    uint32_t seed = 42U;
+    char word[16];
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+
+    seed = 42U;
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        assert_trie_contains_word(test, trie, word);
+    }
+
+    assert_trie_does_not_contain_word(test, trie, "abcde");
+    assert_trie_does_not_contain_word(test, trie, "aaaaaaaaaaaaa");
+
+    trie_destroy_checked(test, trie);
+}
+
+trie_t* trie_create_without_words_checked(CuTest* test) {
+    trie_t* trie;
+    trie_options_t options = { 0U, false, false };
+
+    if (trie_create_with_options(&trie, &options) != TRIE_SUCCESS) {
+        CuFail(test, "trie_create_with_options failed");
+    }
+
+    return trie;
+}
+
+void trie_copy_words_matching_prefix_checked(CuTest* test, trie_t* trie,
+    const char* prefix, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, size_t spans_length, size_t* word_count) {
+
+    if (trie_copy_words_matching_prefix(trie, prefix, buffer, buffer_length,
+        spans, spans_length, word_count) != TRIE_SUCCESS) {
+        CuFail(test, "trie_copy_words_matching_prefix failed");
+    }
+}
+
+void test_prefix_matches_without_stored_words_fails(CuTest* test) {
+    trie_t* trie = trie_create_without_words_checked(test);
+    trie_add_word_checked(test, trie, "word");
+
+    size_t words_length = 1U;
+    const char* words[words_length];
+    size_t word_count;
+    trie_result_t get_result = trie_get_words_matching_prefix(
+        trie, "w", words, words_length, &word_count);
+
+    CuAssertIntEquals(test, TRIE_WORDS_NOT_STORED, get_result);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_contains_without_stored_words(CuTest* test) {
+    trie_t* trie = trie_create_without_words_checked(test);
+
+    trie_add_word_checked(test, trie, "an");
+    trie_add_word_checked(test, trie, "ant");
+
+    assert_trie_contains_word(test, trie, "an");
+    assert_trie_contains_word(test, trie, "ant");
+    assert_trie_does_not_contain_word(test, trie, "a");
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_copy_prefix_matches_zero_buffer_length_fails(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+
+    char buffer[1];
+    trie_word_span_t spans[1];
+    size_t word_count;
+    trie_result_t copy_result = trie_copy_words_matching_prefix(
+        trie, "a", buffer, 0U, spans, 1U, &word_count);
+
+    CuAssertIntEquals(test, TRIE_BUFFER_LENGTH_ZERO, copy_result);
+
+    trie_destroy_checked(test, trie);
+}
+
+void assert_copies_prefix_matches(CuTest* test, trie_t* trie) {
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "wolf");
+    trie_add_word_checked(test, trie, "aardwolf");
+    trie_add_word_checked(test, trie, "aard");
+
+    char buffer[64];
+    size_t spans_length = 4U;
+    trie_word_span_t spans[spans_length];
+    size_t word_count;
+    trie_copy_words_matching_prefix_checked(test, trie, "aa", buffer,
+        sizeof(buffer), spans, spans_length, &word_count);
+
+    CuAssertIntEquals(test, 3U, word_count);
+    CuAssertStrEquals(test, "aard", buffer+spans[0].offset);
+    CuAssertIntEquals(test, 4U, spans[0].length);
+    CuAssertStrEquals(test, "aardvark", buffer+spans[1].offset);
+    CuAssertIntEquals(test, 8U, spans[1].length);
+    CuAssertStrEquals(test, "aardwolf", buffer+spans[2].offset);
+    CuAssertIntEquals(test, 8U, spans[2].length);
+}
+
+void test_copy_prefix_matches(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+
+    assert_copies_prefix_matches(test, trie);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_copy_prefix_matches_without_stored_words(CuTest* test) {
+    trie_t* trie = trie_create_without_words_checked(test);
+
+    assert_copies_prefix_matches(test, trie);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_copy_prefix_matches_bounded_by_buffer(CuTest* test) {
+    trie_t* trie = trie_create_without_words_checked(test);
+    trie_add_word_checked(test, trie, "ab");
+    trie_add_word_checked(test, trie, "abc");
+    trie_add_word_checked(test, trie, "abd");
+
+    // Room for "ab" and "abc" but not "abd"
+    char buffer[8];
+    size_t spans_length = 3U;
+    trie_word_span_t spans[spans_length];
+    size_t word_count;
+    trie_copy_words_matching_prefix_checked(test, trie, "a", buffer,
+        sizeof(buffer), spans, spans_length, &word_count);
+
+    CuAssertIntEquals(test, 2U, word_count);
+    CuAssertStrEquals(test, "ab", buffer+spans[0].offset);
+    CuAssertStrEquals(test, "abc", buffer+spans[1].offset);
+
+    trie_destroy_checked(test, trie);
+}
+
+// Returns the number of allocations made while adding a number of words to
+// trie, which is then destroyed
+int64_t count_allocations_adding_words(CuTest* test, trie_t* trie) {
+    int64_t allocated_before_adding = currently_allocated_memory;
+
+    uint32_t seed = 7U;
+    char word[16];
+    for (size_t i = 0U; i < 50U; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+
+    int64_t allocations = currently_allocated_memory - allocated_before_adding;
+    trie_destroy_checked(test, trie);
+
+    return allocations;
+}
+
+void test_stored_words_are_not_allocated_individually(CuTest* test) {
+    set_up_memory_leak_detection();
+
+    int64_t with_words = count_allocations_adding_words(
+        test, trie_create_checked(test));
+    int64_t without_words = count_allocations_adding_words(
+        test, trie_create_without_words_checked(test));
+
+    // A single chunk of the word pool
+    CuAssertIntEquals(test, without_words+1, with_words);
+    assert_no_memory_leaks(test);
+}
+
+const char* mapped_trie_path = "trie-tests.trie";
+
+// Saves trie, which is then destroyed, and returns it opened from its file
+trie_t* trie_save_and_open_mapped_checked(CuTest* test, trie_t* trie) {
+    if (trie_save(trie, mapped_trie_path) != TRIE_SUCCESS) {
+        CuFail(test, "trie_save failed");
+    }
+    trie_destroy_checked(test, trie);
+
+    trie_t* mapped;
+    if (trie_open_mapped(mapped_trie_path, &mapped) != TRIE_SUCCESS) {
+        CuFail(test, "trie_open_mapped failed");
+    }
+    remove(mapped_trie_path);
+
+    return mapped;
+}
+
+void test_save_null_path_fails(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+
+    trie_result_t save_result = trie_save(trie, NULL);
+
+    CuAssertIntEquals(test, TRIE_PATH_NULL, save_result);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_open_missing_file_fails(CuTest* test) {
+    trie_t* trie;
+    trie_result_t open_result =
+        trie_open_mapped("trie-tests.missing", &trie);
+
+    CuAssertIntEquals(test, TRIE_FILE_ERROR, open_result);
+}
+
+void test_open_invalid_file_fails(CuTest* test) {
+    FILE* file = fopen(mapped_trie_path, "wb");
+    fputs("This is not a trie file, though it is long enough for one", file);
+    fclose(file);
+
+    trie_t* trie;
+    trie_result_t open_result = trie_open_mapped(mapped_trie_path, &trie);
+    remove(mapped_trie_path);
+
+    CuAssertIntEquals(test, TRIE_FILE_INVALID, open_result);
+}
+
+// Saves trie, which is destroyed, then overwrites length bytes of its file at
+// offset with value and returns the result of opening the file
+trie_result_t trie_open_corrupted(CuTest* test, trie_t* trie, size_t offset,
+    const void* value, size_t length) {
+
+    if (trie_save(trie, mapped_trie_path) != TRIE_SUCCESS) {
+        CuFail(test, "trie_save failed");
+    }
+    trie_destroy_checked(test, trie);
+
+    FILE* file = fopen(mapped_trie_path, "r+b");
+    fseek(file, (long) offset, SEEK_SET);
+    fwrite(value, 1U, length, file);
+    fclose(file);
+
+    trie_t* opened;
+    trie_result_t open_result = trie_open_mapped(mapped_trie_path, &opened);
+    remove(mapped_trie_path);
+    if (open_result == TRIE_SUCCESS) {
+        trie_destroy_checked(test, opened);
+    }
+
+    return open_result;
+}
+
+// Reads the uint32_t at offset in the file saved from trie, which is
+// destroyed
+uint32_t read_saved_uint32(CuTest* test, trie_t* trie, size_t offset) {
+    if (trie_save(trie, mapped_trie_path) != TRIE_SUCCESS) {
+        CuFail(test, "trie_save failed");
+    }
+    trie_destroy_checked(test, trie);
+
+    uint32_t value = 0U;
+    FILE* file = fopen(mapped_trie_path, "rb");
+    fseek(file, (long) offset, SEEK_SET);
+    if (fread(&value, sizeof(value), 1U, file) != 1U) {
+        CuFail(test, "fread failed");
+    }
+    fclose(file);
+    remove(mapped_trie_path);
+
+    return value;
+}
+
+trie_t* trie_create_with_words_checked(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "aardwolf");
+    trie_add_word_checked(test, trie, "wolf");
+
+    return trie;
+}
+
+void test_open_corrupted_file_fails(CuTest* test) {
+    // The header holds the offset of the root record at byte 24, and a
+    // record is followed by the offsets of its children at byte 16
+    uint32_t root = read_saved_uint32(test,
+        trie_create_with_words_checked(test), 24U);
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_open_corrupted(test,
+        trie_create_with_words_checked(test), 24U, &root, sizeof(root)));
+
+    uint32_t header_offset = 0U;
+    CuAssertIntEquals(test, TRIE_FILE_INVALID, trie_open_corrupted(test,
+        trie_create_with_words_checked(test), 24U, &header_offset,
+        sizeof(header_offset)));
+
+    uint32_t unaligned = root - 2U;
+    CuAssertIntEquals(test, TRIE_FILE_INVALID, trie_open_corrupted(test,
+        trie_create_with_words_checked(test), 24U, &unaligned,
+        sizeof(unaligned)));
+
+    CuAssertIntEquals(test, TRIE_FILE_INVALID, trie_open_corrupted(test,
+        trie_create_with_words_checked(test), root + 16U, &root,
+        sizeof(root)));
+}
+
+void test_mapped_contains_words(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "organization");
+    trie_add_word_checked(test, trie, "organ");
+    trie_add_word_checked(test, trie, "orbit");
+
+    trie_t* mapped = trie_save_and_open_mapped_checked(test, trie);
+
+    assert_trie_contains_word(test, mapped, "organization");
+    assert_trie_contains_word(test, mapped, "organ");
+    assert_trie_contains_word(test, mapped, "orbit");
+    assert_trie_does_not_contain_word(test, mapped, "or");
+    assert_trie_does_not_contain_word(test, mapped, "organs");
+    assert_trie_does_not_contain_word(test, mapped, "");
+
+    trie_destroy_checked(test, mapped);
+}
+
+void test_mapped_get_prefix_matches(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "wolf");
+    trie_add_word_checked(test, trie, "aardwolf");
+
+    trie_t* mapped = trie_save_and_open_mapped_checked(test, trie);
+
+    size_t words_length = 3U;
+    const char* words[words_length];
+    size_t word_count;
+    if (trie_get_words_matching_prefix(
+        mapped, "aar", words, words_length, &word_count) != TRIE_SUCCESS) {
+        CuFail(test, "trie_get_words_matching_prefix failed");
+    }
+
+    CuAssertIntEquals(test, 2U, word_count);
+    CuAssertStrEquals(test, "aardvark", words[0]);
+    CuAssertStrEquals(test, "aardwolf", words[1]);
+
+    trie_destroy_checked(test, mapped);
+}
+
+void test_mapped_copy_prefix_matches_without_stored_words(CuTest* test) {
+    trie_t* trie = trie_create_without_words_checked(test);
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "wolf");
+    trie_add_word_checked(test, trie, "aardwolf");
+
+    trie_t* mapped = trie_save_and_open_mapped_checked(test, trie);
+
+    const char* words[1];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_WORDS_NOT_STORED,
+        trie_get_words_matching_prefix(mapped, "a", words, 1U, &word_count));
+
+    char buffer[32];
+    size_t spans_length = 3U;
+    trie_word_span_t spans[spans_length];
+    trie_copy_words_matching_prefix_checked(test, mapped, "aardw", buffer,
+        sizeof(buffer), spans, spans_length, &word_count);
+
+    CuAssertIntEquals(test, 1U, word_count);
+    CuAssertStrEquals(test, "aardwolf", buffer+spans[0].offset);
+
+    trie_destroy_checked(test, mapped);
+}
+
+void test_add_to_mapped_fails(CuTest* test) {
+    trie_t* mapped =
+        trie_save_and_open_mapped_checked(test, trie_create_checked(test));
+
+    trie_result_t add_result = trie_add_word(mapped, "word");
+
+    CuAssertIntEquals(test, TRIE_READ_ONLY, add_result);
+
+    trie_destroy_checked(test, mapped);
+}
+
+void test_mapped_contains_many_random_words(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    uint32_t seed = 42U;
+    char word[16];
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+
+    trie_t* mapped = trie_save_and_open_mapped_checked(test, trie);
+    trie_t* resaved = trie_save_and_open_mapped_checked(test, mapped);
+
+    seed = 42U;
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        assert_trie_contains_word(test, resaved, word);
+    }
+    assert_trie_does_not_contain_word(test, resaved, "abcde");
+
+    trie_destroy_checked(test, resaved);
+}
+
+trie_t* trie_build_from_sorted_checked(CuTest* test, const char** words,
+    size_t n) {
+
+    trie_t* trie;
+
+    if (trie_build_from_sorted(words, n, &trie) != TRIE_SUCCESS) {
+        CuFail(test, "trie_build_from_sorted failed");
+    }
+
+    return trie;
+}
+
+void test_build_from_unsorted_words_fails(CuTest* test) {
+    const char* words[] = { "wolf", "aardvark" };
+    trie_t* trie;
+
+    trie_result_t build_result = trie_build_from_sorted(words, 2U, &trie);
+
+    CuAssertIntEquals(test, TRIE_WORDS_NOT_SORTED, build_result);
+}
+
+void test_build_with_prefix_after_word_fails(CuTest* test) {
+    const char* words[] = { "aardvark", "aard" };
+    trie_t* trie;
+
+    trie_result_t build_result = trie_build_from_sorted(words, 2U, &trie);
+
+    CuAssertIntEquals(test, TRIE_WORDS_NOT_SORTED, build_result);
+}
+
+void test_build_from_sorted_contains_words(CuTest* test) {
+    const char* words[] = { "aard", "aardvark", "aardvark", "aardwolf", "ant",
+        "wolf", "wolves" };
+    trie_t* trie = trie_build_from_sorted_checked(test, words, 7U);
+
+    assert_trie_contains_word(test, trie, "aard");
+    assert_trie_contains_word(test, trie, "aardvark");
+    assert_trie_contains_word(test, trie, "aardwolf");
+    assert_trie_contains_word(test, trie, "ant");
+    assert_trie_contains_word(test, trie, "wolf");
+    assert_trie_contains_word(test, trie, "wolves");
+    assert_trie_does_not_contain_word(test, trie, "aardw");
+    assert_trie_does_not_contain_word(test, trie, "wol");
+    assert_trie_does_not_contain_word(test, trie, "a");
+
+    const char* matches[4];
+    size_t word_count;
+    trie_get_words_matching_prefix(trie, "aard", matches, 4U, &word_count);
+    CuAssertIntEquals(test, 3U, word_count);
+
+    trie_add_word_checked(test, trie, "wol");
+    assert_trie_contains_word(test, trie, "wol");
+
+    trie_destroy_checked(test, trie);
+}
+
+int compare_words(const void* first, const void* second) {
+    return strcmp(*(const char* const*) first, *(const char* const*) second);
+}
+
+void test_build_from_many_sorted_random_words(CuTest* test) {
+    size_t n = 2000U;
+    char word_buffers[n][16];
+    const char* words[n];
+    uint32_t seed = 7U;
+    for (size_t i = 0U; i < n; i++) {
+        make_random_word(&seed, word_buffers[i]);
+        words[i] = word_buffers[i];
+    }
+    qsort(words, n, sizeof(words[0]), compare_words);
+
+    trie_t* trie = trie_build_from_sorted_checked(test, words, n);
+
+    for (size_t i = 0U; i < n; i++) {
+        assert_trie_contains_word(test, trie, words[i]);
+    }
+    assert_trie_does_not_contain_word(test, trie, "abcde");
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_build_to_file_contains_words(CuTest* test) {
+    const char* words[] = { "aardvark", "aardwolf", "wolf" };
+    trie_builder_t* builder;
+    if (trie_builder_create_for_file(&builder, mapped_trie_path, true) !=
+        TRIE_SUCCESS) {
+        CuFail(test, "trie_builder_create_for_file failed");
+    }
+    for (size_t i = 0U; i < 3U; i++) {
+        CuAssertIntEquals(test, TRIE_SUCCESS,
+            trie_builder_add_word(builder, words[i]));
+    }
+
+    trie_t* mapped;
+    trie_result_t finish_result = trie_builder_finish(builder, &mapped);
+    remove(mapped_trie_path);
+
+    CuAssertIntEquals(test, TRIE_SUCCESS, finish_result);
+    assert_trie_contains_word(test, mapped, "aardvark");
+    assert_trie_contains_word(test, mapped, "aardwolf");
+    assert_trie_contains_word(test, mapped, "wolf");
+    assert_trie_does_not_contain_word(test, mapped, "aard");
+
+    const char* matches[2];
+    size_t word_count;
+    trie_get_words_matching_prefix(mapped, "aard", matches, 2U, &word_count);
+    CuAssertIntEquals(test, 2U, word_count);
+    CuAssertStrEquals(test, "aardvark", matches[0]);
+    CuAssertStrEquals(test, "aardwolf", matches[1]);
+
+    trie_destroy_checked(test, mapped);
+}
+
+void test_destroy_builder_does_not_leak_memory(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_builder_t* builder;
+    trie_options_t options = { 0U, true, false };
+    if (trie_builder_create(&builder, &options) != TRIE_SUCCESS) {
+        CuFail(test, "trie_builder_create failed");
+    }
+    trie_builder_add_word(builder, "aardvark");
+    trie_builder_add_word(builder, "aardwolf");
+    trie_builder_add_word(builder, "wolf");
+
+    trie_builder_destroy(builder);
+
+    assert_no_memory_leaks(test);
+}
+
+void test_destroy_built_trie_does_not_leak_memory(CuTest* test) {
+    set_up_memory_leak_detection();
+    const char* words[] = { "aardvark", "aardwolf", "wolf" };
+    trie_t* trie = trie_build_from_sorted_checked(test, words, 3U);
+
+    trie_destroy_checked(test, trie);
+
+    assert_no_memory_leaks(test);
+}
+
+trie_t* trie_freeze_to_dawg_checked(CuTest* test, trie_t* trie) {
+    trie_t* dawg;
+
+    if (trie_freeze_to_dawg(trie, &dawg) != TRIE_SUCCESS) {
+        CuFail(test, "trie_freeze_to_dawg failed");
+    }
+    trie_destroy_checked(test, trie);
+
+    return dawg;
+}
+
+size_t trie_count_prefix_checked(CuTest* test, trie_t* trie,
+    const char* prefix) {
+
+    size_t word_count;
+
+    if (trie_count_prefix(trie, prefix, &word_count) != TRIE_SUCCESS) {
+        CuFail(test, "trie_count_prefix failed");
+    }
+
+    return word_count;
+}
+
+void test_count_prefix(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "aardwolf");
+    trie_add_word_checked(test, trie, "aard");
+    trie_add_word_checked(test, trie, "wolf");
+
+    CuAssertIntEquals(test, 3U, trie_count_prefix_checked(test, trie, "a"));
+    CuAssertIntEquals(test, 1U,
+        trie_count_prefix_checked(test, trie, "aardv"));
+    CuAssertIntEquals(test, 0U, trie_count_prefix_checked(test, trie, "b"));
+
+    trie_t* mapped = trie_save_and_open_mapped_checked(test, trie);
+
+    CuAssertIntEquals(test, 3U, trie_count_prefix_checked(test, mapped, "aa"));
+    CuAssertIntEquals(test, 1U, trie_count_prefix_checked(test, mapped, "w"));
+
+    trie_destroy_checked(test, mapped);
+}
+
+void test_count_prefix_empty_prefix_fails(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    size_t word_count;
+
+    trie_result_t count_result = trie_count_prefix(trie, "", &word_count);
+
+    CuAssertIntEquals(test, TRIE_PREFIX_EMPTY, count_result);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_dawg_contains_words(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "walking");
+    trie_add_word_checked(test, trie, "talking");
+    trie_add_word_checked(test, trie, "talk");
+    trie_add_word_checked(test, trie, "walked");
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, trie);
+
+    assert_trie_contains_word(test, dawg, "walking");
+    assert_trie_contains_word(test, dawg, "talking");
+    assert_trie_contains_word(test, dawg, "talk");
+    assert_trie_contains_word(test, dawg, "walked");
+    assert_trie_does_not_contain_word(test, dawg, "walk");
+    assert_trie_does_not_contain_word(test, dawg, "talked");
+    assert_trie_does_not_contain_word(test, dawg, "talkings");
+
+    trie_destroy_checked(test, dawg);
+}
+
+void test_dawg_first_state_leaf(CuTest* test) {
+    // The first state built is the leaf ending "a", which has no transitions,
+    // and the leaves ending the other words are found equal to it
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "a");
+    trie_add_word_checked(test, trie, "b");
+    trie_add_word_checked(test, trie, "ca");
+    trie_add_word_checked(test, trie, "cb");
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, trie);
+
+    assert_trie_contains_word(test, dawg, "a");
+    assert_trie_contains_word(test, dawg, "b");
+    assert_trie_contains_word(test, dawg, "ca");
+    assert_trie_contains_word(test, dawg, "cb");
+    assert_trie_does_not_contain_word(test, dawg, "c");
+    assert_trie_does_not_contain_word(test, dawg, "cc");
+    CuAssertIntEquals(test, 2U, trie_count_prefix_checked(test, dawg, "c"));
+
+    trie_destroy_checked(test, dawg);
+}
+
+void test_dawg_copy_prefix_matches(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "wolf");
+    trie_add_word_checked(test, trie, "aardwolf");
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, trie);
+
+    const char* words[1];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_WORDS_NOT_STORED,
+        trie_get_words_matching_prefix(dawg, "a", words, 1U, &word_count));
+
+    char buffer[32];
+    size_t spans_length = 3U;
+    trie_word_span_t spans[spans_length];
+    trie_copy_words_matching_prefix_checked(test, dawg, "aard", buffer,
+        sizeof(buffer), spans, spans_length, &word_count);
+
+    CuAssertIntEquals(test, 2U, word_count);
+    CuAssertStrEquals(test, "aardvark", buffer+spans[0].offset);
+    CuAssertStrEquals(test, "aardwolf", buffer+spans[1].offset);
+
+    CuAssertIntEquals(test, 2U, trie_count_prefix_checked(test, dawg, "a"));
+    CuAssertIntEquals(test, 1U, trie_count_prefix_checked(test, dawg, "wo"));
+
+    trie_destroy_checked(test, dawg);
+}
+
+void test_dawg_is_read_only(CuTest* test) {
+    trie_t* dawg =
+        trie_freeze_to_dawg_checked(test, trie_create_checked(test));
+
+    CuAssertIntEquals(test, TRIE_READ_ONLY, trie_add_word(dawg, "word"));
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED,
+        trie_save(dawg, mapped_trie_path));
+
+    trie_t* refrozen;
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED,
+        trie_freeze_to_dawg(dawg, &refrozen));
+
+    trie_destroy_checked(test, dawg);
+}
+
+void test_dawg_contains_many_random_words(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    uint32_t seed = 42U;
+    char word[16];
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+    size_t word_count = trie_count_prefix_checked(test, trie, "a");
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, trie);
+
+    seed = 42U;
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        assert_trie_contains_word(test, dawg, word);
+    }
+    assert_trie_does_not_contain_word(test, dawg, "abcde");
+    CuAssertIntEquals(test, word_count,
+        trie_count_prefix_checked(test, dawg, "a"));
+
+    trie_destroy_checked(test, dawg);
+}
+
+void test_destroy_dawg_does_not_leak_memory(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "walking");
+    trie_add_word_checked(test, trie, "talking");
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, trie);
+    trie_destroy_checked(test, dawg);
+
+    assert_no_memory_leaks(test);
+}
+
+trie_t* trie_freeze_to_double_array_checked(CuTest* test, trie_t* trie) {
+    trie_t* double_array;
+
+    if (trie_freeze_to_double_array(trie, &double_array) != TRIE_SUCCESS) {
+        CuFail(test, "trie_freeze_to_double_array failed");
+    }
+    trie_destroy_checked(test, trie);
+
+    return double_array;
+}
+
+void test_double_array_contains_words(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "aard");
+    trie_add_word_checked(test, trie, "wolf");
+    trie_add_word_checked(test, trie, "aardwolf");
+
+    trie_t* double_array = trie_freeze_to_double_array_checked(test, trie);
+
+    assert_trie_contains_word(test, double_array, "aardvark");
+    assert_trie_contains_word(test, double_array, "aard");
+    assert_trie_contains_word(test, double_array, "wolf");
+    assert_trie_contains_word(test, double_array, "aardwolf");
+    assert_trie_does_not_contain_word(test, double_array, "aar");
+    assert_trie_does_not_contain_word(test, double_array, "aardw");
+    assert_trie_does_not_contain_word(test, double_array, "wolfs");
+    assert_trie_does_not_contain_word(test, double_array, "b");
+
+    trie_destroy_checked(test, double_array);
+}
+
+void test_double_array_contains_with_every_fan_out(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    char word[3] = { 'x', '\0', '\0' };
+    for (int c = 1; c < 256; c++) {
+        word[1] = (char) c;
+        trie_add_word_checked(test, trie, word);
+    }
+
+    trie_t* double_array = trie_freeze_to_double_array_checked(test, trie);
+
+    for (int c = 1; c < 256; c++) {
+        word[1] = (char) c;
+        assert_trie_contains_word(test, double_array, word);
+    }
+    CuAssertIntEquals(test, 255U,
+        trie_count_prefix_checked(test, double_array, "x"));
+
+    trie_destroy_checked(test, double_array);
+}
+
+void test_double_array_copy_prefix_matches(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "wolf");
+    trie_add_word_checked(test, trie, "aardwolf");
+
+    trie_t* double_array = trie_freeze_to_double_array_checked(test, trie);
+
+    char buffer[32];
+    size_t spans_length = 3U;
+    trie_word_span_t spans[spans_length];
+    size_t word_count;
+    trie_copy_words_matching_prefix_checked(test, double_array, "aa",
+        buffer, sizeof(buffer), spans, spans_length, &word_count);
+
+    CuAssertIntEquals(test, 2U, word_count);
+    CuAssertStrEquals(test, "aardvark", buffer+spans[0].offset);
+    CuAssertStrEquals(test, "aardwolf", buffer+spans[1].offset);
+
+    trie_destroy_checked(test, double_array);
+}
+
+void test_double_array_is_read_only(CuTest* test) {
+    trie_t* double_array =
+        trie_freeze_to_double_array_checked(test, trie_create_checked(test));
+
+    CuAssertIntEquals(test, TRIE_READ_ONLY,
+        trie_add_word(double_array, "word"));
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED,
+        trie_save(double_array, mapped_trie_path));
+
+    trie_destroy_checked(test, double_array);
+}
+
+void test_double_array_contains_many_random_words(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    uint32_t seed = 42U;
+    char word[16];
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+    size_t word_count = trie_count_prefix_checked(test, trie, "b");
+
+    trie_t* double_array = trie_freeze_to_double_array_checked(test, trie);
+
+    seed = 42U;
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        assert_trie_contains_word(test, double_array, word);
+    }
+    assert_trie_does_not_contain_word(test, double_array, "abcde");
+    CuAssertIntEquals(test, word_count,
+        trie_count_prefix_checked(test, double_array, "b"));
+
+    trie_destroy_checked(test, double_array);
+}
+
+void test_destroy_double_array_does_not_leak_memory(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "aardwolf");
+
+    trie_t* double_array = trie_freeze_to_double_array_checked(test, trie);
+    trie_destroy_checked(test, double_array);
+
+    assert_no_memory_leaks(test);
+}
+
+trie_t* trie_freeze_to_louds_checked(CuTest* test, trie_t* trie) {
+    trie_t* louds;
+
+    if (trie_freeze_to_louds(trie, &louds) != TRIE_SUCCESS) {
+        CuFail(test, "trie_freeze_to_louds failed");
+    }
+    trie_destroy_checked(test, trie);
+
+    return louds;
+}
+
+void test_louds_contains_words(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "aard");
+    trie_add_word_checked(test, trie, "wolf");
+    trie_add_word_checked(test, trie, "aardwolf");
+
+    trie_t* louds = trie_freeze_to_louds_checked(test, trie);
+
+    assert_trie_contains_word(test, louds, "aardvark");
+    assert_trie_contains_word(test, louds, "aard");
+    assert_trie_contains_word(test, louds, "wolf");
+    assert_trie_contains_word(test, louds, "aardwolf");
+    assert_trie_does_not_contain_word(test, louds, "aar");
+    assert_trie_does_not_contain_word(test, louds, "aardw");
+    assert_trie_does_not_contain_word(test, louds, "wolfs");
+    assert_trie_does_not_contain_word(test, louds, "b");
+    CuAssertIntEquals(test, 3U, trie_count_prefix_checked(test, louds, "aa"));
+
+    trie_destroy_checked(test, louds);
+}
+
+void test_louds_copy_prefix_matches(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "wolf");
+    trie_add_word_checked(test, trie, "aardwolf");
+    trie_add_word_checked(test, trie, "aa");
+
+    trie_t* louds = trie_freeze_to_louds_checked(test, trie);
+
+    char buffer[32];
+    size_t spans_length = 3U;
+    trie_word_span_t spans[spans_length];
+    size_t word_count;
+    trie_copy_words_matching_prefix_checked(test, louds, "aa",
+        buffer, sizeof(buffer), spans, spans_length, &word_count);
+
+    CuAssertIntEquals(test, 3U, word_count);
+    CuAssertStrEquals(test, "aa", buffer+spans[0].offset);
+    CuAssertStrEquals(test, "aardvark", buffer+spans[1].offset);
+    CuAssertStrEquals(test, "aardwolf", buffer+spans[2].offset);
+
+    trie_destroy_checked(test, louds);
+}
+
+void test_louds_is_read_only(CuTest* test) {
+    trie_t* louds =
+        trie_freeze_to_louds_checked(test, trie_create_checked(test));
+
+    assert_trie_does_not_contain_word(test, louds, "word");
+    CuAssertIntEquals(test, TRIE_READ_ONLY, trie_add_word(louds, "word"));
+
+    trie_t* copy;
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED,
+        trie_freeze_to_louds(louds, &copy));
+
+    trie_destroy_checked(test, louds);
+}
+
+void test_louds_contains_many_random_words(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    uint32_t seed = 42U;
+    char word[16];
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+    size_t word_count = trie_count_prefix_checked(test, trie, "b");
+
+    trie_t* louds = trie_freeze_to_louds_checked(test, trie);
+
+    seed = 42U;
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        assert_trie_contains_word(test, louds, word);
+    }
+    assert_trie_does_not_contain_word(test, louds, "abcde");
+    CuAssertIntEquals(test, word_count,
+        trie_count_prefix_checked(test, louds, "b"));
+
+    trie_destroy_checked(test, louds);
+}
+
+void test_save_and_open_mapped_louds(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    uint32_t seed = 7U;
+    char word[16];
+    for (size_t i = 0U; i < 1000U; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+
+    trie_t* mapped = trie_save_and_open_mapped_checked(test,
+        trie_freeze_to_louds_checked(test, trie));
+
+    seed = 7U;
+    for (size_t i = 0U; i < 1000U; i++) {
+        make_random_word(&seed, word);
+        assert_trie_contains_word(test, mapped, word);
+    }
+    assert_trie_does_not_contain_word(test, mapped, "abcde");
+    CuAssertIntEquals(test, TRIE_READ_ONLY, trie_add_word(mapped, "word"));
+
+    trie_destroy_checked(test, mapped);
+}
+
+void test_open_corrupted_louds_file_fails(CuTest* test) {
+    // The bits of a LOUDS file follow its 32 byte header
+    uint64_t bits = 0U;
+    CuAssertIntEquals(test, TRIE_FILE_INVALID, trie_open_corrupted(test,
+        trie_freeze_to_louds_checked(test,
+        trie_create_with_words_checked(test)), 32U, &bits, sizeof(bits)));
+
+    bits = ~(uint64_t) 0U;
+    CuAssertIntEquals(test, TRIE_FILE_INVALID, trie_open_corrupted(test,
+        trie_freeze_to_louds_checked(test,
+        trie_create_with_words_checked(test)), 32U, &bits, sizeof(bits)));
+}
+
+void test_destroy_louds_does_not_leak_memory(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "aardwolf");
+
+    trie_t* louds = trie_freeze_to_louds_checked(test, trie);
+    trie_destroy_checked(test, louds);
+
+    assert_no_memory_leaks(test);
+}
+
+void trie_add_weighted_word_checked(CuTest* test, trie_t* trie,
+    const char* word, uint32_t weight) {
+
+    if (trie_add_weighted_word(trie, word, weight) != TRIE_SUCCESS) {
+        CuFail(test, "trie_add_weighted_word failed");
+    }
+}
+
+void trie_top_k_matching_prefix_checked(CuTest* test, trie_t* trie,
+    const char* prefix, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, uint32_t* weights, size_t k,
+    size_t* word_count) {
+
+    if (trie_top_k_matching_prefix(trie, prefix, buffer, buffer_length, spans,
+        weights, k, word_count) != TRIE_SUCCESS) {
+        CuFail(test, "trie_top_k_matching_prefix failed");
+    }
+}
+
+void test_top_k_prefix_matches(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_weighted_word_checked(test, trie, "tea", 5U);
+    trie_add_weighted_word_checked(test, trie, "ten", 20U);
+    trie_add_weighted_word_checked(test, trie, "tent", 8U);
+    trie_add_weighted_word_checked(test, trie, "te", 1U);
+    trie_add_weighted_word_checked(test, trie, "to", 50U);
+    trie_add_word_checked(test, trie, "tell");
+
+    char buffer[32];
+    trie_word_span_t spans[3];
+    uint32_t weights[3];
+    size_t word_count;
+    trie_top_k_matching_prefix_checked(test, trie, "te", buffer,
+        sizeof(buffer), spans, weights, 3U, &word_count);
+
+    CuAssertIntEquals(test, 3U, word_count);
+    CuAssertStrEquals(test, "ten", buffer+spans[0].offset);
+    CuAssertIntEquals(test, 20U, weights[0]);
+    CuAssertStrEquals(test, "tent", buffer+spans[1].offset);
+    CuAssertIntEquals(test, 8U, weights[1]);
+    CuAssertStrEquals(test, "tea", buffer+spans[2].offset);
+    CuAssertIntEquals(test, 5U, weights[2]);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_top_k_prefix_matches_ending_within_edge(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_weighted_word_checked(test, trie, "aardvark", 1U);
+    trie_add_weighted_word_checked(test, trie, "aardwolf", 2U);
+
+    char buffer[32];
+    trie_word_span_t spans[2];
+    size_t word_count;
+    trie_top_k_matching_prefix_checked(test, trie, "aa", buffer,
+        sizeof(buffer), spans, NULL, 2U, &word_count);
+
+    CuAssertIntEquals(test, 2U, word_count);
+    CuAssertStrEquals(test, "aardwolf", buffer+spans[0].offset);
+    CuAssertStrEquals(test, "aardvark", buffer+spans[1].offset);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_top_k_after_lowering_weight(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_weighted_word_checked(test, trie, "tea", 5U);
+    trie_add_weighted_word_checked(test, trie, "ten", 20U);
+    trie_add_weighted_word_checked(test, trie, "ten", 2U);
+
+    char buffer[32];
+    trie_word_span_t spans[1];
+    uint32_t weights[1];
+    size_t word_count;
+    trie_top_k_matching_prefix_checked(test, trie, "t", buffer,
+        sizeof(buffer), spans, weights, 1U, &word_count);
+
+    CuAssertIntEquals(test, 1U, word_count);
+    CuAssertStrEquals(test, "tea", buffer+spans[0].offset);
+    CuAssertIntEquals(test, 5U, weights[0]);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_top_k_keeps_weights_when_splitting_edges(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_weighted_word_checked(test, trie, "romane", 9U);
+    trie_add_word_checked(test, trie, "romulus");
+    trie_add_word_checked(test, trie, "rubens");
+
+    char buffer[32];
+    trie_word_span_t spans[1];
+    size_t word_count;
+    trie_top_k_matching_prefix_checked(test, trie, "r", buffer,
+        sizeof(buffer), spans, NULL, 1U, &word_count);
+
+    CuAssertIntEquals(test, 1U, word_count);
+    CuAssertStrEquals(test, "romane", buffer+spans[0].offset);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_top_k_on_read_only_trie_fails(CuTest* test) {
+    trie_t* dawg =
+        trie_freeze_to_dawg_checked(test, trie_create_checked(test));
+    char buffer[8];
+    trie_word_span_t spans[1];
+    size_t word_count;
+
+    trie_result_t top_k_result = trie_top_k_matching_prefix(dawg, "a", buffer,
+        sizeof(buffer), spans, NULL, 1U, &word_count);
+
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED, top_k_result);
+
+    trie_destroy_checked(test, dawg);
+}
+
+trie_cursor_t* trie_cursor_open_checked(CuTest* test, trie_t* trie,
+    const char* prefix, void* memory, size_t memory_length) {
+
+    trie_cursor_t* cursor;
+
+    if (trie_cursor_open(trie, prefix, 15U, memory, memory_length, &cursor) !=
+        TRIE_SUCCESS) {
+        CuFail(test, "trie_cursor_open failed");
+    }
+
+    return cursor;
+}
+
+const char* trie_cursor_next_checked(CuTest* test, trie_cursor_t* cursor) {
+    const char* word;
+
+    if (trie_cursor_next(cursor, &word) != TRIE_SUCCESS) {
+        CuFail(test, "trie_cursor_next failed");
+    }
+
+    return word;
+}
+
+trie_t* trie_create_for_cursor_checked(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "wolf");
+    trie_add_word_checked(test, trie, "aardwolf");
+    trie_add_word_checked(test, trie, "aardvark");
+    trie_add_word_checked(test, trie, "aard");
+    trie_add_word_checked(test, trie, "ant");
+    trie_add_word_checked(test, trie, "anteater");
+
+    return trie;
+}
+
+void test_cursor_visits_words_in_order(CuTest* test) {
+    trie_t* trie = trie_create_for_cursor_checked(test);
+    long long memory[128];
+    trie_cursor_t* cursor =
+        trie_cursor_open_checked(test, trie, "a", memory, sizeof(memory));
+
+    CuAssertStrEquals(test, "aard", trie_cursor_next_checked(test, cursor));
+    CuAssertStrEquals(test, "aardvark",
+        trie_cursor_next_checked(test, cursor));
+    CuAssertStrEquals(test, "aardwolf",
+        trie_cursor_next_checked(test, cursor));
+    CuAssertStrEquals(test, "ant", trie_cursor_next_checked(test, cursor));
+    CuAssertStrEquals(test, "anteater",
+        trie_cursor_next_checked(test, cursor));
+    CuAssertPtrEquals(test, NULL,
+        (void*) trie_cursor_next_checked(test, cursor));
+
+    trie_cursor_close(cursor);
+    trie_destroy_checked(test, trie);
+}
+
+void test_cursor_with_prefix_ending_within_edge(CuTest* test) {
+    trie_t* trie = trie_create_for_cursor_checked(test);
+    long long memory[128];
+    trie_cursor_t* cursor =
+        trie_cursor_open_checked(test, trie, "aardw", memory, sizeof(memory));
+
+    CuAssertStrEquals(test, "aardwolf",
+        trie_cursor_next_checked(test, cursor));
+    CuAssertPtrEquals(test, NULL,
+        (void*) trie_cursor_next_checked(test, cursor));
+
+    cursor = trie_cursor_open_checked(test, trie, "b", memory, sizeof(memory));
+
+    CuAssertPtrEquals(test, NULL,
+        (void*) trie_cursor_next_checked(test, cursor));
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_cursor_seek(CuTest* test) {
+    trie_t* trie = trie_create_for_cursor_checked(test);
+    long long memory[128];
+    trie_cursor_t* cursor =
+        trie_cursor_open_checked(test, trie, "", memory, sizeof(memory));
+
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_cursor_seek(cursor, "aardw"));
+    CuAssertStrEquals(test, "aardwolf",
+        trie_cursor_next_checked(test, cursor));
+    CuAssertStrEquals(test, "ant", trie_cursor_next_checked(test, cursor));
+
+    trie_cursor_seek(cursor, "aardvark");
+    CuAssertStrEquals(test, "aardvark",
+        trie_cursor_next_checked(test, cursor));
+
+    trie_cursor_seek(cursor, "aardvarks");
+    CuAssertStrEquals(test, "aardwolf",
+        trie_cursor_next_checked(test, cursor));
+
+    trie_cursor_seek(cursor, "aardz");
+    CuAssertStrEquals(test, "ant", trie_cursor_next_checked(test, cursor));
+
+    trie_cursor_seek(cursor, "b");
+    CuAssertStrEquals(test, "wolf", trie_cursor_next_checked(test, cursor));
+
+    trie_cursor_seek(cursor, "wolfs");
+    CuAssertPtrEquals(test, NULL,
+        (void*) trie_cursor_next_checked(test, cursor));
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_cursor_seek_outside_prefix(CuTest* test) {
+    trie_t* trie = trie_create_for_cursor_checked(test);
+    long long memory[128];
+    trie_cursor_t* cursor =
+        trie_cursor_open_checked(test, trie, "an", memory, sizeof(memory));
+
+    trie_cursor_seek(cursor, "a");
+    CuAssertStrEquals(test, "ant", trie_cursor_next_checked(test, cursor));
+
+    trie_cursor_seek(cursor, "b");
+    CuAssertPtrEquals(test, NULL,
+        (void*) trie_cursor_next_checked(test, cursor));
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_cursor_memory_too_small_fails(CuTest* test) {
+    trie_t* trie = trie_create_for_cursor_checked(test);
+    long long memory[128];
+    trie_cursor_t* cursor;
+
+    trie_result_t open_result = trie_cursor_open(trie, "a", 15U, memory,
+        trie_cursor_size(15U)-1, &cursor);
+
+    CuAssertIntEquals(test, TRIE_CURSOR_MEMORY_TOO_SMALL, open_result);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_cursor_word_too_long_fails(CuTest* test) {
+    trie_t* trie = trie_create_for_cursor_checked(test);
+    long long memory[128];
+    trie_cursor_t* cursor;
+    trie_cursor_open(trie, "a", 4U, memory, sizeof(memory), &cursor);
+    const char* word;
+
+    CuAssertStrEquals(test, "aard", trie_cursor_next_checked(test, cursor));
+    CuAssertIntEquals(test, TRIE_WORD_TOO_LONG,
+        trie_cursor_next(cursor, &word));
+    CuAssertIntEquals(test, TRIE_WORD_TOO_LONG,
+        trie_cursor_next(cursor, &word));
+    CuAssertStrEquals(test, "ant", trie_cursor_next_checked(test, cursor));
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_cursor_does_not_allocate_memory(CuTest* test) {
+    trie_t* trie = trie_create_for_cursor_checked(test);
+    long long memory[128];
+    set_up_memory_leak_detection();
+
+    trie_cursor_t* cursor =
+        trie_cursor_open_checked(test, trie, "a", memory, sizeof(memory));
+    trie_cursor_seek(cursor, "aardw");
+    while (trie_cursor_next_checked(test, cursor) != NULL) {
+    }
+    trie_cursor_close(cursor);
+
+    CuAssertIntEquals(test, 0, currently_allocated_memory);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_cursor_visits_many_random_words_in_order(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    uint32_t seed = 42U;
+    char word[16];
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+
+    long long memory[128];
+    trie_cursor_t* cursor =
+        trie_cursor_open_checked(test, trie, "", memory, sizeof(memory));
+    char previous[16] = "";
+    size_t word_count = 0U;
+    const char* next;
+    while ((next = trie_cursor_next_checked(test, cursor)) != NULL) {
+        CuAssertTrue(test, strcmp(previous, next) < 0);
+        strcpy(previous, next);
+        word_count++;
+    }
+
+    CuAssertIntEquals(test, trie_count_prefix_checked(test, trie, "a") +
+        trie_count_prefix_checked(test, trie, "b") +
+        trie_count_prefix_checked(test, trie, "c") +
+        trie_count_prefix_checked(test, trie, "d"), word_count);
+
+    trie_destroy_checked(test, trie);
+}
+
+trie_t* trie_create_concurrent_checked(CuTest* test) {
+    trie_t* trie;
+    trie_options_t options = { 0U, true, true };
+
+    if (trie_create_with_options(&trie, &options) != TRIE_SUCCESS) {
+        CuFail(test, "trie_create_with_options failed");
+    }
+
+    return trie;
+}
+
+void test_concurrent_trie_contains_many_random_words(CuTest* test) {
+    trie_t* trie = trie_create_concurrent_checked(test);
+    uint32_t seed = 42U;
+    char word[16];
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+
+    seed = 42U;
+    for (size_t i = 0U; i < 2000U; i++) {
+        make_random_word(&seed, word);
+        assert_trie_contains_word(test, trie, word);
+    }
+    assert_trie_does_not_contain_word(test, trie, "abcde");
+
+    long long memory[128];
+    trie_cursor_t* cursor =
+        trie_cursor_open_checked(test, trie, "a", memory, sizeof(memory));
+    size_t word_count = 0U;
+    while (trie_cursor_next_checked(test, cursor) != NULL) {
+        word_count++;
+    }
+    trie_cursor_close(cursor);
+    CuAssertIntEquals(test, trie_count_prefix_checked(test, trie, "a"),
+        word_count);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_destroy_concurrent_trie_does_not_leak_memory(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_concurrent_checked(test);
+    uint32_t seed = 42U;
+    char word[16];
+    for (size_t i = 0U; i < 500U; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+
+    trie_destroy_checked(test, trie);
+
+    assert_no_memory_leaks(test);
+}
+
+#define CONCURRENT_READERS 4U
+#define CONCURRENT_PRELOADED_WORDS 1000U
+#define CONCURRENT_ADDED_WORDS 20000U
+
+typedef struct {
+    trie_t* trie;
+    bool done;
+    size_t failures;
+} concurrent_test_t;
+
+// Checks the preloaded words over and over until the writer is done
+void* read_preloaded_words(void* argument) {
+    concurrent_test_t* concurrent_test = argument;
+    size_t failures = 0U;
+    char word[16];
+    while (!__atomic_load_n(&(concurrent_test->done), __ATOMIC_ACQUIRE)) {
+        uint32_t seed = 42U;
+        for (size_t i = 0U; i < CONCURRENT_PRELOADED_WORDS; i++) {
+            make_random_word(&seed, word);
+            bool contains;
+            if (trie_contains_word(concurrent_test->trie, word, &contains) !=
+                TRIE_SUCCESS || !contains) {
+                failures++;
+            }
+        }
+    }
+
+    __atomic_fetch_add(&(concurrent_test->failures), failures,
+        __ATOMIC_RELAXED);
+
+    return NULL;
+}
+
+void test_concurrent_readers_while_adding_words(CuTest* test) {
+    concurrent_test_t concurrent_test = {
+        trie_create_concurrent_checked(test), false, 0U
+    };
+    uint32_t seed = 42U;
+    char word[16];
+    for (size_t i = 0U; i < CONCURRENT_PRELOADED_WORDS; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, concurrent_test.trie, word);
+    }
+
+    pthread_t readers[CONCURRENT_READERS];
+    for (size_t i = 0U; i < CONCURRENT_READERS; i++) {
+        CuAssertIntEquals(test, 0, pthread_create(&readers[i], NULL,
+            read_preloaded_words, &concurrent_test));
+    }
+
+    // Edges are split and children replaced all over the trie while it is
+    // being read
+    for (size_t i = 0U; i < CONCURRENT_ADDED_WORDS; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, concurrent_test.trie, word);
+    }
+    __atomic_store_n(&(concurrent_test.done), true, __ATOMIC_RELEASE);
+
+    for (size_t i = 0U; i < CONCURRENT_READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+
+    CuAssertIntEquals(test, 0U, concurrent_test.failures);
+
+    trie_destroy_checked(test, concurrent_test.trie);
+}
+
+#define CONCURRENT_WRITERS 4U
+#define CONCURRENT_WRITER_WORDS 5000U
+
+typedef struct {
+    trie_t* trie;
+    uint32_t seed;
+    size_t failures;
+} concurrent_writer_t;
+
+// Adds random words from the seed of the writer, several writers adding many
+// of the same words
+void* add_random_words(void* argument) {
+    concurrent_writer_t* writer = argument;
+    uint32_t seed = writer->seed;
+    char word[16];
+    for (size_t i = 0U; i < CONCURRENT_WRITER_WORDS; i++) {
+        make_random_word(&seed, word);
+        if (trie_add_weighted_word(writer->trie, word, (uint32_t) i) !=
+            TRIE_SUCCESS) {
+            writer->failures++;
+        }
+    }
+
+    return NULL;
+}
+
+void test_concurrent_writers_add_every_word(CuTest* test) {
+    trie_t* trie = trie_create_concurrent_checked(test);
+    trie_t* expected = trie_create_checked(test);
+    concurrent_writer_t writers[CONCURRENT_WRITERS];
+    pthread_t threads[CONCURRENT_WRITERS];
+    for (size_t i = 0U; i < CONCURRENT_WRITERS; i++) {
+        writers[i].trie = trie;
+        writers[i].seed = (uint32_t) (i % 2U);
+        writers[i].failures = 0U;
+        CuAssertIntEquals(test, 0, pthread_create(&threads[i], NULL,
+            add_random_words, &writers[i]));
+    }
+    for (size_t i = 0U; i < CONCURRENT_WRITERS; i++) {
+        pthread_join(threads[i], NULL);
+        CuAssertIntEquals(test, 0U, writers[i].failures);
+    }
+
+    char word[16];
+    for (uint32_t seed = 0U; seed < 2U; seed++) {
+        uint32_t state = seed;
+        for (size_t i = 0U; i < CONCURRENT_WRITER_WORDS; i++) {
+            make_random_word(&state, word);
+            assert_trie_contains_word(test, trie, word);
+            trie_add_word_checked(test, expected, word);
+        }
+    }
+
+    const char* prefixes[] = { "a", "b", "c", "d", "ab", "dcb" };
+    for (size_t i = 0U; i < sizeof(prefixes)/sizeof(prefixes[0]); i++) {
+        CuAssertIntEquals(test,
+            trie_count_prefix_checked(test, expected, prefixes[i]),
+            trie_count_prefix_checked(test, trie, prefixes[i]));
+    }
+
+    // Greatest weights left too low by racing writers would bring words out
+    // of order
+    static char buffer[CONCURRENT_WRITER_WORDS * 16U];
+    static trie_word_span_t spans[CONCURRENT_WRITER_WORDS];
+    static uint32_t weights[CONCURRENT_WRITER_WORDS];
+    size_t word_count;
+    trie_top_k_matching_prefix_checked(test, trie, "b", buffer,
+        sizeof(buffer), spans, weights, CONCURRENT_WRITER_WORDS, &word_count);
+    CuAssertIntEquals(test, trie_count_prefix_checked(test, trie, "b"),
+        word_count);
+    for (size_t i = 1U; i < word_count; i++) {
+        CuAssertTrue(test, weights[i-1] >= weights[i]);
+    }
+
+    trie_destroy_checked(test, expected);
+    trie_destroy_checked(test, trie);
+}
+
+void assert_batch_matches_single_lookups(CuTest* test, trie_t* trie,
+    const char** words, size_t n) {
+
+    bool contains[64];
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_contains_words_batch(trie, words, n, contains));
+    for (size_t i = 0U; i < n; i++) {
+        bool single_contains;
+        trie_contains_word_checked(test, trie, words[i], &single_contains);
+        CuAssert(test, words[i], contains[i] == single_contains);
+    }
+}
+
+void test_contains_words_batch(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    uint32_t seed = 42U;
+    char added[40][16];
+    for (size_t i = 0U; i < 40U; i++) {
+        make_random_word(&seed, added[i]);
+        trie_add_word_checked(test, trie, added[i]);
+    }
+
+    // Words added, words not added, prefixes of words and an empty word
+    char missing[20][16];
+    const char* words[64];
+    size_t n = 0U;
+    for (size_t i = 0U; i < 40U; i++) {
+        words[n++] = added[i];
+    }
+    for (size_t i = 0U; i < 20U; i++) {
+        make_random_word(&seed, missing[i]);
+        words[n++] = missing[i];
+    }
+    words[n++] = "";
+    words[n++] = "abcdabcdabcdabcd";
+
+    assert_batch_matches_single_lookups(test, trie, words, n);
+
+    bool contains[64];
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_contains_words_batch(trie, words, 40U, contains));
+    for (size_t i = 0U; i < 40U; i++) {
+        CuAssertTrue(test, contains[i]);
+    }
+
+    trie_t* dawg;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_freeze_to_dawg(trie, &dawg));
+    assert_batch_matches_single_lookups(test, dawg, words, n);
+    trie_destroy_checked(test, dawg);
+
+    trie_t* double_array = trie_freeze_to_double_array_checked(test, trie);
+    assert_batch_matches_single_lookups(test, double_array, words, n);
+
+    trie_destroy_checked(test, double_array);
+}
+
+void test_contains_words_batch_with_null_word_fails(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    const char* words[] = { "word", NULL };
+    bool contains[2];
+
+    CuAssertIntEquals(test, TRIE_NULL,
+        trie_contains_words_batch(NULL, words, 2U, contains));
+    CuAssertIntEquals(test, TRIE_WORD_NULL,
+        trie_contains_words_batch(trie, words, 2U, contains));
+    CuAssertIntEquals(test, TRIE_WORD_NULL,
+        trie_contains_words_batch(trie, NULL, 2U, contains));
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_contains_words_batch(trie, NULL, 0U, contains));
+
+    trie_destroy_checked(test, trie);
+}
+
+void trie_remove_word_checked(CuTest* test, trie_t* trie, const char* word) {
+    if (trie_remove_word(trie, word) != TRIE_SUCCESS) {
+        CuFail(test, "trie_remove_word failed");
+    }
+}
+
+void test_remove_word(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "tea");
+    trie_add_word_checked(test, trie, "ten");
+    trie_add_word_checked(test, trie, "tent");
+    trie_add_word_checked(test, trie, "to");
+
+    trie_remove_word_checked(test, trie, "ten");
+    assert_trie_does_not_contain_word(test, trie, "ten");
+    assert_trie_contains_word(test, trie, "tent");
+
+    trie_remove_word_checked(test, trie, "tent");
+    trie_remove_word_checked(test, trie, "t");
+    trie_remove_word_checked(test, trie, "tents");
+    assert_trie_does_not_contain_word(test, trie, "tent");
+    assert_trie_contains_word(test, trie, "tea");
+    assert_trie_contains_word(test, trie, "to");
+    CuAssertIntEquals(test, 2U, trie_count_prefix_checked(test, trie, "t"));
+
+    const char* words[4];
+    size_t word_count;
+    trie_get_words_matching_prefix(trie, "te", words, 4U, &word_count);
+    CuAssertIntEquals(test, 1U, word_count);
+    CuAssertStrEquals(test, "tea", words[0]);
+
+    trie_add_word_checked(test, trie, "ten");
+    assert_trie_contains_word(test, trie, "ten");
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_remove_word_with_every_fan_out(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    char word[3] = { 'a', '\0', '\0' };
+    for (unsigned byte = 1U; byte < 256U; byte++) {
+        word[1] = (char) byte;
+        trie_add_word_checked(test, trie, word);
+    }
+
+    // Removes children from each class in turn as the fan-out shrinks
+    for (unsigned byte = 255U; byte > 2U; byte--) {
+        word[1] = (char) ((byte * 7U) % 255U + 1U);
+        trie_remove_word_checked(test, trie, word);
+        assert_trie_does_not_contain_word(test, trie, word);
+        CuAssertIntEquals(test, byte-1U,
+            trie_count_prefix_checked(test, trie, "a"));
+    }
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_remove_many_random_words(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    uint32_t seed = 42U;
+    char words[1000][16];
+    for (size_t i = 0U; i < 1000U; i++) {
+        make_random_word(&seed, words[i]);
+        trie_add_word_checked(test, trie, words[i]);
+    }
+
+    for (size_t i = 1U; i < 1000U; i += 2U) {
+        trie_remove_word_checked(test, trie, words[i]);
+    }
+
+    for (size_t i = 0U; i < 1000U; i += 2U) {
+        bool removed = false;
+        for (size_t j = 1U; j < 1000U; j += 2U) {
+            removed = removed || strcmp(words[i], words[j]) == 0;
+        }
+        bool contains;
+        trie_contains_word_checked(test, trie, words[i], &contains);
+        CuAssert(test, words[i], contains != removed);
+    }
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_remove_weighted_word(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_weighted_word_checked(test, trie, "tea", 5U);
+    trie_add_weighted_word_checked(test, trie, "to", 50U);
+
+    trie_remove_word_checked(test, trie, "to");
+
+    char buffer[16];
+    trie_word_span_t spans[1];
+    uint32_t weights[1];
+    size_t word_count;
+    trie_top_k_matching_prefix_checked(test, trie, "t", buffer,
+        sizeof(buffer), spans, weights, 1U, &word_count);
+    CuAssertIntEquals(test, 1U, word_count);
+    CuAssertStrEquals(test, "tea", buffer + spans[0].offset);
+    CuAssertIntEquals(test, 5U, weights[0]);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_remove_word_from_concurrent_trie(CuTest* test) {
+    trie_t* trie = trie_create_concurrent_checked(test);
+    trie_add_word_checked(test, trie, "ten");
+    trie_add_word_checked(test, trie, "tent");
+
+    trie_remove_word_checked(test, trie, "ten");
+    assert_trie_does_not_contain_word(test, trie, "ten");
+    assert_trie_contains_word(test, trie, "tent");
+
+    trie_add_word_checked(test, trie, "ten");
+    assert_trie_contains_word(test, trie, "ten");
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED, trie_compact(trie));
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_remove_word_from_read_only_trie_fails(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "word");
+    trie_t* double_array = trie_freeze_to_double_array_checked(test, trie);
+
+    CuAssertIntEquals(test, TRIE_READ_ONLY,
+        trie_remove_word(double_array, "word"));
+    CuAssertIntEquals(test, TRIE_READ_ONLY, trie_compact(double_array));
+
+    trie_destroy_checked(test, double_array);
+}
+
+void test_remove_all_words_and_compact_frees_memory(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_checked(test);
+    int64_t empty_trie_memory = currently_allocated_memory;
+
+    uint32_t seed = 42U;
+    char word[16];
+    for (size_t i = 0U; i < 500U; i++) {
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+    seed = 42U;
+    for (size_t i = 0U; i < 500U; i++) {
+        make_random_word(&seed, word);
+        trie_remove_word_checked(test, trie, word);
+    }
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_compact(trie));
+
+    CuAssertIntEquals(test, empty_trie_memory, currently_allocated_memory);
+
+    trie_destroy_checked(test, trie);
+
+    assert_no_memory_leaks(test);
+}
+
+void test_compact_keeps_words(CuTest* test) {
+    trie_t* tries[2] = {
+        trie_create_checked(test),
+        trie_create_with_arena_checked(test, 64U)
+    };
+    for (size_t t = 0U; t < 2U; t++) {
+        trie_t* trie = tries[t];
+        uint32_t seed = 42U;
+        char words[500][16];
+        for (size_t i = 0U; i < 500U; i++) {
+            make_random_word(&seed, words[i]);
+            trie_add_weighted_word_checked(test, trie, words[i], 1U);
+        }
+        trie_add_weighted_word_checked(test, trie, "dddd", 9U);
+        for (size_t i = 1U; i < 500U; i += 2U) {
+            trie_remove_word_checked(test, trie, words[i]);
+        }
+        size_t word_count = trie_count_prefix_checked(test, trie, "d");
+
+        CuAssertIntEquals(test, TRIE_SUCCESS, trie_compact(trie));
+
+        CuAssertIntEquals(test, word_count,
+            trie_count_prefix_checked(test, trie, "d"));
+        const char* found[1];
+        size_t found_count;
+        trie_get_words_matching_prefix(trie, "dddd", found, 1U, &found_count);
+        CuAssertIntEquals(test, 1U, found_count);
+        CuAssertStrEquals(test, "dddd", found[0]);
+
+        char buffer[16];
+        trie_word_span_t spans[1];
+        trie_top_k_matching_prefix_checked(test, trie, "d", buffer,
+            sizeof(buffer), spans, NULL, 1U, &found_count);
+        CuAssertStrEquals(test, "dddd", buffer + spans[0].offset);
+
+        trie_add_word_checked(test, trie, "abcdabcd");
+        assert_trie_contains_word(test, trie, "abcdabcd");
+        assert_trie_contains_word(test, trie, words[0]);
+
+        trie_destroy_checked(test, trie);
+    }
+}
+
+// Keys holding NUL bytes, in byte order
+const char* binary_keys[] = { "a", "a\0", "a\0\0c", "a\0b", "ab\0" };
+const size_t binary_key_lengths[] = { 1U, 2U, 4U, 3U, 3U };
+#define BINARY_KEY_COUNT 5U
+
+void trie_add_key_checked(CuTest* test, trie_t* trie, const char* key,
+    size_t length) {
+
+    if (trie_add_key(trie, key, length) != TRIE_SUCCESS) {
+        CuFail(test, "trie_add_key failed");
+    }
+}
+
+bool trie_contains_key_checked(CuTest* test, trie_t* trie, const char* key,
+    size_t length) {
+
+    bool contains;
+
+    if (trie_contains_key(trie, key, length, &contains) != TRIE_SUCCESS) {
+        CuFail(test, "trie_contains_key failed");
+    }
+
+    return contains;
+}
+
+trie_t* trie_create_with_binary_keys_checked(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    for (size_t i = 0U; i < BINARY_KEY_COUNT; i++) {
+        trie_add_key_checked(test, trie, binary_keys[i], binary_key_lengths[i]);
+    }
+
+    return trie;
+}
+
+void assert_trie_contains_binary_keys(CuTest* test, trie_t* trie) {
+    for (size_t i = 0U; i < BINARY_KEY_COUNT; i++) {
+        CuAssertTrue(test, trie_contains_key_checked(
+            test, trie, binary_keys[i], binary_key_lengths[i]));
+    }
+    CuAssertTrue(test, !trie_contains_key_checked(test, trie, "a\0c", 3U));
+    CuAssertTrue(test, !trie_contains_key_checked(test, trie, "a\0\0", 3U));
+    CuAssertTrue(test, !trie_contains_key_checked(test, trie, "ab", 2U));
+
+    size_t key_count;
+    trie_count_keys_matching_prefix(trie, "a\0", 2U, &key_count);
+    CuAssertIntEquals(test, 3U, key_count);
+}
+
+void test_keys_with_nul_bytes(CuTest* test) {
+    trie_t* trie = trie_create_with_binary_keys_checked(test);
+
+    assert_trie_contains_binary_keys(test, trie);
+    assert_trie_contains_word(test, trie, "a");
+    assert_trie_does_not_contain_word(test, trie, "ab");
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    size_t key_count;
+    trie_copy_keys_matching_prefix(trie, "a", 1U, buffer, sizeof(buffer),
+        spans, 8U, &key_count);
+    CuAssertIntEquals(test, BINARY_KEY_COUNT, key_count);
+    for (size_t i = 0U; i < BINARY_KEY_COUNT; i++) {
+        CuAssertIntEquals(test, binary_key_lengths[i], spans[i].length);
+        CuAssertTrue(test, memcmp(buffer + spans[i].offset, binary_keys[i],
+            binary_key_lengths[i]) == 0);
+    }
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_remove_and_compact_keys_with_nul_bytes(CuTest* test) {
+    trie_t* tries[2] = {
+        trie_create_checked(test),
+        trie_create_with_arena_checked(test, 64U)
+    };
+    for (size_t t = 0U; t < 2U; t++) {
+        trie_t* trie = tries[t];
+        for (size_t i = 0U; i < BINARY_KEY_COUNT; i++) {
+            trie_add_weighted_key(trie, binary_keys[i], binary_key_lengths[i],
+                (uint32_t) i);
+        }
+        trie_add_key_checked(test, trie, "a\0x", 3U);
+
+        CuAssertIntEquals(test, TRIE_SUCCESS,
+            trie_remove_key(trie, "a\0x", 3U));
+        CuAssertIntEquals(test, TRIE_SUCCESS, trie_compact(trie));
+
+        assert_trie_contains_binary_keys(test, trie);
+        CuAssertTrue(test, !trie_contains_key_checked(test, trie, "a\0x", 3U));
+
+        char buffer[16];
+        trie_word_span_t spans[1];
+        uint32_t weights[1];
+        size_t key_count;
+        trie_top_k_keys_matching_prefix(trie, "a\0", 2U, buffer,
+            sizeof(buffer), spans, weights, 1U, &key_count);
+        CuAssertIntEquals(test, 1U, key_count);
+        CuAssertIntEquals(test, 3U, weights[0]);
+        CuAssertIntEquals(test, 3U, spans[0].length);
+        CuAssertTrue(test, memcmp(buffer, "a\0b", 3U) == 0);
+
+        trie_destroy_checked(test, trie);
+    }
+}
+
+void test_read_only_tries_with_keys_with_nul_bytes(CuTest* test) {
+    trie_t* mapped = trie_save_and_open_mapped_checked(test,
+        trie_create_with_binary_keys_checked(test));
+    assert_trie_contains_binary_keys(test, mapped);
+    trie_destroy_checked(test, mapped);
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test,
+        trie_create_with_binary_keys_checked(test));
+    assert_trie_contains_binary_keys(test, dawg);
+    trie_destroy_checked(test, dawg);
+
+    trie_t* double_array = trie_freeze_to_double_array_checked(test,
+        trie_create_with_binary_keys_checked(test));
+    assert_trie_contains_binary_keys(test, double_array);
+    trie_destroy_checked(test, double_array);
+
+    trie_t* louds = trie_freeze_to_louds_checked(test,
+        trie_create_with_binary_keys_checked(test));
+    assert_trie_contains_binary_keys(test, louds);
+    trie_destroy_checked(test, louds);
+
+    trie_builder_t* builder;
+    trie_options_t options = { 0U, true, false };
+    if (trie_builder_create(&builder, &options) != TRIE_SUCCESS) {
+        CuFail(test, "trie_builder_create failed");
+    }
+    for (size_t i = 0U; i < BINARY_KEY_COUNT; i++) {
+        CuAssertIntEquals(test, TRIE_SUCCESS, trie_builder_add_key(
+            builder, binary_keys[i], binary_key_lengths[i]));
+    }
+    CuAssertIntEquals(test, TRIE_WORDS_NOT_SORTED,
+        trie_builder_add_key(builder, "a\0", 2U));
+    trie_t* built;
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_builder_finish(builder, &built));
+    assert_trie_contains_binary_keys(test, built);
+    trie_destroy_checked(test, built);
+}
+
+void test_contains_keys_batch(CuTest* test) {
+    const char* keys[] = { "a\0b", "a\0c", "a", "ab\0", "ab" };
+    size_t lengths[] = { 3U, 3U, 1U, 3U, 2U };
+    bool expected[] = { true, false, true, true, false };
+
+    trie_t* trie = trie_create_with_binary_keys_checked(test);
+    trie_t* tries[2] = {
+        trie,
+        trie_freeze_to_double_array_checked(test,
+            trie_create_with_binary_keys_checked(test))
+    };
+    for (size_t t = 0U; t < 2U; t++) {
+        bool contains[5];
+        CuAssertIntEquals(test, TRIE_SUCCESS,
+            trie_contains_keys_batch(tries[t], keys, lengths, 5U, contains));
+        for (size_t i = 0U; i < 5U; i++) {
+            CuAssertIntEquals(test, expected[i], contains[i]);
+        }
+        CuAssertIntEquals(test, TRIE_WORD_NULL,
+            trie_contains_keys_batch(tries[t], keys, NULL, 5U, contains));
+        trie_destroy_checked(test, tries[t]);
+    }
+}
+
+void test_cursor_visits_keys_with_nul_bytes(CuTest* test) {
+    trie_t* trie = trie_create_with_binary_keys_checked(test);
+    size_t memory_length = trie_cursor_size(15U);
+    void* memory = malloc(memory_length);
+
+    trie_cursor_t* cursor;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_cursor_open_key(trie, "a\0", 2U,
+        15U, memory, memory_length, &cursor));
+    const char* key;
+    size_t length;
+    for (size_t i = 1U; i < 4U; i++) {
+        trie_cursor_next_key(cursor, &key, &length);
+        CuAssertIntEquals(test, binary_key_lengths[i], length);
+        CuAssertTrue(test, memcmp(key, binary_keys[i], length) == 0);
+    }
+    trie_cursor_next_key(cursor, &key, &length);
+    CuAssertPtrEquals(test, NULL, (void*) key);
+
+    trie_cursor_seek_key(cursor, "a\0\0", 3U);
+    trie_cursor_next_key(cursor, &key, &length);
+    CuAssertIntEquals(test, 4U, length);
+    CuAssertTrue(test, memcmp(key, "a\0\0c", 4U) == 0);
+
+    trie_cursor_close(cursor);
+    free(memory);
+    trie_destroy_checked(test, trie);
+}
+
+void test_add_empty_key_fails(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+
+    CuAssertIntEquals(test, TRIE_WORD_EMPTY, trie_add_key(trie, "a", 0U));
+    CuAssertIntEquals(test, TRIE_WORD_NULL, trie_add_key(trie, NULL, 1U));
+    CuAssertIntEquals(test, TRIE_NULL, trie_add_key(NULL, "a", 1U));
+    CuAssertTrue(test, !trie_contains_key_checked(test, trie, "a", 0U));
+    size_t key_count;
+    CuAssertIntEquals(test, TRIE_PREFIX_EMPTY,
+        trie_count_keys_matching_prefix(trie, "a", 0U, &key_count));
+
+    trie_destroy_checked(test, trie);
+}
+
+void trie_put_checked(CuTest* test, trie_t* trie, const char* word,
+    void* value) {
+
+    if (trie_put(trie, word, value) != TRIE_SUCCESS) {
+        CuFail(test, "trie_put failed");
+    }
+}
+
+void* trie_get_checked(CuTest* test, trie_t* trie, const char* word) {
+    void* value;
+
+    if (trie_get(trie, word, &value) != TRIE_SUCCESS) {
+        CuFail(test, "trie_get failed");
+    }
+
+    return value;
+}
+
+void test_put_and_get_values(CuTest* test) {
+    int values[3];
+    trie_t* tries[3] = {
+        trie_create_checked(test),
+        trie_create_with_arena_checked(test, 64U),
+        trie_create_concurrent_checked(test)
+    };
+    for (size_t t = 0U; t < 3U; t++) {
+        trie_t* trie = tries[t];
+        trie_put_checked(test, trie, "aardvark", &values[0]);
+        trie_put_checked(test, trie, "aard", &values[1]);
+        trie_add_word_checked(test, trie, "wolf");
+
+        CuAssertPtrEquals(test, &values[0],
+            trie_get_checked(test, trie, "aardvark"));
+        CuAssertPtrEquals(test, &values[1],
+            trie_get_checked(test, trie, "aard"));
+        CuAssertPtrEquals(test, NULL, trie_get_checked(test, trie, "wolf"));
+        assert_trie_contains_word(test, trie, "aardvark");
+
+        void* value = &values[2];
+        CuAssertIntEquals(test, TRIE_NOT_FOUND,
+            trie_get(trie, "aardv", &value));
+        CuAssertIntEquals(test, TRIE_NOT_FOUND, trie_get(trie, "", &value));
+        CuAssertPtrEquals(test, &values[2], value);
+
+        trie_put_checked(test, trie, "aard", &values[2]);
+        trie_add_word_checked(test, trie, "aardvark");
+        CuAssertPtrEquals(test, &values[2],
+            trie_get_checked(test, trie, "aard"));
+        CuAssertPtrEquals(test, &values[0],
+            trie_get_checked(test, trie, "aardvark"));
+
+        trie_remove_word_checked(test, trie, "aard");
+        CuAssertIntEquals(test, TRIE_NOT_FOUND, trie_get(trie, "aard", &value));
+        trie_add_word_checked(test, trie, "aard");
+        CuAssertPtrEquals(test, NULL, trie_get_checked(test, trie, "aard"));
+
+        trie_destroy_checked(test, trie);
+    }
+}
+
+void test_copy_entries_matching_prefix(CuTest* test) {
+    int values[3];
+    trie_t* trie = trie_create_with_arena_checked(test, 64U);
+    trie_put_checked(test, trie, "aardwolf", &values[0]);
+    trie_put_checked(test, trie, "aardvark", &values[1]);
+    trie_put_checked(test, trie, "aard", &values[2]);
+    trie_put_checked(test, trie, "wolf", &values[0]);
+    trie_remove_word_checked(test, trie, "wolf");
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_compact(trie));
+
+    char buffer[64];
+    trie_word_span_t spans[4];
+    void* found_values[4];
+    size_t entry_count;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_copy_entries_matching_prefix(
+        trie, "aar", buffer, sizeof(buffer), spans, found_values, 4U,
+        &entry_count));
+
+    CuAssertIntEquals(test, 3U, entry_count);
+    CuAssertStrEquals(test, "aard", buffer + spans[0].offset);
+    CuAssertPtrEquals(test, &values[2], found_values[0]);
+    CuAssertStrEquals(test, "aardvark", buffer + spans[1].offset);
+    CuAssertPtrEquals(test, &values[1], found_values[1]);
+    CuAssertStrEquals(test, "aardwolf", buffer + spans[2].offset);
+    CuAssertPtrEquals(test, &values[0], found_values[2]);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_values_on_read_only_trie_fail(CuTest* test) {
+    int value;
+    trie_t* trie = trie_create_checked(test);
+    trie_put_checked(test, trie, "aardvark", &value);
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, trie);
+
+    void* found_value;
+    CuAssertIntEquals(test, TRIE_READ_ONLY, trie_put(dawg, "wolf", &value));
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED,
+        trie_get(dawg, "aardvark", &found_value));
+    char buffer[16];
+    trie_word_span_t spans[1];
+    size_t entry_count;
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED,
+        trie_copy_entries_matching_prefix(dawg, "a", buffer, sizeof(buffer),
+            spans, &found_value, 1U, &entry_count));
+
+    trie_destroy_checked(test, dawg);
+}
+
+trie_t* trie_create_for_prefix_matches_checked(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "/api");
+    trie_add_word_checked(test, trie, "/api/users");
+    trie_add_word_checked(test, trie, "/api/users/admin");
+    trie_add_word_checked(test, trie, "/static");
+    trie_add_word_checked(test, trie, "/");
+
+    return trie;
+}
+
+size_t trie_longest_prefix_match_checked(CuTest* test, trie_t* trie,
+    const char* input) {
+
+    size_t match_length;
+
+    if (trie_longest_prefix_match(trie, input, strlen(input), &match_length) !=
+        TRIE_SUCCESS) {
+        CuFail(test, "trie_longest_prefix_match failed");
+    }
+
+    return match_length;
+}
+
+void assert_finds_prefix_matches(CuTest* test, trie_t* trie) {
+    CuAssertIntEquals(test, 10U,
+        trie_longest_prefix_match_checked(test, trie, "/api/users/42"));
+    CuAssertIntEquals(test, 16U,
+        trie_longest_prefix_match_checked(test, trie, "/api/users/admin"));
+    CuAssertIntEquals(test, 4U,
+        trie_longest_prefix_match_checked(test, trie, "/api/user"));
+    CuAssertIntEquals(test, 1U,
+        trie_longest_prefix_match_checked(test, trie, "/stat"));
+    CuAssertIntEquals(test, 0U,
+        trie_longest_prefix_match_checked(test, trie, "api"));
+    CuAssertIntEquals(test, 0U,
+        trie_longest_prefix_match_checked(test, trie, ""));
+
+    size_t match_lengths[4];
+    size_t match_count;
+    const char* input = "/api/users/admin/1";
+    trie_prefix_matches(trie, input, strlen(input), match_lengths, 4U,
+        &match_count);
+    CuAssertIntEquals(test, 4U, match_count);
+    CuAssertIntEquals(test, 1U, match_lengths[0]);
+    CuAssertIntEquals(test, 4U, match_lengths[1]);
+    CuAssertIntEquals(test, 10U, match_lengths[2]);
+    CuAssertIntEquals(test, 16U, match_lengths[3]);
+
+    trie_prefix_matches(trie, input, strlen(input), match_lengths, 2U,
+        &match_count);
+    CuAssertIntEquals(test, 2U, match_count);
+    CuAssertIntEquals(test, 4U, match_lengths[1]);
+
+    // The input need not end in a NUL, so only length bytes are considered
+    trie_prefix_matches(trie, input, 9U, match_lengths, 4U, &match_count);
+    CuAssertIntEquals(test, 2U, match_count);
+}
+
+void test_prefix_matches(CuTest* test) {
+    trie_t* trie = trie_create_for_prefix_matches_checked(test);
+    assert_finds_prefix_matches(test, trie);
+    trie_destroy_checked(test, trie);
+
+    trie_t* mapped = trie_save_and_open_mapped_checked(test,
+        trie_create_for_prefix_matches_checked(test));
+    assert_finds_prefix_matches(test, mapped);
+    trie_destroy_checked(test, mapped);
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test,
+        trie_create_for_prefix_matches_checked(test));
+    assert_finds_prefix_matches(test, dawg);
+    trie_destroy_checked(test, dawg);
+
+    trie_t* double_array = trie_freeze_to_double_array_checked(test,
+        trie_create_for_prefix_matches_checked(test));
+    assert_finds_prefix_matches(test, double_array);
+    trie_destroy_checked(test, double_array);
+
+    trie_t* louds = trie_freeze_to_louds_checked(test,
+        trie_create_for_prefix_matches_checked(test));
+    assert_finds_prefix_matches(test, louds);
+    trie_destroy_checked(test, louds);
+}
+
+void test_prefix_matches_with_invalid_arguments_fail(CuTest* test) {
+    trie_t* trie = trie_create_for_prefix_matches_checked(test);
+    size_t match_lengths[1];
+    size_t match_count;
+
+    CuAssertIntEquals(test, TRIE_NULL,
+        trie_longest_prefix_match(NULL, "/", 1U, &match_count));
+    CuAssertIntEquals(test, TRIE_WORD_NULL,
+        trie_longest_prefix_match(trie, NULL, 1U, &match_count));
+    CuAssertIntEquals(test, TRIE_WORDS_LENGTH_ZERO,
+        trie_prefix_matches(trie, "/", 1U, match_lengths, 0U, &match_count));
+
+    trie_destroy_checked(test, trie);
+}
+
+// The occurrences of words found by a scan
+typedef struct {
+    uint64_t offsets[16];
+    size_t lengths[16];
+    void* values[16];
+    size_t count;
+    uint64_t checksum;
+} scan_matches_t;
+
+void record_scan_match(uint64_t offset, size_t length, void* value,
+    void* context) {
+
+    scan_matches_t* matches = context;
+    if (matches->count < 16U) {
+        matches->offsets[matches->count] = offset;
+        matches->lengths[matches->count] = length;
+        matches->values[matches->count] = value;
+    }
+    matches->count++;
+    matches->checksum += (offset + length) * 2654435761U + length;
+}
+
+trie_automaton_t* trie_automaton_create_checked(CuTest* test, trie_t* trie) {
+    trie_automaton_t* automaton;
+
+    if (trie_automaton_create(trie, &automaton) != TRIE_SUCCESS) {
+        CuFail(test, "trie_automaton_create failed");
+    }
+
+    return automaton;
+}
+
+int scan_values[4];
+
+trie_automaton_t* trie_automaton_create_for_scan_checked(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_put_checked(test, trie, "he", &scan_values[0]);
+    trie_put_checked(test, trie, "she", &scan_values[1]);
+    trie_put_checked(test, trie, "his", &scan_values[2]);
+    trie_put_checked(test, trie, "hers", &scan_values[3]);
+    trie_automaton_t* automaton = trie_automaton_create_checked(test, trie);
+    trie_destroy_checked(test, trie);
+
+    return automaton;
+}
+
+void assert_scan_matches_ushers(CuTest* test, const scan_matches_t* matches) {
+    CuAssertIntEquals(test, 3U, matches->count);
+    CuAssertIntEquals(test, 1U, matches->offsets[0]);
+    CuAssertIntEquals(test, 3U, matches->lengths[0]);
+    CuAssertPtrEquals(test, &scan_values[1], matches->values[0]);
+    CuAssertIntEquals(test, 2U, matches->offsets[1]);
+    CuAssertIntEquals(test, 2U, matches->lengths[1]);
+    CuAssertPtrEquals(test, &scan_values[0], matches->values[1]);
+    CuAssertIntEquals(test, 2U, matches->offsets[2]);
+    CuAssertIntEquals(test, 4U, matches->lengths[2]);
+    CuAssertPtrEquals(test, &scan_values[3], matches->values[2]);
+}
+
+void test_scan_finds_overlapping_words(CuTest* test) {
+    trie_automaton_t* automaton =
+        trie_automaton_create_for_scan_checked(test);
+
+    scan_matches_t matches = { { 0U }, { 0U }, { NULL }, 0U, 0U };
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_scan(automaton, "ushers", 6U,
+        record_scan_match, &matches));
+    assert_scan_matches_ushers(test, &matches);
+
+    scan_matches_t no_matches = { { 0U }, { 0U }, { NULL }, 0U, 0U };
+    trie_scan(automaton, "hxsh", 4U, record_scan_match, &no_matches);
+    CuAssertIntEquals(test, 0U, no_matches.count);
+
+    trie_automaton_destroy(automaton);
+}
+
+void test_scan_chunks(CuTest* test) {
+    trie_automaton_t* automaton =
+        trie_automaton_create_for_scan_checked(test);
+
+    scan_matches_t matches = { { 0U }, { 0U }, { NULL }, 0U, 0U };
+    trie_scan_t scan;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_scan_begin(&scan));
+    const char* chunks[] = { "u", "sh", "", "e", "rs" };
+    for (size_t i = 0U; i < 5U; i++) {
+        CuAssertIntEquals(test, TRIE_SUCCESS, trie_scan_chunk(automaton,
+            &scan, chunks[i], strlen(chunks[i]), record_scan_match,
+            &matches));
+    }
+    assert_scan_matches_ushers(test, &matches);
+    CuAssertIntEquals(test, 6U, scan.offset);
+
+    trie_automaton_destroy(automaton);
+}
+
+void test_scan_many_random_words(CuTest* test) {
+    trie_t* trie = trie_create_with_arena_checked(test, 256U);
+    uint32_t seed = 7U;
+    for (size_t i = 0U; i < 300U; i++) {
+        char word[16];
+        make_random_word(&seed, word);
+        trie_add_word_checked(test, trie, word);
+    }
+    char text[2001];
+    for (size_t i = 0U; i < 2000U; i++) {
+        seed = seed * 1103515245U + 12345U;
+        text[i] = (char) ('a' + (seed >> 16) % 4U);
+    }
+    text[2000] = '\0';
+
+    // Every occurrence starts at some offset and is a prefix of the text
+    // from there on
+    scan_matches_t expected = { { 0U }, { 0U }, { NULL }, 0U, 0U };
+    for (size_t i = 0U; i < 2000U; i++) {
+        size_t match_lengths[12];
+        size_t match_count;
+        trie_prefix_matches(trie, text+i, 2000U-i, match_lengths, 12U,
+            &match_count);
+        for (size_t j = 0U; j < match_count; j++) {
+            expected.count++;
+            expected.checksum += (i + match_lengths[j]) * 2654435761U +
+                match_lengths[j];
+        }
+    }
+
+    trie_automaton_t* automaton = trie_automaton_create_checked(test, trie);
+    scan_matches_t found = { { 0U }, { 0U }, { NULL }, 0U, 0U };
+    trie_scan_t scan;
+    trie_scan_begin(&scan);
+    for (size_t i = 0U; i < 2000U; i += 100U) {
+        trie_scan_chunk(automaton, &scan, text+i, 100U, record_scan_match,
+            &found);
+    }
+    CuAssertIntEquals(test, expected.count, found.count);
+    CuAssertTrue(test, expected.checksum == found.checksum);
+
+    trie_automaton_destroy(automaton);
+    trie_destroy_checked(test, trie);
+}
+
+void test_automaton_create_on_read_only_trie_fails(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    trie_add_word_checked(test, trie, "he");
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, trie);
+
+    trie_automaton_t* automaton;
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED,
+        trie_automaton_create(dawg, &automaton));
+
+    trie_destroy_checked(test, dawg);
+}
+
+void test_destroy_automaton_does_not_leak_memory(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_automaton_t* automaton =
+        trie_automaton_create_for_scan_checked(test);
+
+    trie_automaton_destroy(automaton);
+
+    assert_no_memory_leaks(test);
+}
+
+// Returns the edit distance between two words, computed directly
+uint32_t edit_distance(const char* a, const char* b) {
+    size_t b_length = strlen(b);
+    uint32_t row[32];
+    for (size_t j = 0U; j <= b_length; j++) {
+        row[j] = (uint32_t) j;
+    }
+    for (size_t i = 0U; a[i] != '\0'; i++) {
+        uint32_t diagonal = row[0];
+        row[0] = (uint32_t) i+1;
+        for (size_t j = 1U; j <= b_length; j++) {
+            uint32_t above = row[j];
+            uint32_t entry = diagonal + (a[i] == b[j-1] ? 0U : 1U);
+            if (above+1 < entry) {
+                entry = above+1;
+            }
+            if (row[j-1]+1 < entry) {
+                entry = row[j-1]+1;
+            }
+            row[j] = entry;
+            diagonal = above;
+        }
+    }
+
+    return row[b_length];
+}
+
+// Returns the least edit distance between a prefix of word and prefix
+uint32_t prefix_edit_distance(const char* word, const char* prefix) {
+    char word_prefix[32];
+    uint32_t least = UINT32_MAX;
+    for (size_t i = 0U; i <= strlen(word); i++) {
+        memcpy(word_prefix, word, i);
+        word_prefix[i] = '\0';
+        uint32_t distance = edit_distance(word_prefix, prefix);
+        if (distance < least) {
+            least = distance;
+        }
+    }
+
+    return least;
+}
+
+trie_t* trie_create_for_fuzzy_search_checked(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    const char* words[] = {
+        "cart", "cat", "cats", "coat", "cot", "dog", "scat", "at"
+    };
+    for (size_t i = 0U; i < 8U; i++) {
+        trie_add_word_checked(test, trie, words[i]);
+    }
+
+    return trie;
+}
+
+void test_fuzzy_search_orders_by_distance(CuTest* test) {
+    trie_t* trie = trie_create_for_fuzzy_search_checked(test);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    uint32_t distances[8];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_fuzzy_search(trie, "cat", 1U,
+        buffer, sizeof(buffer), spans, distances, 8U, &word_count));
+    const char* expected[] = { "cat", "at", "cart", "cats", "coat", "cot",
+        "scat" };
+    CuAssertIntEquals(test, 7U, word_count);
+    for (size_t i = 0U; i < 7U; i++) {
+        CuAssertStrEquals(test, expected[i], buffer + spans[i].offset);
+        CuAssertIntEquals(test, i == 0U ? 0U : 1U, distances[i]);
+    }
+
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_fuzzy_search(trie, "cat", 0U,
+        buffer, sizeof(buffer), spans, NULL, 8U, &word_count));
+    CuAssertIntEquals(test, 1U, word_count);
+    CuAssertStrEquals(test, "cat", buffer + spans[0].offset);
+
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_fuzzy_search(trie, "cat", 1U,
+        buffer, sizeof(buffer), spans, distances, 3U, &word_count));
+    CuAssertIntEquals(test, 3U, word_count);
+    CuAssertStrEquals(test, "cart", buffer + spans[2].offset);
+
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_fuzzy_search(trie, "xyz", 2U,
+        buffer, sizeof(buffer), spans, distances, 8U, &word_count));
+    CuAssertIntEquals(test, 0U, word_count);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_fuzzy_search_any_distance(CuTest* test) {
+    trie_t* trie = trie_create_for_fuzzy_search_checked(test);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    uint32_t distances[8];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_fuzzy_search(trie, "cat",
+        UINT32_MAX, buffer, sizeof(buffer), spans, distances, 8U,
+        &word_count));
+    CuAssertIntEquals(test, 8U, word_count);
+    CuAssertStrEquals(test, "cat", buffer + spans[0].offset);
+    CuAssertStrEquals(test, "dog", buffer + spans[7].offset);
+    CuAssertIntEquals(test, 3U, distances[7]);
+
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_fuzzy_search(trie, "cat",
+        1000000000U, buffer, sizeof(buffer), spans, NULL, 8U, &word_count));
+    CuAssertIntEquals(test, 8U, word_count);
+
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_fuzzy_prefix_search(trie,
+        "ca", UINT32_MAX, buffer, sizeof(buffer), spans, distances, 8U,
+        &word_count));
+    CuAssertIntEquals(test, 8U, word_count);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_fuzzy_prefix_search(CuTest* test) {
+    trie_t* trie = trie_create_for_fuzzy_search_checked(test);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    uint32_t distances[8];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_fuzzy_prefix_search(trie, "ca",
+        1U, buffer, sizeof(buffer), spans, distances, 8U, &word_count));
+    const char* expected[] = { "cart", "cat", "cats", "at", "coat", "cot",
+        "scat" };
+    uint32_t expected_distances[] = { 0U, 0U, 0U, 1U, 1U, 1U, 1U };
+    CuAssertIntEquals(test, 7U, word_count);
+    for (size_t i = 0U; i < 7U; i++) {
+        CuAssertStrEquals(test, expected[i], buffer + spans[i].offset);
+        CuAssertIntEquals(test, expected_distances[i], distances[i]);
+    }
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_fuzzy_search_many_random_words(CuTest* test) {
+    trie_t* trie = trie_create_with_arena_checked(test, 256U);
+    char words[300][16];
+    uint32_t seed = 11U;
+    size_t distinct_count = 0U;
+    for (size_t i = 0U; i < 300U; i++) {
+        make_random_word(&seed, words[distinct_count]);
+        bool contains;
+        trie_contains_word_checked(test, trie, words[distinct_count],
+            &contains);
+        if (!contains) {
+            trie_add_word_checked(test, trie, words[distinct_count]);
+            distinct_count++;
+        }
+    }
+
+    char buffer[4096];
+    trie_word_span_t spans[300];
+    uint32_t distances[300];
+    for (size_t query_index = 0U; query_index < 20U; query_index++) {
+        char query[16];
+        make_random_word(&seed, query);
+        for (size_t prefix = 0U; prefix < 2U; prefix++) {
+            size_t word_count;
+            trie_result_t result = prefix ?
+                trie_fuzzy_prefix_search(trie, query, 2U, buffer,
+                    sizeof(buffer), spans, distances, 300U, &word_count) :
+                trie_fuzzy_search(trie, query, 2U, buffer, sizeof(buffer),
+                    spans, distances, 300U, &word_count);
+            CuAssertIntEquals(test, TRIE_SUCCESS, result);
+
+            size_t expected_count = 0U;
+            for (size_t i = 0U; i < distinct_count; i++) {
+                uint32_t distance = prefix ?
+                    prefix_edit_distance(words[i], query) :
+                    edit_distance(words[i], query);
+                if (distance <= 2U) {
+                    expected_count++;
+                }
+            }
+            CuAssertIntEquals(test, expected_count, word_count);
+
+            for (size_t i = 0U; i < word_count; i++) {
+                const char* word = buffer + spans[i].offset;
+                uint32_t distance = prefix ?
+                    prefix_edit_distance(word, query) :
+                    edit_distance(word, query);
+                CuAssertIntEquals(test, distance, distances[i]);
+                if (i > 0U) {
+                    CuAssertTrue(test, distances[i-1] < distances[i] ||
+                        (distances[i-1] == distances[i] &&
+                        strcmp(buffer + spans[i-1].offset, word) < 0));
+                }
+            }
+        }
+    }
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_fuzzy_search_binary_keys(CuTest* test) {
+    trie_t* trie = trie_create_with_binary_keys_checked(test);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    uint32_t distances[8];
+    size_t key_count;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_fuzzy_search_key(trie,
+        "a\0\0", 3U, 1U, buffer, sizeof(buffer), spans, distances, 8U,
+        &key_count));
+    CuAssertIntEquals(test, 4U, key_count);
+    CuAssertIntEquals(test, 2U, spans[0].length);
+    CuAssertIntEquals(test, 1U, distances[0]);
+    CuAssertIntEquals(test, 4U, spans[1].length);
+    CuAssertIntEquals(test, 3U, spans[2].length);
+    CuAssertTrue(test, memcmp(buffer + spans[2].offset, "a\0b", 3U) == 0);
+    CuAssertIntEquals(test, 3U, spans[3].length);
+    CuAssertTrue(test, memcmp(buffer + spans[3].offset, "ab\0", 3U) == 0);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_fuzzy_search_on_read_only_trie_fails(CuTest* test) {
+    trie_t* trie = trie_create_for_fuzzy_search_checked(test);
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, trie);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED, trie_fuzzy_search(dawg, "cat",
+        1U, buffer, sizeof(buffer), spans, NULL, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED, trie_fuzzy_prefix_search(dawg,
+        "ca", 1U, buffer, sizeof(buffer), spans, NULL, 8U, &word_count));
+
+    trie_destroy_checked(test, dawg);
+}
+
+void test_fuzzy_search_with_invalid_arguments_fails(CuTest* test) {
+    trie_t* trie = trie_create_for_fuzzy_search_checked(test);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_NULL, trie_fuzzy_search(NULL, "cat", 1U,
+        buffer, sizeof(buffer), spans, NULL, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_WORD_NULL, trie_fuzzy_search(trie, NULL, 1U,
+        buffer, sizeof(buffer), spans, NULL, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_WORD_EMPTY, trie_fuzzy_search(trie, "", 1U,
+        buffer, sizeof(buffer), spans, NULL, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_WORDS_LENGTH_ZERO, trie_fuzzy_search(trie,
+        "cat", 1U, buffer, sizeof(buffer), spans, NULL, 0U, &word_count));
+    CuAssertIntEquals(test, TRIE_BUFFER_LENGTH_ZERO, trie_fuzzy_search(trie,
+        "cat", 1U, buffer, 0U, spans, NULL, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_PREFIX_NULL, trie_fuzzy_prefix_search(trie,
+        NULL, 1U, buffer, sizeof(buffer), spans, NULL, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_PREFIX_EMPTY, trie_fuzzy_prefix_search(trie,
+        "", 1U, buffer, sizeof(buffer), spans, NULL, 8U, &word_count));
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_fuzzy_search_does_not_leak_memory(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_for_fuzzy_search_checked(test);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    size_t word_count;
+    trie_fuzzy_search(trie, "cat", 2U, buffer, sizeof(buffer), spans, NULL,
+        8U, &word_count);
+    trie_fuzzy_prefix_search(trie, "ca", 2U, buffer, sizeof(buffer), spans,
+        NULL, 8U, &word_count);
+
+    trie_destroy_checked(test, trie);
+    assert_no_memory_leaks(test);
+}
+
+trie_t* trie_create_for_pattern_checked(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    const char* words[] = {
+        "bar", "bark", "barn", "bat", "bear", "bier", "boar", "car", "cat",
+        "a*b", "a]b"
+    };
+    for (size_t i = 0U; i < 11U; i++) {
+        trie_add_word_checked(test, trie, words[i]);
+    }
+
+    return trie;
+}
+
+void assert_pattern_matches(CuTest* test, trie_t* trie, const char* pattern,
+    const char* expected) {
+
+    char buffer[64];
+    trie_word_span_t spans[16];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_match_pattern(trie, pattern,
+        buffer, sizeof(buffer), spans, 16U, &word_count));
+
+    char found[128] = "";
+    for (size_t i = 0U; i < word_count; i++) {
+        if (i > 0U) {
+            strcat(found, " ");
+        }
+        strcat(found, buffer + spans[i].offset);
+    }
+    CuAssertStrEquals(test, expected, found);
+}
+
+void test_match_pattern(CuTest* test) {
+    trie_t* trie = trie_create_for_pattern_checked(test);
+
+    assert_pattern_matches(test, trie, "bar", "bar");
+    assert_pattern_matches(test, trie, "b?r*", "bar bark barn");
+    assert_pattern_matches(test, trie, "b*r", "bar bear bier boar");
+    assert_pattern_matches(test, trie, "[bc]at", "bat cat");
+    assert_pattern_matches(test, trie, "[a-b]a?", "bar bat");
+    assert_pattern_matches(test, trie, "[^b]a*", "car cat");
+    assert_pattern_matches(test, trie, "*r*",
+        "bar bark barn bear bier boar car");
+    assert_pattern_matches(test, trie, "**a**r", "bar bear boar car");
+    assert_pattern_matches(test, trie, "a\\*b", "a*b");
+    assert_pattern_matches(test, trie, "a[]]b", "a]b");
+    assert_pattern_matches(test, trie, "?", "");
+    assert_pattern_matches(test, trie, "bar?*", "bark barn");
+
+    char buffer[64];
+    trie_word_span_t spans[16];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_match_pattern(trie, "b*",
+        buffer, sizeof(buffer), spans, 2U, &word_count));
+    CuAssertIntEquals(test, 2U, word_count);
+    CuAssertStrEquals(test, "bark", buffer + spans[1].offset);
+
+    trie_destroy_checked(test, trie);
+}
+
+// Returns true if word matches pattern, computed directly by backtracking
+bool pattern_matches(const char* pattern, const char* word) {
+    if (*pattern == '\0') {
+        return *word == '\0';
+    }
+    if (*pattern == '*') {
+        return pattern_matches(pattern+1, word) ||
+            (*word != '\0' && pattern_matches(pattern, word+1));
+    }
+    if (*word == '\0') {
+        return false;
+    }
+    if (*pattern == '[') {
+        const char* end = strchr(pattern, ']');
+        bool negated = pattern[1] == '^';
+        bool listed = memchr(pattern + (negated ? 2 : 1), *word,
+            (size_t) (end - pattern) - (negated ? 2U : 1U)) != NULL;
+        return listed != negated && pattern_matches(end+1, word+1);
+    }
+
+    return (*pattern == '?' || *pattern == *word) &&
+        pattern_matches(pattern+1, word+1);
+}
+
+void test_match_pattern_many_random_words(CuTest* test) {
+    trie_t* trie = trie_create_with_arena_checked(test, 256U);
+    char words[300][16];
+    uint32_t seed = 13U;
+    size_t distinct_count = 0U;
+    for (size_t i = 0U; i < 300U; i++) {
+        make_random_word(&seed, words[distinct_count]);
+        bool contains;
+        trie_contains_word_checked(test, trie, words[distinct_count],
+            &contains);
+        if (!contains) {
+            trie_add_word_checked(test, trie, words[distinct_count]);
+            distinct_count++;
+        }
+    }
+
+    const char* parts[] = { "a", "b", "?", "*", "[ab]", "[^c]", "[cd]" };
+    char buffer[4096];
+    trie_word_span_t spans[300];
+    for (size_t pattern_index = 0U; pattern_index < 50U; pattern_index++) {
+        char pattern[64] = "";
+        seed = seed * 1103515245U + 12345U;
+        size_t part_count = 1U + (seed >> 16) % 5U;
+        for (size_t i = 0U; i < part_count; i++) {
+            seed = seed * 1103515245U + 12345U;
+            strcat(pattern, parts[(seed >> 16) % 7U]);
+        }
+
+        size_t word_count;
+        CuAssertIntEquals(test, TRIE_SUCCESS, trie_match_pattern(trie,
+            pattern, buffer, sizeof(buffer), spans, 300U, &word_count));
+
+        size_t expected_count = 0U;
+        for (size_t i = 0U; i < distinct_count; i++) {
+            if (pattern_matches(pattern, words[i])) {
+                expected_count++;
+            }
+        }
+        CuAssertIntEquals(test, expected_count, word_count);
+
+        for (size_t i = 0U; i < word_count; i++) {
+            const char* word = buffer + spans[i].offset;
+            CuAssertTrue(test, pattern_matches(pattern, word));
+            if (i > 0U) {
+                CuAssertTrue(test,
+                    strcmp(buffer + spans[i-1].offset, word) < 0);
+            }
+        }
+    }
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_match_pattern_binary_keys(CuTest* test) {
+    trie_t* trie = trie_create_with_binary_keys_checked(test);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    size_t key_count;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_match_pattern_key(trie,
+        "a\0*", 3U, buffer, sizeof(buffer), spans, 8U, &key_count));
+    CuAssertIntEquals(test, 3U, key_count);
+    CuAssertIntEquals(test, 2U, spans[0].length);
+    CuAssertIntEquals(test, 4U, spans[1].length);
+    CuAssertIntEquals(test, 3U, spans[2].length);
+
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_match_pattern_key(trie,
+        "a?", 2U, buffer, sizeof(buffer), spans, 8U, &key_count));
+    CuAssertIntEquals(test, 1U, key_count);
+    CuAssertIntEquals(test, 2U, spans[0].length);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_match_pattern_with_invalid_arguments_fails(CuTest* test) {
+    trie_t* trie = trie_create_for_pattern_checked(test);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_NULL, trie_match_pattern(NULL, "b*",
+        buffer, sizeof(buffer), spans, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_WORD_NULL, trie_match_pattern(trie, NULL,
+        buffer, sizeof(buffer), spans, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_WORD_EMPTY, trie_match_pattern(trie, "",
+        buffer, sizeof(buffer), spans, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_WORDS_LENGTH_ZERO, trie_match_pattern(trie,
+        "b*", buffer, sizeof(buffer), spans, 0U, &word_count));
+    CuAssertIntEquals(test, TRIE_BUFFER_LENGTH_ZERO, trie_match_pattern(trie,
+        "b*", buffer, 0U, spans, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_PATTERN_INVALID, trie_match_pattern(trie,
+        "b[ar", buffer, sizeof(buffer), spans, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_PATTERN_INVALID, trie_match_pattern(trie,
+        "b[]", buffer, sizeof(buffer), spans, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_PATTERN_INVALID, trie_match_pattern(trie,
+        "bar\\", buffer, sizeof(buffer), spans, 8U, &word_count));
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, trie);
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED, trie_match_pattern(dawg, "b*",
+        buffer, sizeof(buffer), spans, 8U, &word_count));
+    trie_destroy_checked(test, dawg);
+}
+
+void test_match_pattern_does_not_leak_memory(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_for_pattern_checked(test);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    size_t word_count;
+    trie_match_pattern(trie, "b*r*", buffer, sizeof(buffer), spans, 8U,
+        &word_count);
+    trie_match_pattern(trie, "b[", buffer, sizeof(buffer), spans, 8U,
+        &word_count);
+
+    trie_destroy_checked(test, trie);
+    assert_no_memory_leaks(test);
+}
+
+trie_t* trie_create_for_range_checked(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    const char* words[] = {
+        "pear", "apple", "peach", "banana", "app", "cherry", "pea", "apricot"
+    };
+    for (size_t i = 0U; i < 8U; i++) {
+        trie_add_word_checked(test, trie, words[i]);
+    }
+
+    return trie;
+}
+
+void assert_range(CuTest* test, trie_t* trie, const char* low,
+    const char* high, size_t n, const char* expected) {
+
+    char buffer[128];
+    trie_word_span_t spans[16];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_range(trie, low, high, buffer,
+        sizeof(buffer), spans, n, &word_count));
+
+    char found[128] = "";
+    for (size_t i = 0U; i < word_count; i++) {
+        if (i > 0U) {
+            strcat(found, " ");
+        }
+        strcat(found, buffer + spans[i].offset);
+    }
+    CuAssertStrEquals(test, expected, found);
+}
+
+void test_range(CuTest* test) {
+    trie_t* trie = trie_create_for_range_checked(test);
+
+    assert_range(test, trie, NULL, NULL, 16U,
+        "app apple apricot banana cherry pea peach pear");
+    assert_range(test, trie, "apple", "cherry", 16U,
+        "apple apricot banana");
+    assert_range(test, trie, "appl", "cherrz", 16U,
+        "apple apricot banana cherry");
+    assert_range(test, trie, "b", NULL, 16U,
+        "banana cherry pea peach pear");
+    assert_range(test, trie, NULL, "app", 16U, "");
+    assert_range(test, trie, NULL, "apq", 16U, "app apple");
+    assert_range(test, trie, "pea", "peach", 16U, "pea");
+    assert_range(test, trie, "pe", "pf", 2U, "pea peach");
+    assert_range(test, trie, "q", NULL, 16U, "");
+    assert_range(test, trie, "c", "b", 16U, "");
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_successor_and_predecessor(CuTest* test) {
+    trie_t* trie = trie_create_for_range_checked(test);
+
+    char buffer[16];
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_successor(trie, "", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "app", buffer);
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_successor(trie, "app", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "apple", buffer);
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_successor(trie, "apples", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "apricot", buffer);
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_successor(trie, "c", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "cherry", buffer);
+    CuAssertIntEquals(test, TRIE_NOT_FOUND,
+        trie_successor(trie, "pear", buffer, sizeof(buffer)));
+
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_predecessor(trie, "peach", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "pea", buffer);
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_predecessor(trie, "peaches", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "peach", buffer);
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_predecessor(trie, "b", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "apricot", buffer);
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_predecessor(trie, "zzz", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "pear", buffer);
+    CuAssertIntEquals(test, TRIE_NOT_FOUND,
+        trie_predecessor(trie, "app", buffer, sizeof(buffer)));
+    CuAssertIntEquals(test, TRIE_NOT_FOUND,
+        trie_predecessor(trie, "", buffer, sizeof(buffer)));
+
+    CuAssertIntEquals(test, TRIE_WORD_TOO_LONG,
+        trie_successor(trie, "b", buffer, 6U));
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_successor(trie, "b", buffer, 7U));
+    CuAssertStrEquals(test, "banana", buffer);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_successor_and_predecessor_after_concurrent_removal(CuTest* test) {
+    trie_t* trie = trie_create_concurrent_checked(test);
+    const char* words[] = { "a", "abc", "abd", "b", "bcd", "c" };
+    for (size_t i = 0U; i < 6U; i++) {
+        trie_add_word_checked(test, trie, words[i]);
+    }
+
+    // Removing from a concurrent trie leaves the nodes of the words in place
+    char buffer[16];
+    trie_remove_word_checked(test, trie, "abc");
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_successor(trie, "a", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "abd", buffer);
+
+    trie_remove_word_checked(test, trie, "abd");
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_successor(trie, "a", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "b", buffer);
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_predecessor(trie, "b", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "a", buffer);
+
+    trie_remove_word_checked(test, trie, "b");
+    trie_remove_word_checked(test, trie, "bcd");
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_successor(trie, "a", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "c", buffer);
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_successor(trie, "ab", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "c", buffer);
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_predecessor(trie, "c", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "a", buffer);
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_predecessor(trie, "bz", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "a", buffer);
+
+    trie_remove_word_checked(test, trie, "c");
+    CuAssertIntEquals(test, TRIE_NOT_FOUND,
+        trie_successor(trie, "a", buffer, sizeof(buffer)));
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_predecessor(trie, "zz", buffer, sizeof(buffer)));
+    CuAssertStrEquals(test, "a", buffer);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_range_and_neighbours_of_many_random_words(CuTest* test) {
+    size_t n = 500U;
+    char word_buffers[n][16];
+    const char* words[n];
+    trie_t* trie = trie_create_with_arena_checked(test, 256U);
+    uint32_t seed = 17U;
+    size_t distinct_count = 0U;
+    for (size_t i = 0U; i < n; i++) {
+        make_random_word(&seed, word_buffers[distinct_count]);
+        bool contains;
+        trie_contains_word_checked(test, trie, word_buffers[distinct_count],
+            &contains);
+        if (!contains) {
+            trie_add_word_checked(test, trie, word_buffers[distinct_count]);
+            words[distinct_count] = word_buffers[distinct_count];
+            distinct_count++;
+        }
+    }
+    qsort(words, distinct_count, sizeof(words[0]), compare_words);
+
+    char buffer[8192];
+    trie_word_span_t spans[500];
+    size_t word_count;
+    trie_copy_words_matching_prefix(trie, "a", buffer, sizeof(buffer), spans,
+        500U, &word_count);
+    for (size_t i = 0U; i < word_count; i++) {
+        CuAssertStrEquals(test, words[i], buffer + spans[i].offset);
+    }
+
+    for (size_t query_index = 0U; query_index < 50U; query_index++) {
+        char low[16];
+        char high[16];
+        make_random_word(&seed, low);
+        make_random_word(&seed, high);
+
+        size_t expected_first = 0U;
+        while (expected_first < distinct_count &&
+            strcmp(words[expected_first], low) < 0) {
+            expected_first++;
+        }
+        size_t expected_end = expected_first;
+        while (expected_end < distinct_count &&
+            strcmp(words[expected_end], high) < 0) {
+            expected_end++;
+        }
+
+        trie_range(trie, low, high, buffer, sizeof(buffer), spans, 500U,
+            &word_count);
+        CuAssertIntEquals(test, expected_end - expected_first, word_count);
+        for (size_t i = 0U; i < word_count; i++) {
+            CuAssertStrEquals(test, words[expected_first+i],
+                buffer + spans[i].offset);
+        }
+
+        // The successor is the first word after low, which is skipped if it
+        // is contained
+        size_t successor = expected_first;
+        if (successor < distinct_count && strcmp(words[successor], low) == 0) {
+            successor++;
+        }
+        char neighbour[16];
+        trie_result_t result =
+            trie_successor(trie, low, neighbour, sizeof(neighbour));
+        if (successor < distinct_count) {
+            CuAssertIntEquals(test, TRIE_SUCCESS, result);
+            CuAssertStrEquals(test, words[successor], neighbour);
+        }
+        else {
+            CuAssertIntEquals(test, TRIE_NOT_FOUND, result);
+        }
+
+        result = trie_predecessor(trie, low, neighbour, sizeof(neighbour));
+        if (expected_first > 0U) {
+            CuAssertIntEquals(test, TRIE_SUCCESS, result);
+            CuAssertStrEquals(test, words[expected_first-1], neighbour);
+        }
+        else {
+            CuAssertIntEquals(test, TRIE_NOT_FOUND, result);
+        }
+    }
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_range_and_neighbours_of_binary_keys(CuTest* test) {
+    trie_t* trie = trie_create_with_binary_keys_checked(test);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    size_t key_count;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_range_key(trie, "a\0", 2U,
+        "a\0b", 3U, buffer, sizeof(buffer), spans, 8U, &key_count));
+    CuAssertIntEquals(test, 2U, key_count);
+    CuAssertIntEquals(test, 2U, spans[0].length);
+    CuAssertIntEquals(test, 4U, spans[1].length);
+
+    size_t length;
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_successor_key(trie, "a\0\0",
+        3U, buffer, sizeof(buffer), &length));
+    CuAssertIntEquals(test, 4U, length);
+    CuAssertTrue(test, memcmp(buffer, "a\0\0c", 4U) == 0);
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_predecessor_key(trie, "ab",
+        2U, buffer, sizeof(buffer), &length));
+    CuAssertIntEquals(test, 3U, length);
+    CuAssertTrue(test, memcmp(buffer, "a\0b", 3U) == 0);
+
+    trie_destroy_checked(test, trie);
+}
+
+void test_range_with_invalid_arguments_fails(CuTest* test) {
+    trie_t* trie = trie_create_for_range_checked(test);
+
+    char buffer[64];
+    trie_word_span_t spans[8];
+    size_t word_count;
+    CuAssertIntEquals(test, TRIE_NULL, trie_range(NULL, "a", "b", buffer,
+        sizeof(buffer), spans, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_WORDS_LENGTH_ZERO, trie_range(trie, "a",
+        "b", buffer, sizeof(buffer), spans, 0U, &word_count));
+    CuAssertIntEquals(test, TRIE_BUFFER_LENGTH_ZERO, trie_range(trie, "a",
+        "b", buffer, 0U, spans, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_NULL,
+        trie_successor(NULL, "a", buffer, sizeof(buffer)));
+    CuAssertIntEquals(test, TRIE_WORD_NULL,
+        trie_successor(trie, NULL, buffer, sizeof(buffer)));
+    CuAssertIntEquals(test, TRIE_BUFFER_LENGTH_ZERO,
+        trie_predecessor(trie, "b", buffer, 0U));
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, trie);
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED, trie_range(dawg, "a", "b",
+        buffer, sizeof(buffer), spans, 8U, &word_count));
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED,
+        trie_successor(dawg, "a", buffer, sizeof(buffer)));
+    trie_destroy_checked(test, dawg);
+}
+
+void test_rank_and_select(CuTest* test) {
+    trie_t* trie = trie_create_for_range_checked(test);
+
+    const char* expected[] = {
+        "app", "apple", "apricot", "banana", "cherry", "pea", "peach", "pear"
+    };
+    char buffer[16];
+    for (size_t i = 0U; i < 8U; i++) {
+        size_t rank;
+        CuAssertIntEquals(test, TRIE_SUCCESS,
+            trie_rank(trie, expected[i], &rank));
+        CuAssertIntEquals(test, i, rank);
+        CuAssertIntEquals(test, TRIE_SUCCESS,
+            trie_select(trie, i, buffer, sizeof(buffer)));
+        CuAssertStrEquals(test, expected[i], buffer);
+    }
+    CuAssertIntEquals(test, TRIE_NOT_FOUND,
+        trie_select(trie, 8U, buffer, sizeof(buffer)));
+    CuAssertIntEquals(test, TRIE_WORD_TOO_LONG,
+        trie_select(trie, 2U, buffer, 7U));
+
+    size_t rank;
+    trie_rank(trie, "", &rank);
+    CuAssertIntEquals(test, 0U, rank);
+    trie_rank(trie, "b", &rank);
+    CuAssertIntEquals(test, 3U, rank);
+    trie_rank(trie, "peaches", &rank);
+    CuAssertIntEquals(test, 7U, rank);
+    trie_rank(trie, "zebra", &rank);
+    CuAssertIntEquals(test, 8U, rank);
+
+    // The completions of a prefix start at its rank
+    trie_rank(trie, "pe", &rank);
+    trie_select(trie, rank+1U, buffer, sizeof(buffer));
+    CuAssertStrEquals(test, "peach", buffer);
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test,
+        trie_create_for_range_checked(test));
+    trie_rank(dawg, "peaches", &rank);
+    CuAssertIntEquals(test, 7U, rank);
+    trie_rank(dawg, "pe", &rank);
+    trie_select(dawg, rank+1U, buffer, sizeof(buffer));
+    CuAssertStrEquals(test, "peach", buffer);
+    CuAssertIntEquals(test, TRIE_WORD_TOO_LONG,
+        trie_select(dawg, 2U, buffer, 7U));
+    CuAssertIntEquals(test, TRIE_NOT_FOUND,
+        trie_select(dawg, 8U, buffer, sizeof(buffer)));
+    trie_destroy_checked(test, dawg);
+
+    trie_remove_word_checked(test, trie, "apple");
+    trie_remove_word_checked(test, trie, "pea");
+    trie_rank(trie, "pear", &rank);
+    CuAssertIntEquals(test, 5U, rank);
+    trie_select(trie, 4U, buffer, sizeof(buffer));
+    CuAssertStrEquals(test, "peach", buffer);
+
+    trie_destroy_checked(test, trie);
+}
+
+// Checks trie_count_prefix(), trie_rank() and trie_select() against the
+// sorted array of the words of trie
+void assert_counts_match_sorted_words(CuTest* test, trie_t* trie,
+    const char** words, size_t n) {
+
+    char buffer[16];
+    for (size_t i = 0U; i < n; i++) {
+        size_t rank;
+        CuAssertIntEquals(test, TRIE_SUCCESS,
+            trie_rank(trie, words[i], &rank));
+        CuAssertIntEquals(test, i, rank);
+        CuAssertIntEquals(test, TRIE_SUCCESS,
+            trie_select(trie, i, buffer, sizeof(buffer)));
+        CuAssertStrEquals(test, words[i], buffer);
+    }
+    CuAssertIntEquals(test, TRIE_NOT_FOUND,
+        trie_select(trie, n, buffer, sizeof(buffer)));
+
+    const char* prefixes[] = { "a", "ab", "ba", "ccd", "dddd" };
+    for (size_t i = 0U; i < 5U; i++) {
+        size_t expected_count = 0U;
+        for (size_t j = 0U; j < n; j++) {
+            if (strncmp(words[j], prefixes[i], strlen(prefixes[i])) == 0) {
+                expected_count++;
+            }
+        }
+        size_t word_count;
+        trie_count_prefix(trie, prefixes[i], &word_count);
+        CuAssertIntEquals(test, expected_count, word_count);
+    }
+}
+
+void test_counts_of_many_random_words(CuTest* test) {
+    size_t n = 600U;
+    char word_buffers[n][16];
+    const char* words[n];
+    trie_t* trie = trie_create_with_arena_checked(test, 256U);
+    trie_t* concurrent = trie_create_concurrent_checked(test);
+    uint32_t seed = 19U;
+    size_t distinct_count = 0U;
+    for (size_t i = 0U; i < n; i++) {
+        make_random_word(&seed, word_buffers[distinct_count]);
+        bool contains;
+        trie_contains_word_checked(test, trie, word_buffers[distinct_count],
+            &contains);
+        trie_put_checked(test, trie, word_buffers[distinct_count], NULL);
+        trie_add_word_checked(test, concurrent,
+            word_buffers[distinct_count]);
+        if (!contains) {
+            words[distinct_count] = word_buffers[distinct_count];
+            distinct_count++;
+        }
+    }
+
+    // Remove every third word
+    size_t kept_count = 0U;
+    for (size_t i = 0U; i < distinct_count; i++) {
+        if (i % 3U == 0U) {
+            trie_remove_word_checked(test, trie, words[i]);
+            trie_remove_word_checked(test, concurrent, words[i]);
+        }
+        else {
+            words[kept_count++] = words[i];
+        }
+    }
+    qsort(words, kept_count, sizeof(words[0]), compare_words);
+
+    assert_counts_match_sorted_words(test, trie, words, kept_count);
+    assert_counts_match_sorted_words(test, concurrent, words, kept_count);
+
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_compact(trie));
+    assert_counts_match_sorted_words(test, trie, words, kept_count);
+
+    trie_t* built = trie_build_from_sorted_checked(test, words, kept_count);
+    assert_counts_match_sorted_words(test, built, words, kept_count);
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, built);
+    assert_counts_match_sorted_words(test, dawg, words, kept_count);
+
+    trie_destroy_checked(test, dawg);
+    trie_destroy_checked(test, concurrent);
+    trie_destroy_checked(test, trie);
+}
+
+void test_rank_and_select_with_invalid_arguments_fails(CuTest* test) {
+    trie_t* trie = trie_create_for_range_checked(test);
+
+    char buffer[16];
+    size_t rank;
+    CuAssertIntEquals(test, TRIE_NULL, trie_rank(NULL, "a", &rank));
+    CuAssertIntEquals(test, TRIE_WORD_NULL, trie_rank(trie, NULL, &rank));
+    CuAssertIntEquals(test, TRIE_NULL,
+        trie_select(NULL, 0U, buffer, sizeof(buffer)));
+    CuAssertIntEquals(test, TRIE_BUFFER_LENGTH_ZERO,
+        trie_select(trie, 0U, buffer, 0U));
+
+    trie_t* double_array = trie_freeze_to_double_array_checked(test, trie);
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED,
+        trie_rank(double_array, "a", &rank));
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED,
+        trie_select(double_array, 0U, buffer, sizeof(buffer)));
+    trie_destroy_checked(test, double_array);
+}
+
+trie_stats_t trie_get_stats_checked(CuTest* test, trie_t* trie) {
+    trie_stats_t stats;
+
+    if (trie_get_stats(trie, &stats) != TRIE_SUCCESS) {
+        CuFail(test, "trie_get_stats failed");
+    }
+
+    return stats;
+}
+
+void assert_small_trie_stats(CuTest* test, trie_t* trie) {
+    trie_add_word_checked(test, trie, "a");
+    trie_add_word_checked(test, trie, "ab");
+    trie_add_word_checked(test, trie, "ac");
+    trie_add_word_checked(test, trie, "bcd");
+
+    trie_stats_t stats = trie_get_stats_checked(test, trie);
+
+    CuAssertIntEquals(test, 5U, stats.node_count);
+    CuAssertIntEquals(test, 4U, stats.word_count);
+    CuAssertIntEquals(test, 1U, stats.depth_histogram[0]);
+    CuAssertIntEquals(test, 2U, stats.depth_histogram[1]);
+    CuAssertIntEquals(test, 2U, stats.depth_histogram[2]);
+    CuAssertIntEquals(test, 0U, stats.depth_histogram[3]);
+    CuAssertIntEquals(test, 3U, stats.fan_out_histogram[0]);
+    CuAssertIntEquals(test, 0U, stats.fan_out_histogram[1]);
+    CuAssertIntEquals(test, 2U, stats.fan_out_histogram[2]);
+    CuAssertDblEquals(test, 1.5, stats.average_lookup_path_length, 1e-9);
+    CuAssertTrue(test, stats.node_bytes > 0U);
+    CuAssertTrue(test, stats.children_bytes > 0U);
+    CuAssertTrue(test, stats.allocated_bytes >=
+        stats.node_bytes + stats.children_bytes + stats.string_bytes);
+}
+
+void test_get_stats(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+    assert_small_trie_stats(test, trie);
+    CuAssertIntEquals(test, 12U,
+        trie_get_stats_checked(test, trie).string_bytes);
+    trie_destroy_checked(test, trie);
+
+    trie_t* without_words = trie_create_without_words_checked(test);
+    assert_small_trie_stats(test, without_words);
+    CuAssertIntEquals(test, 0U,
+        trie_get_stats_checked(test, without_words).string_bytes);
+    trie_destroy_checked(test, without_words);
+
+    trie_t* arena = trie_create_with_arena_checked(test, 64U);
+    assert_small_trie_stats(test, arena);
+    trie_destroy_checked(test, arena);
+
+    trie_t* concurrent = trie_create_concurrent_checked(test);
+    assert_small_trie_stats(test, concurrent);
+    trie_destroy_checked(test, concurrent);
+}
+
+void test_get_stats_of_empty_and_deep_tries(CuTest* test) {
+    trie_t* trie = trie_create_checked(test);
+
+    trie_stats_t stats = trie_get_stats_checked(test, trie);
+    CuAssertIntEquals(test, 1U, stats.node_count);
+    CuAssertIntEquals(test, 0U, stats.word_count);
+    CuAssertIntEquals(test, 1U, stats.fan_out_histogram[0]);
+    CuAssertDblEquals(test, 0.0, stats.average_lookup_path_length, 0.0);
+
+    // Words "a" to 70 "a"s put one node at each depth from 1 to 70
+    char word[71];
+    for (size_t i = 0U; i < 70U; i++) {
+        word[i] = 'a';
+        word[i+1] = '\0';
+        trie_add_word_checked(test, trie, word);
+    }
+
+    stats = trie_get_stats_checked(test, trie);
+    CuAssertIntEquals(test, 71U, stats.node_count);
+    CuAssertIntEquals(test, 1U, stats.depth_histogram[1]);
+    CuAssertIntEquals(test, 1U,
+        stats.depth_histogram[TRIE_STATS_MAX_DEPTH-2]);
+    CuAssertIntEquals(test, 71U - (TRIE_STATS_MAX_DEPTH-1),
+        stats.depth_histogram[TRIE_STATS_MAX_DEPTH-1]);
+    CuAssertIntEquals(test, 70U, stats.fan_out_histogram[1]);
+    CuAssertDblEquals(test, 35.5, stats.average_lookup_path_length, 1e-9);
+
+    trie_destroy_checked(test, trie);
+}
+
+// Returns the bytes currently reported allocated across every category
+int64_t get_allocated_bytes() {
+    int64_t total = 0;
+    for (size_t i = 0U; i <= TRIE_MEMORY_OTHER; i++) {
+        total += currently_allocated_bytes[i];
+    }
+
+    return total;
+}
+
+void test_get_stats_bytes_match_sized_listeners(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_checked(test);
+    uint32_t seed = 23U;
+    char words[300][16];
+    for (size_t i = 0U; i < 300U; i++) {
+        make_random_word(&seed, words[i]);
+        trie_add_word_checked(test, trie, words[i]);
+    }
+    for (size_t i = 0U; i < 300U; i += 4U) {
+        trie_remove_word(trie, words[i]);
+    }
+
+    trie_stats_t stats = trie_get_stats_checked(test, trie);
+    CuAssertIntEquals(test, currently_allocated_bytes[TRIE_MEMORY_NODES],
+        (int64_t) stats.node_bytes);
+    CuAssertIntEquals(test, currently_allocated_bytes[TRIE_MEMORY_CHILDREN],
+        (int64_t) stats.children_bytes);
+    CuAssertIntEquals(test, get_allocated_bytes(),
+        (int64_t) stats.allocated_bytes);
+    CuAssertTrue(test, (int64_t) stats.string_bytes <=
+        currently_allocated_bytes[TRIE_MEMORY_STRINGS]);
+    trie_destroy_checked(test, trie);
+
+    trie_t* arena = trie_create_with_arena_checked(test, 256U);
+    for (size_t i = 0U; i < 300U; i++) {
+        trie_add_word_checked(test, arena, words[i]);
+    }
+    stats = trie_get_stats_checked(test, arena);
+    CuAssertIntEquals(test, 0, currently_allocated_bytes[TRIE_MEMORY_NODES]);
+    CuAssertIntEquals(test, get_allocated_bytes(),
+        (int64_t) stats.allocated_bytes);
+    trie_destroy_checked(test, arena);
+
+    assert_no_memory_leaks(test);
+}
+
+void test_sized_memory_listeners_balance(CuTest* test) {
+    set_up_memory_leak_detection();
+    trie_t* trie = trie_create_for_pattern_checked(test);
+    trie_t* arena = trie_create_with_arena_checked(test, 64U);
+    trie_t* concurrent = trie_create_concurrent_checked(test);
+    const char* words[] = { "car", "cart", "care", "dog", "do" };
+    for (size_t i = 0U; i < 5U; i++) {
+        trie_add_word_checked(test, arena, words[i]);
+        trie_add_word_checked(test, concurrent, words[i]);
+    }
+    trie_remove_word_checked(test, concurrent, "care");
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_compact(trie));
+    CuAssertIntEquals(test, TRIE_SUCCESS, trie_compact(arena));
+    CuAssertTrue(test, currently_allocated_bytes[TRIE_MEMORY_NODES] > 0);
+    CuAssertTrue(test, currently_allocated_bytes[TRIE_MEMORY_CHILDREN] > 0);
+    CuAssertTrue(test, currently_allocated_bytes[TRIE_MEMORY_STRINGS] > 0);
+    CuAssertTrue(test, currently_allocated_bytes[TRIE_MEMORY_ARENA] > 0);
+
+    trie_automaton_t* automaton;
+    CuAssertIntEquals(test, TRIE_SUCCESS,
+        trie_automaton_create(concurrent, &automaton));
+    CuAssertTrue(test, currently_allocated_bytes[TRIE_MEMORY_READ_ONLY] > 0);
+    trie_automaton_destroy(automaton);
+
+    trie_destroy_checked(test, trie_freeze_to_dawg_checked(test, trie));
+    trie_destroy_checked(test,
+        trie_freeze_to_double_array_checked(test, arena));
+    trie_destroy_checked(test, trie_freeze_to_louds_checked(test, concurrent));
+
+    assert_no_memory_leaks(test);
+}
+
+void test_get_stats_with_invalid_arguments_fails(CuTest* test) {
+    trie_t* trie = trie_create_for_range_checked(test);
+
+    trie_stats_t stats;
+    CuAssertIntEquals(test, TRIE_NULL, trie_get_stats(NULL, &stats));
+    CuAssertIntEquals(test, TRIE_NULL, trie_get_stats(trie, NULL));
+
+    trie_t* dawg = trie_freeze_to_dawg_checked(test, trie);
+    CuAssertIntEquals(test, TRIE_UNSUPPORTED, trie_get_stats(dawg, &stats));
+    trie_destroy_checked(test, dawg);
+}
+
+void assert_removal_keeps_edges_compressed(CuTest* test, trie_t* trie) {
+    size_t n = 400U;
+    char words[n][16];
+    uint32_t seed = 29U;
+    for (size_t i = 0U; i < n; i++) {
+        bool contains = true;
+        while (contains) {
+            make_random_word(&seed, words[i]);
+            trie_contains_word_checked(test, trie, words[i], &contains);
+        }
+        trie_add_word_checked(test, trie, words[i]);
+    }
+
+    // Removing a word which ends where others branch off, or a branch, leaves
+    // nodes with a single child and no word
+    trie_add_word_checked(test, trie, "ab");
+    trie_add_word_checked(test, trie, "abcd");
+    trie_add_word_checked(test, trie, "abce");
+    trie_remove_word_checked(test, trie, "abce");
+    for (size_t i = 0U; i < n; i += 3U) {
+        trie_remove_word_checked(test, trie, words[i]);
+    }
+
+    trie_t* fresh = trie_create_checked(test);
+    trie_add_word_checked(test, fresh, "ab");
+    trie_add_word_checked(test, fresh, "abcd");
+    for (size_t i = 0U; i < n; i++) {
+        bool contains;
+        trie_contains_word_checked(test, trie, words[i], &contains);
+        if (i % 3U != 0U) {
+            CuAssertTrue(test, contains);
+            trie_add_word_checked(test, fresh, words[i]);
+        }
+    }
+    assert_trie_contains_word(test, trie, "abcd");
+    assert_trie_does_not_contain_word(test, trie, "abce");
+
+    trie_stats_t stats = trie_get_stats_checked(test, trie);
+    trie_stats_t fresh_stats = trie_get_stats_checked(test, fresh);
+    CuAssertIntEquals(test, fresh_stats.node_count, stats.node_count);
+    CuAssertIntEquals(test, fresh_stats.word_count, stats.word_count);
+
+    trie_destroy_checked(test, fresh);
+    trie_destroy_checked(test, trie);
+}
+
+void test_remove_word_keeps_edges_compressed(CuTest* test) {
+    set_up_memory_leak_detection();
+    assert_removal_keeps_edges_compressed(test, trie_create_checked(test));
+    assert_removal_keeps_edges_compressed(test,
+        trie_create_with_arena_checked(test, 256U));
+    assert_no_memory_leaks(test);
+}
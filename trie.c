@@ -1,211 +1,2180 @@
 #include "trie.h"
+#include "trie-internal.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
-typedef struct _trie_node_t _trie_node_t;
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-typedef struct {
-    _trie_node_t* head_node;
-} _trie_node_list_t;
-
-struct _trie_node_t {
-    char ch;
-    char* word;
-    _trie_node_list_t children;
-    _trie_node_t* next;
+// Alignment applied to every allocation carved out of an arena chunk
+#define _TRIE_ARENA_ALIGNMENT sizeof(union { void* p; long long l; double d; })
+
+// Size in bytes of the first chunk of the word pool of a trie which does not
+// have an arena
+#define _TRIE_WORD_POOL_INITIAL_BYTES 4096U
+
+void (*memory_allocation_listener)() = NULL;
+
+void (*memory_deallocation_listener)() = NULL;
+
+void (*sized_memory_allocation_listener)(size_t size,
+    trie_memory_category_t category) = NULL;
+
+void (*sized_memory_deallocation_listener)(size_t size,
+    trie_memory_category_t category) = NULL;
+
+void* _allocate_memory(size_t size, trie_memory_category_t category) {
+    void* allocated_memory = malloc(size);
+    if (allocated_memory == NULL) {
+        return NULL;
+    }
+
+    void (*listener)() =
+        __atomic_load_n(&memory_allocation_listener, __ATOMIC_ACQUIRE);
+    if (listener != NULL) {
+        listener();
+    }
+
+    void (*sized_listener)(size_t, trie_memory_category_t) = __atomic_load_n(
+        &sized_memory_allocation_listener, __ATOMIC_ACQUIRE);
+    if (sized_listener != NULL) {
+        sized_listener(size, category);
+    }
+
+    return allocated_memory;
+}
+
+void _deallocate_memory(void* memory, size_t size,
+    trie_memory_category_t category) {
+
+    free(memory);
+
+    void (*listener)() =
+        __atomic_load_n(&memory_deallocation_listener, __ATOMIC_ACQUIRE);
+    if (listener != NULL) {
+        listener();
+    }
+
+    void (*sized_listener)(size_t, trie_memory_category_t) = __atomic_load_n(
+        &sized_memory_deallocation_listener, __ATOMIC_ACQUIRE);
+    if (sized_listener != NULL) {
+        sized_listener(size, category);
+    }
+}
+
+// Ensures the array of elements of the given size pointed to by array has a
+// capacity of at least needed elements, doubling it if not. Returns false if
+// memory allocation fails
+bool _reserve(void** array, size_t* capacity, size_t needed,
+    size_t element_size) {
+
+    if (needed <= *capacity) {
+        return true;
+    }
+
+    size_t grown_capacity = *capacity == 0U ? 16U : *capacity * 2U;
+    if (grown_capacity < needed) {
+        grown_capacity = needed;
+    }
+
+    void* grown_array =
+        _allocate_memory(grown_capacity * element_size, TRIE_MEMORY_OTHER);
+    if (grown_array == NULL) {
+        return false;
+    }
+
+    if (*array != NULL) {
+        memcpy(grown_array, *array, *capacity * element_size);
+        _release(*array, *capacity, element_size);
+    }
+    *array = grown_array;
+    *capacity = grown_capacity;
+
+    return true;
+}
+
+// Deallocates an array grown by _reserve() to a capacity of capacity elements
+// of the given size, if it was ever allocated
+void _release(void* array, size_t capacity, size_t element_size) {
+    if (array != NULL) {
+        _deallocate_memory(array, capacity * element_size, TRIE_MEMORY_OTHER);
+    }
+}
+
+// Attempts to allocate a chunk able to hold at least capacity bytes, of the
+// given category, returning it if successful or NULL if memory allocation
+// fails
+_trie_arena_chunk_t* _create_arena_chunk(size_t capacity,
+    _trie_arena_chunk_t* previous, trie_memory_category_t category) {
+
+    _trie_arena_chunk_t* chunk = _allocate_memory(
+        sizeof(_trie_arena_chunk_t) + capacity, category);
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    chunk->previous = previous;
+    chunk->capacity = capacity;
+    chunk->used = 0U;
+
+    return chunk;
+}
+
+// Deallocates a chunk allocated by _create_arena_chunk()
+void _deallocate_arena_chunk(_trie_arena_chunk_t* chunk,
+    trie_memory_category_t category) {
+
+    _deallocate_memory(chunk, sizeof(_trie_arena_chunk_t) + chunk->capacity,
+        category);
+}
+
+// Returns the number of bytes taken up in an arena chunk by an allocation of
+// size bytes
+size_t _get_arena_size(size_t size) {
+    return (size + _TRIE_ARENA_ALIGNMENT - 1U) & ~(_TRIE_ARENA_ALIGNMENT - 1U);
+}
+
+// Carves size bytes out of the arena, starting a new chunk (twice the size of
+// the current one, or larger if needed) of the given category when the
+// current chunk is exhausted. Returns NULL if memory allocation fails
+void* _allocate_from_arena(_trie_arena_t* arena, size_t size,
+    trie_memory_category_t category) {
+
+    size_t aligned_size = _get_arena_size(size);
+
+    _trie_arena_chunk_t* chunk = arena->current_chunk;
+    if (chunk->capacity - chunk->used < aligned_size) {
+        size_t capacity = chunk->capacity * 2U;
+        if (capacity < aligned_size) {
+            capacity = aligned_size;
+        }
+
+        chunk = _create_arena_chunk(capacity, chunk, category);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        arena->current_chunk = chunk;
+    }
+
+    void* allocated_memory = chunk->memory + chunk->used;
+    chunk->used += aligned_size;
+
+    return allocated_memory;
+}
+
+// Carves size bytes out of an arena shared by several threads, like
+// _allocate_from_arena(). Space within a chunk is claimed with an atomic add,
+// and a new chunk replaces the current one with a compare-and-swap, so threads
+// never wait for each other. When the arena has no chunk yet, the first holds
+// initial_bytes. Returns NULL if memory allocation fails
+void* _allocate_from_shared_arena(_trie_arena_t* arena, size_t size,
+    size_t initial_bytes, trie_memory_category_t category) {
+
+    size_t aligned_size = _get_arena_size(size);
+
+    _trie_arena_chunk_t* chunk =
+        __atomic_load_n(&(arena->current_chunk), __ATOMIC_ACQUIRE);
+    while (true) {
+        if (chunk != NULL) {
+            size_t used = __atomic_fetch_add(&(chunk->used), aligned_size,
+                __ATOMIC_RELAXED);
+            if (used <= chunk->capacity &&
+                chunk->capacity - used >= aligned_size) {
+                return chunk->memory + used;
+            }
+        }
+
+        size_t capacity = chunk == NULL ? initial_bytes : chunk->capacity * 2U;
+        if (capacity < aligned_size) {
+            capacity = aligned_size;
+        }
+
+        _trie_arena_chunk_t* created_chunk =
+            _create_arena_chunk(capacity, chunk, category);
+        if (created_chunk == NULL) {
+            return NULL;
+        }
+
+        // On failure another thread replaced the chunk first, and chunk is
+        // set to its replacement
+        if (__atomic_compare_exchange_n(&(arena->current_chunk), &chunk,
+            created_chunk, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            chunk = created_chunk;
+        }
+        else {
+            _deallocate_arena_chunk(created_chunk, category);
+        }
+    }
+}
+
+// Frees every chunk of the arena, each of the given category
+void _destroy_arena_chunks(_trie_arena_t* arena,
+    trie_memory_category_t category) {
+
+    _trie_arena_chunk_t* chunk = arena->current_chunk;
+    while (chunk != NULL) {
+        _trie_arena_chunk_t* previous_chunk = chunk->previous;
+        _deallocate_arena_chunk(chunk, category);
+        chunk = previous_chunk;
+    }
+}
+
+// Frees every chunk of the arena, and the arena itself
+void _destroy_arena(_trie_arena_t* arena) {
+    _destroy_arena_chunks(arena, TRIE_MEMORY_ARENA);
+    _deallocate_memory(arena, sizeof(_trie_arena_t), TRIE_MEMORY_ARENA);
+}
+
+// Allocates memory of the given category for a node or children block
+// belonging to trie, from its arena if it has one
+void* _allocate_trie_memory(trie_t* trie, size_t size,
+    trie_memory_category_t category) {
+
+    if (trie->arena != NULL) {
+        return trie->epochs == NULL ?
+            _allocate_from_arena(trie->arena, size, TRIE_MEMORY_ARENA) :
+            _allocate_from_shared_arena(trie->arena, size, 0U,
+                TRIE_MEMORY_ARENA);
+    }
+
+    return _allocate_memory(size, category);
+}
+
+// Returns the number of bytes allocated for node
+size_t _get_node_size(const _trie_node_t* node) {
+    return sizeof(_trie_node_t) + node->label_length;
+}
+
+// Deallocates a node created by _create_node(). Memory carved out of an arena
+// is only released when the whole arena is destroyed
+void _deallocate_node(trie_t* trie, _trie_node_t* node) {
+    if (trie->arena == NULL) {
+        _deallocate_memory(node, _get_node_size(node), TRIE_MEMORY_NODES);
+    }
+}
+
+// Deallocates a children block created by _create_children(), like
+// _deallocate_node()
+void _deallocate_children(trie_t* trie, _trie_children_t* children) {
+    if (trie->arena == NULL) {
+        _deallocate_memory(children, _children_sizes[children->kind],
+            TRIE_MEMORY_CHILDREN);
+    }
+}
+
+// Attempts to create an arena whose first chunk holds initial_bytes, returning
+// it if successful or NULL if memory allocation fails
+_trie_arena_t* _create_arena(size_t initial_bytes) {
+    _trie_arena_t* arena =
+        _allocate_memory(sizeof(_trie_arena_t), TRIE_MEMORY_ARENA);
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    arena->current_chunk =
+        _create_arena_chunk(initial_bytes, NULL, TRIE_MEMORY_ARENA);
+    if (arena->current_chunk == NULL) {
+        _deallocate_memory(arena, sizeof(_trie_arena_t), TRIE_MEMORY_ARENA);
+        return NULL;
+    }
+
+    return arena;
+}
+
+// Allocates memory for a copy of a word belonging to trie. Words are never
+// allocated individually: they are carved out of the arena of the trie if it
+// has one, or otherwise out of its word pool, the first chunk of which is
+// allocated on first use. Returns NULL if memory allocation fails
+char* _allocate_word_memory(trie_t* trie, size_t size) {
+    if (trie->epochs != NULL) {
+        return trie->arena != NULL ?
+            _allocate_from_shared_arena(trie->arena, size, 0U,
+                TRIE_MEMORY_ARENA) :
+            _allocate_from_shared_arena(&(trie->word_pool), size,
+                _TRIE_WORD_POOL_INITIAL_BYTES, TRIE_MEMORY_STRINGS);
+    }
+
+    if (trie->arena != NULL) {
+        return _allocate_from_arena(trie->arena, size, TRIE_MEMORY_ARENA);
+    }
+
+    if (trie->word_pool.current_chunk == NULL) {
+        trie->word_pool.current_chunk = _create_arena_chunk(
+            _TRIE_WORD_POOL_INITIAL_BYTES, NULL, TRIE_MEMORY_STRINGS);
+        if (trie->word_pool.current_chunk == NULL) {
+            return NULL;
+        }
+    }
+
+    return _allocate_from_arena(&(trie->word_pool), size,
+        TRIE_MEMORY_STRINGS);
+}
+
+// Attempts to create a node without a word or children, labelled with the
+// first_length bytes of first followed by the second_length bytes of second.
+// Returns the node if successful, or NULL if memory allocation fails
+_trie_node_t* _create_joined_node(trie_t* trie, const char* first,
+    uint32_t first_length, const char* second, uint32_t second_length) {
+
+    uint32_t label_length = first_length + second_length;
+    _trie_node_t* node = _allocate_trie_memory(trie,
+        sizeof(_trie_node_t) + label_length, TRIE_MEMORY_NODES);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    node->word = NULL;
+    node->value = NULL;
+    node->children = NULL;
+    node->terminal = false;
+    node->weight = 0U;
+    node->max_weight = 0U;
+    node->label_length = label_length;
+    node->word_count = 0U;
+    memcpy(node->label, first, first_length);
+    if (second_length > 0U) {
+        memcpy(node->label + first_length, second, second_length);
+    }
+
+    return node;
+}
+
+// Attempts to create a node without a word or children, labelled with the
+// first label_length bytes of label. Returns the node if successful, or NULL
+// if memory allocation fails
+_trie_node_t* _create_node(trie_t* trie, const char* label,
+    uint32_t label_length) {
+
+    return _create_joined_node(trie, label, label_length, NULL, 0U);
+}
+
+trie_result_t trie_create(trie_t** trie) {
+    trie_options_t options = { 0U, true, false };
+
+    return trie_create_with_options(trie, &options);
+}
+
+trie_result_t trie_create_with_arena(trie_t** trie, size_t initial_bytes) {
+    if (initial_bytes == 0U) {
+        return TRIE_ARENA_SIZE_ZERO;
+    }
+
+    trie_options_t options = { initial_bytes, true, false };
+
+    return trie_create_with_options(trie, &options);
+}
+
+trie_result_t trie_create_with_options(trie_t** trie,
+    const trie_options_t* options) {
+
+    trie_t* created = _allocate_memory(sizeof(trie_t), TRIE_MEMORY_OTHER);
+    if (created == NULL) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    memset(created, 0, sizeof(trie_t));
+    created->kind = _TRIE_NODES;
+    created->store_words = options->store_words;
+
+    if (options->concurrent) {
+        created->epochs = _create_epochs();
+        if (created->epochs == NULL) {
+            _deallocate_memory(created, sizeof(trie_t), TRIE_MEMORY_OTHER);
+            return TRIE_MALLOC_FAIL;
+        }
+    }
+
+    if (options->arena_initial_bytes != 0U) {
+        created->arena = _create_arena(options->arena_initial_bytes);
+        if (created->arena == NULL) {
+            if (created->epochs != NULL) {
+                _destroy_epochs(created);
+            }
+            _deallocate_memory(created, sizeof(trie_t), TRIE_MEMORY_OTHER);
+            return TRIE_MALLOC_FAIL;
+        }
+    }
+
+    created->root = _create_node(created, "", 0U);
+    if (created->root == NULL) {
+        if (created->epochs != NULL) {
+            _destroy_epochs(created);
+        }
+        if (created->arena != NULL) {
+            _destroy_arena(created->arena);
+        }
+        _deallocate_memory(created, sizeof(trie_t), TRIE_MEMORY_OTHER);
+        return TRIE_MALLOC_FAIL;
+    }
+
+    *trie = created;
+
+    return TRIE_SUCCESS;
+}
+
+// Size in bytes of each children class, indexed by _trie_children_kind_t
+const size_t _children_sizes[] = {
+    sizeof(_trie_children4_t),
+    sizeof(_trie_children16_t),
+    sizeof(_trie_children48_t),
+    sizeof(_trie_children256_t)
 };
 
-struct trie_t {
-    _trie_node_list_t roots;
-};
+// Maximum number of children held by each children class, indexed by
+// _trie_children_kind_t
+const uint16_t _children_capacities[] = { 4U, 16U, 48U, 256U };
+
+// Returns the index of key within the first count entries of the sorted keys
+// array or count if key is not present
+uint16_t _find_sorted_key(const unsigned char* keys, uint16_t count,
+    unsigned char key) {
+
+    for (uint16_t i = 0U; i < count; i++) {
+        if (keys[i] == key) {
+            return i;
+        }
+    }
+
+    return count;
+}
+
+// Returns the index of key within the 16 entry keys array of a
+// _trie_children16_t holding count keys, or count if key is not present
+uint16_t _find_key16(const unsigned char* keys, uint16_t count,
+    unsigned char key) {
+#if defined(__SSE2__)
+    __m128i matches = _mm_cmpeq_epi8(_mm_set1_epi8((char) key),
+        _mm_loadu_si128((const __m128i*) keys));
+    int mask = _mm_movemask_epi8(matches) & ((1 << count) - 1);
+
+    return mask == 0 ? count : (uint16_t) __builtin_ctz(mask);
+#else
+    return _find_sorted_key(keys, count, key);
+#endif
+}
+
+// Returns the child within children, which may be NULL, reached through the
+// edge with the given key, setting label_length to the length of the edge
+// label, or returns NULL if there is no such child
+_trie_node_t* _get_child_from(const _trie_children_t* children,
+    unsigned char key, uint32_t* label_length) {
+
+    if (children == NULL) {
+        return NULL;
+    }
+
+    switch (children->kind) {
+        case _TRIE_CHILDREN_4: {
+            const _trie_children4_t* children4 =
+                (const _trie_children4_t*) children;
+            uint16_t i =
+                _find_sorted_key(children4->keys, children->count, key);
+            if (i == children->count) {
+                return NULL;
+            }
+            *label_length = children4->label_lengths[i];
+            return children4->nodes[i];
+        }
+        case _TRIE_CHILDREN_16: {
+            const _trie_children16_t* children16 =
+                (const _trie_children16_t*) children;
+            uint16_t i = _find_key16(children16->keys, children->count, key);
+            if (i == children->count) {
+                return NULL;
+            }
+            *label_length = children16->label_lengths[i];
+            return children16->nodes[i];
+        }
+        case _TRIE_CHILDREN_48: {
+            const _trie_children48_t* children48 =
+                (const _trie_children48_t*) children;
+            uint8_t index = children48->indexes[key];
+            if (index == 0U) {
+                return NULL;
+            }
+            *label_length = children48->label_lengths[index-1];
+            return children48->nodes[index-1];
+        }
+        default: {
+            const _trie_children256_t* children256 =
+                (const _trie_children256_t*) children;
+            *label_length = children256->label_lengths[key];
+            return children256->nodes[key];
+        }
+    }
+}
+
+// Returns the child of node reached through the edge with the given key,
+// setting label_length to the length of the edge label, or returns NULL if
+// node has no such child
+_trie_node_t* _get_child(const _trie_node_t* node, unsigned char key,
+    uint32_t* label_length) {
+
+    return _get_child_from(
+        __atomic_load_n(&(node->children), __ATOMIC_ACQUIRE), key,
+        label_length);
+}
+
+// Returns the label of an edge of the given length leading to node
+const char* _get_edge_label(const _trie_node_t* node, uint32_t label_length) {
+    return node->label + node->label_length - label_length;
+}
+
+// Attempts to create an empty children block of the given class, returning it
+// if successful or NULL if memory allocation fails
+_trie_children_t* _create_children(trie_t* trie, _trie_children_kind_t kind) {
+    _trie_children_t* children = _allocate_trie_memory(trie,
+        _children_sizes[kind], TRIE_MEMORY_CHILDREN);
+    if (children == NULL) {
+        return NULL;
+    }
+
+    memset(children, 0, _children_sizes[kind]);
+    children->kind = kind;
+
+    return children;
+}
+
+// Inserts child under key into the first count entries of the sorted keys,
+// label_lengths and nodes arrays, which must have room for one more entry
+void _insert_sorted_child(unsigned char* keys, uint32_t* label_lengths,
+    _trie_node_t** nodes, uint16_t count, unsigned char key,
+    uint32_t label_length, _trie_node_t* child) {
+
+    uint16_t position = count;
+    while (position > 0U && keys[position-1] > key) {
+        position--;
+    }
+
+    memmove(keys+position+1, keys+position, count-position);
+    memmove(label_lengths+position+1, label_lengths+position,
+        (count-position)*sizeof(uint32_t));
+    memmove(nodes+position+1, nodes+position,
+        (count-position)*sizeof(_trie_node_t*));
+    keys[position] = key;
+    label_lengths[position] = label_length;
+    nodes[position] = child;
+}
+
+// Inserts child, reached through an edge with the given key and label length,
+// into children. children must not already contain key and must have spare
+// capacity
+void _insert_child(_trie_children_t* children, unsigned char key,
+    uint32_t label_length, _trie_node_t* child) {
+
+    switch (children->kind) {
+        case _TRIE_CHILDREN_4: {
+            _trie_children4_t* children4 = (_trie_children4_t*) children;
+            _insert_sorted_child(children4->keys, children4->label_lengths,
+                children4->nodes, children->count, key, label_length, child);
+            break;
+        }
+        case _TRIE_CHILDREN_16: {
+            _trie_children16_t* children16 = (_trie_children16_t*) children;
+            _insert_sorted_child(children16->keys, children16->label_lengths,
+                children16->nodes, children->count, key, label_length, child);
+            break;
+        }
+        case _TRIE_CHILDREN_48: {
+            _trie_children48_t* children48 = (_trie_children48_t*) children;
+            children48->label_lengths[children->count] = label_length;
+            children48->nodes[children->count] = child;
+            children48->indexes[key] = (uint8_t) (children->count+1);
+            break;
+        }
+        default: {
+            _trie_children256_t* children256 = (_trie_children256_t*) children;
+            children256->label_lengths[key] = label_length;
+            children256->nodes[key] = child;
+            break;
+        }
+    }
+
+    children->count++;
+}
+
+// Replaces the child reached through the edge with the given key, which must
+// exist, with child reached through an edge of the given label length
+void _replace_child(_trie_children_t* children, unsigned char key,
+    uint32_t label_length, _trie_node_t* child) {
+
+    switch (children->kind) {
+        case _TRIE_CHILDREN_4: {
+            _trie_children4_t* children4 = (_trie_children4_t*) children;
+            uint16_t i =
+                _find_sorted_key(children4->keys, children->count, key);
+            children4->label_lengths[i] = label_length;
+            children4->nodes[i] = child;
+            break;
+        }
+        case _TRIE_CHILDREN_16: {
+            _trie_children16_t* children16 = (_trie_children16_t*) children;
+            uint16_t i = _find_key16(children16->keys, children->count, key);
+            children16->label_lengths[i] = label_length;
+            children16->nodes[i] = child;
+            break;
+        }
+        case _TRIE_CHILDREN_48: {
+            _trie_children48_t* children48 = (_trie_children48_t*) children;
+            uint8_t index = children48->indexes[key];
+            children48->label_lengths[index-1] = label_length;
+            children48->nodes[index-1] = child;
+            break;
+        }
+        default: {
+            _trie_children256_t* children256 = (_trie_children256_t*) children;
+            children256->label_lengths[key] = label_length;
+            children256->nodes[key] = child;
+            break;
+        }
+    }
+}
+
+// Removes the child reached through the edge with the given key, which must
+// exist
+void _remove_child(_trie_children_t* children, unsigned char key) {
+    uint16_t last = (uint16_t) (children->count-1);
+    switch (children->kind) {
+        case _TRIE_CHILDREN_4: {
+            _trie_children4_t* children4 = (_trie_children4_t*) children;
+            uint16_t i =
+                _find_sorted_key(children4->keys, children->count, key);
+            memmove(children4->keys+i, children4->keys+i+1, last-i);
+            memmove(children4->label_lengths+i, children4->label_lengths+i+1,
+                (last-i)*sizeof(uint32_t));
+            memmove(children4->nodes+i, children4->nodes+i+1,
+                (last-i)*sizeof(_trie_node_t*));
+            break;
+        }
+        case _TRIE_CHILDREN_16: {
+            _trie_children16_t* children16 = (_trie_children16_t*) children;
+            uint16_t i = _find_key16(children16->keys, children->count, key);
+            memmove(children16->keys+i, children16->keys+i+1, last-i);
+            memmove(children16->label_lengths+i,
+                children16->label_lengths+i+1, (last-i)*sizeof(uint32_t));
+            memmove(children16->nodes+i, children16->nodes+i+1,
+                (last-i)*sizeof(_trie_node_t*));
+            break;
+        }
+        case _TRIE_CHILDREN_48: {
+            // The last child moves into the place of the one removed
+            _trie_children48_t* children48 = (_trie_children48_t*) children;
+            uint8_t index = children48->indexes[key];
+            children48->indexes[key] = 0U;
+            if (index-1 != last) {
+                children48->label_lengths[index-1] =
+                    children48->label_lengths[last];
+                children48->nodes[index-1] = children48->nodes[last];
+                for (unsigned moved_key = 0U; moved_key < 256U; moved_key++) {
+                    if (children48->indexes[moved_key] == last+1) {
+                        children48->indexes[moved_key] = index;
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+        default: {
+            _trie_children256_t* children256 = (_trie_children256_t*) children;
+            children256->label_lengths[key] = 0U;
+            children256->nodes[key] = NULL;
+            break;
+        }
+    }
+
+    children->count--;
+}
+
+// Starts an iteration over the children of node
+void _begin_children(const _trie_node_t* node,
+    _trie_children_iterator_t* iterator) {
+
+    iterator->children = __atomic_load_n(&(node->children), __ATOMIC_ACQUIRE);
+    iterator->position = 0U;
+}
+
+// Advances to the next child in key order, setting key, label_length and
+// child and returning true, or returning false if there are no more children
+bool _next_child(_trie_children_iterator_t* iterator, unsigned char* key,
+    uint32_t* label_length, _trie_node_t** child) {
+
+    const _trie_children_t* children = iterator->children;
+    if (children == NULL) {
+        return false;
+    }
+
+    switch (children->kind) {
+        case _TRIE_CHILDREN_4: {
+            const _trie_children4_t* children4 =
+                (const _trie_children4_t*) children;
+            if (iterator->position == children->count) {
+                return false;
+            }
+            *key = children4->keys[iterator->position];
+            *label_length = children4->label_lengths[iterator->position];
+            *child = children4->nodes[iterator->position];
+            iterator->position++;
+            return true;
+        }
+        case _TRIE_CHILDREN_16: {
+            const _trie_children16_t* children16 =
+                (const _trie_children16_t*) children;
+            if (iterator->position == children->count) {
+                return false;
+            }
+            *key = children16->keys[iterator->position];
+            *label_length = children16->label_lengths[iterator->position];
+            *child = children16->nodes[iterator->position];
+            iterator->position++;
+            return true;
+        }
+        case _TRIE_CHILDREN_48: {
+            const _trie_children48_t* children48 =
+                (const _trie_children48_t*) children;
+            while (iterator->position < 256U) {
+                uint8_t index = children48->indexes[iterator->position];
+                iterator->position++;
+                if (index != 0U) {
+                    *key = (unsigned char) (iterator->position-1);
+                    *label_length = children48->label_lengths[index-1];
+                    *child = children48->nodes[index-1];
+                    return true;
+                }
+            }
+            return false;
+        }
+        default: {
+            const _trie_children256_t* children256 =
+                (const _trie_children256_t*) children;
+            while (iterator->position < 256U) {
+                _trie_node_t* node = children256->nodes[iterator->position];
+                iterator->position++;
+                if (node != NULL) {
+                    *key = (unsigned char) (iterator->position-1);
+                    *label_length =
+                        children256->label_lengths[iterator->position-1];
+                    *child = node;
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+}
+
+// Moves iterator to the first child whose key is at least key, where a key
+// of 256 moves it beyond every child
+void _seek_children(_trie_children_iterator_t* iterator, uint16_t key) {
+    const _trie_children_t* children = iterator->children;
+    if (children == NULL) {
+        return;
+    }
+
+    const unsigned char* keys;
+    switch (children->kind) {
+        case _TRIE_CHILDREN_4:
+            keys = ((const _trie_children4_t*) children)->keys;
+            break;
+        case _TRIE_CHILDREN_16:
+            keys = ((const _trie_children16_t*) children)->keys;
+            break;
+        default:
+            iterator->position = key;
+            return;
+    }
+
+    uint16_t position = 0U;
+    while (position < children->count && keys[position] < key) {
+        position++;
+    }
+    iterator->position = position;
+}
+
+// Attempts to create a children block of the given class holding the same
+// children as children, which may be NULL. Returns the block if successful,
+// or NULL if memory allocation fails
+_trie_children_t* _copy_children(trie_t* trie,
+    const _trie_children_t* children, _trie_children_kind_t kind) {
+
+    _trie_children_t* copied_children = _create_children(trie, kind);
+    if (copied_children == NULL) {
+        return NULL;
+    }
+
+    _trie_children_iterator_t iterator = { children, 0U };
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        _insert_child(copied_children, key, label_length, child);
+    }
+
+    return copied_children;
+}
+
+// Outcome of a change to the children of a node
+typedef enum {
+    _TRIE_CHANGED,
+    // Another thread changed the children of the node first, so the change
+    // must be retried from a fresh look at them
+    _TRIE_CHANGE_LOST,
+    _TRIE_CHANGE_MALLOC_FAIL
+} _trie_change_t;
+
+// Adds child, reached through an edge with the given key and label length, to
+// the children of node, provided they are still those in which the key was
+// looked up and found to be missing. The children are replaced by the next
+// larger class when full
+_trie_change_t _add_child(trie_t* trie, _trie_node_t* node,
+    _trie_children_t* children, unsigned char key, uint32_t label_length,
+    _trie_node_t* child) {
+
+    bool full = children != NULL &&
+        children->count == _children_capacities[children->kind];
+    if (children != NULL && !full && trie->epochs == NULL) {
+        _insert_child(children, key, label_length, child);
+        return _TRIE_CHANGED;
+    }
+
+    // A new block is needed: the first, a larger one or, in a concurrent
+    // trie, a copy, since readers may be using the current one
+    _trie_children_kind_t kind = children == NULL ? _TRIE_CHILDREN_4 :
+        full ? children->kind+1 : children->kind;
+    _trie_children_t* copied_children =
+        _copy_children(trie, children, kind);
+    if (copied_children == NULL) {
+        return _TRIE_CHANGE_MALLOC_FAIL;
+    }
+
+    _insert_child(copied_children, key, label_length, child);
+    if (!_publish_children(trie, node, children, copied_children)) {
+        _deallocate_children(trie, copied_children);
+        return _TRIE_CHANGE_LOST;
+    }
+
+    return _TRIE_CHANGED;
+}
+
+// Replaces the child of node reached through the edge with the given key,
+// which must exist, with child reached through an edge of the given label
+// length, provided the children of node are still those in which the key was
+// looked up
+_trie_change_t _replace_child_of(trie_t* trie, _trie_node_t* node,
+    const _trie_children_t* looked_up, unsigned char key,
+    uint32_t label_length, _trie_node_t* child) {
+
+    if (trie->epochs == NULL) {
+        _replace_child(node->children, key, label_length, child);
+        return _TRIE_CHANGED;
+    }
+
+    _trie_children_t* copied_children =
+        _copy_children(trie, looked_up, looked_up->kind);
+    if (copied_children == NULL) {
+        return _TRIE_CHANGE_MALLOC_FAIL;
+    }
+
+    _replace_child(copied_children, key, label_length, child);
+    if (!_publish_children(trie, node, looked_up, copied_children)) {
+        _deallocate_children(trie, copied_children);
+        return _TRIE_CHANGE_LOST;
+    }
+
+    return _TRIE_CHANGED;
+}
+
+// Returns the number of leading bytes which a and b have in common, examining
+// at most length bytes
+uint32_t _common_prefix_length(const char* a, const char* b, uint32_t length) {
+    uint32_t common = 0U;
+    while (common < length && a[common] == b[common]) {
+        common++;
+    }
+
+    return common;
+}
+
+// Follows the edges from node spelling out the length bytes of prefix, which
+// may end part of the way along an edge. Returns the node at the end of the
+// final edge followed, setting remaining_length to the number of bytes of its
+// label beyond the end of prefix, or returns NULL if no such node exists
+_trie_node_t* _find_prefix_node(_trie_node_t* node, const char* prefix,
+    size_t length, uint32_t* remaining_length) {
+
+    *remaining_length = 0U;
+
+    size_t i = 0U;
+    while (i < length) {
+        uint32_t label_length;
+        _trie_node_t* child =
+            _get_child(node, (unsigned char) prefix[i], &label_length);
+        if (child == NULL) {
+            return NULL;
+        }
+
+        const char* label = _get_edge_label(child, label_length);
+        size_t remaining = length-i;
+        if (remaining < label_length) {
+            if (memcmp(label, prefix+i, remaining) != 0) {
+                return NULL;
+            }
+            *remaining_length = label_length - (uint32_t) remaining;
+            return child;
+        }
+
+        if (memcmp(label, prefix+i, label_length) != 0) {
+            return NULL;
+        }
+
+        i += label_length;
+        node = child;
+    }
+
+    return node;
+}
+
+// Follows the edges from node spelling out the length bytes of key. Returns
+// the node at the end of key, or NULL if no such node exists
+_trie_node_t* _find_node(_trie_node_t* node, const char* key, size_t length) {
+    uint32_t remaining_length;
+    node = _find_prefix_node(node, key, length, &remaining_length);
+
+    return remaining_length == 0U ? node : NULL;
+}
+
+// Raises the greatest weight below node to at least weight
+void _raise_max_weight(_trie_node_t* node, uint32_t weight) {
+    uint32_t max_weight =
+        __atomic_load_n(&(node->max_weight), __ATOMIC_ACQUIRE);
+    while (max_weight < weight &&
+        !__atomic_compare_exchange_n(&(node->max_weight), &max_weight,
+            weight, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+// Returns the node at the end of the length bytes of key, creating it, and
+// splitting any edge which key ends or diverges part of the way along, as
+// needed. In a concurrent trie, a step which loses a race with another writer
+// changing the same children is retried. Returns NULL if memory allocation
+// fails
+_trie_node_t* _find_or_create_node(trie_t* trie, const char* key,
+    size_t length) {
+
+    _trie_node_t* node = trie->root;
+    size_t i = 0U;
+    while (i < length) {
+        unsigned char key_char = (unsigned char) key[i];
+        size_t remaining = length-i;
+        _trie_children_t* looked_up =
+            __atomic_load_n(&(node->children), __ATOMIC_ACQUIRE);
+        uint32_t label_length;
+        _trie_node_t* child = _get_child_from(looked_up, key_char,
+            &label_length);
+        if (child == NULL) {
+            uint32_t leaf_label_length = remaining > UINT32_MAX ?
+                UINT32_MAX : (uint32_t) remaining;
+            _trie_node_t* leaf =
+                _create_node(trie, key+i, leaf_label_length);
+            if (leaf == NULL) {
+                return NULL;
+            }
+
+            _trie_change_t change = _add_child(trie, node, looked_up,
+                key_char, leaf_label_length, leaf);
+            if (change != _TRIE_CHANGED) {
+                _deallocate_node(trie, leaf);
+                if (change == _TRIE_CHANGE_MALLOC_FAIL) {
+                    return NULL;
+                }
+                continue;
+            }
+
+            i += leaf_label_length;
+            node = leaf;
+            continue;
+        }
+
+        const char* label = _get_edge_label(child, label_length);
+        uint32_t common = _common_prefix_length(label, key+i,
+            remaining < label_length ? (uint32_t) remaining : label_length);
+        if (common < label_length) {
+            _trie_node_t* middle = _create_node(trie, label, common);
+            if (middle == NULL) {
+                return NULL;
+            }
+            middle->max_weight =
+                __atomic_load_n(&(child->max_weight), __ATOMIC_RELAXED);
+            middle->word_count = child->word_count;
+
+            if (_add_child(trie, middle, NULL, (unsigned char) label[common],
+                label_length-common, child) != _TRIE_CHANGED) {
+                _deallocate_node(trie, middle);
+                return NULL;
+            }
+
+            _trie_change_t change = _replace_child_of(trie, node, looked_up,
+                key_char, common, middle);
+            if (change != _TRIE_CHANGED) {
+                _deallocate_children(trie, middle->children);
+                _deallocate_node(trie, middle);
+                if (change == _TRIE_CHANGE_MALLOC_FAIL) {
+                    return NULL;
+                }
+                continue;
+            }
+
+            // A writer which looked up child before middle was published
+            // raises child but not middle. Either its raise is seen here or
+            // it finds middle afterwards, see _raise_max_weights()
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            _raise_max_weight(middle,
+                __atomic_load_n(&(child->max_weight), __ATOMIC_RELAXED));
+            child = middle;
+        }
+
+        i += common;
+        node = child;
+    }
+
+    return node;
+}
+
+// Marks node as the end of the word of the given length, storing a copy of
+// the word if trie stores words. Returns false if memory allocation fails
+bool _set_terminal(trie_t* trie, _trie_node_t* node, const char* word,
+    size_t word_length) {
+
+    if (trie->store_words) {
+        char* allocated_word = _allocate_word_memory(trie, word_length+1);
+        if (allocated_word == NULL) {
+            return false;
+        }
+        memcpy(allocated_word, word, word_length);
+        allocated_word[word_length] = '\0';
+
+        // When concurrent writers add the same word, the first copy is kept
+        // and the others are left unused in the word pool
+        char* expected = NULL;
+        __atomic_compare_exchange_n(&(node->word), &expected, allocated_word,
+            false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+
+    // Published after the word, so a concurrent reader which sees the node as
+    // terminal also sees its word
+    __atomic_store_n(&(node->terminal), true, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+// Returns whether or not a word ends at node
+bool _is_terminal_node(const _trie_node_t* node) {
+    return __atomic_load_n(&(node->terminal), __ATOMIC_ACQUIRE);
+}
+
+// Counts a word of the given length just added to trie in the word count of
+// each node on its path. Concurrent writers could split an edge on the path
+// between one counting and another, so the counts of a concurrent trie are
+// not kept, and _get_word_count() walks its nodes instead
+void _count_added_word(trie_t* trie, const char* word, size_t word_length) {
+    if (trie->epochs != NULL) {
+        return;
+    }
+
+    _trie_node_t* node = trie->root;
+    size_t i = 0U;
+    while (true) {
+        node->word_count++;
+        if (i == word_length) {
+            return;
+        }
+
+        uint32_t label_length;
+        node = _get_child(node, (unsigned char) word[i], &label_length);
+        i += label_length;
+    }
+}
+
+trie_result_t trie_add_key(trie_t* trie, const char* word,
+    size_t word_length) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (word == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    if (word_length == 0U) {
+        return TRIE_WORD_EMPTY;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_READ_ONLY;
+    }
+
+    // Other writers may retire children blocks while this one is looking
+    // through them
+    uint64_t* active = _begin_read(trie);
+    _trie_node_t* node = _find_or_create_node(trie, word, word_length);
+    bool was_terminal = node != NULL && _is_terminal_node(node);
+    bool added = node != NULL && (was_terminal ||
+        _set_terminal(trie, node, word, word_length));
+    if (added && !was_terminal) {
+        _count_added_word(trie, word, word_length);
+    }
+    _end_read(active);
+    if (!added) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    _reclaim_retired(trie);
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_add_word(trie_t* trie, const char* word) {
+    return trie_add_key(trie, word, word == NULL ? 0U : strlen(word));
+}
+
+// Raises the greatest weight below each node on the path of key to at least
+// weight. Nodes are raised from the end of key upwards, and with
+// compare-and-swap, so that concurrent writers raising or refreshing weights
+// on the same path never leave a node lower than one of its children
+void _raise_max_weights(_trie_node_t* node, const char* key, size_t length,
+    uint32_t weight) {
+
+    if (length > 0U) {
+        uint32_t label_length;
+        _trie_node_t* child =
+            _get_child(node, (unsigned char) key[0], &label_length);
+        _raise_max_weights(child, key+label_length, length-label_length,
+            weight);
+
+        // Another writer may since have split the edge into child, putting
+        // nodes between which were not raised. Either they are found here,
+        // or the splitting writer sees the raised weight of child
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        const _trie_node_t* between = node;
+        size_t offset = 0U;
+        while (true) {
+            uint32_t between_label_length;
+            _trie_node_t* next = _get_child(between,
+                (unsigned char) key[offset], &between_label_length);
+            if (next == child) {
+                break;
+            }
+            _raise_max_weight(next, weight);
+            between = next;
+            offset += between_label_length;
+        }
+    }
+
+    _raise_max_weight(node, weight);
+}
+
+// Returns the greatest weight of the word at node, if any, and the greatest
+// weights below its children
+uint32_t _get_max_weight(const _trie_node_t* node) {
+    uint32_t max_weight = _is_terminal_node(node) ?
+        __atomic_load_n(&(node->weight), __ATOMIC_RELAXED) : 0U;
+
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        uint32_t child_max_weight =
+            __atomic_load_n(&(child->max_weight), __ATOMIC_RELAXED);
+        if (max_weight < child_max_weight) {
+            max_weight = child_max_weight;
+        }
+    }
+
+    return max_weight;
+}
+
+// Recalculates the greatest weight below each node on the path of key, from
+// the weights of the children of those nodes. Each node is recalculated
+// again if its greatest weight changed while it was being recalculated
+void _refresh_max_weights(_trie_node_t* node, const char* key,
+    size_t length) {
+
+    if (length > 0U) {
+        uint32_t label_length;
+        _trie_node_t* child =
+            _get_child(node, (unsigned char) key[0], &label_length);
+        _refresh_max_weights(child, key+label_length, length-label_length);
+    }
+
+    uint32_t previous_max_weight =
+        __atomic_load_n(&(node->max_weight), __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&(node->max_weight),
+        &previous_max_weight, _get_max_weight(node), false, __ATOMIC_ACQ_REL,
+        __ATOMIC_ACQUIRE)) {
+    }
+}
+
+trie_result_t trie_add_weighted_key(trie_t* trie, const char* word,
+    size_t word_length, uint32_t weight) {
+
+    trie_result_t add_result = trie_add_key(trie, word, word_length);
+    if (add_result != TRIE_SUCCESS) {
+        return add_result;
+    }
+
+    uint64_t* active = _begin_read(trie);
+    _trie_node_t* node = _find_node(trie->root, word, word_length);
+    uint32_t previous_weight =
+        __atomic_exchange_n(&(node->weight), weight, __ATOMIC_ACQ_REL);
+    if (weight >= previous_weight) {
+        _raise_max_weights(trie->root, word, word_length, weight);
+    }
+    else {
+        _refresh_max_weights(trie->root, word, word_length);
+    }
+    _end_read(active);
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_add_weighted_word(trie_t* trie, const char* word,
+    uint32_t weight) {
+
+    return trie_add_weighted_key(
+        trie, word, word == NULL ? 0U : strlen(word), weight);
+}
+
+trie_result_t trie_put_key(trie_t* trie, const char* word, size_t word_length,
+    void* value) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (word == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    if (word_length == 0U) {
+        return TRIE_WORD_EMPTY;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_READ_ONLY;
+    }
+
+    uint64_t* active = _begin_read(trie);
+    _trie_node_t* node = _find_or_create_node(trie, word, word_length);
+    if (node != NULL) {
+        // Stored before the node is marked terminal, so a concurrent reader
+        // which sees the word also sees its value
+        __atomic_store_n(&(node->value), value, __ATOMIC_RELEASE);
+    }
+    bool was_terminal = node != NULL && _is_terminal_node(node);
+    bool added = node != NULL && (was_terminal ||
+        _set_terminal(trie, node, word, word_length));
+    if (added && !was_terminal) {
+        _count_added_word(trie, word, word_length);
+    }
+    _end_read(active);
+    if (!added) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    _reclaim_retired(trie);
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_put(trie_t* trie, const char* word, void* value) {
+    return trie_put_key(trie, word, word == NULL ? 0U : strlen(word), value);
+}
+
+// Merges child, reached from node through the edge with the given key and
+// label length, into the edge to its only child if it has no word, so that
+// the trie keeps the shape it would have if its words were added afresh.
+// Leaves both edges in place if memory allocation fails
+void _merge_child(trie_t* trie, _trie_node_t* node, unsigned char key,
+    uint32_t label_length, _trie_node_t* child) {
+
+    if (child->terminal || child->children == NULL ||
+        child->children->count != 1U) {
+        return;
+    }
+
+    _trie_children_iterator_t iterator;
+    _begin_children(child, &iterator);
+    unsigned char grandchild_key;
+    uint32_t grandchild_label_length;
+    _trie_node_t* grandchild;
+    _next_child(&iterator, &grandchild_key, &grandchild_label_length,
+        &grandchild);
+    if (grandchild_label_length > UINT32_MAX - label_length) {
+        return;
+    }
+
+    // The label of the grandchild may already end with the merged edge, if
+    // that edge was split when child was created
+    uint32_t merged_length = label_length + grandchild_label_length;
+    const char* label = _get_edge_label(child, label_length);
+    _trie_node_t* merged = grandchild;
+    if (grandchild->label_length < merged_length ||
+        memcmp(_get_edge_label(grandchild, merged_length), label,
+            label_length) != 0) {
+        merged = _create_joined_node(trie, label, label_length,
+            _get_edge_label(grandchild, grandchild_label_length),
+            grandchild_label_length);
+        if (merged == NULL) {
+            return;
+        }
+        merged->word = grandchild->word;
+        merged->value = grandchild->value;
+        merged->children = grandchild->children;
+        merged->terminal = grandchild->terminal;
+        merged->weight = grandchild->weight;
+        merged->max_weight = grandchild->max_weight;
+        merged->word_count = grandchild->word_count;
+        _deallocate_node(trie, grandchild);
+    }
+
+    _replace_child(node->children, key, merged_length, merged);
+    _deallocate_children(trie, child->children);
+    _deallocate_node(trie, child);
+}
+
+// Removes the word spelled out by the length bytes of key from the words at or
+// below node, setting removed if it was there, and prunes any child of node
+// left with neither a word nor children, or merges it into the edge below if
+// it is left without a word and with a single child. Returns whether or not
+// node itself is left with neither a word nor children
+bool _remove_from_node(trie_t* trie, _trie_node_t* node, const char* key,
+    size_t length, bool* removed) {
+
+    if (length == 0U) {
+        if (node->terminal) {
+            node->terminal = false;
+            node->word = NULL;
+            node->value = NULL;
+            node->weight = 0U;
+            *removed = true;
+        }
+    }
+    else {
+        uint32_t label_length;
+        _trie_node_t* child =
+            _get_child(node, (unsigned char) key[0], &label_length);
+        if (child == NULL || label_length > length ||
+            memcmp(_get_edge_label(child, label_length), key,
+                label_length) != 0) {
+            return false;
+        }
+
+        if (_remove_from_node(trie, child, key+label_length,
+            length-label_length, removed)) {
+            _remove_child(node->children, (unsigned char) key[0]);
+            if (node->children->count == 0U) {
+                _deallocate_children(trie, node->children);
+                node->children = NULL;
+            }
+            _destroy_node(trie, child);
+        }
+        else if (*removed) {
+            _merge_child(trie, node, (unsigned char) key[0], label_length,
+                child);
+        }
+    }
+
+    if (*removed) {
+        node->max_weight = _get_max_weight(node);
+        node->word_count--;
+    }
+
+    return !node->terminal && node->children == NULL;
+}
+
+trie_result_t trie_remove_key(trie_t* trie, const char* word,
+    size_t word_length) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (word == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    if (word_length == 0U) {
+        return TRIE_WORD_EMPTY;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_READ_ONLY;
+    }
+
+    if (trie->epochs == NULL) {
+        bool removed = false;
+        _remove_from_node(trie, trie->root, word, word_length, &removed);
+        return TRIE_SUCCESS;
+    }
+
+    // Another writer may be adding a word below any node of a concurrent
+    // trie, so nodes are never pruned from it: the word is only unmarked, and
+    // its nodes are reused if it is added again
+    uint64_t* active = _begin_read(trie);
+    _trie_node_t* node = _find_node(trie->root, word, word_length);
+    if (node != NULL && _is_terminal_node(node)) {
+        __atomic_store_n(&(node->terminal), false, __ATOMIC_RELEASE);
+        __atomic_store_n(&(node->value), NULL, __ATOMIC_RELAXED);
+        __atomic_store_n(&(node->weight), 0U, __ATOMIC_RELAXED);
+        _refresh_max_weights(trie->root, word, word_length);
+    }
+    _end_read(active);
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_remove_word(trie_t* trie, const char* word) {
+    return trie_remove_key(trie, word, word == NULL ? 0U : strlen(word));
+}
+
+trie_result_t trie_contains_key(trie_t* trie, const char* word,
+    size_t word_length, bool* contains) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (word == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    if (word_length == 0U) {
+        *contains = false;
+        return TRIE_SUCCESS;
+    }
+
+    if (trie->kind == _TRIE_MAPPED) {
+        *contains = _mapped_contains_word(trie->mapped, word, word_length);
+        return TRIE_SUCCESS;
+    }
+
+    if (trie->kind == _TRIE_DAWG) {
+        *contains = _dawg_contains_word(trie->dawg, word, word_length);
+        return TRIE_SUCCESS;
+    }
+
+    if (trie->kind == _TRIE_DOUBLE_ARRAY) {
+        *contains = _double_array_contains_word(
+            trie->double_array, word, word_length);
+        return TRIE_SUCCESS;
+    }
+
+    if (trie->kind == _TRIE_LOUDS) {
+        *contains = _louds_contains_word(trie->louds, word, word_length);
+        return TRIE_SUCCESS;
+    }
+
+    uint64_t* active = _begin_read(trie);
+    _trie_node_t* node = _find_node(trie->root, word, word_length);
+    *contains = node != NULL && _is_terminal_node(node);
+    _end_read(active);
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_contains_word(trie_t* trie, const char* word,
+    bool* contains) {
+
+    return trie_contains_key(
+        trie, word, word == NULL ? 0U : strlen(word), contains);
+}
+
+trie_result_t trie_get_key(trie_t* trie, const char* word, size_t word_length,
+    void** value) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (word == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    if (word_length == 0U) {
+        return TRIE_NOT_FOUND;
+    }
+
+    uint64_t* active = _begin_read(trie);
+    _trie_node_t* node = _find_node(trie->root, word, word_length);
+    bool found = node != NULL && _is_terminal_node(node);
+    if (found) {
+        *value = __atomic_load_n(&(node->value), __ATOMIC_ACQUIRE);
+    }
+    _end_read(active);
+
+    return found ? TRIE_SUCCESS : TRIE_NOT_FOUND;
+}
+
+trie_result_t trie_get(trie_t* trie, const char* word, void** value) {
+    return trie_get_key(trie, word, word == NULL ? 0U : strlen(word), value);
+}
+
+// Records that the first length bytes of the input of matches form a word,
+// finishing the search if there is no room for more lengths
+void _record_prefix_match(_trie_prefix_matches_t* matches, size_t length) {
+    matches->longest = length;
+    if (matches->lengths != NULL) {
+        matches->lengths[matches->match_count] = length;
+    }
+    matches->match_count++;
+
+    if (matches->match_count == matches->lengths_length) {
+        matches->done = true;
+    }
+}
+
+// Finds the words which are prefixes of input, following the path of input
+// from the root once and noting each terminal node on it
+void _find_node_prefix_matches(const _trie_node_t* root, const char* input,
+    size_t length, _trie_prefix_matches_t* matches) {
+
+    const _trie_node_t* node = root;
+    size_t i = 0U;
+    while (i < length && !matches->done) {
+        uint32_t label_length;
+        node = _get_child(node, (unsigned char) input[i], &label_length);
+        if (node == NULL || label_length > length-i ||
+            memcmp(_get_edge_label(node, label_length), input+i,
+                label_length) != 0) {
+            return;
+        }
+
+        i += label_length;
+        if (_is_terminal_node(node)) {
+            _record_prefix_match(matches, i);
+        }
+    }
+}
+
+// Finds the words which are prefixes of input in trie, whatever its kind
+void _find_prefix_matches(trie_t* trie, const char* input, size_t length,
+    _trie_prefix_matches_t* matches) {
+
+    if (trie->kind == _TRIE_MAPPED) {
+        _mapped_find_prefix_matches(trie->mapped, input, length, matches);
+    }
+    else if (trie->kind == _TRIE_DAWG) {
+        _dawg_find_prefix_matches(trie->dawg, input, length, matches);
+    }
+    else if (trie->kind == _TRIE_DOUBLE_ARRAY) {
+        _double_array_find_prefix_matches(
+            trie->double_array, input, length, matches);
+    }
+    else if (trie->kind == _TRIE_LOUDS) {
+        _louds_find_prefix_matches(trie->louds, input, length, matches);
+    }
+    else {
+        uint64_t* active = _begin_read(trie);
+        _find_node_prefix_matches(trie->root, input, length, matches);
+        _end_read(active);
+    }
+}
+
+trie_result_t trie_longest_prefix_match(trie_t* trie, const char* input,
+    size_t length, size_t* match_length) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (input == NULL) {
+        return TRIE_WORD_NULL;
+    }
+
+    _trie_prefix_matches_t matches = { NULL, 0U, 0U, 0U, false };
+    _find_prefix_matches(trie, input, length, &matches);
+    *match_length = matches.longest;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_prefix_matches(trie_t* trie, const char* input,
+    size_t length, size_t* match_lengths, size_t match_lengths_length,
+    size_t* match_count) {
+
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (input == NULL) {
+        return TRIE_WORD_NULL;
+    }
 
-void (*memory_allocation_listener)() = NULL;
+    if (match_lengths_length == 0U) {
+        return TRIE_WORDS_LENGTH_ZERO;
+    }
 
-void (*memory_deallocation_listener)() = NULL;
+    _trie_prefix_matches_t matches = {
+        match_lengths, match_lengths_length, 0U, 0U, false
+    };
+    _find_prefix_matches(trie, input, length, &matches);
+    *match_count = matches.match_count;
 
-void* _allocate_memory(size_t size) {
-    void* allocated_memory = malloc(size);
+    return TRIE_SUCCESS;
+}
+
+size_t _get_descendant_words(_trie_node_t* from_node,
+    const char** words, size_t words_length) {
+
+    size_t word_count = 0U;
 
-    if (allocated_memory != NULL && memory_allocation_listener != NULL) {
-        memory_allocation_listener();
+    if (_is_terminal_node(from_node)) {
+        words[word_count] = from_node->word;
+        word_count++;
     }
 
-    return allocated_memory;
+    _trie_children_iterator_t iterator;
+    _begin_children(from_node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (word_count < words_length &&
+        _next_child(&iterator, &key, &label_length, &child)) {
+        word_count += _get_descendant_words(
+            child, words+word_count, words_length-word_count);
+    }
+
+    return word_count;
 }
 
-void _deallocate_memory(void* memory) {
-    free(memory);
+trie_result_t trie_get_words_matching_prefix(trie_t* trie, const char* prefix,
+    const char** words, size_t words_length, size_t* word_count) {
 
-    if (memory_deallocation_listener != NULL) {
-        memory_deallocation_listener();
+    if (trie == NULL) {
+        return TRIE_NULL;
     }
-}
 
-trie_result_t trie_create(trie_t** trie) {
-    trie_t* created = _allocate_memory(sizeof(trie_t));
-    if (created == NULL) {
-        return TRIE_MALLOC_FAIL;
+    if (prefix == NULL) {
+        return TRIE_PREFIX_NULL;
     }
 
-    created->roots.head_node = NULL;
+    size_t prefix_length = strlen(prefix);
+    if (prefix_length == 0U) {
+        return TRIE_PREFIX_EMPTY;
+    }
 
-    *trie = created;
+    if (words_length == 0U) {
+        return TRIE_WORDS_LENGTH_ZERO;
+    }
 
-    return TRIE_SUCCESS;
-}
+    if (!trie->store_words) {
+        return TRIE_WORDS_NOT_STORED;
+    }
 
-// Returns the node within node_list which contains ch or NULL if no node
-// exists in the node list for the given ch
-_trie_node_t* _get_node_with_char(_trie_node_list_t* node_list, char ch) {
-    _trie_node_t* current_node = node_list->head_node;
+    if (trie->kind == _TRIE_MAPPED) {
+        *word_count = _mapped_get_words_matching_prefix(
+            trie->mapped, prefix, prefix_length, words, words_length);
+        return TRIE_SUCCESS;
+    }
 
-    while (current_node != NULL) {
-        if (current_node->ch == ch) {
-            return current_node;
-        }
+    uint64_t* active = _begin_read(trie);
+    uint32_t remaining_length;
+    _trie_node_t* node = _find_prefix_node(
+        trie->root, prefix, prefix_length, &remaining_length);
+    *word_count = node == NULL ?
+        0U : _get_descendant_words(node, words, words_length);
+    _end_read(active);
+
+    return TRIE_SUCCESS;
+}
 
-        current_node = current_node->next;
+// Appends length bytes to the path, returning false and finishing the copy if
+// the buffer has no room for them
+bool _push_path(_trie_word_copy_t* copy, const char* bytes, size_t length) {
+    if (copy->buffer_length - copy->used - copy->path_length < length) {
+        copy->done = true;
+        return false;
     }
 
-    return NULL;
+    memcpy(copy->buffer + copy->used + copy->path_length, bytes, length);
+    copy->path_length += length;
+
+    return true;
 }
 
-// Attempts to create a node containing the given character, returning it if
-// successful, or NULL if memory allocation fails
-_trie_node_t* _create_node(char ch) {
-    _trie_node_t* node = _allocate_memory(sizeof(_trie_node_t));
-    if (node == NULL) {
-        return NULL;
+// Copies the path as a word, then moves the path beyond it. Finishes the copy
+// if there is no room for the word or the path, or no more spans
+void _copy_path_word(_trie_word_copy_t* copy) {
+    size_t word_end = copy->used + copy->path_length;
+    if (word_end == copy->buffer_length) {
+        copy->done = true;
+        return;
     }
 
-    node->ch = ch;
-    node->word = NULL;
-    node->children.head_node = NULL;
-    node->next = NULL;
+    copy->buffer[word_end] = '\0';
+    copy->spans[copy->word_count].offset = copy->used;
+    copy->spans[copy->word_count].length = copy->path_length;
+    copy->word_count++;
 
-    return node;
+    const char* path = copy->buffer + copy->used;
+    copy->used = word_end+1;
+
+    if (copy->word_count == copy->spans_length ||
+        copy->buffer_length - copy->used < copy->path_length) {
+        copy->done = true;
+        return;
+    }
+
+    memcpy(copy->buffer + copy->used, path, copy->path_length);
 }
 
-// Inserts the given node into the given node list
-void _insert_node(_trie_node_list_t* node_list, _trie_node_t* node) {
-    if (node_list->head_node == NULL) {
-        node_list->head_node = node;
+void _copy_descendant_words(const _trie_node_t* from_node,
+    _trie_word_copy_t* copy) {
+
+    if (_is_terminal_node(from_node)) {
+        if (copy->values != NULL) {
+            copy->values[copy->word_count] =
+                __atomic_load_n(&(from_node->value), __ATOMIC_ACQUIRE);
+        }
+        _copy_path_word(copy);
     }
-    else {
-        _trie_node_t* previous_node = node_list->head_node;
-        while (previous_node->next != NULL) {
-            previous_node = previous_node->next;
+
+    _trie_children_iterator_t iterator;
+    _begin_children(from_node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (!copy->done &&
+        _next_child(&iterator, &key, &label_length, &child)) {
+        if (_push_path(copy, _get_edge_label(child, label_length),
+            label_length)) {
+            _copy_descendant_words(child, copy);
+            copy->path_length -= label_length;
         }
-        previous_node->next = node;
     }
 }
 
-trie_result_t trie_add_word(trie_t* trie, const char* word) {
+// Copies the words at or below the node of prefix in a trie made up of nodes
+void _copy_node_words(trie_t* trie, const char* prefix, size_t prefix_length,
+    _trie_word_copy_t* copy) {
+
+    uint64_t* active = _begin_read(trie);
+    uint32_t remaining_length;
+    _trie_node_t* node = _find_prefix_node(
+        trie->root, prefix, prefix_length, &remaining_length);
+    if (node != NULL &&
+        _push_path(copy, prefix, prefix_length) &&
+        _push_path(copy, node->label + node->label_length - remaining_length,
+            remaining_length)) {
+        _copy_descendant_words(node, copy);
+    }
+    _end_read(active);
+}
+
+trie_result_t trie_copy_keys_matching_prefix(trie_t* trie,
+    const char* prefix, size_t prefix_length, char* buffer,
+    size_t buffer_length, trie_word_span_t* spans, size_t spans_length,
+    size_t* word_count) {
+
     if (trie == NULL) {
         return TRIE_NULL;
     }
 
-    if (word == NULL) {
-        return TRIE_WORD_NULL;
+    if (prefix == NULL) {
+        return TRIE_PREFIX_NULL;
     }
 
-    if (strlen(word) == 0U) {
-        return TRIE_WORD_EMPTY;
+    if (prefix_length == 0U) {
+        return TRIE_PREFIX_EMPTY;
     }
 
-    _trie_node_list_t* current_node_list = &(trie->roots);
+    if (spans_length == 0U) {
+        return TRIE_WORDS_LENGTH_ZERO;
+    }
 
-    for (size_t i = 0U; i < strlen(word); i++) {
-        char current_char = word[i];
-        _trie_node_t* node_with_char =
-            _get_node_with_char(current_node_list, current_char);
-        if (node_with_char == NULL) {
-            node_with_char = _create_node(current_char);
-            if (node_with_char == NULL) {
-                return TRIE_MALLOC_FAIL;
-            }
+    if (buffer_length == 0U) {
+        return TRIE_BUFFER_LENGTH_ZERO;
+    }
 
-            _insert_node(current_node_list, node_with_char);
-        }
+    _trie_word_copy_t copy = {
+        buffer, buffer_length, 0U, 0U, spans, NULL, spans_length, 0U, false
+    };
 
-        if (i == strlen(word)-1) {
-            char* allocated_word = _allocate_memory(strlen(word)+1);
-            if (allocated_word == NULL) {
-                return TRIE_MALLOC_FAIL;
-            }
-            strcpy(allocated_word, word);
-            node_with_char->word = allocated_word;
-        }
+    if (trie->kind == _TRIE_MAPPED) {
+        _mapped_copy_words_matching_prefix(
+            trie->mapped, prefix, prefix_length, &copy);
+        *word_count = copy.word_count;
+        return TRIE_SUCCESS;
+    }
+
+    if (trie->kind == _TRIE_DAWG) {
+        _dawg_copy_words_matching_prefix(
+            trie->dawg, prefix, prefix_length, &copy);
+        *word_count = copy.word_count;
+        return TRIE_SUCCESS;
+    }
+
+    if (trie->kind == _TRIE_DOUBLE_ARRAY) {
+        _double_array_copy_words_matching_prefix(
+            trie->double_array, prefix, prefix_length, &copy);
+        *word_count = copy.word_count;
+        return TRIE_SUCCESS;
+    }
 
-        current_node_list = &(node_with_char->children);
+    if (trie->kind == _TRIE_LOUDS) {
+        _louds_copy_words_matching_prefix(
+            trie->louds, prefix, prefix_length, &copy);
+        *word_count = copy.word_count;
+        return TRIE_SUCCESS;
     }
 
+    _copy_node_words(trie, prefix, prefix_length, &copy);
+    *word_count = copy.word_count;
+
     return TRIE_SUCCESS;
 }
 
-trie_result_t trie_contains_word(trie_t* trie, const char* word,
-    bool* contains) {
+trie_result_t trie_copy_words_matching_prefix(trie_t* trie,
+    const char* prefix, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, size_t spans_length, size_t* word_count) {
+
+    return trie_copy_keys_matching_prefix(trie, prefix,
+        prefix == NULL ? 0U : strlen(prefix), buffer, buffer_length, spans,
+        spans_length, word_count);
+}
+
+trie_result_t trie_copy_key_entries_matching_prefix(trie_t* trie,
+    const char* prefix, size_t prefix_length, char* buffer,
+    size_t buffer_length, trie_word_span_t* spans, void** values,
+    size_t spans_length, size_t* entry_count) {
 
     if (trie == NULL) {
         return TRIE_NULL;
     }
 
-    if (word == NULL) {
-        return TRIE_WORD_NULL;
+    if (prefix == NULL) {
+        return TRIE_PREFIX_NULL;
     }
 
-    if (strlen(word) == 0U) {
-        *contains = false;
-        return TRIE_SUCCESS;
+    if (prefix_length == 0U) {
+        return TRIE_PREFIX_EMPTY;
+    }
+
+    if (spans_length == 0U) {
+        return TRIE_WORDS_LENGTH_ZERO;
+    }
+
+    if (buffer_length == 0U) {
+        return TRIE_BUFFER_LENGTH_ZERO;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    _trie_word_copy_t copy = {
+        buffer, buffer_length, 0U, 0U, spans, values, spans_length, 0U, false
+    };
+
+    _copy_node_words(trie, prefix, prefix_length, &copy);
+    *entry_count = copy.word_count;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_copy_entries_matching_prefix(trie_t* trie,
+    const char* prefix, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, void** values, size_t spans_length,
+    size_t* entry_count) {
+
+    return trie_copy_key_entries_matching_prefix(trie, prefix,
+        prefix == NULL ? 0U : strlen(prefix), buffer, buffer_length, spans,
+        values, spans_length, entry_count);
+}
+
+// An entry of a best-first search for the words of greatest weight. An entry
+// stands either for all the words at or below node or, if word is set, for
+// the word ending at node alone, and weight is the greatest weight of those
+// words. The path of an entry is the path of its parent followed by label
+typedef struct {
+    const _trie_node_t* node;
+    size_t parent;
+    const char* label;
+    uint32_t label_length;
+    uint32_t weight;
+    bool word;
+} _trie_search_entry_t;
+
+// Marks an entry without a parent
+#define _TRIE_SEARCH_NO_PARENT SIZE_MAX
+
+// State of a best-first search. entries holds every entry created and heap
+// the indexes of those yet to be visited, as a binary heap with the greatest
+// weight first and, among equal weights, the earliest created first
+typedef struct {
+    _trie_search_entry_t* entries;
+    size_t entry_count;
+    size_t entries_capacity;
+    size_t* heap;
+    size_t heap_count;
+    size_t heap_capacity;
+} _trie_search_t;
+
+// Returns whether or not the entry at index first is visited before the entry
+// at index second
+bool _precedes(const _trie_search_t* search, size_t first, size_t second) {
+    uint32_t first_weight = search->entries[first].weight;
+    uint32_t second_weight = search->entries[second].weight;
+
+    return first_weight > second_weight ||
+        (first_weight == second_weight && first < second);
+}
+
+// Adds an entry to be visited. Returns false if memory allocation fails
+bool _push_entry(_trie_search_t* search, const _trie_node_t* node,
+    size_t parent, const char* label, uint32_t label_length, uint32_t weight,
+    bool word) {
+
+    if (!_reserve((void**) &(search->entries), &(search->entries_capacity),
+        search->entry_count+1, sizeof(_trie_search_entry_t)) ||
+        !_reserve((void**) &(search->heap), &(search->heap_capacity),
+        search->heap_count+1, sizeof(size_t))) {
+        return false;
+    }
+
+    _trie_search_entry_t* entry = &(search->entries[search->entry_count]);
+    entry->node = node;
+    entry->parent = parent;
+    entry->label = label;
+    entry->label_length = label_length;
+    entry->weight = weight;
+    entry->word = word;
+
+    size_t position = search->heap_count;
+    while (position > 0U) {
+        size_t parent_position = (position-1) / 2U;
+        if (!_precedes(search, search->entry_count,
+            search->heap[parent_position])) {
+            break;
+        }
+        search->heap[position] = search->heap[parent_position];
+        position = parent_position;
     }
+    search->heap[position] = search->entry_count;
 
-    *contains = true;
-    _trie_node_list_t* current_node_list = &(trie->roots);
+    search->entry_count++;
+    search->heap_count++;
 
-    for (size_t i = 0U; i < strlen(word); i++) {
-        _trie_node_t* node_with_char =
-            _get_node_with_char(current_node_list, word[i]);
-        if (node_with_char == NULL) {
-            *contains = false;
+    return true;
+}
+
+// Removes the next entry to be visited from the heap, returning its index
+size_t _pop_entry(_trie_search_t* search) {
+    size_t popped = search->heap[0];
+    search->heap_count--;
+    size_t last = search->heap[search->heap_count];
+
+    size_t position = 0U;
+    while (true) {
+        size_t child = position*2U + 1U;
+        if (child >= search->heap_count) {
+            break;
+        }
+        if (child+1 < search->heap_count &&
+            _precedes(search, search->heap[child+1], search->heap[child])) {
+            child++;
+        }
+        if (!_precedes(search, search->heap[child], last)) {
             break;
         }
+        search->heap[position] = search->heap[child];
+        position = child;
+    }
+    search->heap[position] = last;
+
+    return popped;
+}
+
+// Copies the word of the given entry into the buffer of copy, after prefix.
+// Finishes the copy if there is no room for the word or no more spans
+void _copy_entry_word(const _trie_search_t* search, size_t index,
+    const char* prefix, size_t prefix_length, _trie_word_copy_t* copy) {
+
+    size_t word_length = prefix_length;
+    for (size_t i = index; i != _TRIE_SEARCH_NO_PARENT;
+        i = search->entries[i].parent) {
+        word_length += search->entries[i].label_length;
+    }
+
+    if (copy->buffer_length - copy->used <= word_length) {
+        copy->done = true;
+        return;
+    }
+
+    char* word = copy->buffer + copy->used;
+    size_t position = word_length;
+    word[position] = '\0';
+    for (size_t i = index; i != _TRIE_SEARCH_NO_PARENT;
+        i = search->entries[i].parent) {
+        const _trie_search_entry_t* entry = &(search->entries[i]);
+        position -= entry->label_length;
+        memcpy(word + position, entry->label, entry->label_length);
+    }
+    memcpy(word, prefix, prefix_length);
 
-        if (i == strlen(word)-1) {
-            if (node_with_char->word == NULL) {
-                *contains = false;
+    copy->spans[copy->word_count].offset = copy->used;
+    copy->spans[copy->word_count].length = word_length;
+    copy->word_count++;
+    copy->used += word_length+1;
+
+    if (copy->word_count == copy->spans_length) {
+        copy->done = true;
+    }
+}
+
+// Copies the words at or below node, after prefix and the final
+// remaining_length bytes of the label of node, in descending order of
+// weight. Visits only the nodes which may lead to one of the words copied.
+// Returns false if memory allocation fails
+bool _copy_heaviest_words(const _trie_node_t* node, const char* prefix,
+    size_t prefix_length, uint32_t remaining_length, uint32_t* weights,
+    _trie_word_copy_t* copy) {
+
+    _trie_search_t search = { NULL, 0U, 0U, NULL, 0U, 0U };
+    bool pushed = _push_entry(&search, node, _TRIE_SEARCH_NO_PARENT,
+        node->label + node->label_length - remaining_length,
+        remaining_length,
+        __atomic_load_n(&(node->max_weight), __ATOMIC_RELAXED), false);
+
+    while (pushed && search.heap_count > 0U && !copy->done) {
+        size_t index = _pop_entry(&search);
+        _trie_search_entry_t entry = search.entries[index];
+        if (entry.word) {
+            if (weights != NULL) {
+                weights[copy->word_count] = entry.weight;
             }
+            _copy_entry_word(&search, index, prefix, prefix_length, copy);
+            continue;
         }
 
-        current_node_list = &(node_with_char->children);
+        if (_is_terminal_node(entry.node)) {
+            pushed = _push_entry(&search, entry.node, index, "", 0U,
+                __atomic_load_n(&(entry.node->weight), __ATOMIC_RELAXED),
+                true);
+        }
+
+        _trie_children_iterator_t iterator;
+        _begin_children(entry.node, &iterator);
+        unsigned char key;
+        uint32_t label_length;
+        _trie_node_t* child;
+        while (pushed &&
+            _next_child(&iterator, &key, &label_length, &child)) {
+            pushed = _push_entry(&search, child, index,
+                _get_edge_label(child, label_length), label_length,
+                __atomic_load_n(&(child->max_weight), __ATOMIC_RELAXED),
+                false);
+        }
     }
 
-    return TRIE_SUCCESS;
+    _release(search.entries, search.entries_capacity,
+        sizeof(_trie_search_entry_t));
+    _release(search.heap, search.heap_capacity, sizeof(size_t));
+
+    return pushed;
 }
 
-size_t _get_descendant_words(_trie_node_t* from_node,
-    const char** words, size_t words_length) {
+trie_result_t trie_top_k_keys_matching_prefix(trie_t* trie,
+    const char* prefix, size_t prefix_length, char* buffer,
+    size_t buffer_length, trie_word_span_t* spans, uint32_t* weights,
+    size_t k, size_t* word_count) {
 
-    size_t word_count = 0U;
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
 
-    if (from_node->word != NULL) {
-        words[word_count] = from_node->word;
-        word_count++;
+    if (prefix == NULL) {
+        return TRIE_PREFIX_NULL;
     }
 
-    _trie_node_t* current_node = from_node->children.head_node;
-    while (current_node != NULL && word_count < words_length) {
-        word_count += _get_descendant_words(
-            current_node, words+word_count, words_length-word_count);
-        current_node = current_node->next;
+    if (prefix_length == 0U) {
+        return TRIE_PREFIX_EMPTY;
+    }
+
+    if (k == 0U) {
+        return TRIE_WORDS_LENGTH_ZERO;
+    }
+
+    if (buffer_length == 0U) {
+        return TRIE_BUFFER_LENGTH_ZERO;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_UNSUPPORTED;
+    }
+
+    _trie_word_copy_t copy = {
+        buffer, buffer_length, 0U, 0U, spans, NULL, k, 0U, false
+    };
+
+    uint64_t* active = _begin_read(trie);
+    uint32_t remaining_length;
+    _trie_node_t* node = _find_prefix_node(
+        trie->root, prefix, prefix_length, &remaining_length);
+    bool copied = node == NULL || _copy_heaviest_words(node, prefix,
+        prefix_length, remaining_length, weights, &copy);
+    _end_read(active);
+    if (!copied) {
+        return TRIE_MALLOC_FAIL;
+    }
+
+    *word_count = copy.word_count;
+
+    return TRIE_SUCCESS;
+}
+
+trie_result_t trie_top_k_matching_prefix(trie_t* trie, const char* prefix,
+    char* buffer, size_t buffer_length, trie_word_span_t* spans,
+    uint32_t* weights, size_t k, size_t* word_count) {
+
+    return trie_top_k_keys_matching_prefix(trie, prefix,
+        prefix == NULL ? 0U : strlen(prefix), buffer, buffer_length, spans,
+        weights, k, word_count);
+}
+
+size_t _count_descendant_words(const _trie_node_t* from_node) {
+    size_t word_count = _is_terminal_node(from_node) ? 1U : 0U;
+
+    _trie_children_iterator_t iterator;
+    _begin_children(from_node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        word_count += _count_descendant_words(child);
     }
 
     return word_count;
 }
 
-trie_result_t trie_get_words_matching_prefix(trie_t* trie, const char* prefix,
-    const char** words, size_t words_length, size_t* word_count) {
+// Returns the number of words at or below node
+size_t _get_word_count(const trie_t* trie, const _trie_node_t* node) {
+    return trie->epochs == NULL ? node->word_count :
+        _count_descendant_words(node);
+}
+
+trie_result_t trie_count_keys_matching_prefix(trie_t* trie,
+    const char* prefix, size_t prefix_length, size_t* word_count) {
 
     if (trie == NULL) {
         return TRIE_NULL;
@@ -215,65 +2184,257 @@ trie_result_t trie_get_words_matching_prefix(trie_t* trie, const char* prefix,
         return TRIE_PREFIX_NULL;
     }
 
-    if (strlen(prefix) == 0U) {
+    if (prefix_length == 0U) {
         return TRIE_PREFIX_EMPTY;
     }
 
-    if (words_length == 0U) {
-        return TRIE_WORDS_LENGTH_ZERO;
+    if (trie->kind == _TRIE_MAPPED) {
+        *word_count = _mapped_count_words_matching_prefix(
+            trie->mapped, prefix, prefix_length);
+        return TRIE_SUCCESS;
     }
 
-    _trie_node_list_t* current_node_list = &(trie->roots);
-    _trie_node_t* node_with_char = NULL;
+    if (trie->kind == _TRIE_DAWG) {
+        *word_count = _dawg_count_words_matching_prefix(
+            trie->dawg, prefix, prefix_length);
+        return TRIE_SUCCESS;
+    }
 
-    for (size_t i = 0U; i < strlen(prefix); i++) {
-        node_with_char = _get_node_with_char(current_node_list, prefix[i]);
-        if (node_with_char == NULL) {
-            *word_count = 0U;
-            return TRIE_SUCCESS;
-        }
+    if (trie->kind == _TRIE_DOUBLE_ARRAY) {
+        *word_count = _double_array_count_words_matching_prefix(
+            trie->double_array, prefix, prefix_length);
+        return TRIE_SUCCESS;
+    }
 
-        current_node_list = &(node_with_char->children);
+    if (trie->kind == _TRIE_LOUDS) {
+        *word_count = _louds_count_words_matching_prefix(
+            trie->louds, prefix, prefix_length);
+        return TRIE_SUCCESS;
     }
 
-    *word_count = _get_descendant_words(node_with_char, words, words_length);
+    uint64_t* active = _begin_read(trie);
+    uint32_t remaining_length;
+    _trie_node_t* node = _find_prefix_node(
+        trie->root, prefix, prefix_length, &remaining_length);
+    *word_count = node == NULL ? 0U : _get_word_count(trie, node);
+    _end_read(active);
 
     return TRIE_SUCCESS;
 }
 
-void _destroy_node_list(_trie_node_list_t* node_list);
+trie_result_t trie_count_prefix(trie_t* trie, const char* prefix,
+    size_t* word_count) {
+
+    return trie_count_keys_matching_prefix(
+        trie, prefix, prefix == NULL ? 0U : strlen(prefix), word_count);
+}
+
+// Returns the smallest children class able to hold count children
+_trie_children_kind_t _get_children_kind(uint16_t count) {
+    _trie_children_kind_t kind = _TRIE_CHILDREN_4;
+    while (_children_capacities[kind] < count) {
+        kind++;
+    }
+
+    return kind;
+}
+
+// Returns the number of bytes of arena needed to hold a copy of the words at
+// or below node, whose path is length bytes long, and, if nodes_included, of
+// the nodes and children too
+size_t _get_compacted_size(const _trie_node_t* node, size_t length,
+    bool nodes_included) {
+
+    size_t size = node->word == NULL ? 0U : _get_arena_size(length+1);
+    if (nodes_included) {
+        size += _get_arena_size(sizeof(_trie_node_t) + node->label_length);
+        if (node->children != NULL) {
+            size += _get_arena_size(
+                _children_sizes[_get_children_kind(node->children->count)]);
+        }
+    }
+
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        size += _get_compacted_size(
+            child, length+label_length, nodes_included);
+    }
+
+    return size;
+}
+
+// Copies the word of node, which is length bytes long, into the word memory
+// of trie, returning the copy, or NULL if node has no word. Keys may hold NUL
+// bytes, so the length is taken from the path rather than from the word
+char* _copy_word(trie_t* trie, const _trie_node_t* node, size_t length) {
+    if (node->word == NULL) {
+        return NULL;
+    }
+
+    size_t size = length+1;
+    char* copied_word = _allocate_word_memory(trie, size);
+    memcpy(copied_word, node->word, size);
+
+    return copied_word;
+}
+
+// Moves the words at or below node, whose path is length bytes long, into
+// the word pool of trie
+void _compact_words(trie_t* trie, _trie_node_t* node, size_t length) {
+    node->word = _copy_word(trie, node, length);
+
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        _compact_words(trie, child, length+label_length);
+    }
+}
+
+// Copies node, whose path is length bytes long, and everything below it,
+// into the arena of trie, giving each children block the smallest class
+// which holds its children. Returns the copy
+_trie_node_t* _compact_node(trie_t* trie, const _trie_node_t* node,
+    size_t length) {
+
+    _trie_node_t* copied_node =
+        _create_node(trie, node->label, node->label_length);
+    copied_node->word = _copy_word(trie, node, length);
+    copied_node->value = node->value;
+    copied_node->terminal = node->terminal;
+    copied_node->weight = node->weight;
+    copied_node->max_weight = node->max_weight;
+    copied_node->word_count = node->word_count;
+    if (node->children != NULL) {
+        copied_node->children = _create_children(trie,
+            _get_children_kind(node->children->count));
+    }
+
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        _insert_child(copied_node->children, key, label_length,
+            _compact_node(trie, child, length+label_length));
+    }
+
+    return copied_node;
+}
+
+trie_result_t trie_compact(trie_t* trie) {
+    if (trie == NULL) {
+        return TRIE_NULL;
+    }
+
+    if (trie->kind != _TRIE_NODES) {
+        return TRIE_READ_ONLY;
+    }
+
+    if (trie->epochs != NULL) {
+        return TRIE_UNSUPPORTED;
+    }
 
-void _destroy_node_and_following_siblings(_trie_node_t* node) {
-    _trie_node_t* next_node = node->next;
-    if (next_node != NULL) {
-        _destroy_node_and_following_siblings(next_node);
+    // Everything is copied into a single chunk sized to fit, so no allocation
+    // can fail once copying has started
+    _trie_arena_t* arena =
+        trie->arena != NULL ? trie->arena : &(trie->word_pool);
+    trie_memory_category_t category = trie->arena != NULL ?
+        TRIE_MEMORY_ARENA : TRIE_MEMORY_STRINGS;
+    size_t size = _get_compacted_size(trie->root, 0U, trie->arena != NULL);
+    _trie_arena_chunk_t* chunk = NULL;
+    if (size > 0U) {
+        chunk = _create_arena_chunk(size, NULL, category);
+        if (chunk == NULL) {
+            return TRIE_MALLOC_FAIL;
+        }
     }
 
-    if (node->word != NULL) {
-        _deallocate_memory(node->word);
+    _trie_arena_t previous_arena = *arena;
+    arena->current_chunk = chunk;
+    if (trie->arena != NULL) {
+        trie->root = _compact_node(trie, trie->root, 0U);
+    }
+    else {
+        _compact_words(trie, trie->root, 0U);
     }
-    _destroy_node_list(&(node->children));
-    _deallocate_memory(node);
+    _destroy_arena_chunks(&previous_arena, category);
+
+    return TRIE_SUCCESS;
 }
 
-void _destroy_node_list(_trie_node_list_t* node_list) {
-    _trie_node_t* head_node = node_list->head_node;
-    if (head_node != NULL) {
-        _destroy_node_and_following_siblings(head_node);
+// Deallocates node, including its children and descendants
+void _destroy_node(trie_t* trie, _trie_node_t* node) {
+    _trie_children_iterator_t iterator;
+    _begin_children(node, &iterator);
+    unsigned char key;
+    uint32_t label_length;
+    _trie_node_t* child;
+    while (_next_child(&iterator, &key, &label_length, &child)) {
+        _destroy_node(trie, child);
+    }
+
+    if (node->children != NULL) {
+        _deallocate_children(trie, node->children);
     }
+    _deallocate_node(trie, node);
 }
 
 trie_result_t trie_destroy(trie_t* trie) {
-    _destroy_node_list(&(trie->roots));
-    _deallocate_memory(trie);
+    if (trie->epochs != NULL) {
+        _destroy_epochs(trie);
+    }
+
+    if (trie->kind == _TRIE_MAPPED) {
+        _destroy_mapped(trie->mapped);
+    }
+    else if (trie->kind == _TRIE_DAWG) {
+        _destroy_dawg(trie->dawg);
+    }
+    else if (trie->kind == _TRIE_DOUBLE_ARRAY) {
+        _destroy_double_array(trie->double_array);
+    }
+    else if (trie->kind == _TRIE_LOUDS) {
+        _destroy_louds(trie->louds);
+    }
+    else if (trie->arena != NULL) {
+        _destroy_arena(trie->arena);
+    }
+    else {
+        _destroy_node(trie, trie->root);
+    }
+    _destroy_arena_chunks(&(trie->word_pool), TRIE_MEMORY_STRINGS);
+    _deallocate_memory(trie, sizeof(trie_t), TRIE_MEMORY_OTHER);
 
     return TRIE_SUCCESS;
 }
 
 void trie_set_memory_allocation_listener(void (*listener)()) {
-    memory_allocation_listener = listener;
+    __atomic_store_n(&memory_allocation_listener, listener, __ATOMIC_RELEASE);
 }
 
 void trie_set_memory_deallocation_listener(void (*listener)()) {
-    memory_deallocation_listener = listener;
+    __atomic_store_n(&memory_deallocation_listener, listener,
+        __ATOMIC_RELEASE);
+}
+
+void trie_set_sized_memory_allocation_listener(
+    void (*listener)(size_t size, trie_memory_category_t category)) {
+
+    __atomic_store_n(&sized_memory_allocation_listener, listener,
+        __ATOMIC_RELEASE);
+}
+
+void trie_set_sized_memory_deallocation_listener(
+    void (*listener)(size_t size, trie_memory_category_t category)) {
+
+    __atomic_store_n(&sized_memory_deallocation_listener, listener,
+        __ATOMIC_RELEASE);
 }
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * A trie used for retrieving words matching a prefix. Useful, for example, in
@@ -10,6 +11,24 @@
  */
 typedef struct trie_t trie_t;
 
+/**
+ * Builds a trie from words supplied in sorted order, in time linear in their
+ * total length. See trie_builder_create().
+ */
+typedef struct trie_builder_t trie_builder_t;
+
+/**
+ * A position within the words of a trie matching a prefix, used to page
+ * through them. See trie_cursor_open().
+ */
+typedef struct trie_cursor_t trie_cursor_t;
+
+/**
+ * An Aho-Corasick automaton compiled from a trie, which finds every
+ * occurrence of any of its words in a text. See trie_automaton_create().
+ */
+typedef struct trie_automaton_t trie_automaton_t;
+
 /**
  * The result of a call to a trie function.
  */
@@ -21,9 +40,183 @@ typedef enum {
     TRIE_PREFIX_NULL,
     TRIE_PREFIX_EMPTY,
     TRIE_WORDS_LENGTH_ZERO,
-    TRIE_MALLOC_FAIL
+    TRIE_MALLOC_FAIL,
+    TRIE_ARENA_SIZE_ZERO,
+    TRIE_WORDS_NOT_STORED,
+    TRIE_BUFFER_LENGTH_ZERO,
+    TRIE_READ_ONLY,
+    TRIE_PATH_NULL,
+    TRIE_FILE_ERROR,
+    TRIE_FILE_INVALID,
+    TRIE_WORDS_NOT_SORTED,
+    TRIE_UNSUPPORTED,
+    TRIE_WORD_TOO_LONG,
+    TRIE_CURSOR_MEMORY_TOO_SMALL,
+    TRIE_NOT_FOUND,
+    TRIE_PATTERN_INVALID
 } trie_result_t;
 
+/**
+ * Options controlling how a trie holds its contents.
+ */
+typedef struct {
+    /**
+     * Size in bytes of the first arena chunk, or zero to allocate each node
+     * individually. See trie_create_with_arena().
+     */
+    size_t arena_initial_bytes;
+
+    /**
+     * Whether or not a copy of each word is stored. Word copies are held in
+     * large shared chunks rather than being allocated individually. Without
+     * them, trie_get_words_matching_prefix() is unavailable and
+     * trie_copy_words_matching_prefix() must be used instead, but the trie
+     * takes substantially less memory.
+     */
+    bool store_words;
+
+    /**
+     * Whether or not the trie may be queried and added to by any number of
+     * threads at once. Neither queries nor trie_add_word(),
+     * trie_add_weighted_word() and trie_put() take a lock or wait for each
+     * other, and each query sees every word added before it started.
+     * Children being extended are copied rather than changed in place and
+     * swapped in atomically, so threads adding words under different
+     * prefixes do not contend, and the copies replaced are freed once no
+     * thread can be using them. Adding is therefore somewhat slower than in
+     * a trie which is not concurrent.
+     * Queries are trie_contains_word(), trie_get(),
+     * trie_longest_prefix_match(), trie_prefix_matches(),
+     * trie_get_words_matching_prefix(), trie_copy_words_matching_prefix(),
+     * trie_copy_entries_matching_prefix(), trie_top_k_matching_prefix(),
+     * trie_fuzzy_search(), trie_fuzzy_prefix_search(), trie_match_pattern(),
+     * trie_range(), trie_successor(), trie_predecessor(), trie_rank(),
+     * trie_select(), trie_count_prefix(), trie_get_stats(), trie_save(),
+     * trie_freeze_to_dawg(), trie_freeze_to_double_array(),
+     * trie_freeze_to_louds(), trie_automaton_create() and cursors, which count
+     * as a query from trie_cursor_open() to trie_cursor_close().
+     */
+    bool concurrent;
+} trie_options_t;
+
+/**
+ * The location of a word within a buffer.
+ */
+typedef struct {
+    /**
+     * Offset of the first byte of the word from the start of the buffer.
+     */
+    size_t offset;
+
+    /**
+     * Length of the word in bytes, excluding its terminating NUL.
+     */
+    size_t length;
+} trie_word_span_t;
+
+/**
+ * The progress of a scan of a stream of text by an automaton, carried from
+ * one chunk of the stream to the next. See trie_scan_chunk().
+ */
+typedef struct {
+    /**
+     * State of the automaton after the text scanned so far.
+     */
+    uint32_t state;
+
+    /**
+     * Number of bytes of text scanned so far.
+     */
+    uint64_t offset;
+} trie_scan_t;
+
+/**
+ * What a block of dynamically allocated memory holds, as reported to sized
+ * memory listeners. See trie_set_sized_memory_allocation_listener().
+ */
+typedef enum {
+    /** Nodes of a trie, each allocated individually. */
+    TRIE_MEMORY_NODES,
+    /** Children blocks of the nodes of a trie, each allocated individually. */
+    TRIE_MEMORY_CHILDREN,
+    /** Chunks of the pool holding the copies of the words of a trie. */
+    TRIE_MEMORY_STRINGS,
+    /** Chunks of the arena of a trie, holding its nodes and children. */
+    TRIE_MEMORY_ARENA,
+    /**
+     * Read-only representations: DAWGs, double arrays, LOUDS tries and
+     * automata.
+     */
+    TRIE_MEMORY_READ_ONLY,
+    /**
+     * Everything else, such as trie structures, builders and scratch space
+     * used by queries.
+     */
+    TRIE_MEMORY_OTHER
+} trie_memory_category_t;
+
+/**
+ * Number of entries of the depth histogram of trie_stats_t.
+ */
+#define TRIE_STATS_MAX_DEPTH 64
+
+/**
+ * Statistics on the memory use and shape of a trie. See trie_get_stats().
+ */
+typedef struct {
+    /**
+     * Number of nodes, including the root.
+     */
+    size_t node_count;
+
+    /**
+     * Number of words.
+     */
+    size_t word_count;
+
+    /**
+     * Bytes taken by the nodes, including their edge labels.
+     */
+    size_t node_bytes;
+
+    /**
+     * Bytes taken by the children blocks of the nodes.
+     */
+    size_t children_bytes;
+
+    /**
+     * Bytes taken by the copies of the words, including their terminating
+     * NULs, or zero if the trie does not store words.
+     */
+    size_t string_bytes;
+
+    /**
+     * Bytes currently allocated for the trie: the trie itself, its nodes and
+     * children blocks or its arena chunks, its word pool chunks and, if it
+     * is concurrent, its thread epochs. Children blocks replaced in a
+     * concurrent trie but not yet freed are not included.
+     */
+    size_t allocated_bytes;
+
+    /**
+     * Number of nodes at each depth in edges from the root, the root being
+     * at depth zero. Nodes deeper than TRIE_STATS_MAX_DEPTH-1 are counted in
+     * the last entry.
+     */
+    size_t depth_histogram[TRIE_STATS_MAX_DEPTH];
+
+    /**
+     * Number of nodes having each number of children, from 0 to 256.
+     */
+    size_t fan_out_histogram[257];
+
+    /**
+     * Mean number of edges followed to look up each word, or zero if the
+     * trie is empty.
+     */
+    double average_lookup_path_length;
+} trie_stats_t;
+
 /**
  * Creates an empty trie. To prevent resource leakage, each call to this
  * function must be matched by a call to trie_destroy().
@@ -34,6 +227,35 @@ typedef enum {
  */
 trie_result_t trie_create(trie_t** trie);
 
+/**
+ * Creates an empty trie in arena mode. Nodes and words are carved out of large
+ * chunks of memory rather than being allocated individually, which makes
+ * adding many words considerably cheaper. The first chunk holds initial_bytes
+ * and each further chunk is twice the size of its predecessor. All chunks are
+ * freed together by trie_destroy(). The memory allocation and deallocation
+ * listeners are called once per chunk.
+ *
+ * @param trie (out) set to the created trie
+ * @param initial_bytes size in bytes of the first chunk
+ * @return TRIE_SUCCESS if the creation was successful, TRIE_ARENA_SIZE_ZERO if
+ *         initial_bytes is zero or TRIE_MALLOC_FAIL if memory allocation
+ *         failed
+ */
+trie_result_t trie_create_with_arena(trie_t** trie, size_t initial_bytes);
+
+/**
+ * Creates an empty trie with the given options. trie_create() is equivalent to
+ * this with an arena_initial_bytes of zero, store_words set and concurrent
+ * unset.
+ *
+ * @param trie (out) set to the created trie
+ * @param options options for the trie
+ * @return TRIE_SUCCESS if the creation was successful or TRIE_MALLOC_FAIL if
+ *         memory allocation failed
+ */
+trie_result_t trie_create_with_options(trie_t** trie,
+    const trie_options_t* options);
+
 /**
  * Adds a word to a trie.
  *
@@ -41,10 +263,119 @@ trie_result_t trie_create(trie_t** trie);
  * @param word word to add
  * @return TRIE_SUCCESS if the addition was successful, TRIE_NULL if trie
  *         is NULL, TRIE_WORD_NULL if word is NULL, TRIE_WORD_EMPTY if word
- *         is an empty string or TRIE_MALLOC_FAIL if memory allocation failed
+ *         is an empty string, TRIE_READ_ONLY if trie cannot be modified (for
+ *         example because it was opened by trie_open_mapped()) or
+ *         TRIE_MALLOC_FAIL if memory allocation failed
  */
 trie_result_t trie_add_word(trie_t* trie, const char* word);
 
+/**
+ * Adds a key of the given length to a trie. Keys are arbitrary bytes and may
+ * include NUL bytes, which words given as strings cannot.
+ *
+ * @param trie trie to which to add the key
+ * @param key key to add
+ * @param length length of key in bytes
+ * @return as for trie_add_word(), with TRIE_WORD_EMPTY if length is zero
+ */
+trie_result_t trie_add_key(trie_t* trie, const char* key, size_t length);
+
+/**
+ * Adds a word with a weight, such as its frequency of use, to a trie. Words
+ * added by trie_add_word() have a weight of zero. If the word is already in
+ * the trie, its weight is replaced.
+ *
+ * @param trie trie to which to add the word
+ * @param word word to add
+ * @param weight weight of the word
+ * @return as for trie_add_word()
+ */
+trie_result_t trie_add_weighted_word(trie_t* trie, const char* word,
+    uint32_t weight);
+
+/**
+ * Adds a key of the given length with a weight to a trie, as
+ * trie_add_weighted_word() does for a word.
+ *
+ * @param trie trie to which to add the key
+ * @param key key to add
+ * @param length length of key in bytes
+ * @param weight weight of the key
+ * @return as for trie_add_key()
+ */
+trie_result_t trie_add_weighted_key(trie_t* trie, const char* key,
+    size_t length, uint32_t weight);
+
+/**
+ * Adds a word to a trie together with a value associated with it, making the
+ * trie a map from words to values. The value is held in the node at which the
+ * word ends, so trie_get() finds it in a single lookup. If the word is already
+ * in the trie, its value is replaced. Words added by trie_add_word() have a
+ * NULL value, and adding a word again by trie_add_word() keeps its value.
+ * Values are not kept by trie_save(), trie_freeze_to_dawg(),
+ * trie_freeze_to_double_array() or trie_freeze_to_louds().
+ *
+ * @param trie trie to which to add the word
+ * @param word word to add
+ * @param value value to associate with the word, which the trie does not own
+ * @return as for trie_add_word()
+ */
+trie_result_t trie_put(trie_t* trie, const char* word, void* value);
+
+/**
+ * Adds a key of the given length to a trie together with a value associated
+ * with it, as trie_put() does for a word.
+ *
+ * @param trie trie to which to add the key
+ * @param key key to add
+ * @param length length of key in bytes
+ * @param value value to associate with the key
+ * @return as for trie_add_key()
+ */
+trie_result_t trie_put_key(trie_t* trie, const char* key, size_t length,
+    void* value);
+
+/**
+ * Removes a word from a trie, if present. Nodes left with neither a word nor
+ * words below them are freed, except in arena mode, where they remain in the
+ * arena, and in a concurrent trie, where they are kept for reuse. The space
+ * taken by the copy of the word stays in use until trie_compact() is called.
+ *
+ * @param trie trie from which to remove the word
+ * @param word word to remove
+ * @return TRIE_SUCCESS if the removal was successful or the word was not
+ *         present, TRIE_NULL if trie is NULL, TRIE_WORD_NULL if word is NULL,
+ *         TRIE_WORD_EMPTY if word is an empty string or TRIE_READ_ONLY if trie
+ *         cannot be modified
+ */
+trie_result_t trie_remove_word(trie_t* trie, const char* word);
+
+/**
+ * Removes a key of the given length from a trie, if present, as
+ * trie_remove_word() does for a word.
+ *
+ * @param trie trie from which to remove the key
+ * @param key key to remove
+ * @param length length of key in bytes
+ * @return as for trie_remove_word(), with TRIE_WORD_EMPTY if length is zero
+ */
+trie_result_t trie_remove_key(trie_t* trie, const char* key, size_t length);
+
+/**
+ * Reclaims the space left unused in a trie by removed words. The words still
+ * present are copied together into a single chunk, and in arena mode the
+ * nodes and children are too, each children array shrinking to the smallest
+ * size which holds its children. Must not be called while the trie is in use
+ * by another thread.
+ *
+ * @param trie trie to compact
+ * @return TRIE_SUCCESS if the compaction was successful, TRIE_NULL if trie is
+ *         NULL, TRIE_READ_ONLY if trie cannot be modified, TRIE_UNSUPPORTED if
+ *         trie is concurrent or TRIE_MALLOC_FAIL if memory allocation failed,
+ *         in which case the trie is unchanged
+ */
+trie_result_t trie_compact(trie_t* trie);
+
 /**
  * Determines whether or not a trie contains a specified word.
  *
@@ -57,10 +388,129 @@ trie_result_t trie_add_word(trie_t* trie, const char* word);
  */
 trie_result_t trie_contains_word(trie_t* trie, const char* word, bool* contains);
 
+/**
+ * Determines whether or not a trie contains a key of the given length.
+ *
+ * @param trie trie to check
+ * @param key key for which to search
+ * @param length length of key in bytes
+ * @param contains (out) set to true if the key was found, false otherwise.
+ *        Always false if length is zero
+ * @return as for trie_contains_word()
+ */
+trie_result_t trie_contains_key(trie_t* trie, const char* key, size_t length,
+    bool* contains);
+
+/**
+ * Retrieves the value associated with a word contained within a trie.
+ *
+ * @param trie trie to search
+ * @param word word for which to search
+ * @param value (out) set to the value associated with the word by trie_put(),
+ *        or to NULL if it was added without one. Left unchanged if the word
+ *        was not found
+ * @return TRIE_SUCCESS if the word was found, TRIE_NULL if trie is NULL,
+ *         TRIE_WORD_NULL if word is NULL, TRIE_UNSUPPORTED if trie is
+ *         read-only (read-only tries do not hold values) or TRIE_NOT_FOUND if
+ *         the trie does not contain the word, which is always the case if word
+ *         is an empty string
+ */
+trie_result_t trie_get(trie_t* trie, const char* word, void** value);
+
+/**
+ * Retrieves the value associated with a key of the given length contained
+ * within a trie, as trie_get() does for a word.
+ *
+ * @param trie trie to search
+ * @param key key for which to search
+ * @param length length of key in bytes
+ * @param value (out) set to the value associated with the key
+ * @return as for trie_get()
+ */
+trie_result_t trie_get_key(trie_t* trie, const char* key, size_t length,
+    void** value);
+
+/**
+ * Finds the longest word contained within a trie which is a prefix of an
+ * input, as needed for routing by prefix or greedy tokenization. The path of
+ * the input is followed once, noting each word ended on the way, so the
+ * search costs a single lookup however many words match.
+ *
+ * @param trie trie to search
+ * @param input input whose prefixes to search for, which need not end in a
+ *        NUL
+ * @param length length of input in bytes
+ * @param match_length (out) set to the length of the longest word which is a
+ *        prefix of input, or to zero if there is none
+ * @return TRIE_SUCCESS if the search was successful, TRIE_NULL if trie is NULL
+ *         or TRIE_WORD_NULL if input is NULL
+ */
+trie_result_t trie_longest_prefix_match(trie_t* trie, const char* input,
+    size_t length, size_t* match_length);
+
+/**
+ * Finds every word contained within a trie which is a prefix of an input,
+ * shortest first, in a single lookup as trie_longest_prefix_match() does.
+ * The number of words found is bounded by the length of the output array.
+ *
+ * @param trie trie to search
+ * @param input input whose prefixes to search for, which need not end in a
+ *        NUL
+ * @param length length of input in bytes
+ * @param match_lengths (out) an array into which to write the length of each
+ *        word found
+ * @param match_lengths_length the length of the match_lengths array
+ * @param match_count (out) set to the number of words found. This will never
+ *        be greater than match_lengths_length
+ * @return TRIE_SUCCESS if the search was successful, TRIE_NULL if trie is
+ *         NULL, TRIE_WORD_NULL if input is NULL or TRIE_WORDS_LENGTH_ZERO if
+ *         match_lengths_length is zero
+ */
+trie_result_t trie_prefix_matches(trie_t* trie, const char* input,
+    size_t length, size_t* match_lengths, size_t match_lengths_length,
+    size_t* match_count);
+
+/**
+ * Determines which of a batch of words a trie contains. Gives the same
+ * results as calling trie_contains_word() for each word, but many times
+ * faster for large batches: the lookups are interleaved, so the memory each
+ * one is about to read is prefetched while the others proceed. Independent
+ * batches, such as parts of one large batch, may be looked up from several
+ * threads at once, provided the trie is concurrent or not being changed.
+ *
+ * @param trie trie to check
+ * @param words words for which to search
+ * @param n number of words
+ * @param contains (out) an array of n elements, each set to true if the
+ *        corresponding word was found, false otherwise
+ * @return TRIE_SUCCESS if the search was successful, TRIE_NULL if trie is NULL
+ *         or TRIE_WORD_NULL if words or any word is NULL
+ */
+trie_result_t trie_contains_words_batch(trie_t* trie, const char** words,
+    size_t n, bool* contains);
+
+/**
+ * Determines which of a batch of keys a trie contains, as
+ * trie_contains_words_batch() does for words.
+ *
+ * @param trie trie to check
+ * @param keys keys for which to search
+ * @param lengths an array of n elements giving the length of each key in bytes
+ * @param n number of keys
+ * @param contains (out) an array of n elements, each set to true if the
+ *        corresponding key was found, false otherwise
+ * @return TRIE_SUCCESS if the search was successful, TRIE_NULL if trie is NULL
+ *         or TRIE_WORD_NULL if keys, lengths or any key is NULL
+ */
+trie_result_t trie_contains_keys_batch(trie_t* trie, const char** keys,
+    const size_t* lengths, size_t n, bool* contains);
+
 /**
  * Retrieves words contained within a trie which start with the specified
- * prefix. The number of words retrieved is bounded by the length of the
- * specified output array.
+ * prefix, in byte order. The number of words retrieved is bounded by the
+ * length of the specified output array. Stored words end at their first NUL,
+ * so keys holding NUL bytes should be retrieved by
+ * trie_copy_keys_matching_prefix() instead.
  *
  * @param trie trie to search
  * @param prefix the prefix for which to search
@@ -70,22 +520,945 @@ trie_result_t trie_contains_word(trie_t* trie, const char* word, bool* contains)
  *        never be greater than words_length
  * @return TRIE_SUCCESS if the search was successful, TRIE_NULL if trie is NULL,
  *         TRIE_PREFIX_NULL if prefix is NULL, TRIE_PREFIX_EMPTY if prefix is an
- *         empty string or TRIE_WORDS_LENGTH_ZERO if words_length is zero
+ *         empty string, TRIE_WORDS_LENGTH_ZERO if words_length is zero or
+ *         TRIE_WORDS_NOT_STORED if the trie does not store words
  */
 trie_result_t trie_get_words_matching_prefix(trie_t* trie, const char* prefix,
     const char** words, size_t words_length, size_t* word_count);
 
 /**
- * Destroys a trie created by a call to trie_create().
+ * Copies words contained within a trie which start with the specified prefix
+ * into a buffer, in byte order. Words are reconstructed from the structure of
+ * the trie, so this works whether or not the trie stores words. Each word is
+ * followed by a NUL in the buffer. The number of words copied is bounded by
+ * the length of the spans array and by the room left in the buffer.
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search
+ * @param buffer (out) buffer into which to copy the words
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array into which to write the location of each word
+ *        within buffer
+ * @param spans_length the length of the spans array
+ * @param word_count (out) set to the number of words copied. This will never
+ *        be greater than spans_length
+ * @return TRIE_SUCCESS if the search was successful, TRIE_NULL if trie is NULL,
+ *         TRIE_PREFIX_NULL if prefix is NULL, TRIE_PREFIX_EMPTY if prefix is an
+ *         empty string, TRIE_WORDS_LENGTH_ZERO if spans_length is zero or
+ *         TRIE_BUFFER_LENGTH_ZERO if buffer_length is zero
+ */
+trie_result_t trie_copy_words_matching_prefix(trie_t* trie,
+    const char* prefix, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, size_t spans_length, size_t* word_count);
+
+/**
+ * Copies keys contained within a trie which start with a prefix of the given
+ * length into a buffer, as trie_copy_words_matching_prefix() does for words.
+ * The span of each key gives its length, so keys holding NUL bytes are copied
+ * whole.
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search
+ * @param prefix_length length of prefix in bytes
+ * @param buffer (out) buffer into which to copy the keys
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array into which to write the location of each key
+ *        within buffer
+ * @param spans_length the length of the spans array
+ * @param key_count (out) set to the number of keys copied
+ * @return as for trie_copy_words_matching_prefix(), with TRIE_PREFIX_EMPTY if
+ *         prefix_length is zero
+ */
+trie_result_t trie_copy_keys_matching_prefix(trie_t* trie,
+    const char* prefix, size_t prefix_length, char* buffer,
+    size_t buffer_length, trie_word_span_t* spans, size_t spans_length,
+    size_t* key_count);
+
+/**
+ * Copies the words contained within a trie which start with the specified
+ * prefix into a buffer together with their values, as
+ * trie_copy_words_matching_prefix() does, so that the (word, value) pairs
+ * under a prefix are found in a single traversal.
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search
+ * @param buffer (out) buffer into which to copy the words
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array into which to write the location of each word
+ *        within buffer
+ * @param values (out) an array of the same length as spans into which to
+ *        write the value of each word
+ * @param spans_length the length of the spans and values arrays
+ * @param entry_count (out) set to the number of words copied. This will never
+ *        be greater than spans_length
+ * @return as for trie_copy_words_matching_prefix(), or TRIE_UNSUPPORTED if
+ *         trie is read-only (read-only tries do not hold values)
+ */
+trie_result_t trie_copy_entries_matching_prefix(trie_t* trie,
+    const char* prefix, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, void** values, size_t spans_length,
+    size_t* entry_count);
+
+/**
+ * Copies the keys contained within a trie which start with a prefix of the
+ * given length into a buffer together with their values, as
+ * trie_copy_entries_matching_prefix() does for words.
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search
+ * @param prefix_length length of prefix in bytes
+ * @param buffer (out) buffer into which to copy the keys
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array into which to write the location of each key
+ *        within buffer
+ * @param values (out) an array into which to write the value of each key
+ * @param spans_length the length of the spans and values arrays
+ * @param entry_count (out) set to the number of keys copied
+ * @return as for trie_copy_entries_matching_prefix(), with TRIE_PREFIX_EMPTY
+ *         if prefix_length is zero
+ */
+trie_result_t trie_copy_key_entries_matching_prefix(trie_t* trie,
+    const char* prefix, size_t prefix_length, char* buffer,
+    size_t buffer_length, trie_word_span_t* spans, void** values,
+    size_t spans_length, size_t* entry_count);
+
+/**
+ * Copies the k words of greatest weight contained within a trie which start
+ * with the specified prefix into a buffer, in descending order of weight.
+ * Each node records the greatest weight of any word below it, so only nodes
+ * which may lead to one of those words are visited. Words are copied as by
+ * trie_copy_words_matching_prefix(), and fewer than k are copied if there is
+ * no room for more in the buffer.
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search
+ * @param buffer (out) buffer into which to copy the words
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array of length k into which to write the location of
+ *        each word within buffer
+ * @param weights (out) an array of length k into which to write the weight of
+ *        each word, or NULL
+ * @param k the greatest number of words to copy
+ * @param word_count (out) set to the number of words copied. This will never
+ *        be greater than k
+ * @return TRIE_SUCCESS if the search was successful, TRIE_NULL if trie is NULL,
+ *         TRIE_PREFIX_NULL if prefix is NULL, TRIE_PREFIX_EMPTY if prefix is an
+ *         empty string, TRIE_WORDS_LENGTH_ZERO if k is zero,
+ *         TRIE_BUFFER_LENGTH_ZERO if buffer_length is zero, TRIE_UNSUPPORTED
+ *         if trie is read-only (read-only tries do not hold weights) or
+ *         TRIE_MALLOC_FAIL if memory allocation failed
+ */
+trie_result_t trie_top_k_matching_prefix(trie_t* trie, const char* prefix,
+    char* buffer, size_t buffer_length, trie_word_span_t* spans,
+    uint32_t* weights, size_t k, size_t* word_count);
+
+/**
+ * Copies the k keys of greatest weight contained within a trie which start
+ * with a prefix of the given length into a buffer, as
+ * trie_top_k_matching_prefix() does for words.
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search
+ * @param prefix_length length of prefix in bytes
+ * @param buffer (out) buffer into which to copy the keys
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array of length k into which to write the location of
+ *        each key within buffer
+ * @param weights (out) an array of length k into which to write the weight of
+ *        each key, or NULL
+ * @param k the greatest number of keys to copy
+ * @param key_count (out) set to the number of keys copied
+ * @return as for trie_top_k_matching_prefix(), with TRIE_PREFIX_EMPTY if
+ *         prefix_length is zero
+ */
+trie_result_t trie_top_k_keys_matching_prefix(trie_t* trie,
+    const char* prefix, size_t prefix_length, char* buffer,
+    size_t buffer_length, trie_word_span_t* spans, uint32_t* weights,
+    size_t k, size_t* key_count);
+
+/**
+ * Copies the words contained within a trie within an edit distance of a
+ * query into a buffer, in order of distance and, among words at the same
+ * distance, in byte order. The distance is the least number of single byte
+ * insertions, deletions and substitutions turning one into the other. Only
+ * the paths which may lead to a word within max_edits of the query are
+ * visited, so the search stays fast for small distances. Words are copied as
+ * by trie_copy_words_matching_prefix(), and fewer than n are copied if there
+ * is no room for more in the buffer.
+ *
+ * @param trie trie to search
+ * @param query the word for which to search
+ * @param max_edits the greatest distance of any word copied
+ * @param buffer (out) buffer into which to copy the words
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array of length n into which to write the location of
+ *        each word within buffer
+ * @param distances (out) an array of length n into which to write the
+ *        distance of each word from query, or NULL
+ * @param n the greatest number of words to copy
+ * @param word_count (out) set to the number of words copied. This will never
+ *        be greater than n
+ * @return TRIE_SUCCESS if the search was successful, TRIE_NULL if trie is NULL,
+ *         TRIE_WORD_NULL if query is NULL, TRIE_WORD_EMPTY if query is an
+ *         empty string, TRIE_WORDS_LENGTH_ZERO if n is zero,
+ *         TRIE_BUFFER_LENGTH_ZERO if buffer_length is zero, TRIE_UNSUPPORTED
+ *         if trie is read-only or TRIE_MALLOC_FAIL if memory allocation
+ *         failed
+ */
+trie_result_t trie_fuzzy_search(trie_t* trie, const char* query,
+    uint32_t max_edits, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, uint32_t* distances, size_t n,
+    size_t* word_count);
+
+/**
+ * Copies the keys contained within a trie within an edit distance of a query
+ * of the given length into a buffer, as trie_fuzzy_search() does for words.
+ *
+ * @param trie trie to search
+ * @param query the key for which to search
+ * @param length length of query in bytes
+ * @param max_edits the greatest distance of any key copied
+ * @param buffer (out) buffer into which to copy the keys
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array of length n into which to write the location of
+ *        each key within buffer
+ * @param distances (out) an array of length n into which to write the
+ *        distance of each key from query, or NULL
+ * @param n the greatest number of keys to copy
+ * @param key_count (out) set to the number of keys copied
+ * @return as for trie_fuzzy_search(), with TRIE_WORD_EMPTY if length is zero
+ */
+trie_result_t trie_fuzzy_search_key(trie_t* trie, const char* query,
+    size_t length, uint32_t max_edits, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, uint32_t* distances, size_t n,
+    size_t* key_count);
+
+/**
+ * Copies the words contained within a trie which start with a prefix within
+ * an edit distance of the specified prefix into a buffer, as needed to
+ * complete words while tolerating typos. The distance of a word is the least
+ * distance of any of its prefixes, and words are copied in order of distance
+ * as by trie_fuzzy_search().
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search
+ * @param max_edits the greatest distance of any word copied
+ * @param buffer (out) buffer into which to copy the words
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array of length n into which to write the location of
+ *        each word within buffer
+ * @param distances (out) an array of length n into which to write the
+ *        distance of each word, or NULL
+ * @param n the greatest number of words to copy
+ * @param word_count (out) set to the number of words copied. This will never
+ *        be greater than n
+ * @return as for trie_fuzzy_search(), with TRIE_PREFIX_NULL if prefix is NULL
+ *         and TRIE_PREFIX_EMPTY if prefix is an empty string
+ */
+trie_result_t trie_fuzzy_prefix_search(trie_t* trie, const char* prefix,
+    uint32_t max_edits, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, uint32_t* distances, size_t n,
+    size_t* word_count);
+
+/**
+ * Copies the keys contained within a trie which start with a prefix within
+ * an edit distance of a prefix of the given length into a buffer, as
+ * trie_fuzzy_prefix_search() does for words.
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search
+ * @param prefix_length length of prefix in bytes
+ * @param max_edits the greatest distance of any key copied
+ * @param buffer (out) buffer into which to copy the keys
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array of length n into which to write the location of
+ *        each key within buffer
+ * @param distances (out) an array of length n into which to write the
+ *        distance of each key, or NULL
+ * @param n the greatest number of keys to copy
+ * @param key_count (out) set to the number of keys copied
+ * @return as for trie_fuzzy_prefix_search(), with TRIE_PREFIX_EMPTY if
+ *         prefix_length is zero
+ */
+trie_result_t trie_fuzzy_prefix_search_key(trie_t* trie, const char* prefix,
+    size_t prefix_length, uint32_t max_edits, char* buffer,
+    size_t buffer_length, trie_word_span_t* spans, uint32_t* distances,
+    size_t n, size_t* key_count);
+
+/**
+ * Copies the words contained within a trie matching a pattern into a buffer,
+ * in byte order. In the pattern, '?' matches any single byte, '*' matches
+ * any number of bytes, including none, and a class such as "[a-cx]" matches a
+ * single byte of those listed, or with a leading '^', a byte not listed. A
+ * ']' first in a class is taken literally, and a '\' makes the byte after
+ * it literal, both in and out of classes. Only the branches of the trie which
+ * may lead to a match are visited, so patterns with few wildcards near their
+ * start are fast. Words are copied as by trie_copy_words_matching_prefix(),
+ * and fewer than n are copied if there is no room for more in the buffer.
+ *
+ * @param trie trie to search
+ * @param pattern the pattern the words must match
+ * @param buffer (out) buffer into which to copy the words
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array of length n into which to write the location of
+ *        each word within buffer
+ * @param n the greatest number of words to copy
+ * @param word_count (out) set to the number of words copied. This will never
+ *        be greater than n
+ * @return TRIE_SUCCESS if the search was successful, TRIE_NULL if trie is NULL,
+ *         TRIE_WORD_NULL if pattern is NULL, TRIE_WORD_EMPTY if pattern is an
+ *         empty string, TRIE_WORDS_LENGTH_ZERO if n is zero,
+ *         TRIE_BUFFER_LENGTH_ZERO if buffer_length is zero, TRIE_UNSUPPORTED
+ *         if trie is read-only, TRIE_PATTERN_INVALID if a class is not closed
+ *         or the pattern ends in '\', or TRIE_MALLOC_FAIL if memory
+ *         allocation failed
+ */
+trie_result_t trie_match_pattern(trie_t* trie, const char* pattern,
+    char* buffer, size_t buffer_length, trie_word_span_t* spans, size_t n,
+    size_t* word_count);
+
+/**
+ * Copies the keys contained within a trie matching a pattern of the given
+ * length into a buffer, as trie_match_pattern() does for words.
+ *
+ * @param trie trie to search
+ * @param pattern the pattern the keys must match
+ * @param pattern_length length of pattern in bytes
+ * @param buffer (out) buffer into which to copy the keys
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array of length n into which to write the location of
+ *        each key within buffer
+ * @param n the greatest number of keys to copy
+ * @param key_count (out) set to the number of keys copied
+ * @return as for trie_match_pattern(), with TRIE_WORD_EMPTY if pattern_length
+ *         is zero
+ */
+trie_result_t trie_match_pattern_key(trie_t* trie, const char* pattern,
+    size_t pattern_length, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, size_t n, size_t* key_count);
+
+/**
+ * Copies the words contained within a trie from low up to but not including
+ * high into a buffer, in byte order. Only the paths of the bounds are
+ * compared against, so a page of a range costs little more than copying it,
+ * and the next page starts from the successor of the last word copied. Words
+ * are copied as by trie_copy_words_matching_prefix().
+ *
+ * @param trie trie to search
+ * @param low the least word to copy, or NULL to start from the first word
+ * @param high the word at which to stop, or NULL to go on to the last word
+ * @param buffer (out) buffer into which to copy the words
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array of length n into which to write the location of
+ *        each word within buffer
+ * @param n the greatest number of words to copy
+ * @param word_count (out) set to the number of words copied. This will never
+ *        be greater than n
+ * @return TRIE_SUCCESS if the search was successful, TRIE_NULL if trie is NULL,
+ *         TRIE_WORDS_LENGTH_ZERO if n is zero, TRIE_BUFFER_LENGTH_ZERO if
+ *         buffer_length is zero or TRIE_UNSUPPORTED if trie is read-only
+ */
+trie_result_t trie_range(trie_t* trie, const char* low, const char* high,
+    char* buffer, size_t buffer_length, trie_word_span_t* spans, size_t n,
+    size_t* word_count);
+
+/**
+ * Copies the keys contained within a trie from low up to but not including
+ * high into a buffer, as trie_range() does for words.
+ *
+ * @param trie trie to search
+ * @param low the least key to copy, or NULL to start from the first key
+ * @param low_length length of low in bytes
+ * @param high the key at which to stop, or NULL to go on to the last key
+ * @param high_length length of high in bytes
+ * @param buffer (out) buffer into which to copy the keys
+ * @param buffer_length the length of buffer in bytes
+ * @param spans (out) an array of length n into which to write the location of
+ *        each key within buffer
+ * @param n the greatest number of keys to copy
+ * @param key_count (out) set to the number of keys copied
+ * @return as for trie_range()
+ */
+trie_result_t trie_range_key(trie_t* trie, const char* low, size_t low_length,
+    const char* high, size_t high_length, char* buffer, size_t buffer_length,
+    trie_word_span_t* spans, size_t n, size_t* key_count);
+
+/**
+ * Finds the first word contained within a trie which comes after a word in
+ * byte order, whether or not that word is itself contained, and copies it
+ * into a buffer followed by a NUL.
+ *
+ * @param trie trie to search
+ * @param word the word whose successor to find. This may be an empty string
+ * @param buffer (out) buffer into which to copy the successor
+ * @param buffer_length the length of buffer in bytes
+ * @return TRIE_SUCCESS if a successor was found, TRIE_NULL if trie is NULL,
+ *         TRIE_WORD_NULL if word is NULL, TRIE_BUFFER_LENGTH_ZERO if
+ *         buffer_length is zero, TRIE_UNSUPPORTED if trie is read-only,
+ *         TRIE_WORD_TOO_LONG if there is no room in buffer for the successor
+ *         or TRIE_NOT_FOUND if no word comes after word
+ */
+trie_result_t trie_successor(trie_t* trie, const char* word, char* buffer,
+    size_t buffer_length);
+
+/**
+ * Finds the first key contained within a trie which comes after a key of the
+ * given length, as trie_successor() does for words.
+ *
+ * @param trie trie to search
+ * @param key the key whose successor to find
+ * @param length length of key in bytes
+ * @param buffer (out) buffer into which to copy the successor
+ * @param buffer_length the length of buffer in bytes
+ * @param successor_length (out) set to the length of the successor in bytes
+ * @return as for trie_successor()
+ */
+trie_result_t trie_successor_key(trie_t* trie, const char* key, size_t length,
+    char* buffer, size_t buffer_length, size_t* successor_length);
+
+/**
+ * Finds the last word contained within a trie which comes before a word in
+ * byte order, whether or not that word is itself contained, and copies it
+ * into a buffer followed by a NUL.
+ *
+ * @param trie trie to search
+ * @param word the word whose predecessor to find
+ * @param buffer (out) buffer into which to copy the predecessor
+ * @param buffer_length the length of buffer in bytes
+ * @return as for trie_successor(), with TRIE_NOT_FOUND if no word comes
+ *         before word
+ */
+trie_result_t trie_predecessor(trie_t* trie, const char* word, char* buffer,
+    size_t buffer_length);
+
+/**
+ * Finds the last key contained within a trie which comes before a key of the
+ * given length, as trie_predecessor() does for words.
+ *
+ * @param trie trie to search
+ * @param key the key whose predecessor to find
+ * @param length length of key in bytes
+ * @param buffer (out) buffer into which to copy the predecessor
+ * @param buffer_length the length of buffer in bytes
+ * @param predecessor_length (out) set to the length of the predecessor in
+ *        bytes
+ * @return as for trie_predecessor()
+ */
+trie_result_t trie_predecessor_key(trie_t* trie, const char* key,
+    size_t length, char* buffer, size_t buffer_length,
+    size_t* predecessor_length);
+
+/**
+ * Finds the number of words contained within a trie which come before a word
+ * in byte order, whether or not that word is itself contained. This is the
+ * index of the word in byte order if it is contained. Since the words
+ * starting with a prefix are contiguous in byte order, the rank of a prefix
+ * together with trie_select() pages through its completions at random. Takes
+ * time proportional to the length of word times the number of children of
+ * each node on its path, except in a concurrent trie, which does not keep the
+ * counts of words below its nodes. Of the read-only tries, only a DAWG, which
+ * keeps the counts of words below its states, is supported.
+ *
+ * @param trie trie to search
+ * @param word the word whose rank to find. This may be an empty string
+ * @param rank (out) set to the number of words before word
+ * @return TRIE_SUCCESS if the rank was found, TRIE_NULL if trie is NULL,
+ *         TRIE_WORD_NULL if word is NULL or TRIE_UNSUPPORTED if trie is
+ *         read-only and not a DAWG
+ */
+trie_result_t trie_rank(trie_t* trie, const char* word, size_t* rank);
+
+/**
+ * Finds the number of keys contained within a trie which come before a key of
+ * the given length, as trie_rank() does for words.
+ *
+ * @param trie trie to search
+ * @param key the key whose rank to find
+ * @param length length of key in bytes
+ * @param rank (out) set to the number of keys before key
+ * @return as for trie_rank()
+ */
+trie_result_t trie_rank_key(trie_t* trie, const char* key, size_t length,
+    size_t* rank);
+
+/**
+ * Finds the word contained within a trie at an index in byte order, and copies
+ * it into a buffer followed by a NUL. Takes time as for trie_rank().
+ *
+ * @param trie trie to search
+ * @param index the index of the word, from zero
+ * @param buffer (out) buffer into which to copy the word
+ * @param buffer_length the length of buffer in bytes
+ * @return TRIE_SUCCESS if the word was found, TRIE_NULL if trie is NULL,
+ *         TRIE_BUFFER_LENGTH_ZERO if buffer_length is zero, TRIE_UNSUPPORTED
+ *         if trie is read-only and not a DAWG, TRIE_WORD_TOO_LONG if there is
+ *         no room in buffer for the word or TRIE_NOT_FOUND if index is not
+ *         less than the number of words
+ */
+trie_result_t trie_select(trie_t* trie, size_t index, char* buffer,
+    size_t buffer_length);
+
+/**
+ * Finds the key contained within a trie at an index in byte order, as
+ * trie_select() does for words.
+ *
+ * @param trie trie to search
+ * @param index the index of the key, from zero
+ * @param buffer (out) buffer into which to copy the key
+ * @param buffer_length the length of buffer in bytes
+ * @param key_length (out) set to the length of the key in bytes
+ * @return as for trie_select()
+ */
+trie_result_t trie_select_key(trie_t* trie, size_t index, char* buffer,
+    size_t buffer_length, size_t* key_length);
+
+/**
+ * Returns the number of bytes of memory needed by a cursor over words of up
+ * to max_word_length bytes.
+ *
+ * @param max_word_length the length of the longest word the cursor can visit
+ * @return the number of bytes to pass to trie_cursor_open()
+ */
+size_t trie_cursor_size(size_t max_word_length);
+
+/**
+ * Opens a cursor over the words contained within a trie which start with the
+ * specified prefix, in byte order. The cursor lives entirely within memory
+ * supplied by the caller, which must be at least trie_cursor_size() bytes and
+ * aligned as for any object (as memory returned by malloc() is), and it
+ * never allocates memory. It resumes where it left off on each call to
+ * trie_cursor_next(), so paging through many words takes time proportional
+ * to the number of words visited. The trie must not be modified while the
+ * cursor is open.
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search, which may be an empty string
+ *        to visit every word
+ * @param max_word_length the length of the longest word the cursor can visit
+ * @param memory memory in which to hold the cursor
+ * @param memory_length the length of memory in bytes
+ * @param cursor (out) set to the opened cursor
+ * @return TRIE_SUCCESS if the cursor was opened, TRIE_NULL if trie is NULL,
+ *         TRIE_PREFIX_NULL if prefix is NULL, TRIE_CURSOR_MEMORY_TOO_SMALL if
+ *         memory is NULL or shorter than trie_cursor_size(max_word_length),
+ *         TRIE_UNSUPPORTED if trie is read-only or TRIE_WORD_TOO_LONG if
+ *         prefix, or every word matching it, is longer than max_word_length
+ */
+trie_result_t trie_cursor_open(trie_t* trie, const char* prefix,
+    size_t max_word_length, void* memory, size_t memory_length,
+    trie_cursor_t** cursor);
+
+/**
+ * Opens a cursor over the keys contained within a trie which start with a
+ * prefix of the given length, as trie_cursor_open() does for words.
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search
+ * @param prefix_length length of prefix in bytes, which may be zero to visit
+ *        every key
+ * @param max_word_length the length of the longest key the cursor can visit
+ * @param memory memory in which to hold the cursor
+ * @param memory_length the length of memory in bytes
+ * @param cursor (out) set to the opened cursor
+ * @return as for trie_cursor_open()
+ */
+trie_result_t trie_cursor_open_key(trie_t* trie, const char* prefix,
+    size_t prefix_length, size_t max_word_length, void* memory,
+    size_t memory_length, trie_cursor_t** cursor);
+
+/**
+ * Advances a cursor to the next word.
+ *
+ * @param cursor the cursor to advance
+ * @param word (out) set to the next word, or to NULL if there are no more
+ *        words. The word is held within the memory of the cursor, and is
+ *        only valid until the cursor is next used
+ * @return TRIE_SUCCESS if the cursor was advanced, TRIE_NULL if cursor is
+ *         NULL or TRIE_WORD_TOO_LONG if the next word is longer than the
+ *         cursor allows, in which case advancing again skips that word
+ */
+trie_result_t trie_cursor_next(trie_cursor_t* cursor, const char** word);
+
+/**
+ * Advances a cursor to the next key, as trie_cursor_next() does, also giving
+ * the length of the key.
+ *
+ * @param cursor the cursor to advance
+ * @param key (out) set to the next key, or to NULL if there are no more keys
+ * @param length (out) set to the length of the key in bytes, or to zero if
+ *        there are no more keys
+ * @return as for trie_cursor_next()
+ */
+trie_result_t trie_cursor_next_key(trie_cursor_t* cursor, const char** key,
+    size_t* length);
+
+/**
+ * Moves a cursor so that it is next advanced to the first word matching its
+ * prefix which is not before the specified word in byte order.
+ *
+ * @param cursor the cursor to move
+ * @param word the word to which to move
+ * @return TRIE_SUCCESS if the cursor was moved, TRIE_NULL if cursor is NULL,
+ *         TRIE_WORD_NULL if word is NULL or TRIE_WORD_TOO_LONG if word is
+ *         longer than the cursor allows
+ */
+trie_result_t trie_cursor_seek(trie_cursor_t* cursor, const char* word);
+
+/**
+ * Moves a cursor so that it is next advanced to the first key matching its
+ * prefix which is not before the specified key in byte order.
+ *
+ * @param cursor the cursor to move
+ * @param key the key to which to move
+ * @param length length of key in bytes
+ * @return as for trie_cursor_seek()
+ */
+trie_result_t trie_cursor_seek_key(trie_cursor_t* cursor, const char* key,
+    size_t length);
+
+/**
+ * Closes a cursor, after which its memory may be reused.
+ *
+ * @param cursor the cursor to close
+ * @return whether or not the closing was successful
+ */
+trie_result_t trie_cursor_close(trie_cursor_t* cursor);
+
+/**
+ * Saves a trie to a file which can later be opened with trie_open_mapped().
+ * The file holds a copy of each word only if the trie stores words. A trie
+ * created by trie_freeze_to_louds() is saved as it is held in memory. Files
+ * are limited to 4 GiB and can only be opened on machines with the same byte
+ * order.
+ *
+ * @param trie trie to save
+ * @param path path of the file to which to save the trie, which is replaced
+ *        if it already exists
+ * @return TRIE_SUCCESS if the trie was saved, TRIE_NULL if trie is NULL,
+ *         TRIE_PATH_NULL if path is NULL, TRIE_UNSUPPORTED if trie was
+ *         created by trie_freeze_to_dawg() or trie_freeze_to_double_array()
+ *         or TRIE_FILE_ERROR if the file could not be written or the trie is
+ *         too large to save
+ */
+trie_result_t trie_save(trie_t* trie, const char* path);
+
+/**
+ * Opens a trie saved by trie_save() by mapping its file into memory. The trie
+ * is queried in place, without being loaded, and its pages are shared between
+ * all processes which open the same file. Opening reads through the file once
+ * to check that it is intact, so that a truncated or corrupt file is
+ * rejected rather than read beyond its end. The trie is read-only: words
+ * cannot be added to it. A file saved from a trie created by
+ * trie_freeze_to_louds() opens as such a trie. To prevent resource leakage,
+ * each call to this function must be matched by a call to trie_destroy().
+ *
+ * @param path path of the file to open
+ * @param trie (out) set to the opened trie
+ * @return TRIE_SUCCESS if the trie was opened, TRIE_PATH_NULL if path is
+ *         NULL, TRIE_FILE_ERROR if the file could not be opened or mapped,
+ *         TRIE_FILE_INVALID if the file is not an intact trie file saved on a
+ *         machine with the same byte order or TRIE_MALLOC_FAIL if memory
+ *         allocation failed
+ */
+trie_result_t trie_open_mapped(const char* path, trie_t** trie);
+
+/**
+ * Counts the words contained within a trie which start with the specified
+ * prefix. Each node of a trie made up of nodes keeps the number of words
+ * below it, so this takes time proportional to the length of the prefix,
+ * except in a concurrent trie, where the words below the prefix are counted
+ * one by one.
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search
+ * @param word_count (out) set to the number of words starting with prefix
+ * @return TRIE_SUCCESS if the count was successful, TRIE_NULL if trie is NULL,
+ *         TRIE_PREFIX_NULL if prefix is NULL or TRIE_PREFIX_EMPTY if prefix
+ *         is an empty string
+ */
+trie_result_t trie_count_prefix(trie_t* trie, const char* prefix,
+    size_t* word_count);
+
+/**
+ * Counts the keys contained within a trie which start with a prefix of the
+ * given length.
+ *
+ * @param trie trie to search
+ * @param prefix the prefix for which to search
+ * @param prefix_length length of prefix in bytes
+ * @param key_count (out) set to the number of keys starting with prefix
+ * @return as for trie_count_prefix(), with TRIE_PREFIX_EMPTY if prefix_length
+ *         is zero
+ */
+trie_result_t trie_count_keys_matching_prefix(trie_t* trie,
+    const char* prefix, size_t prefix_length, size_t* key_count);
+
+/**
+ * Gathers statistics on the memory use and shape of a trie made up of nodes,
+ * visiting every node. In a concurrent trie this counts as a query, and
+ * words added while it runs may or may not be included.
+ *
+ * @param trie trie to examine
+ * @param stats (out) set to the statistics of trie
+ * @return TRIE_SUCCESS if the statistics were gathered, TRIE_NULL if trie or
+ *         stats is NULL or TRIE_UNSUPPORTED if trie is read-only
+ */
+trie_result_t trie_get_stats(trie_t* trie, trie_stats_t* stats);
+
+/**
+ * Creates a read-only copy of a trie as a minimal DAWG (directed acyclic word
+ * graph), in which words ending in the same suffixes share the nodes for
+ * those suffixes as well as sharing nodes for common prefixes. For a typical
+ * dictionary this takes a small fraction of the memory of the trie. The DAWG
+ * does not store words, so trie_copy_words_matching_prefix() must be used to
+ * retrieve them, but it counts words matching a prefix without visiting them,
+ * and supports trie_rank() and trie_select().
+ * The original trie is left unchanged. To prevent resource leakage, each call
+ * to this function must be matched by a call to trie_destroy().
+ *
+ * @param trie trie to copy
+ * @param dawg (out) set to the created DAWG
+ * @return TRIE_SUCCESS if the DAWG was created, TRIE_NULL if trie is NULL,
+ *         TRIE_UNSUPPORTED if trie is itself read-only or TRIE_MALLOC_FAIL
+ *         if memory allocation failed
+ */
+trie_result_t trie_freeze_to_dawg(trie_t* trie, trie_t** dawg);
+
+/**
+ * Creates a read-only copy of a trie held in a double array, in which
+ * following each byte of a word takes two array reads rather than a search
+ * of the children of a node. This makes trie_contains_word() as fast as
+ * possible, at the cost of more memory than the trie. The double array does
+ * not store words, so trie_copy_words_matching_prefix() must be used to
+ * retrieve them. The original trie is left unchanged. To prevent resource
+ * leakage, each call to this function must be matched by a call to
+ * trie_destroy().
+ *
+ * @param trie trie to copy
+ * @param double_array (out) set to the created double array
+ * @return TRIE_SUCCESS if the double array was created, TRIE_NULL if trie is
+ *         NULL, TRIE_UNSUPPORTED if trie is itself read-only or
+ *         TRIE_MALLOC_FAIL if memory allocation failed or the trie is too
+ *         large
+ */
+trie_result_t trie_freeze_to_double_array(trie_t* trie,
+    trie_t** double_array);
+
+/**
+ * Creates a read-only copy of a trie in a succinct LOUDS (level-order unary
+ * degree sequence) encoding, which takes about two bits plus a byte for each
+ * byte of each edge, so a little over a byte per node, and no pointers.
+ * Children are found by rank and select over the bits, so lookups are a few
+ * times slower than in the trie. The copy does not store words, so
+ * trie_copy_words_matching_prefix() must be used to retrieve them. It is held
+ * in a single block, which trie_save() writes out as it is and
+ * trie_open_mapped() queries in place. The original trie is left unchanged.
+ * To prevent resource leakage, each call to this function must be matched by
+ * a call to trie_destroy().
+ *
+ * @param trie trie to copy
+ * @param louds (out) set to the created copy
+ * @return TRIE_SUCCESS if the copy was created, TRIE_NULL if trie is NULL,
+ *         TRIE_UNSUPPORTED if trie is itself read-only or TRIE_MALLOC_FAIL
+ *         if memory allocation failed or the trie is too large
+ */
+trie_result_t trie_freeze_to_louds(trie_t* trie, trie_t** louds);
+
+/**
+ * Destroys a trie created by a call to trie_create(), trie_create_with_arena(),
+ * trie_create_with_options(), trie_build_from_sorted(), trie_builder_finish(),
+ * trie_freeze_to_dawg(), trie_freeze_to_double_array() or
+ * trie_freeze_to_louds(), or opened by a call to trie_open_mapped().
  *
  * @param trie the trie to destroy
  * @return whether or not the destruction was successful
  */
 trie_result_t trie_destroy(trie_t* trie);
 
+/**
+ * Creates a builder of a trie with the specified options. Words must be added
+ * in ascending byte order (the order given by strcmp()). Each node is created
+ * once, with all of its children known, so building a large trie this way is
+ * much faster than adding its words one at a time. To prevent resource
+ * leakage, each call to this function must be matched by a call to
+ * trie_builder_finish() or trie_builder_destroy().
+ *
+ * @param builder (out) set to the created builder
+ * @param options options for the trie being built
+ * @return TRIE_SUCCESS if the creation was successful or TRIE_MALLOC_FAIL if
+ *         memory allocation failed
+ */
+trie_result_t trie_builder_create(trie_builder_t** builder,
+    const trie_options_t* options);
+
+/**
+ * Creates a builder which streams a trie directly into a file in the format
+ * written by trie_save(), without holding the trie in memory. Words must be
+ * added in ascending byte order. If the builder is destroyed rather than
+ * finished, the file is removed.
+ *
+ * @param builder (out) set to the created builder
+ * @param path path of the file to which to write the trie, which is replaced
+ *        if it already exists
+ * @param store_words whether or not the file holds a copy of each word
+ * @return TRIE_SUCCESS if the creation was successful, TRIE_PATH_NULL if path
+ *         is NULL, TRIE_FILE_ERROR if the file could not be written or
+ *         TRIE_MALLOC_FAIL if memory allocation failed
+ */
+trie_result_t trie_builder_create_for_file(trie_builder_t** builder,
+    const char* path, bool store_words);
+
+/**
+ * Adds a word to the trie being built. Adding the same word again in
+ * succession has no effect.
+ *
+ * @param builder builder to which to add the word
+ * @param word word to add
+ * @return TRIE_SUCCESS if the addition was successful, TRIE_NULL if builder
+ *         is NULL, TRIE_WORD_NULL if word is NULL, TRIE_WORD_EMPTY if word
+ *         is an empty string, TRIE_WORDS_NOT_SORTED if word sorts before the
+ *         previously added word, TRIE_MALLOC_FAIL if memory allocation failed
+ *         or TRIE_FILE_ERROR if the file being built could not be written
+ */
+trie_result_t trie_builder_add_word(trie_builder_t* builder,
+    const char* word);
+
+/**
+ * Adds a key of the given length to the trie being built, as
+ * trie_builder_add_word() does for a word. Keys must be added in byte order,
+ * a key sorting after every key of which it is a prefix.
+ *
+ * @param builder builder to which to add the key
+ * @param key key to add
+ * @param length length of key in bytes
+ * @return as for trie_builder_add_word(), with TRIE_WORD_EMPTY if length is
+ *         zero
+ */
+trie_result_t trie_builder_add_key(trie_builder_t* builder,
+    const char* key, size_t length);
+
+/**
+ * Finishes building a trie and destroys the builder, whether or not finishing
+ * was successful.
+ *
+ * @param builder builder to finish
+ * @param trie (out) set to the built trie. For a builder created by
+ *        trie_builder_create_for_file(), set to the file opened by
+ *        trie_open_mapped(), unless trie is NULL
+ * @return TRIE_SUCCESS if the trie was built, TRIE_NULL if builder is NULL,
+ *         TRIE_MALLOC_FAIL if memory allocation failed, TRIE_FILE_ERROR if
+ *         the file being built could not be written or any result of
+ *         trie_open_mapped()
+ */
+trie_result_t trie_builder_finish(trie_builder_t* builder, trie_t** trie);
+
+/**
+ * Destroys a builder without finishing the trie being built.
+ *
+ * @param builder the builder to destroy
+ * @return whether or not the destruction was successful
+ */
+trie_result_t trie_builder_destroy(trie_builder_t* builder);
+
+/**
+ * Builds a trie which stores words from an array of words in ascending byte
+ * order. See trie_builder_create().
+ *
+ * @param words the words from which to build the trie
+ * @param n the number of words
+ * @param trie (out) set to the built trie
+ * @return TRIE_SUCCESS if the trie was built, TRIE_WORD_NULL if words or
+ *         any of its words is NULL, TRIE_WORD_EMPTY if any word is an empty
+ *         string, TRIE_WORDS_NOT_SORTED if the words are not sorted or
+ *         TRIE_MALLOC_FAIL if memory allocation failed
+ */
+trie_result_t trie_build_from_sorted(const char** words, size_t n,
+    trie_t** trie);
+
+/**
+ * Compiles an Aho-Corasick automaton from the words of a trie, which finds
+ * every occurrence of any of the words in a text in a single pass, in time
+ * proportional to the length of the text plus the number of occurrences. The
+ * value of each word (see trie_put()) is copied into the automaton, and the
+ * trie is left unchanged. To prevent resource leakage, each call to this
+ * function must be matched by a call to trie_automaton_destroy().
+ *
+ * @param trie trie whose words to find
+ * @param automaton (out) set to the compiled automaton
+ * @return TRIE_SUCCESS if the automaton was compiled, TRIE_NULL if trie is
+ *         NULL, TRIE_UNSUPPORTED if trie is read-only or TRIE_MALLOC_FAIL if
+ *         memory allocation failed or the automaton would be too large
+ */
+trie_result_t trie_automaton_create(trie_t* trie,
+    trie_automaton_t** automaton);
+
+/**
+ * Finds every occurrence of a word of an automaton in a text. For each
+ * occurrence the callback is given the offset of its first byte within the
+ * text, its length and the value of the word. Occurrences are reported in
+ * order of their last byte and, among those ending at the same byte, longest
+ * first. Occurrences may overlap.
+ *
+ * @param automaton automaton with which to scan
+ * @param text the text to scan, which need not end in a NUL
+ * @param length length of text in bytes
+ * @param callback function called for each occurrence
+ * @param context passed to each call of callback
+ * @return TRIE_SUCCESS if the scan was successful, TRIE_NULL if automaton or
+ *         callback is NULL or TRIE_WORD_NULL if text is NULL and length is
+ *         not zero
+ */
+trie_result_t trie_scan(const trie_automaton_t* automaton, const char* text,
+    size_t length,
+    void (*callback)(uint64_t offset, size_t length, void* value,
+        void* context),
+    void* context);
+
+/**
+ * Starts a scan of a stream of text which arrives in chunks, such as from a
+ * socket. See trie_scan_chunk().
+ *
+ * @param scan (out) the scan to start
+ * @return TRIE_SUCCESS if the scan was started or TRIE_NULL if scan is NULL
+ */
+trie_result_t trie_scan_begin(trie_scan_t* scan);
+
+/**
+ * Scans the next chunk of a stream of text, finding the occurrences of words
+ * as trie_scan() does, including those which began in earlier chunks. The
+ * offset of each occurrence is counted from the start of the stream. Chunks
+ * need not be kept once scanned, and independent scans may share one
+ * automaton across threads.
+ *
+ * @param automaton automaton with which to scan
+ * @param scan the scan to continue, started by trie_scan_begin()
+ * @param chunk the next chunk of text
+ * @param length length of chunk in bytes
+ * @param callback function called for each occurrence
+ * @param context passed to each call of callback
+ * @return TRIE_SUCCESS if the scan was successful, TRIE_NULL if automaton,
+ *         scan or callback is NULL or TRIE_WORD_NULL if chunk is NULL and
+ *         length is not zero
+ */
+trie_result_t trie_scan_chunk(const trie_automaton_t* automaton,
+    trie_scan_t* scan, const char* chunk, size_t length,
+    void (*callback)(uint64_t offset, size_t length, void* value,
+        void* context),
+    void* context);
+
+/**
+ * Destroys an automaton.
+ *
+ * @param automaton the automaton to destroy
+ * @return whether or not the destruction was successful
+ */
+trie_result_t trie_automaton_destroy(trie_automaton_t* automaton);
+
 /**
  * Sets a listener function which will be called every time a dynamic memory
  * allocation occurs.
+ * The listener may be set while other threads use tries, and may be called
+ * by several threads at once.
  *
  * @param listener allocation listener function to set
  */
@@ -94,9 +1467,37 @@ void trie_set_memory_allocation_listener(void (*listener)());
 /**
  * Sets a listener function which will be called every time a dynamic memory
  * deallocation occurs.
+ * The listener may be set while other threads use tries, and may be called
+ * by several threads at once.
  *
  * @param listener deallocation listener function to set
  */
 void trie_set_memory_deallocation_listener(void (*listener)());
 
+/**
+ * Sets a listener function which will be called every time a dynamic memory
+ * allocation occurs, with its size in bytes and what it holds, alongside any
+ * listener set by trie_set_memory_allocation_listener(). Files mapped into
+ * memory by trie_open_mapped() are not reported.
+ * The listener may be set while other threads use tries, and may be called
+ * by several threads at once.
+ *
+ * @param listener sized allocation listener function to set, or NULL
+ */
+void trie_set_sized_memory_allocation_listener(
+    void (*listener)(size_t size, trie_memory_category_t category));
+
+/**
+ * Sets a listener function which will be called every time a dynamic memory
+ * deallocation occurs, with the size and category the memory was allocated
+ * with, so that the bytes reported for each category balance once every
+ * trie is destroyed. Files mapped into memory are not reported.
+ * The listener may be set while other threads use tries, and may be called
+ * by several threads at once.
+ *
+ * @param listener sized deallocation listener function to set, or NULL
+ */
+void trie_set_sized_memory_deallocation_listener(
+    void (*listener)(size_t size, trie_memory_category_t category));
+
 #endif /* TRIE_H */